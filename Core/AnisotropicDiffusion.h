@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#ifndef NO_OPENMP_SUPPORT
+#	include <omp.h>
+#endif
+
+namespace iseg {
+
+namespace diffusion {
+
+enum eConductance {
+	kExponential, ///< exp(-(dI/k)^2), favors high contrast edges
+	kRational			///< 1 / (1 + (dI/k)^2), favors wide regions
+};
+
+/// Stores 1/k^2, a contrast k of 0 stops diffusion across any edge
+inline float InverseSquare(float k)
+{
+	return (k > 0) ? std::min(1.f / (k * k), std::numeric_limits<float>::max()) : std::numeric_limits<float>::max();
+}
+
+struct ExponentialConductance
+{
+	explicit ExponentialConductance(float k) : inv_k2(InverseSquare(k)) {}
+	float operator()(float d) const { return std::exp(-d * d * inv_k2); }
+	float inv_k2;
+};
+
+struct RationalConductance
+{
+	explicit RationalConductance(float k) : inv_k2(InverseSquare(k)) {}
+	float operator()(float d) const { return 1.f / (1.f + d * d * inv_k2); }
+	float inv_k2;
+};
+
+/// Flux g(a d) a^2 d between two voxels with difference d, a is the relative inverse spacing along the axis
+template<typename TConductance>
+inline float Flux(const TConductance& g, float d, float a)
+{
+	return g(d * a) * (a * a) * d;
+}
+
+} // namespace diffusion
+
+/** \brief Perona-Malik diffusion of a 2D (nrslices == 1) or 3D image with explicit time steps
+
+	Each step adds dt * restraint * (original - image) and the fluxes g(dI) dI between all pairs of 6-neighbors,
+	where dI is measured in units of the smallest spacing. If ax^2 + ay^2 + az^2 > 2 (a = smallest spacing / spacing),
+	the time step is scaled by 2 / (ax^2 + ay^2 + az^2), so the step is as stable as the 2D scheme with square pixels.
+
+	The image is updated in place: the slices are split into slabs which are processed in parallel, each slab
+	is swept row by row keeping the fluxes to the previous row and slice. The fluxes across slab borders are
+	computed first. The conductance is a template argument, so it is inlined into the row loops.
+*/
+template<typename TConductance>
+void AnisotropicDiffusion(float* const* images, const float* const* originals, size_t width, size_t height,
+		size_t nrslices, const float spacing[3], float dt, int iterations, float restraint, const TConductance& g)
+{
+	using diffusion::Flux;
+	const size_t area = width * height;
+	if (area == 0 || nrslices == 0)
+		return;
+
+	const float smin = (nrslices > 1) ? std::min(spacing[0], std::min(spacing[1], spacing[2])) : std::min(spacing[0], spacing[1]);
+	const float ax = (width > 1) ? smin / spacing[0] : 0.f;
+	const float ay = (height > 1) ? smin / spacing[1] : 0.f;
+	const float az = (nrslices > 1) ? smin / spacing[2] : 0.f;
+	const float asum = ax * ax + ay * ay + az * az;
+	const float tau = (asum > 2.f) ? dt * 2.f / asum : dt;
+
+#ifdef NO_OPENMP_SUPPORT
+	const size_t threads = 1;
+#else
+	const size_t threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+	const size_t nrslabs = std::min(nrslices, 4 * threads);
+	const size_t thickness = (nrslices + nrslabs - 1) / nrslabs;
+	const int n = static_cast<int>((nrslices + thickness - 1) / thickness);
+	const int nrborders = n - 1;
+
+	// flux from slice z1 - 1 to z1 at the upper border of each slab
+	std::vector<std::vector<float>> border(nrborders);
+
+	for (int it = 0; it < iterations; ++it)
+	{
+#pragma omp parallel for
+		for (int s = 0; s < nrborders; ++s)
+		{
+			const size_t z1 = (s + 1) * thickness;
+			const float* lower = images[z1 - 1];
+			const float* upper = images[z1];
+			border[s].resize(area);
+			for (size_t i = 0; i < area; ++i)
+			{
+				border[s][i] = Flux(g, upper[i] - lower[i], az);
+			}
+		}
+
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int s = 0; s < n; ++s)
+		{
+			const size_t z0 = s * thickness, z1 = std::min(z0 + thickness, nrslices);
+			// flux from the previous slice, from the previous row, to the next row, to the next slice
+			std::vector<float> fz_prev(area, 0.f), fy_prev(width), fy_next(width), fz_next(width), fx(width, 0.f);
+			if (s > 0)
+				fz_prev = border[s - 1];
+
+			for (size_t z = z0; z < z1; ++z)
+			{
+				float* image = images[z];
+				const float* original = originals[z];
+				const float* next_slice = (z + 1 < nrslices) ? images[z + 1] : nullptr;
+				const bool slab_end = (z + 1 == z1 && z + 1 < nrslices);
+				std::fill(fy_prev.begin(), fy_prev.end(), 0.f);
+
+				for (size_t y = 0; y < height; ++y)
+				{
+					float* row = image + y * width;
+					float* fzp = &fz_prev[y * width];
+
+					for (size_t x = 0; x + 1 < width; ++x)
+						fx[x] = Flux(g, row[x + 1] - row[x], ax);
+					if (y + 1 < height)
+					{
+						const float* below = row + width;
+						for (size_t x = 0; x < width; ++x)
+							fy_next[x] = Flux(g, below[x] - row[x], ay);
+					}
+					else
+					{
+						std::fill(fy_next.begin(), fy_next.end(), 0.f);
+					}
+					if (slab_end)
+					{
+						std::copy(&border[s][y * width], &border[s][y * width] + width, fz_next.begin());
+					}
+					else if (next_slice)
+					{
+						const float* above = next_slice + y * width;
+						for (size_t x = 0; x < width; ++x)
+							fz_next[x] = Flux(g, above[x] - row[x], az);
+					}
+					else
+					{
+						std::fill(fz_next.begin(), fz_next.end(), 0.f);
+					}
+
+					const float* orig = original + y * width;
+					float fx_prev = 0.f;
+					for (size_t x = 0; x < width; ++x)
+					{
+						const float fx_next = (x + 1 < width) ? fx[x] : 0.f;
+						const float div = fx_next - fx_prev + fy_next[x] - fy_prev[x] + fz_next[x] - fzp[x];
+						row[x] += dt * restraint * (orig[x] - row[x]) + tau * div;
+						fx_prev = fx_next;
+						fzp[x] = fz_next[x];
+					}
+					fy_prev.swap(fy_next);
+				}
+			}
+		}
+	}
+}
+
+/// Anisotropic diffusion with one of the predefined conductances and contrast parameter k
+inline void AnisotropicDiffusion(float* const* images, const float* const* originals, size_t width, size_t height,
+		size_t nrslices, const float spacing[3], float dt, int iterations, float restraint,
+		diffusion::eConductance conductance, float k)
+{
+	if (conductance == diffusion::kExponential)
+	{
+		AnisotropicDiffusion(images, originals, width, height, nrslices, spacing, dt, iterations, restraint,
+				diffusion::ExponentialConductance(k));
+	}
+	else
+	{
+		AnisotropicDiffusion(images, originals, width, height, nrslices, spacing, dt, iterations, restraint,
+				diffusion::RationalConductance(k));
+	}
+}
+
+} // namespace iseg
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include "Precompiled.h"
+
+#include "BrickSurfaceCache.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+
+namespace iseg {
+
+namespace {
+
+// position dependent hash, summed per label, i.e. independent of traversal order
+inline std::uint64_t mix(std::uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+template<typename T>
+void hash_labels(const T* field, const int dims[3], const int extent[6], std::map<unsigned, std::uint64_t>& hashes)
+{
+	const long long slice_size = static_cast<long long>(dims[0]) * dims[1];
+
+	unsigned last_label = 0;
+	std::uint64_t* last_hash = nullptr;
+	for (int z = extent[4]; z <= extent[5]; ++z)
+	{
+		for (int y = extent[2]; y <= extent[3]; ++y)
+		{
+			const long long line = z * slice_size + static_cast<long long>(y) * dims[0];
+			for (int x = extent[0]; x <= extent[1]; ++x)
+			{
+				const unsigned label = field[line + x];
+				if (label == 0)
+					continue;
+				if (label != last_label || !last_hash)
+				{
+					last_label = label;
+					last_hash = &hashes[label];
+				}
+				*last_hash += mix(static_cast<std::uint64_t>(line + x));
+			}
+		}
+	}
+}
+
+} // namespace
+
+bool BrickSurfaceCache::PointKey::operator==(const PointKey& other) const
+{
+	return x[0] == other.x[0] && x[1] == other.x[1] && x[2] == other.x[2] && label == other.label;
+}
+
+size_t BrickSurfaceCache::PointKeyHash::operator()(const PointKey& k) const
+{
+	// coordinates are multiples of 0.5
+	std::uint64_t h = mix(static_cast<std::uint64_t>(2.f * k.x[0]));
+	h = mix(h ^ static_cast<std::uint64_t>(2.f * k.x[1]));
+	h = mix(h ^ static_cast<std::uint64_t>(2.f * k.x[2]));
+	return static_cast<size_t>(mix(h ^ k.label));
+}
+
+BrickSurfaceCache::BrickSurfaceCache(int brick_size) : _brick_size(std::max(brick_size, 2)) {}
+
+void BrickSurfaceCache::set_input(vtkImageData* labels)
+{
+	_labels = labels;
+	_bricks.clear();
+	_output = nullptr;
+	if (!_labels)
+		return;
+
+	_labels->GetDimensions(_dims);
+	for (int k = 0; k < 3; ++k)
+	{
+		const int num_cells = std::max(_dims[k] - 1, 1);
+		_num_bricks[k] = (num_cells + _brick_size - 1) / _brick_size;
+	}
+
+	_bricks.resize(static_cast<size_t>(_num_bricks[0]) * _num_bricks[1] * _num_bricks[2]);
+	size_t idx = 0;
+	for (int bz = 0; bz < _num_bricks[2]; ++bz)
+	{
+		for (int by = 0; by < _num_bricks[1]; ++by)
+		{
+			for (int bx = 0; bx < _num_bricks[0]; ++bx, ++idx)
+			{
+				const int b[3] = {bx, by, bz};
+				auto& brick = _bricks[idx];
+				for (int k = 0; k < 3; ++k)
+				{
+					brick.extent[2 * k] = b[k] * _brick_size;
+					brick.extent[2 * k + 1] = std::min(brick.extent[2 * k] + _brick_size, std::max(_dims[k] - 1, 0));
+				}
+			}
+		}
+	}
+
+	reset_output();
+}
+
+void BrickSurfaceCache::invalidate_slices(int z0, int z1)
+{
+	for (auto& brick : _bricks)
+	{
+		if (brick.extent[5] >= z0 && brick.extent[4] <= z1)
+		{
+			brick.stale = true;
+		}
+	}
+}
+
+void BrickSurfaceCache::invalidate_all()
+{
+	for (auto& brick : _bricks)
+	{
+		brick.stale = true;
+	}
+}
+
+bool BrickSurfaceCache::update(const std::function<bool()>& cancel)
+{
+	_changed_labels.clear();
+	_remeshed_bricks = 0;
+
+	std::vector<size_t> stale;
+	for (size_t i = 0; i < _bricks.size(); ++i)
+	{
+		if (_bricks[i].stale)
+			stale.push_back(i);
+	}
+
+	// hashing is cheap compared to meshing, and tells which bricks really changed
+	std::vector<label_hashes_type> hashes(stale.size());
+	const int num_stale = static_cast<int>(stale.size());
+#pragma omp parallel for schedule(dynamic)
+	for (int k = 0; k < num_stale; ++k)
+	{
+		hashes[k] = compute_hashes(_bricks[stale[k]]);
+	}
+
+	bool cancelled = false;
+	for (size_t k = 0; k < stale.size(); ++k)
+	{
+		auto& brick = _bricks[stale[k]];
+		if (brick.surface && hashes[k] == brick.hashes)
+		{
+			brick.stale = false;
+			continue;
+		}
+
+		if (cancel && cancel())
+		{
+			cancelled = true;
+			break;
+		}
+
+		// labels which appeared, disappeared or moved in this brick
+		for (const auto& h : hashes[k])
+		{
+			auto found = brick.hashes.find(h.first);
+			if (found == brick.hashes.end() || found->second != h.second)
+				_changed_labels.insert(h.first);
+		}
+		for (const auto& h : brick.hashes)
+		{
+			if (hashes[k].count(h.first) == 0)
+				_changed_labels.insert(h.first);
+		}
+
+		remove_from_output(brick);
+		brick.surface = extract_surface(brick, hashes[k]);
+		brick.hashes.swap(hashes[k]);
+		brick.stale = false;
+		add_to_output(brick);
+
+		_remeshed_bricks++;
+	}
+
+	if (_remeshed_bricks != 0)
+	{
+		const vtkIdType num_triangles = _triangles->GetNumberOfTuples() / 4;
+		if (2 * static_cast<vtkIdType>(_free_triangles.size()) > num_triangles ||
+				2 * _free_points.size() > _point_refs.size())
+		{
+			// compact
+			reset_output();
+			for (auto& brick : _bricks)
+			{
+				add_to_output(brick);
+			}
+		}
+
+		_polys->SetCells(_triangles->GetNumberOfTuples() / 4, _triangles);
+		_points->Modified();
+		_scalars->Modified();
+		_output->DeleteCells();
+		_output->Modified();
+	}
+	return !cancelled;
+}
+
+BrickSurfaceCache::label_hashes_type BrickSurfaceCache::compute_hashes(const Brick& brick) const
+{
+	label_hashes_type hashes;
+	switch (_labels->GetScalarType())
+	{
+	case VTK_UNSIGNED_CHAR:
+		hash_labels(static_cast<const unsigned char*>(_labels->GetScalarPointer()), _dims, brick.extent, hashes);
+		break;
+	case VTK_UNSIGNED_SHORT:
+		hash_labels(static_cast<const unsigned short*>(_labels->GetScalarPointer()), _dims, brick.extent, hashes);
+		break;
+	default:
+		break;
+	}
+	return hashes;
+}
+
+vtkSmartPointer<vtkPolyData> BrickSurfaceCache::extract_surface(const Brick& brick, const label_hashes_type& hashes) const
+{
+	if (hashes.empty())
+	{
+		return vtkSmartPointer<vtkPolyData>::New();
+	}
+
+	// copy brick, including the point layer shared with the next brick
+	auto image = vtkSmartPointer<vtkImageData>::New();
+	image->SetExtent(const_cast<int*>(brick.extent));
+	image->SetOrigin(0, 0, 0);
+	image->SetSpacing(1, 1, 1);
+	image->AllocateScalars(_labels->GetScalarType(), 1);
+
+	const int size_x = brick.extent[1] - brick.extent[0] + 1;
+	const size_t element_size = image->GetScalarSize();
+	const long long slice_size = static_cast<long long>(_dims[0]) * _dims[1];
+	auto src = static_cast<const char*>(_labels->GetScalarPointer());
+	auto dst = static_cast<char*>(image->GetScalarPointer());
+	for (int z = brick.extent[4]; z <= brick.extent[5]; ++z)
+	{
+		for (int y = brick.extent[2]; y <= brick.extent[3]; ++y)
+		{
+			const long long offset = z * slice_size + static_cast<long long>(y) * _dims[0] + brick.extent[0];
+			std::copy(src + offset * element_size, src + (offset + size_x) * element_size, dst);
+			dst += size_x * element_size;
+		}
+	}
+
+	auto cubes = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
+	cubes->SetInputData(image);
+	cubes->ComputeScalarsOn();
+	cubes->SetNumberOfContours(static_cast<int>(hashes.size()));
+	int i = 0;
+	for (const auto& h : hashes)
+	{
+		cubes->SetValue(i++, h.first);
+	}
+	cubes->Update();
+
+	vtkSmartPointer<vtkPolyData> surface = cubes->GetOutput();
+	return surface;
+}
+
+void BrickSurfaceCache::reset_output()
+{
+	_points = vtkSmartPointer<vtkPoints>::New();
+	_points->SetDataTypeToFloat();
+	_scalars.TakeReference(vtkDataArray::CreateDataArray(_labels->GetScalarType()));
+	_scalars->SetName("Labels");
+	_triangles = vtkSmartPointer<vtkIdTypeArray>::New();
+	_polys = vtkSmartPointer<vtkCellArray>::New();
+	_point_refs.clear();
+	_free_points.clear();
+	_free_triangles.clear();
+	_shared_points.clear();
+	for (auto& brick : _bricks)
+	{
+		brick.points.clear();
+		brick.triangles.clear();
+	}
+
+	if (!_output)
+	{
+		_output = vtkSmartPointer<vtkPolyData>::New();
+	}
+	_output->SetPoints(_points);
+	_output->SetPolys(_polys);
+	_output->GetPointData()->SetScalars(_scalars);
+}
+
+vtkIdType BrickSurfaceCache::insert_point(const double p[3], unsigned label)
+{
+	vtkIdType id;
+	if (!_free_points.empty())
+	{
+		id = _free_points.back();
+		_free_points.pop_back();
+		_points->SetPoint(id, p);
+		_scalars->SetTuple1(id, label);
+		_point_refs[id] = 1;
+	}
+	else
+	{
+		id = _points->InsertNextPoint(p);
+		_scalars->InsertNextTuple1(label);
+		_point_refs.push_back(1);
+	}
+	return id;
+}
+
+vtkIdType BrickSurfaceCache::insert_triangle(vtkIdType a, vtkIdType b, vtkIdType c)
+{
+	if (!_free_triangles.empty())
+	{
+		const vtkIdType slot = _free_triangles.back();
+		_free_triangles.pop_back();
+		_triangles->SetValue(4 * slot + 1, a);
+		_triangles->SetValue(4 * slot + 2, b);
+		_triangles->SetValue(4 * slot + 3, c);
+		return slot;
+	}
+
+	const vtkIdType slot = _triangles->GetNumberOfTuples() / 4;
+	_triangles->InsertNextValue(3);
+	_triangles->InsertNextValue(a);
+	_triangles->InsertNextValue(b);
+	_triangles->InsertNextValue(c);
+	return slot;
+}
+
+void BrickSurfaceCache::add_to_output(Brick& brick)
+{
+	vtkPolyData* surface = brick.surface;
+	if (!surface || surface->GetNumberOfPoints() == 0)
+		return;
+
+	vtkDataArray* labels = surface->GetPointData()->GetScalars();
+	const vtkIdType num_points = surface->GetNumberOfPoints();
+	brick.points.resize(num_points);
+	for (vtkIdType i = 0; i < num_points; ++i)
+	{
+		double p[3];
+		surface->GetPoint(i, p);
+		const unsigned label = labels ? static_cast<unsigned>(labels->GetTuple1(i)) : 0;
+
+		bool on_face = false;
+		for (int k = 0; k < 3; ++k)
+		{
+			on_face = on_face || p[k] == brick.extent[2 * k] || p[k] == brick.extent[2 * k + 1];
+		}
+
+		if (on_face)
+		{
+			// points on brick faces are generated by both neighboring bricks
+			PointKey key = {{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2])}, label};
+			auto found = _shared_points.find(key);
+			if (found != _shared_points.end())
+			{
+				brick.points[i] = found->second;
+				_point_refs[found->second]++;
+				continue;
+			}
+			brick.points[i] = insert_point(p, label);
+			_shared_points[key] = brick.points[i];
+		}
+		else
+		{
+			brick.points[i] = insert_point(p, label);
+		}
+	}
+
+	vtkIdType npts;
+	vtkIdType* pts;
+	vtkCellArray* brick_polys = surface->GetPolys();
+	for (brick_polys->InitTraversal(); brick_polys->GetNextCell(npts, pts);)
+	{
+		for (vtkIdType j = 1; j + 1 < npts; ++j)
+		{
+			brick.triangles.push_back(insert_triangle(brick.points[pts[0]], brick.points[pts[j]], brick.points[pts[j + 1]]));
+		}
+	}
+}
+
+void BrickSurfaceCache::remove_from_output(Brick& brick)
+{
+	for (vtkIdType slot : brick.triangles)
+	{
+		// degenerate, i.e. not rendered, until the slot is reused
+		_triangles->SetValue(4 * slot + 1, 0);
+		_triangles->SetValue(4 * slot + 2, 0);
+		_triangles->SetValue(4 * slot + 3, 0);
+		_free_triangles.push_back(slot);
+	}
+
+	for (vtkIdType id : brick.points)
+	{
+		if (--_point_refs[id] != 0)
+			continue;
+
+		double p[3];
+		_points->GetPoint(id, p);
+		PointKey key = {{static_cast<float>(p[0]), static_cast<float>(p[1]), static_cast<float>(p[2])},
+				static_cast<unsigned>(_scalars->GetTuple1(id))};
+		auto found = _shared_points.find(key);
+		if (found != _shared_points.end() && found->second == id)
+		{
+			_shared_points.erase(found);
+		}
+		_free_points.push_back(id);
+	}
+
+	brick.points.clear();
+	brick.triangles.clear();
+}
+
+} // namespace iseg
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "iSegCore.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+class vtkCellArray;
+class vtkDataArray;
+class vtkIdTypeArray;
+class vtkImageData;
+class vtkPoints;
+class vtkPolyData;
+
+namespace iseg {
+
+/** \brief Caches the surfaces of a label field in bricks, to quickly update after local edits
+
+	The label field is partitioned into bricks of brick_size^3 cells. Neighboring bricks share
+	one layer of points, so every marching cubes cell belongs to exactly one brick. For each
+	brick a position dependent hash per label is stored. On update() only bricks in invalidated
+	slices are rehashed, and only bricks where the hash of some label changed are re-meshed.
+
+	The surfaces are extracted in voxel coordinates (spacing 1, origin 0). Duplicate points on
+	brick faces are merged (per label). The output is assembled in place: the points and triangles
+	of a re-meshed brick are removed and its new ones fill the freed slots, so an update costs
+	O(re-meshed bricks). Freed triangles are kept as degenerate triangles and freed points are not
+	referenced, until the output is compacted once more than half of it is unused.
+
+	\note The label field must have unsigned char or unsigned short scalars. The cache does not copy
+	the label field, the caller must not modify it while update() is running.
+*/
+class ISEG_CORE_API BrickSurfaceCache
+{
+public:
+	explicit BrickSurfaceCache(int brick_size = 32);
+
+	/// Set label field, all bricks are invalidated
+	void set_input(vtkImageData* labels);
+
+	/// Mark slices z0 to z1 (inclusive) as possibly modified
+	void invalidate_slices(int z0, int z1);
+
+	void invalidate_all();
+
+	/// Re-mesh modified bricks. Returns false if cancel() returned true before all bricks were updated.
+	bool update(const std::function<bool()>& cancel = std::function<bool()>());
+
+	/// Surface of all bricks, the same object is modified by every update() after set_input()
+	vtkPolyData* get_output() const { return _output; }
+
+	/// Labels whose surface changed in the last update()
+	const std::set<unsigned>& changed_labels() const { return _changed_labels; }
+
+	/// Number of bricks re-meshed in the last update()
+	size_t number_of_remeshed_bricks() const { return _remeshed_bricks; }
+
+private:
+	using label_hashes_type = std::map<unsigned, std::uint64_t>;
+
+	struct Brick
+	{
+		int extent[6];
+		bool stale = true;
+		label_hashes_type hashes;
+		vtkSmartPointer<vtkPolyData> surface;
+		/// points (ids in the output) referenced by the surface and its triangle slots in the output
+		std::vector<vtkIdType> points;
+		std::vector<vtkIdType> triangles;
+	};
+
+	/// point on a brick face, which is shared with the neighboring brick
+	struct PointKey
+	{
+		float x[3];
+		unsigned label;
+		bool operator==(const PointKey& other) const;
+	};
+	struct PointKeyHash
+	{
+		size_t operator()(const PointKey& k) const;
+	};
+
+	label_hashes_type compute_hashes(const Brick& brick) const;
+	vtkSmartPointer<vtkPolyData> extract_surface(const Brick& brick, const label_hashes_type& hashes) const;
+	void reset_output();
+	void add_to_output(Brick& brick);
+	void remove_from_output(Brick& brick);
+	vtkIdType insert_point(const double p[3], unsigned label);
+	vtkIdType insert_triangle(vtkIdType a, vtkIdType b, vtkIdType c);
+
+	int _brick_size;
+	int _dims[3] = {0, 0, 0};
+	int _num_bricks[3] = {0, 0, 0};
+	vtkSmartPointer<vtkImageData> _labels;
+	std::vector<Brick> _bricks;
+	vtkSmartPointer<vtkPolyData> _output;
+	vtkSmartPointer<vtkPoints> _points;
+	vtkSmartPointer<vtkDataArray> _scalars;
+	vtkSmartPointer<vtkIdTypeArray> _triangles; ///< cell array layout, i.e. (3, a, b, c) per triangle
+	vtkSmartPointer<vtkCellArray> _polys;
+	std::vector<unsigned> _point_refs; ///< number of bricks referencing a point, 0 if the point is free
+	std::vector<vtkIdType> _free_points;
+	std::vector<vtkIdType> _free_triangles;
+	std::unordered_map<PointKey, vtkIdType, PointKeyHash> _shared_points;
+	std::set<unsigned> _changed_labels;
+	size_t _remeshed_bricks = 0;
+};
+
+} // namespace iseg
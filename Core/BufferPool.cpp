@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include "Precompiled.h"
+
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#ifdef _WIN32
+#	include <malloc.h>
+#endif
+
+namespace iseg {
+
+struct BufferPool::SizeClass
+{
+	explicit SizeClass(size_t b) : bytes(b), in_use(0), high_water(0), allocated(0) {}
+
+	const size_t bytes;
+	std::mutex mutex;
+	std::vector<void*> shared; ///< released buffers, which are not in a thread cache
+	std::atomic<size_t> in_use;
+	std::atomic<size_t> high_water;
+	std::atomic<size_t> allocated;
+};
+
+/// Released buffers and the size classes known to a thread. The lock is only contended by Trim.
+struct BufferPool::ThreadCache
+{
+	static const int kMaxBuffers = 4;
+	static const size_t kMaxBytes = size_t(16) << 20;
+	static const int kMaxClasses = 8;
+
+	ThreadCache();
+	~ThreadCache();
+
+	std::mutex mutex;
+	SizeClass* buffer_class[kMaxBuffers];
+	void* buffers[kMaxBuffers];
+	int nrbuffers = 0;
+	size_t bytes = 0;
+
+	// only used by the owning thread
+	SizeClass* classes[kMaxClasses];
+	int nrclasses = 0;
+};
+
+namespace {
+size_t round_up(size_t bytes)
+{
+	const size_t a = BufferPool::kAlignment;
+	return std::max(a, (bytes + a - 1) / a * a);
+}
+
+void* allocate_aligned(size_t bytes)
+{
+#ifdef _WIN32
+	return _aligned_malloc(bytes, BufferPool::kAlignment);
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, BufferPool::kAlignment, bytes) != 0)
+		return nullptr;
+	return p;
+#endif
+}
+
+void free_aligned(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+thread_local BufferPool::ThreadCache cache;
+} // namespace
+
+BufferPool& BufferPool::Instance()
+{
+	// never destroyed, threads may return their cached buffers during shutdown
+	static BufferPool* pool = new BufferPool;
+	return *pool;
+}
+
+BufferPool::ThreadCache::ThreadCache()
+{
+	BufferPool& pool = BufferPool::Instance();
+	std::lock_guard<std::mutex> lock(pool._mutex);
+	pool._caches.push_back(this);
+}
+
+BufferPool::ThreadCache::~ThreadCache()
+{
+	BufferPool& pool = BufferPool::Instance();
+	{
+		std::lock_guard<std::mutex> lock(pool._mutex);
+		pool._caches.erase(std::find(pool._caches.begin(), pool._caches.end(), this));
+	}
+	for (int i = 0; i < nrbuffers; ++i)
+	{
+		std::lock_guard<std::mutex> lock(buffer_class[i]->mutex);
+		buffer_class[i]->shared.push_back(buffers[i]);
+	}
+}
+
+BufferPool::Owners& BufferPool::Shard(const void* buffer) const
+{
+	return _owners[(reinterpret_cast<uintptr_t>(buffer) / kAlignment) % kOwnerShards];
+}
+
+BufferPool::SizeClass* BufferPool::Owner(const void* buffer) const
+{
+	Owners& shard = Shard(buffer);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	auto it = shard.owner.find(buffer);
+	return (it != shard.owner.end()) ? it->second : nullptr;
+}
+
+bool BufferPool::Owns(const void* buffer) const { return buffer != nullptr && Owner(buffer) != nullptr; }
+
+void* BufferPool::Allocate(SizeClass* c)
+{
+	void* buffer = allocate_aligned(c->bytes);
+	if (buffer == nullptr)
+		return nullptr;
+
+	Owners& shard = Shard(buffer);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.owner[buffer] = c;
+	}
+	++c->allocated;
+	return buffer;
+}
+
+void BufferPool::Free(void* buffer, SizeClass* c)
+{
+	Owners& shard = Shard(buffer);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.owner.erase(buffer);
+	}
+	--c->allocated;
+	free_aligned(buffer);
+}
+
+BufferPool::SizeClass* BufferPool::Class(size_t bytes)
+{
+	for (int i = 0; i < cache.nrclasses; ++i)
+	{
+		if (cache.classes[i]->bytes == bytes)
+			return cache.classes[i];
+	}
+
+	SizeClass* c;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto& entry = _classes[bytes];
+		if (!entry)
+			entry.reset(new SizeClass(bytes));
+		c = entry.get();
+	}
+
+	// remember the most recently used classes
+	if (cache.nrclasses < ThreadCache::kMaxClasses)
+		cache.nrclasses++;
+	for (int i = cache.nrclasses - 1; i > 0; --i)
+		cache.classes[i] = cache.classes[i - 1];
+	cache.classes[0] = c;
+	return c;
+}
+
+void* BufferPool::Acquire(size_t bytes)
+{
+	SizeClass* c = Class(round_up(bytes));
+
+	void* buffer = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+		for (int i = cache.nrbuffers - 1; i >= 0; --i)
+		{
+			if (cache.buffer_class[i] == c)
+			{
+				buffer = cache.buffers[i];
+				cache.bytes -= c->bytes;
+				--cache.nrbuffers;
+				cache.buffers[i] = cache.buffers[cache.nrbuffers];
+				cache.buffer_class[i] = cache.buffer_class[cache.nrbuffers];
+				break;
+			}
+		}
+	}
+	if (buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(c->mutex);
+		if (!c->shared.empty())
+		{
+			buffer = c->shared.back();
+			c->shared.pop_back();
+		}
+	}
+	if (buffer == nullptr)
+	{
+		buffer = Allocate(c);
+		if (buffer == nullptr)
+			return nullptr;
+	}
+
+	const size_t in_use = ++c->in_use;
+	size_t high_water = c->high_water.load();
+	while (in_use > high_water && !c->high_water.compare_exchange_weak(high_water, in_use))
+	{
+	}
+	return buffer;
+}
+
+void BufferPool::Release(void* buffer)
+{
+	if (buffer == nullptr)
+		return;
+
+	SizeClass* c = Owner(buffer);
+	if (c == nullptr)
+	{
+		// not from the pool, its size and alignment are unknown
+		free(buffer);
+		return;
+	}
+
+	--c->in_use;
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+		if (cache.nrbuffers < ThreadCache::kMaxBuffers && cache.bytes + c->bytes <= ThreadCache::kMaxBytes)
+		{
+			cache.buffer_class[cache.nrbuffers] = c;
+			cache.buffers[cache.nrbuffers] = buffer;
+			cache.bytes += c->bytes;
+			++cache.nrbuffers;
+			return;
+		}
+	}
+	std::lock_guard<std::mutex> lock(c->mutex);
+	c->shared.push_back(buffer);
+}
+
+void BufferPool::Trim(size_t bytes)
+{
+	SizeClass* c = Class(round_up(bytes));
+
+	std::vector<void*> unused;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (ThreadCache* tc : _caches)
+		{
+			std::lock_guard<std::mutex> cache_lock(tc->mutex);
+			for (int i = tc->nrbuffers - 1; i >= 0; --i)
+			{
+				if (tc->buffer_class[i] == c)
+				{
+					unused.push_back(tc->buffers[i]);
+					tc->bytes -= c->bytes;
+					--tc->nrbuffers;
+					tc->buffers[i] = tc->buffers[tc->nrbuffers];
+					tc->buffer_class[i] = tc->buffer_class[tc->nrbuffers];
+				}
+			}
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(c->mutex);
+		unused.insert(unused.end(), c->shared.begin(), c->shared.end());
+		c->shared.clear();
+		c->shared.shrink_to_fit();
+	}
+	for (void* p : unused)
+		Free(p, c);
+}
+
+std::vector<BufferPool::Statistics> BufferPool::Report() const
+{
+	std::vector<Statistics> report;
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto& c : _classes)
+	{
+		Statistics s;
+		s.bytes = c.first;
+		s.in_use = c.second->in_use;
+		s.high_water = c.second->high_water;
+		s.allocated = c.second->allocated;
+		report.push_back(s);
+	}
+	return report;
+}
+
+} // namespace iseg
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "iSegCore.h"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace iseg {
+
+/** \brief Thread-safe pool of aligned scratch buffers
+
+	Buffers are grouped in size classes (the size rounded up to the alignment of 64 bytes), so padded and
+	unpadded slices of the same image use different classes. Each thread keeps a few released buffers in a
+	local cache, which serves most requests without contention, the remaining buffers are shared per size class.
+	The pool knows the buffers it allocated, so it cannot hand out a foreign buffer and its statistics stay exact.
+*/
+class ISEG_CORE_API BufferPool
+{
+public:
+	static const size_t kAlignment = 64;
+
+	struct Statistics
+	{
+		size_t bytes;				///< size of the buffers in this class
+		size_t in_use;			///< buffers handed out
+		size_t high_water;	///< largest number of buffers handed out at the same time
+		size_t allocated;		///< buffers allocated (in use or cached)
+	};
+
+	static BufferPool& Instance();
+
+	/// Buffer of at least bytes bytes, aligned to kAlignment. It must be returned with Release, not free().
+	void* Acquire(size_t bytes);
+	/// Returns a buffer of the pool. Other buffers (e.g. from malloc) are not taken, they are released with free().
+	void Release(void* buffer);
+	/// Frees the cached buffers of the size class of bytes, including the ones in the thread caches
+	void Trim(size_t bytes);
+	/// True if buffer was allocated by the pool
+	bool Owns(const void* buffer) const;
+
+	/// Statistics of all size classes, ordered by size
+	std::vector<Statistics> Report() const;
+
+	struct SizeClass;
+	struct ThreadCache;
+
+private:
+	BufferPool() = default;
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	SizeClass* Class(size_t bytes);
+	SizeClass* Owner(const void* buffer) const;
+	void* Allocate(SizeClass* c);
+	void Free(void* buffer, SizeClass* c);
+
+	/// owner of the pool's buffers, split by address to keep Release from contending on one lock
+	struct Owners
+	{
+		std::mutex mutex;
+		std::unordered_map<const void*, SizeClass*> owner;
+	};
+	static const int kOwnerShards = 16;
+	Owners& Shard(const void* buffer) const;
+
+	mutable std::mutex _mutex; ///< guards _classes and _caches
+	std::map<size_t, std::unique_ptr<SizeClass>> _classes;
+	std::vector<ThreadCache*> _caches;
+	mutable Owners _owners[kOwnerShards];
+};
+
+/// Scratch buffer of count elements from the BufferPool, returned when the lease goes out of scope
+template<typename T>
+class ScratchLease
+{
+	static_assert(std::is_trivial<T>::value, "scratch buffers are not initialized");
+
+public:
+	explicit ScratchLease(size_t count)
+			: _count(count), _data(static_cast<T*>(BufferPool::Instance().Acquire(count * sizeof(T)))) {}
+	ScratchLease(ScratchLease&& other) : _count(other._count), _data(other._data) { other._data = nullptr; }
+	~ScratchLease() { reset(); }
+
+	ScratchLease& operator=(ScratchLease&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			_count = other._count;
+			_data = other._data;
+			other._data = nullptr;
+		}
+		return *this;
+	}
+
+	T* get() const { return _data; }
+	size_t size() const { return _count; }
+	T& operator[](size_t i) const { return _data[i]; }
+
+private:
+	ScratchLease(const ScratchLease&) = delete;
+	ScratchLease& operator=(const ScratchLease&) = delete;
+
+	void reset()
+	{
+		if (_data)
+			BufferPool::Instance().Release(_data);
+		_data = nullptr;
+	}
+
+	size_t _count;
+	T* _data;
+};
+
+} // namespace iseg
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "Data/ProgressInfo.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifndef NO_OPENMP_SUPPORT
+#	include <omp.h>
+#endif
+
+namespace iseg {
+
+/// Neighborhood for connected component labeling. kConnectivity4 and kConnectivity8 only connect within a slice
+enum eConnectivity {
+	kConnectivity4 = 4,
+	kConnectivity8 = 8,
+	kConnectivity6 = 6,
+	kConnectivity18 = 18,
+	kConnectivity26 = 26
+};
+
+namespace ccl {
+
+/// Backward neighbors (already visited in raster order) for a connectivity
+inline std::vector<std::ptrdiff_t> BackwardOffsets(eConnectivity connectivity)
+{
+	// (dx, dy, dz) triplets
+	std::vector<std::ptrdiff_t> offsets = {-1, 0, 0, 0, -1, 0};
+	if (connectivity != kConnectivity4 && connectivity != kConnectivity6)
+	{
+		offsets.insert(offsets.end(), {-1, -1, 0, 1, -1, 0});
+	}
+	if (connectivity != kConnectivity4 && connectivity != kConnectivity8)
+	{
+		offsets.insert(offsets.end(), {0, 0, -1});
+	}
+	if (connectivity == kConnectivity18 || connectivity == kConnectivity26)
+	{
+		offsets.insert(offsets.end(), {-1, 0, -1, 1, 0, -1, 0, -1, -1, 0, 1, -1});
+	}
+	if (connectivity == kConnectivity26)
+	{
+		offsets.insert(offsets.end(), {-1, -1, -1, 1, -1, -1, -1, 1, -1, 1, 1, -1});
+	}
+	return offsets;
+}
+
+/// Union-find with path compression, the smaller label is always the root
+template<typename TLabel>
+inline TLabel FindRoot(std::vector<TLabel>& parent, TLabel x)
+{
+	TLabel root = x;
+	while (parent[root] != root)
+		root = parent[root];
+	while (parent[x] != root)
+	{
+		TLabel next = parent[x];
+		parent[x] = root;
+		x = next;
+	}
+	return root;
+}
+
+template<typename TLabel>
+inline TLabel Union(std::vector<TLabel>& parent, TLabel a, TLabel b)
+{
+	a = FindRoot(parent, a);
+	b = FindRoot(parent, b);
+	if (a < b)
+		return parent[b] = a;
+	return parent[a] = b;
+}
+
+} // namespace ccl
+
+/** \brief Connected component labeling of a stack of slices
+
+	Voxels v with foreground(v) get labels 1..N (returned), other voxels get label 0. Two neighboring
+	foreground voxels are in the same component if connected(a, b) is true. Labels are integers, so
+	the number of components is only limited by TLabel.
+
+	The volume is split into blocks of consecutive rows (in raster order), which are labeled in parallel with
+	a two-pass union-find scheme. The equivalences across block boundaries are merged afterwards. Roots are
+	always the smallest label, therefore the final labels are numbered by first appearance in raster order,
+	independent of the number of threads.
+
+	\note Returns 0 if canceled via progress, the labels are undefined in this case.
+*/
+template<typename TInput, typename TLabel, typename TForeground, typename TConnected>
+TLabel ConnectedComponents(const TInput* const* slices, size_t width, size_t height, size_t nrslices,
+		eConnectivity connectivity, TLabel* const* labels, TForeground foreground, TConnected connected,
+		ProgressInfo* progress = nullptr)
+{
+	const auto offsets = ccl::BackwardOffsets(connectivity);
+	const size_t num_offsets = offsets.size() / 3;
+	const size_t num_rows = height * nrslices;
+	if (num_rows == 0 || width == 0)
+		return 0;
+
+#ifdef NO_OPENMP_SUPPORT
+	const size_t num_threads = 1;
+#else
+	const size_t num_threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+	const size_t rows_per_block = std::max<size_t>((num_rows + 4 * num_threads - 1) / (4 * num_threads), 1);
+	const int num_blocks = static_cast<int>((num_rows + rows_per_block - 1) / rows_per_block);
+
+	// first pass: provisional labels 1..n_b in each block, equivalences resolved within the block
+	std::vector<std::vector<TLabel>> block_parents(num_blocks);
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		const size_t r0 = b * rows_per_block;
+		const size_t r1 = std::min(r0 + rows_per_block, num_rows);
+		auto& parent = block_parents[b];
+		parent.push_back(0);
+
+		for (size_t r = r0; r < r1; ++r)
+		{
+			const size_t z = r / height, y = r % height;
+			const TInput* in = slices[z];
+			TLabel* out = labels[z];
+			for (size_t x = 0, i = y * width; x < width; ++x, ++i)
+			{
+				if (!foreground(in[i]))
+				{
+					out[i] = 0;
+					continue;
+				}
+
+				TLabel label = 0;
+				for (size_t n = 0; n < num_offsets; ++n)
+				{
+					const std::ptrdiff_t nx = static_cast<std::ptrdiff_t>(x) + offsets[3 * n];
+					const std::ptrdiff_t ny = static_cast<std::ptrdiff_t>(y) + offsets[3 * n + 1];
+					const std::ptrdiff_t nz = static_cast<std::ptrdiff_t>(z) + offsets[3 * n + 2];
+					if (nx < 0 || ny < 0 || nz < 0 || nx >= static_cast<std::ptrdiff_t>(width) || ny >= static_cast<std::ptrdiff_t>(height))
+						continue;
+					// neighbors in previous blocks are merged later
+					if (static_cast<size_t>(nz) * height + ny < r0)
+						continue;
+					const size_t ni = ny * width + nx;
+					if (labels[nz][ni] == 0 || !connected(in[i], slices[nz][ni]))
+						continue;
+					label = label ? ccl::Union(parent, label, labels[nz][ni]) : ccl::FindRoot(parent, labels[nz][ni]);
+				}
+				if (label == 0)
+				{
+					label = static_cast<TLabel>(parent.size());
+					parent.push_back(label);
+				}
+				out[i] = label;
+			}
+		}
+	}
+
+	if (progress)
+	{
+		progress->setValue(40);
+		if (progress->wasCanceled())
+			return 0;
+	}
+
+	// global provisional labels: offset of block + local label
+	std::vector<TLabel> block_offset(num_blocks + 1, 0);
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		block_offset[b + 1] = block_offset[b] + static_cast<TLabel>(block_parents[b].size() - 1);
+	}
+	std::vector<TLabel> parent(block_offset[num_blocks] + 1);
+	parent[0] = 0;
+#pragma omp parallel for
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		auto& local = block_parents[b];
+		for (TLabel l = 1; l < static_cast<TLabel>(local.size()); ++l)
+		{
+			parent[block_offset[b] + l] = block_offset[b] + ccl::FindRoot(local, l);
+		}
+		std::vector<TLabel>().swap(local);
+	}
+
+	// merge across block boundaries, only rows which can have neighbors in a previous block
+	const size_t boundary_rows = (connectivity == kConnectivity4 || connectivity == kConnectivity8) ? 1 : height + 1;
+	for (int b = 1; b < num_blocks; ++b)
+	{
+		const size_t r0 = b * rows_per_block;
+		const size_t r1 = std::min(r0 + boundary_rows, num_rows);
+		for (size_t r = r0; r < r1; ++r)
+		{
+			const size_t z = r / height, y = r % height;
+			const int rb = static_cast<int>(r / rows_per_block);
+			for (size_t x = 0, i = y * width; x < width; ++x, ++i)
+			{
+				if (labels[z][i] == 0)
+					continue;
+				for (size_t n = 0; n < num_offsets; ++n)
+				{
+					const std::ptrdiff_t nx = static_cast<std::ptrdiff_t>(x) + offsets[3 * n];
+					const std::ptrdiff_t ny = static_cast<std::ptrdiff_t>(y) + offsets[3 * n + 1];
+					const std::ptrdiff_t nz = static_cast<std::ptrdiff_t>(z) + offsets[3 * n + 2];
+					if (nx < 0 || ny < 0 || nz < 0 || nx >= static_cast<std::ptrdiff_t>(width) || ny >= static_cast<std::ptrdiff_t>(height))
+						continue;
+					const size_t nr = static_cast<size_t>(nz) * height + ny;
+					if (nr >= r0)
+						continue;
+					const size_t ni = ny * width + nx;
+					if (labels[nz][ni] == 0 || !connected(slices[z][i], slices[nz][ni]))
+						continue;
+					const int nb = static_cast<int>(nr / rows_per_block);
+					ccl::Union(parent, static_cast<TLabel>(block_offset[rb] + labels[z][i]), static_cast<TLabel>(block_offset[nb] + labels[nz][ni]));
+				}
+			}
+		}
+	}
+
+	// roots are the smallest labels, i.e. compact labels are assigned in raster order
+	TLabel num_components = 0;
+	for (size_t l = 1; l < parent.size(); ++l)
+	{
+		parent[l] = (parent[l] == l) ? ++num_components : parent[parent[l]];
+	}
+
+	if (progress)
+	{
+		progress->setValue(70);
+		if (progress->wasCanceled())
+			return 0;
+	}
+
+	// second pass
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		const size_t r0 = b * rows_per_block;
+		const size_t r1 = std::min(r0 + rows_per_block, num_rows);
+		const TLabel offset = block_offset[b];
+		for (size_t r = r0; r < r1; ++r)
+		{
+			TLabel* out = labels[r / height] + (r % height) * width;
+			for (size_t x = 0; x < width; ++x)
+			{
+				if (out[x] != 0)
+					out[x] = parent[offset + out[x]];
+			}
+		}
+	}
+
+	if (progress)
+	{
+		progress->setValue(100);
+	}
+	return num_components;
+}
+
+/// All voxels are labeled, neighbors with equal value are connected
+template<typename TInput, typename TLabel>
+TLabel ConnectedComponents(const TInput* const* slices, size_t width, size_t height, size_t nrslices,
+		eConnectivity connectivity, TLabel* const* labels, ProgressInfo* progress = nullptr)
+{
+	return ConnectedComponents(
+			slices, width, height, nrslices, connectivity, labels,
+			[](TInput) { return true; },
+			[](TInput a, TInput b) { return a == b; },
+			progress);
+}
+
+} // namespace iseg
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace iseg {
+
+namespace edt {
+
+/// Marks voxels without feature in the input of SquaredDistanceTransform
+inline float Infinity() { return std::numeric_limits<float>::max(); }
+
+/** \brief Lower envelope of parabolas (Felzenszwalb & Huttenlocher)
+
+	d[i] = min_j (f[j] + (s * (i - j))^2), samples with f[j] == Infinity() are ignored.
+	v, z are work buffers of size n and n + 1.
+*/
+inline void LowerEnvelope(const float* f, size_t n, double s, float* d, size_t* v, double* z)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	const double s2 = s * s;
+
+	size_t k = 0;
+	bool empty = true;
+	for (size_t q = 0; q < n; ++q)
+	{
+		if (f[q] == Infinity())
+			continue;
+		if (empty)
+		{
+			v[0] = q;
+			z[0] = -inf;
+			z[1] = inf;
+			empty = false;
+			continue;
+		}
+
+		// intersection with the parabola on top of the stack, in units of samples
+		double x;
+		for (;;)
+		{
+			const double p = static_cast<double>(v[k]);
+			x = ((f[q] + s2 * q * q) - (f[v[k]] + s2 * p * p)) / (2.0 * s2 * (q - p));
+			if (x > z[k])
+				break;
+			--k; // z[0] = -inf, the loop stops at k == 0
+		}
+		++k;
+		v[k] = q;
+		z[k] = x;
+		z[k + 1] = inf;
+	}
+
+	if (empty)
+	{
+		std::fill(d, d + n, Infinity());
+		return;
+	}
+
+	k = 0;
+	for (size_t q = 0; q < n; ++q)
+	{
+		while (z[k + 1] < q)
+			++k;
+		const double dq = s * (static_cast<double>(q) - v[k]);
+		d[q] = static_cast<float>(dq * dq + f[v[k]]);
+	}
+}
+
+} // namespace edt
+
+/** \brief Exact squared Euclidean distance transform of a stack of slices, in place
+
+	On input dist2 is 0 at feature voxels and edt::Infinity() elsewhere (in general any non-negative
+	function f), on output dist2(p) = min_q (f(q) + |p - q|^2), where distances are measured with the
+	voxel spacing. Voxels remain at edt::Infinity() if there is no feature.
+
+	The transform is separable, each pass computes the lower envelope of parabolas along lines
+	of one axis, in linear time. The lines are processed in parallel. If independent_slices is set,
+	the pass along z is skipped, i.e. a batch of 2D transforms is computed.
+*/
+inline void SquaredDistanceTransform(float* const* dist2, size_t width, size_t height, size_t nrslices, const double spacing[3],
+		bool independent_slices = false)
+{
+	const size_t slice_size = width * height;
+	const size_t max_length = std::max(width, std::max(height, nrslices));
+
+	// x and y axis: independent slices
+	const int num_lines_x = static_cast<int>(height * nrslices);
+	const int num_lines_y = static_cast<int>(width * nrslices);
+#pragma omp parallel
+	{
+		std::vector<float> f(max_length), d(max_length);
+		std::vector<size_t> v(max_length);
+		std::vector<double> z(max_length + 1);
+
+#pragma omp for schedule(dynamic, 16)
+		for (int line = 0; line < num_lines_x; ++line)
+		{
+			float* row = dist2[line / height] + (line % height) * width;
+			std::copy(row, row + width, f.begin());
+			edt::LowerEnvelope(f.data(), width, spacing[0], row, v.data(), z.data());
+		}
+
+#pragma omp for schedule(dynamic, 16)
+		for (int line = 0; line < num_lines_y; ++line)
+		{
+			float* column = dist2[line / width] + (line % width);
+			for (size_t y = 0; y < height; ++y)
+				f[y] = column[y * width];
+			edt::LowerEnvelope(f.data(), height, spacing[1], d.data(), v.data(), z.data());
+			for (size_t y = 0; y < height; ++y)
+				column[y * width] = d[y];
+		}
+
+		if (nrslices > 1 && !independent_slices)
+		{
+			const int num_lines_z = static_cast<int>(slice_size);
+#pragma omp for schedule(dynamic, 256)
+			for (int i = 0; i < num_lines_z; ++i)
+			{
+				for (size_t k = 0; k < nrslices; ++k)
+					f[k] = dist2[k][i];
+				edt::LowerEnvelope(f.data(), nrslices, spacing[2], d.data(), v.data(), z.data());
+				for (size_t k = 0; k < nrslices; ++k)
+					dist2[k][i] = d[k];
+			}
+		}
+	}
+}
+
+/** \brief Euclidean distance to the closest voxel where feature(value) is true
+
+	Voxels without any feature in the volume get edt::Infinity().
+*/
+template<typename TInput, typename TFeature>
+void DistanceTransform(const TInput* const* slices, size_t width, size_t height, size_t nrslices, const double spacing[3],
+		TFeature feature, float* const* dist, bool squared = false)
+{
+	const size_t slice_size = width * height;
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int k = 0; k < n; ++k)
+	{
+		for (size_t i = 0; i < slice_size; ++i)
+			dist[k][i] = feature(slices[k][i]) ? 0.f : edt::Infinity();
+	}
+
+	SquaredDistanceTransform(dist, width, height, nrslices, spacing);
+
+	if (!squared)
+	{
+#pragma omp parallel for
+		for (int k = 0; k < n; ++k)
+		{
+			for (size_t i = 0; i < slice_size; ++i)
+			{
+				if (dist[k][i] != edt::Infinity())
+					dist[k][i] = std::sqrt(dist[k][i]);
+			}
+		}
+	}
+}
+
+} // namespace iseg
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace iseg {
+
+namespace edgepreserving {
+
+/// Quantization of the intensities to at most 65536 levels, exact for integer valued images
+struct Levels
+{
+	static const int kMaxLevels = 65536;
+
+	Levels(const float* const* images, size_t area, size_t nrslices)
+	{
+		float lo = images[0][0], hi = images[0][0];
+		bool integral = true;
+		for (size_t z = 0; z < nrslices; ++z)
+		{
+			const float* image = images[z];
+			for (size_t i = 0; i < area; ++i)
+			{
+				lo = std::min(lo, image[i]);
+				hi = std::max(hi, image[i]);
+				integral = integral && (image[i] == std::floor(image[i]));
+			}
+		}
+		offset = lo;
+		if ((integral && hi - lo < kMaxLevels) || hi == lo)
+		{
+			step = 1.f;
+			count = static_cast<int>(hi - lo) + 1;
+		}
+		else
+		{
+			step = (hi - lo) / (kMaxLevels - 1);
+			count = kMaxLevels;
+		}
+		inv_step = 1.f / step;
+	}
+
+	int operator()(float v) const
+	{
+		const int l = static_cast<int>((v - offset) * inv_step + 0.5f);
+		return std::min(std::max(l, 0), count - 1);
+	}
+
+	float offset, step, inv_step;
+	int count;
+};
+
+/// Counts and sums per level, with blocks of kBlock levels so range queries skip over full blocks
+class LevelHistogram
+{
+public:
+	static const int kBlockBits = 4;
+	static const int kBlock = 1 << kBlockBits;
+
+	explicit LevelHistogram(int levels)
+			: _count(levels, 0), _sum(levels, 0.0), _block_count((levels >> kBlockBits) + 1, 0),
+				_block_sum((levels >> kBlockBits) + 1, 0.0) {}
+
+	void Add(int l, float v)
+	{
+		const int b = l >> kBlockBits;
+		++_count[l];
+		_sum[l] += v;
+		++_block_count[b];
+		_block_sum[b] += v;
+	}
+
+	/// Empty levels are reset to an exact zero sum, so rounding errors do not accumulate
+	void Remove(int l, float v)
+	{
+		const int b = l >> kBlockBits;
+		_sum[l] = (--_count[l] == 0) ? 0.0 : _sum[l] - v;
+		_block_sum[b] = (--_block_count[b] == 0) ? 0.0 : _block_sum[b] - v;
+	}
+
+	/// Count and sum of the values with level in [lo, hi]
+	void Query(int lo, int hi, int& count, double& sum) const
+	{
+		count = 0;
+		sum = 0.0;
+		const int b0 = lo >> kBlockBits, b1 = hi >> kBlockBits;
+		if (b0 == b1)
+		{
+			Fine(lo, hi, count, sum);
+			return;
+		}
+		Fine(lo, ((b0 + 1) << kBlockBits) - 1, count, sum);
+		for (int b = b0 + 1; b < b1; ++b)
+		{
+			count += _block_count[b];
+			sum += _block_sum[b];
+		}
+		Fine(b1 << kBlockBits, hi, count, sum);
+	}
+
+private:
+	void Fine(int lo, int hi, int& count, double& sum) const
+	{
+		for (int l = lo; l <= hi; ++l)
+		{
+			count += _count[l];
+			sum += _sum[l];
+		}
+	}
+
+	std::vector<int> _count;
+	std::vector<double> _sum;
+	std::vector<int> _block_count;
+	std::vector<double> _block_sum;
+};
+
+/// Separable [1 4 6 4 1] / 16 smoothing of a grid along one axis (approximately a Gaussian with sigma of 1 cell)
+inline void BlurAxis(std::vector<float>& grid, const int dims[4], int axis)
+{
+	const int n = dims[axis];
+	if (n < 2)
+		return;
+	int stride = 1;
+	for (int a = 0; a < axis; ++a)
+		stride *= dims[a];
+	const int nrlines = static_cast<int>(grid.size() / n);
+
+#pragma omp parallel
+	{
+		std::vector<float> line(n + 4, 0.f);
+#pragma omp for
+		for (int l = 0; l < nrlines; ++l)
+		{
+			float* p = &grid[(l / stride) * stride * n + l % stride];
+			for (int i = 0; i < n; ++i)
+				line[i + 2] = p[i * stride];
+			for (int i = 0; i < n; ++i)
+			{
+				const float* t = &line[i];
+				p[i * stride] = (t[0] + t[4] + 4.f * (t[1] + t[3]) + 6.f * t[2]) * (1.f / 16.f);
+			}
+		}
+	}
+}
+
+/// Bilateral grid filter of nrslices slices filtered together, see BilateralFilter
+inline void BilateralGrid(const float* const* images, float* const* results, size_t width, size_t height,
+		size_t nrslices, const float cell[4], float lo, float hi)
+{
+	const int pad = 2;
+	const int dims[4] = {
+			static_cast<int>((width - 1) / cell[0] + 0.5f) + 1 + 2 * pad,
+			static_cast<int>((height - 1) / cell[1] + 0.5f) + 1 + 2 * pad,
+			(nrslices > 1) ? static_cast<int>((nrslices - 1) / cell[2] + 0.5f) + 1 + 2 * pad : 1,
+			static_cast<int>((hi - lo) / cell[3] + 0.5f) + 1 + 2 * pad};
+	const size_t strides[4] = {1, static_cast<size_t>(dims[0]), static_cast<size_t>(dims[0]) * dims[1],
+			static_cast<size_t>(dims[0]) * dims[1] * dims[2]};
+	const float zpad = (nrslices > 1) ? static_cast<float>(pad) : 0.f;
+
+	std::vector<float> weights(strides[3] * dims[3], 0.f), values(weights.size(), 0.f);
+
+	// splat to the nearest cell, in parallel over the outermost spatial axis so no two threads share a cell
+	const bool by_slice = (nrslices > 1);
+	const int nrgroups = static_cast<int>(by_slice ? nrslices : height);
+	const float group_cell = by_slice ? cell[2] : cell[1];
+	const int nrcells = by_slice ? dims[2] : dims[1];
+#pragma omp parallel for
+	for (int c = 0; c < nrcells; ++c)
+	{
+		for (int g = 0; g < nrgroups; ++g)
+		{
+			if (static_cast<int>(g / group_cell + 0.5f) + pad != c)
+				continue;
+			const size_t z0 = by_slice ? g : 0, z1 = by_slice ? g + 1 : nrslices;
+			const size_t y0 = by_slice ? 0 : g, y1 = by_slice ? height : g + 1;
+			for (size_t z = z0; z < z1; ++z)
+			{
+				const size_t gz = static_cast<size_t>(z / cell[2] + zpad + 0.5f);
+				for (size_t y = y0; y < y1; ++y)
+				{
+					const size_t gy = static_cast<size_t>(y / cell[1] + pad + 0.5f);
+					const float* row = images[z] + y * width;
+					for (size_t x = 0; x < width; ++x)
+					{
+						const size_t gx = static_cast<size_t>(x / cell[0] + pad + 0.5f);
+						const size_t gr = static_cast<size_t>((row[x] - lo) / cell[3] + pad + 0.5f);
+						const size_t i = gx + gy * strides[1] + gz * strides[2] + gr * strides[3];
+						weights[i] += 1.f;
+						values[i] += row[x];
+					}
+				}
+			}
+		}
+	}
+
+	for (int axis = 0; axis < 4; ++axis)
+	{
+		BlurAxis(weights, dims, axis);
+		BlurAxis(values, dims, axis);
+	}
+
+	// slice the grid by multilinear interpolation at the position of each voxel
+	const int nrrows = static_cast<int>(nrslices * height);
+#pragma omp parallel for
+	for (int r = 0; r < nrrows; ++r)
+	{
+		const size_t z = r / height, y = r % height;
+		const float* row = images[z] + y * width;
+		float* out = results[z] + y * width;
+		float pos[4];
+		pos[1] = y / cell[1] + pad;
+		pos[2] = z / cell[2] + zpad;
+		for (size_t x = 0; x < width; ++x)
+		{
+			pos[0] = x / cell[0] + pad;
+			pos[3] = (row[x] - lo) / cell[3] + pad;
+			size_t base = 0;
+			float frac[4];
+			for (int a = 0; a < 4; ++a)
+			{
+				const int i = std::min(static_cast<int>(pos[a]), dims[a] - 2 > 0 ? dims[a] - 2 : 0);
+				frac[a] = (dims[a] > 1) ? pos[a] - i : 0.f;
+				base += i * strides[a];
+			}
+			float w = 0.f, v = 0.f;
+			for (int corner = 0; corner < 16; ++corner)
+			{
+				float f = 1.f;
+				size_t i = base;
+				for (int a = 0; a < 4; ++a)
+				{
+					if (corner & (1 << a))
+					{
+						f *= frac[a];
+						i += (dims[a] > 1) ? strides[a] : 0;
+					}
+					else
+					{
+						f *= 1.f - frac[a];
+					}
+				}
+				if (f != 0.f)
+				{
+					w += f * weights[i];
+					v += f * values[i];
+				}
+			}
+			out[x] = (w > 0.f) ? v / w : row[x];
+		}
+	}
+}
+
+} // namespace edgepreserving
+
+/** \brief Sigma filter: mean of the values within (center - sigma, center + sigma) in a nx x ny x nz window
+
+	Even window sizes are increased by one, the window is clipped at the image borders. The window slides along
+	each row keeping a histogram of the quantized values (see edgepreserving::Levels) with their sums, so moving
+	the window costs 2 ny nz histogram updates and the range query visits at most 2 sigma / (16 step) blocks,
+	independent of nx. For integer valued images the result equals the direct filter. Rows are filtered in
+	parallel, images and results must not overlap.
+*/
+inline void SigmaFilter(const float* const* images, float* const* results, size_t width, size_t height,
+		size_t nrslices, float sigma, int nx, int ny, int nz)
+{
+	const size_t area = width * height;
+	if (area == 0 || nrslices == 0)
+		return;
+	if (!(sigma > 0.f))
+	{
+		for (size_t z = 0; z < nrslices; ++z)
+			std::copy(images[z], images[z] + area, results[z]);
+		return;
+	}
+
+	const edgepreserving::Levels levels(images, area, nrslices);
+	const double s = sigma / levels.step;
+	// levels l with |l - center| < s
+	const int radius = (s < levels.count) ? static_cast<int>(std::ceil(s)) - 1 : levels.count;
+	const int rx = nx / 2, ry = ny / 2, rz = nz / 2;
+	const int w = static_cast<int>(width), h = static_cast<int>(height), d = static_cast<int>(nrslices);
+	const int nrrows = d * h;
+
+#pragma omp parallel
+	{
+		edgepreserving::LevelHistogram hist(levels.count);
+#pragma omp for
+		for (int r = 0; r < nrrows; ++r)
+		{
+			const int z = r / h, y = r % h;
+			const int z0 = std::max(z - rz, 0), z1 = std::min(z + rz, d - 1);
+			const int y0 = std::max(y - ry, 0), y1 = std::min(y + ry, h - 1);
+
+			auto add = [&](int x) {
+				for (int k = z0; k <= z1; ++k)
+					for (int j = y0; j <= y1; ++j)
+					{
+						const float v = images[k][j * width + x];
+						hist.Add(levels(v), v);
+					}
+			};
+			auto remove = [&](int x) {
+				for (int k = z0; k <= z1; ++k)
+					for (int j = y0; j <= y1; ++j)
+					{
+						const float v = images[k][j * width + x];
+						hist.Remove(levels(v), v);
+					}
+			};
+
+			for (int x = 0; x <= std::min(rx, w - 1); ++x)
+				add(x);
+
+			const float* row = images[z] + y * width;
+			float* out = results[z] + y * width;
+			for (int x = 0; x < w; ++x)
+			{
+				const int center = levels(row[x]);
+				int count;
+				double sum;
+				hist.Query(std::max(center - radius, 0), std::min(center + radius, levels.count - 1), count, sum);
+				out[x] = static_cast<float>(sum / count);
+
+				if (x - rx >= 0)
+					remove(x - rx);
+				if (x + rx + 1 < w)
+					add(x + rx + 1);
+			}
+
+			for (int x = std::max(w - rx, 0); x < w; ++x)
+				remove(x);
+		}
+	}
+}
+
+/** \brief Bilateral filter with Gaussian spatial and range kernels, computed on a bilateral grid
+
+	The voxels are accumulated in a grid sampled at sigma_space along each axis (in voxels, at least 1) and at
+	sigma_range along the intensity, the grid is smoothed and interpolated at each voxel. If sigma_space[2] is
+	not positive, each slice is filtered separately. The range axis is limited to kMaxRangeCells cells and the grid
+	to kMaxCells cells, by coarser sampling, i.e. stronger smoothing. Images and results must not overlap.
+*/
+inline void BilateralFilter(const float* const* images, float* const* results, size_t width, size_t height,
+		size_t nrslices, const float sigma_space[3], float sigma_range)
+{
+	static const float kMaxRangeCells = 256.f;
+	static const double kMaxCells = 1 << 25;
+
+	const size_t area = width * height;
+	if (area == 0 || nrslices == 0)
+		return;
+
+	float lo = images[0][0], hi = images[0][0];
+	for (size_t z = 0; z < nrslices; ++z)
+	{
+		const float* image = images[z];
+		for (size_t i = 0; i < area; ++i)
+		{
+			lo = std::min(lo, image[i]);
+			hi = std::max(hi, image[i]);
+		}
+	}
+	if (!(sigma_range > 0.f) || hi == lo)
+	{
+		for (size_t z = 0; z < nrslices; ++z)
+			std::copy(images[z], images[z] + area, results[z]);
+		return;
+	}
+
+	const bool volume = (sigma_space[2] > 0.f && nrslices > 1);
+	const size_t depth = volume ? nrslices : 1;
+	float cell[4] = {std::max(sigma_space[0], 1.f), std::max(sigma_space[1], 1.f),
+			volume ? std::max(sigma_space[2], 1.f) : 1.f, std::max(sigma_range, (hi - lo) / kMaxRangeCells)};
+
+	const double cells = (width / cell[0] + 5.0) * (height / cell[1] + 5.0) * (volume ? depth / cell[2] + 5.0 : 1.0) *
+											 ((hi - lo) / cell[3] + 5.0);
+	if (cells > kMaxCells)
+	{
+		const float f = static_cast<float>(std::pow(cells / kMaxCells, volume ? 1.0 / 3.0 : 0.5));
+		for (int a = 0; a < (volume ? 3 : 2); ++a)
+			cell[a] *= f;
+	}
+
+	for (size_t z = 0; z < nrslices; z += depth)
+	{
+		edgepreserving::BilateralGrid(images + z, results + z, width, height, depth, cell, lo, hi);
+	}
+}
+
+} // namespace iseg
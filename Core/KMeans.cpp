@@ -10,6 +10,7 @@
 #include "Precompiled.h"
 
 #include "KMeans.h"
+#include "VolumeClustering.h"
 
 #include <cfloat>
 
@@ -107,40 +108,26 @@ void KMeans::return_m(float* result_bits)
 
 void KMeans::apply_to(float** sources, float* result_bits)
 {
-	float dist, distmin;
-	short unsigned cindex;
-	short dummy;
-
-	for (unsigned i = 0; i < area; i++)
+	const int n = static_cast<int>(area);
+#pragma omp parallel
 	{
-		dummy = 0;
-		distmin = 0;
-		cindex = 0;
-		for (short n = 0; n < dim; n++)
+		std::vector<float> x(dim);
+		clustering::DynamicDistance distance(dim);
+#pragma omp for
+		for (int i = 0; i < n; i++)
 		{
-			distmin += (sources[n][i] - centers[cindex]) *
-								 (sources[n][i] - centers[cindex]) * weights[n];
-			cindex++;
-		}
-		for (short l = 1; l < nrclasses; l++)
-		{
-			dist = 0;
-			for (short n = 0; n < dim; n++)
-			{
-				dist += (sources[n][i] - centers[cindex]) *
-								(sources[n][i] - centers[cindex]) * weights[n];
-				cindex++;
-			}
-			if (dist < distmin)
-			{
-				distmin = dist;
-				dummy = l;
-			}
+			result_bits[i] = 255.0f / (nrclasses - 1) * nearest_center(distance, sources, i, x.data());
 		}
-		result_bits[i] = 255.0f / (nrclasses - 1) * dummy;
 	}
 }
 
+short KMeans::nearest_center(const clustering::DynamicDistance& distance, float** sources, unsigned i, float* x) const
+{
+	for (short n = 0; n < dim; n++)
+		x[n] = sources[n][i];
+	return clustering::NearestCenter(distance, x, centers, weights, nrclasses);
+}
+
 void KMeans::recompute_centers()
 {
 	std::vector<unsigned> count;
@@ -171,40 +158,20 @@ void KMeans::recompute_centers()
 unsigned KMeans::recompute_membership()
 {
 	unsigned count = 0;
-	float dist, distmin;
-	short unsigned cindex;
-	short dummy;
-
-	for (unsigned i = 0; i < area; i++)
+	const int n = static_cast<int>(area);
+#pragma omp parallel reduction(+ : count)
 	{
-		dummy = 0;
-		distmin = 0;
-		cindex = 0;
-		for (short n = 0; n < dim; n++)
-		{
-			distmin += (bits[n][i] - centers[cindex]) *
-								 (bits[n][i] - centers[cindex]) * weights[n];
-			cindex++;
-		}
-		for (short l = 1; l < nrclasses; l++)
+		std::vector<float> x(dim);
+		clustering::DynamicDistance distance(dim);
+#pragma omp for
+		for (int i = 0; i < n; i++)
 		{
-			dist = 0;
-			for (short n = 0; n < dim; n++)
+			const short l = nearest_center(distance, bits, i, x.data());
+			if (m[i] != l)
 			{
-				dist += (bits[n][i] - centers[cindex]) *
-								(bits[n][i] - centers[cindex]) * weights[n];
-				cindex++;
+				count++;
+				m[i] = l;
 			}
-			if (dist < distmin)
-			{
-				distmin = dist;
-				dummy = l;
-			}
-		}
-		if (m[i] != dummy)
-		{
-			count++;
-			m[i] = dummy;
 		}
 	}
 
@@ -16,6 +16,10 @@
 
 namespace iseg {
 
+namespace clustering {
+struct DynamicDistance;
+}
+
 class ISEG_CORE_API KMeans
 {
 public:
@@ -40,6 +44,7 @@ public:
 private:
 	void recompute_centers();
 	unsigned recompute_membership();
+	short nearest_center(const clustering::DynamicDistance& distance, float** sources, unsigned i, float* x) const;
 	short* m;
 	short nrclasses;
 	short dim;
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <set>
+#include <vector>
+
+namespace iseg {
+
+/** \brief Maps values to levels, out[i] = leveldiff * j where j is the index of the first threshold with in[i] <= threshold
+
+	For ascending thresholds j is the number of thresholds below in[i], which is counted without branches
+	in blocks of pixels, one threshold at a time, i.e. the inner loop can be vectorized by the compiler.
+	Otherwise the thresholds are searched per pixel. in and out may be the same array.
+*/
+template<typename T>
+void ThresholdToLevels(const float* in, T* out, size_t n, const float* thresholds, size_t nrthresholds, float leveldiff)
+{
+	bool sorted = true;
+	for (size_t k = 1; k < nrthresholds; ++k)
+	{
+		// false for NaN, where counting and searching differ
+		sorted = sorted && (thresholds[k - 1] <= thresholds[k]);
+	}
+
+	if (!sorted)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			size_t j = 0;
+			while (j < nrthresholds && in[i] > thresholds[j])
+				j++;
+			out[i] = static_cast<T>(j * leveldiff);
+		}
+		return;
+	}
+
+	const size_t block = 256;
+	unsigned count[block];
+	for (size_t b = 0; b < n; b += block)
+	{
+		const size_t m = std::min(block, n - b);
+		const float* v = in + b;
+		std::fill(count, count + m, 0u);
+		for (size_t k = 0; k < nrthresholds; ++k)
+		{
+			const float t = thresholds[k];
+			for (size_t i = 0; i < m; ++i)
+				count[i] += (v[i] > t) ? 1u : 0u;
+		}
+		for (size_t i = 0; i < m; ++i)
+			out[b + i] = static_cast<T>(count[i] * leveldiff);
+	}
+}
+
+/** \brief Dense lookup table over all values of an unsigned label type, e.g. tissues_size_t
+
+	The operations (renumbering, grouping, removing, capping) are composed into the table, i.e. the labels
+	are rewritten only once by RemapLabels however many operations are applied. Starts as the identity.
+*/
+template<typename T>
+class LabelMap
+{
+public:
+	LabelMap() : _lut(static_cast<size_t>(std::numeric_limits<T>::max()) + 1)
+	{
+		for (size_t v = 0; v < _lut.size(); ++v)
+			_lut[v] = static_cast<T>(v);
+	}
+
+	T operator[](T v) const { return _lut[v]; }
+
+	const T* data() const { return _lut.data(); }
+
+	bool is_identity() const
+	{
+		for (size_t v = 0; v < _lut.size(); ++v)
+		{
+			if (_lut[v] != static_cast<T>(v))
+				return false;
+		}
+		return true;
+	}
+
+	/// then v -> indexMap[v], labels beyond the end of indexMap are kept
+	LabelMap& map(const std::vector<T>& indexMap)
+	{
+		for (auto& v : _lut)
+		{
+			if (v < indexMap.size())
+				v = indexMap[v];
+		}
+		return *this;
+	}
+
+	/// then olds[i] -> news[i], if a label is listed twice the last entry is used
+	LabelMap& group(const std::vector<T>& olds, const std::vector<T>& news)
+	{
+		LabelMap crossref;
+		const size_t count = std::min(olds.size(), news.size());
+		for (size_t i = 0; i < count; ++i)
+			crossref._lut[olds[i]] = news[i];
+		return then(crossref);
+	}
+
+	/// then the labels are set to 0 (background, which is never removed) and the ones above are renumbered without gaps
+	LabelMap& remove(const std::set<T>& labels)
+	{
+		LabelMap shifted;
+		size_t removed = 0;
+		for (size_t v = 1; v < _lut.size(); ++v)
+		{
+			if (labels.count(static_cast<T>(v)))
+			{
+				shifted._lut[v] = 0;
+				removed++;
+			}
+			else
+			{
+				shifted._lut[v] = static_cast<T>(v - removed);
+			}
+		}
+		return then(shifted);
+	}
+
+	/// then labels above maxval are set to 0
+	LabelMap& cap(T maxval)
+	{
+		for (auto& v : _lut)
+		{
+			if (v > maxval)
+				v = 0;
+		}
+		return *this;
+	}
+
+	/// then v -> next[v]
+	LabelMap& then(const LabelMap& next)
+	{
+		for (auto& v : _lut)
+			v = next._lut[v];
+		return *this;
+	}
+
+private:
+	std::vector<T> _lut;
+};
+
+/// labels[i] = map[labels[i]] for i < n
+template<typename T>
+void RemapLabels(T* labels, size_t n, const LabelMap<T>& map)
+{
+	const T* lut = map.data();
+	for (size_t i = 0; i < n; ++i)
+		labels[i] = lut[labels[i]];
+}
+
+} // namespace iseg
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace iseg {
+
+namespace morphology {
+
+enum eOperation {
+	kErode,
+	kDilate,
+	kClose,
+	kOpen
+};
+
+/// The two closest labels (which are different) and their squared distance
+template<typename TLabel>
+struct NearestLabels
+{
+	float d2[2];
+	TLabel label[2];
+
+	void Clear()
+	{
+		d2[0] = d2[1] = std::numeric_limits<float>::max();
+		label[0] = label[1] = 0;
+	}
+
+	void Add(float d, TLabel l)
+	{
+		if (l == label[0])
+		{
+			d2[0] = std::min(d2[0], d);
+		}
+		else if (l == label[1])
+		{
+			if (d < d2[1])
+			{
+				d2[1] = d;
+				if (d2[1] < d2[0])
+				{
+					std::swap(d2[0], d2[1]);
+					std::swap(label[0], label[1]);
+				}
+			}
+		}
+		else if (d < d2[0])
+		{
+			d2[1] = d2[0];
+			label[1] = label[0];
+			d2[0] = d;
+			label[0] = l;
+		}
+		else if (d < d2[1])
+		{
+			d2[1] = d;
+			label[1] = l;
+		}
+	}
+
+	/// Squared distance to the closest label other than l
+	float Other(TLabel l) const { return (label[0] != l) ? d2[0] : d2[1]; }
+
+	/// Squared distance to label l
+	float To(TLabel l) const
+	{
+		return (label[0] == l) ? d2[0] : ((label[1] == l) ? d2[1] : std::numeric_limits<float>::max());
+	}
+};
+
+/// Voxels changed by a pass of one slice, i.e. index and previous label
+template<typename TLabel>
+using Changes = std::vector<std::vector<std::pair<unsigned, TLabel>>>;
+
+/** \brief Computes the two closest different labels of the feature voxels within radius, and lets decide set the new label
+
+	The ball is decomposed into three passes along the axes, each pass only looks radius / spacing voxels
+	in both directions. Keeping the two closest different labels per voxel is exact (a label which is
+	not among the two closest at any voxel on a line cannot be among the two closest after the pass).
+	The slices are processed in order, only the in-slice results of the slices within reach in z are kept.
+
+	decide(z, i, label, nearest) returns the new label of voxel i in slice z, the changes are recorded
+	(sorted by index) per slice.
+*/
+template<typename TLabel, typename TFeature, typename TDecide>
+void NearestLabelPass(TLabel* const* labels, size_t width, size_t height, size_t nrslices, const double spacing[3],
+		double radius, TFeature feature, TDecide decide, Changes<TLabel>& changes)
+{
+	typedef NearestLabels<TLabel> nearest_type;
+	const size_t area = width * height;
+	changes.assign(nrslices, std::vector<std::pair<unsigned, TLabel>>());
+	if (area == 0 || nrslices == 0)
+		return;
+
+	const float r2 = static_cast<float>(radius * radius);
+	const int rx = static_cast<int>(radius / spacing[0]);
+	const int ry = static_cast<int>(radius / spacing[1]);
+	const int rz = std::min(static_cast<int>(radius / spacing[2]), static_cast<int>(nrslices) - 1);
+	const int w = static_cast<int>(width), h = static_cast<int>(height), n = static_cast<int>(nrslices);
+
+	std::vector<float> dx2(2 * rx + 1), dy2(2 * ry + 1), dz2(2 * rz + 1);
+	for (int d = -rx; d <= rx; ++d)
+		dx2[d + rx] = static_cast<float>((d * spacing[0]) * (d * spacing[0]));
+	for (int d = -ry; d <= ry; ++d)
+		dy2[d + ry] = static_cast<float>((d * spacing[1]) * (d * spacing[1]));
+	for (int d = -rz; d <= rz; ++d)
+		dz2[d + rz] = static_cast<float>((d * spacing[2]) * (d * spacing[2]));
+
+	// in-slice results of the slices k - rz ... k + rz
+	const int ring_size = 2 * rz + 1;
+	std::vector<std::vector<nearest_type>> ring(ring_size, std::vector<nearest_type>(area));
+	std::vector<nearest_type> along_x(area);
+	std::vector<TLabel> output(area);
+
+	auto in_slice = [&](int z) {
+		const TLabel* slice = labels[z];
+		std::vector<nearest_type>& result = ring[z % ring_size];
+
+#pragma omp parallel for
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				nearest_type& c = along_x[y * width + x];
+				c.Clear();
+				for (int d = std::max(-rx, -x); d <= std::min(rx, w - 1 - x); ++d)
+				{
+					const TLabel l = slice[y * width + x + d];
+					if (feature(l))
+						c.Add(dx2[d + rx], l);
+				}
+			}
+		}
+
+#pragma omp parallel for
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				nearest_type& c = result[y * width + x];
+				c.Clear();
+				for (int d = std::max(-ry, -y); d <= std::min(ry, h - 1 - y); ++d)
+				{
+					const nearest_type& q = along_x[(y + d) * width + x];
+					for (int k = 0; k < 2; ++k)
+					{
+						const float d2 = q.d2[k] + dy2[d + ry];
+						if (d2 <= r2)
+							c.Add(d2, q.label[k]);
+					}
+				}
+			}
+		}
+	};
+
+	for (int z = 0; z < std::min(rz, n); ++z)
+	{
+		in_slice(z);
+	}
+
+	const int num_pixels = static_cast<int>(area);
+	for (int z = 0; z < n; ++z)
+	{
+		if (z + rz < n)
+			in_slice(z + rz);
+
+		const int z0 = std::max(z - rz, 0), z1 = std::min(z + rz, n - 1);
+		TLabel* slice = labels[z];
+#pragma omp parallel for
+		for (int i = 0; i < num_pixels; ++i)
+		{
+			nearest_type c;
+			c.Clear();
+			for (int k = z0; k <= z1; ++k)
+			{
+				const nearest_type& q = ring[k % ring_size][i];
+				for (int j = 0; j < 2; ++j)
+				{
+					const float d2 = q.d2[j] + dz2[k - z + rz];
+					if (d2 <= r2)
+						c.Add(d2, q.label[j]);
+				}
+			}
+			output[i] = decide(z, i, slice[i], c);
+		}
+
+		for (unsigned i = 0; i < area; ++i)
+		{
+			if (output[i] != slice[i])
+			{
+				changes[z].push_back(std::make_pair(i, slice[i]));
+				slice[i] = output[i];
+			}
+		}
+	}
+}
+
+/// Previous label of voxel i, if it was changed
+template<typename TLabel>
+bool FindChange(const std::vector<std::pair<unsigned, TLabel>>& changes, unsigned i, TLabel& previous)
+{
+	auto it = std::lower_bound(changes.begin(), changes.end(), std::make_pair(i, TLabel(0)),
+			[](const std::pair<unsigned, TLabel>& a, const std::pair<unsigned, TLabel>& b) { return a.first < b.first; });
+	if (it == changes.end() || it->first != i)
+		return false;
+	previous = it->second;
+	return true;
+}
+
+} // namespace morphology
+
+/** \brief Erode, dilate, open or close all selected labels at once
+
+	Morphology with a ball of the given radius (in the units of spacing), applied to all selected labels
+	(selected[label] != 0) in one pass:
+	- erosion sets a voxel to 0 if a voxel with a different label is in its ball, as if each label was eroded on its own,
+	- dilation sets a voxel which is not selected to the closest selected label in its ball,
+	- opening only restores eroded voxels to their previous label, closing only reverts dilated voxels.
+	Voxels with a locked label (locked[label] != 0) are never changed. Labels which are not in the
+	tables are neither selected nor locked.
+*/
+template<typename TLabel>
+void LabelMorphology(TLabel* const* labels, size_t width, size_t height, size_t nrslices, const double spacing[3],
+		double radius, morphology::eOperation operation, const std::vector<char>& selected, const std::vector<char>& locked)
+{
+	using namespace morphology;
+
+	auto is_selected = [&](TLabel l) { return static_cast<size_t>(l) < selected.size() && selected[l] != 0; };
+	auto is_locked = [&](TLabel l) { return static_cast<size_t>(l) < locked.size() && locked[l] != 0; };
+	auto any_label = [](TLabel) { return true; };
+	const float r2 = static_cast<float>(radius * radius);
+
+	auto erode = [&](size_t, size_t, TLabel l, const NearestLabels<TLabel>& c) {
+		return (is_selected(l) && !is_locked(l) && c.Other(l) <= r2) ? TLabel(0) : l;
+	};
+	auto dilate = [&](size_t, size_t, TLabel l, const NearestLabels<TLabel>& c) {
+		return (!is_selected(l) && !is_locked(l) && c.d2[0] <= r2) ? c.label[0] : l;
+	};
+
+	Changes<TLabel> first, second;
+	if (operation == kErode)
+	{
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, any_label, erode, first);
+	}
+	else if (operation == kDilate)
+	{
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, is_selected, dilate, first);
+	}
+	else if (operation == kOpen)
+	{
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, any_label, erode, first);
+
+		// only the previous label can reach an eroded voxel
+		auto restore = [&](size_t z, size_t i, TLabel l, const NearestLabels<TLabel>& c) {
+			TLabel previous;
+			if (FindChange(first[z], static_cast<unsigned>(i), previous) && c.To(previous) <= r2)
+				return previous;
+			return l;
+		};
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, is_selected, restore, second);
+	}
+	else
+	{
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, is_selected, dilate, first);
+
+		// dilated voxels, which are close to a different label
+		auto restore = [&](size_t z, size_t i, TLabel l, const NearestLabels<TLabel>& c) {
+			TLabel previous;
+			if (c.Other(l) <= r2 && FindChange(first[z], static_cast<unsigned>(i), previous))
+				return previous;
+			return l;
+		};
+		NearestLabelPass(labels, width, height, nrslices, spacing, radius, any_label, restore, second);
+	}
+}
+
+} // namespace iseg
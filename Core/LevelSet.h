@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace iseg {
+
+namespace levelset {
+
+enum eState : unsigned char {
+	kFar = 0,
+	kTrial,
+	kBand
+};
+
+/** \brief Upwind solution of |grad d| = 1 (unit spacing) from the distances m of the accepted neighbors
+
+	m contains the smallest accepted distance along each axis, axes without accepted neighbor are ignored.
+*/
+inline float SolveEikonal(float m[3], int dim)
+{
+	std::sort(m, m + dim);
+	float d = m[0] + 1.f;
+	float sum = m[0], sum2 = m[0] * m[0];
+	for (int a = 1; a < dim && m[a] < d; ++a)
+	{
+		sum += m[a];
+		sum2 += m[a] * m[a];
+		const float n = static_cast<float>(a + 1);
+		const float disc = sum * sum - n * (sum2 - 1.f);
+		d = (sum + std::sqrt(std::max(disc, 0.f))) / n;
+	}
+	return d;
+}
+
+} // namespace levelset
+
+/** \brief Narrow band level set for geodesic active contours in 2D (nrslices == 1) and 3D
+
+	phi_t = k (balloon + epsilon curvature) |grad phi| - grad P . grad phi
+
+	where phi is positive inside the contour, k is the speed image and P the edge attraction potential.
+	Only the voxels with |phi| < band_width are updated, in parallel, all other voxels hold +/- band_width.
+	The band is rebuilt by fast marching redistancing from the zero level, when the front gets close to the
+	border of the band or when Reinitialize is called.
+*/
+class NarrowBandLevelSet
+{
+public:
+	/// Sets the initial level set (need not be a distance function) and builds the band
+	void Init(size_t width, size_t height, size_t nrslices, const float* const* phi, float band_width = 3.f)
+	{
+		_width = width;
+		_height = height;
+		_nrslices = nrslices;
+		_area = width * height;
+		_band_width = band_width;
+
+		const size_t n = _area * _nrslices;
+		_phi.resize(n);
+		_state.assign(n, levelset::kFar);
+		_band.resize(n);
+		for (size_t k = 0; k < _nrslices; ++k)
+		{
+			for (size_t i = 0; i < _area; ++i)
+			{
+				_phi[k * _area + i] = std::max(-_band_width, std::min(phi[k][i], _band_width));
+				_band[k * _area + i] = k * _area + i;
+			}
+		}
+		Reinitialize();
+	}
+
+	/// Speed image k, one pointer per slice, must stay valid while iterating
+	void SetSpeed(const float* const* k) { _k.assign(k, k + _nrslices); }
+
+	/// Edge attraction potential P, one pointer per slice, must stay valid while iterating
+	void SetPotential(const float* const* P) { _P.assign(P, P + _nrslices); }
+
+	void SetParameters(float balloon, float epsilon, float step_size)
+	{
+		_balloon = balloon;
+		_epsilon = epsilon;
+		_step_size = step_size;
+	}
+
+	/// Runs nrsteps time steps, redistancing every reinit_frequency steps (never if 0)
+	void Iterate(unsigned nrsteps, unsigned reinit_frequency)
+	{
+		for (unsigned i = 1; i <= nrsteps; ++i)
+		{
+			if (Step() || (reinit_frequency != 0 && i % reinit_frequency == 0))
+				Reinitialize();
+		}
+	}
+
+	/** \brief One explicit time step on the band
+
+		\returns true if the zero level got close to the border of the band, i.e. the band should be rebuilt
+	*/
+	bool Step()
+	{
+		const int n = static_cast<int>(_band.size());
+		_update.resize(_band.size());
+
+#pragma omp parallel for schedule(dynamic, 256)
+		for (int b = 0; b < n; ++b)
+		{
+			_update[b] = Update(_band[b]);
+		}
+
+		int near_border = 0;
+#pragma omp parallel for reduction(+ : near_border)
+		for (int b = 0; b < n; ++b)
+		{
+			const size_t idx = _band[b];
+			const float v = std::max(-_band_width, std::min(_phi[idx] + _step_size * _update[b], _band_width));
+			_phi[idx] = v;
+			if (std::abs(v) < 1.f && TouchesFar(idx))
+				++near_border;
+		}
+		return near_border != 0;
+	}
+
+	/// Redistancing of the band by fast marching from the zero level
+	void Reinitialize()
+	{
+		using namespace levelset;
+		const float inf = std::numeric_limits<float>::max();
+
+		// distance of the voxels next to the zero level, from linear interpolation
+		const int n = static_cast<int>(_band.size());
+		std::vector<float> d0(_band.size());
+#pragma omp parallel for schedule(dynamic, 256)
+		for (int b = 0; b < n; ++b)
+		{
+			d0[b] = InterfaceDistance(_band[b]);
+		}
+
+		for (size_t idx : _band)
+		{
+			_state[idx] = kFar;
+			_phi[idx] = (_phi[idx] > 0) ? _band_width : -_band_width;
+		}
+
+		typedef std::pair<float, size_t> Entry;
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> trial;
+		std::vector<size_t> band;
+		for (int b = 0; b < n; ++b)
+		{
+			if (d0[b] != inf)
+			{
+				const size_t idx = _band[b];
+				_phi[idx] = (_phi[idx] > 0) ? d0[b] : -d0[b];
+				_state[idx] = kBand;
+				band.push_back(idx);
+			}
+		}
+		for (size_t b = 0, num_interface = band.size(); b < num_interface; ++b)
+		{
+			UpdateNeighbors(band[b], trial);
+		}
+
+		while (!trial.empty())
+		{
+			const Entry e = trial.top();
+			trial.pop();
+			if (_state[e.second] != kTrial || std::abs(_phi[e.second]) != e.first)
+				continue;
+			_state[e.second] = kBand;
+			band.push_back(e.second);
+			UpdateNeighbors(e.second, trial);
+		}
+
+		_band.swap(band);
+	}
+
+	/// Level set value of voxel i in slice z
+	float Value(size_t z, size_t i) const { return _phi[z * _area + i]; }
+
+	void GetLevelSet(float* const* phi) const
+	{
+		for (size_t k = 0; k < _nrslices; ++k)
+		{
+			std::copy(_phi.begin() + k * _area, _phi.begin() + (k + 1) * _area, phi[k]);
+		}
+	}
+
+	/// Voxels which are updated in each step
+	const std::vector<size_t>& Band() const { return _band; }
+
+private:
+	float At(long x, long y, long z) const { return _phi[z * _area + y * _width + x]; }
+
+	/// First and second derivative along one axis, one-sided at the border
+	template<typename TGet>
+	static void Derivatives(long c, long size, TGet get, float& d1, float& d2)
+	{
+		if (size < 2)
+		{
+			d1 = d2 = 0.f;
+		}
+		else if (c == 0)
+		{
+			d1 = get(1) - get(0);
+			d2 = 0.f;
+		}
+		else if (c == size - 1)
+		{
+			d1 = get(c) - get(c - 1);
+			d2 = 0.f;
+		}
+		else
+		{
+			d1 = 0.5f * (get(c + 1) - get(c - 1));
+			d2 = get(c + 1) - 2.f * get(c) + get(c - 1);
+		}
+	}
+
+	/// Mixed derivative in the plane of two axes, 0 at the border
+	template<typename TGet>
+	static float Mixed(long a, long size_a, long b, long size_b, TGet get)
+	{
+		if (a == 0 || b == 0 || a + 1 >= size_a || b + 1 >= size_b)
+			return 0.f;
+		return 0.25f * (get(a + 1, b + 1) - get(a - 1, b + 1) - get(a + 1, b - 1) + get(a - 1, b - 1));
+	}
+
+	float Update(size_t idx) const
+	{
+		const long z = static_cast<long>(idx / _area);
+		const long y = static_cast<long>((idx % _area) / _width);
+		const long x = static_cast<long>(idx % _width);
+		const long w = static_cast<long>(_width), h = static_cast<long>(_height), n = static_cast<long>(_nrslices);
+
+		float px, py, pz, pxx, pyy, pzz;
+		Derivatives(x, w, [&](long c) { return At(c, y, z); }, px, pxx);
+		Derivatives(y, h, [&](long c) { return At(x, c, z); }, py, pyy);
+		Derivatives(z, n, [&](long c) { return At(x, y, c); }, pz, pzz);
+
+		const float g2 = px * px + py * py + pz * pz;
+		if (g2 == 0)
+			return 0.f;
+
+		float curvature = 0.f;
+		if (_epsilon != 0)
+		{
+			const float pxy = Mixed(x, w, y, h, [&](long a, long b) { return At(a, b, z); });
+			const float pxz = Mixed(x, w, z, n, [&](long a, long b) { return At(a, y, b); });
+			const float pyz = Mixed(y, h, z, n, [&](long a, long b) { return At(x, a, b); });
+			curvature = ((pyy + pzz) * px * px + (pxx + pzz) * py * py + (pxx + pyy) * pz * pz -
+										2.f * (px * py * pxy + px * pz * pxz + py * pz * pyz)) /
+									g2;
+		}
+
+		const size_t i = idx % _area;
+		float Px, Py, Pz, dummy;
+		Derivatives(x, w, [&](long c) { return _P[z][y * w + c]; }, Px, dummy);
+		Derivatives(y, h, [&](long c) { return _P[z][c * w + x]; }, Py, dummy);
+		Derivatives(z, n, [&](long c) { return _P[c][i]; }, Pz, dummy);
+
+		return _k[z][i] * (std::sqrt(g2) * _balloon + _epsilon * curvature) - (Px * px + Py * py + Pz * pz);
+	}
+
+	template<typename TVisit>
+	void ForEachNeighbor(size_t idx, TVisit visit) const
+	{
+		const size_t x = idx % _width, y = (idx % _area) / _width, z = idx / _area;
+		if (x > 0)
+			visit(idx - 1, 0);
+		if (x + 1 < _width)
+			visit(idx + 1, 0);
+		if (y > 0)
+			visit(idx - _width, 1);
+		if (y + 1 < _height)
+			visit(idx + _width, 1);
+		if (z > 0)
+			visit(idx - _area, 2);
+		if (z + 1 < _nrslices)
+			visit(idx + _area, 2);
+	}
+
+	bool TouchesFar(size_t idx) const
+	{
+		bool touches = false;
+		ForEachNeighbor(idx, [&](size_t q, int) { touches = touches || _state[q] == levelset::kFar; });
+		return touches;
+	}
+
+	/// Distance to the zero level if it crosses an edge to a neighbor, infinity otherwise
+	float InterfaceDistance(size_t idx) const
+	{
+		const float inf = std::numeric_limits<float>::max();
+		const float v = _phi[idx];
+		float d[3] = {inf, inf, inf};
+		ForEachNeighbor(idx, [&](size_t q, int axis) {
+			const float vq = _phi[q];
+			if ((v > 0) != (vq > 0))
+				d[axis] = std::min(d[axis], v / (v - vq));
+		});
+
+		float sum = 0.f;
+		for (int a = 0; a < 3; ++a)
+		{
+			if (d[a] == 0)
+				return 0.f;
+			if (d[a] != inf)
+				sum += 1.f / (d[a] * d[a]);
+		}
+		return (sum == 0) ? inf : 1.f / std::sqrt(sum);
+	}
+
+	template<typename TQueue>
+	void UpdateNeighbors(size_t idx, TQueue& trial)
+	{
+		using namespace levelset;
+		const float inf = std::numeric_limits<float>::max();
+		ForEachNeighbor(idx, [&](size_t q, int) {
+			if (_state[q] == kBand)
+				return;
+
+			float m[3] = {inf, inf, inf};
+			ForEachNeighbor(q, [&](size_t r, int axis) {
+				if (_state[r] == kBand)
+					m[axis] = std::min(m[axis], std::abs(_phi[r]));
+			});
+			const int dim = (_nrslices > 1) ? 3 : 2;
+			const float d = SolveEikonal(m, dim);
+
+			if (d < _band_width && (_state[q] == kFar || d < std::abs(_phi[q])))
+			{
+				_phi[q] = (_phi[q] > 0) ? d : -d;
+				_state[q] = kTrial;
+				trial.push(std::make_pair(d, q));
+			}
+		});
+	}
+
+	size_t _width = 0;
+	size_t _height = 0;
+	size_t _nrslices = 0;
+	size_t _area = 0;
+	float _band_width = 3.f;
+	float _balloon = 0.f;
+	float _epsilon = 0.f;
+	float _step_size = 1.f;
+
+	std::vector<float> _phi;
+	std::vector<unsigned char> _state;
+	std::vector<size_t> _band;
+	std::vector<float> _update;
+	std::vector<const float*> _k;
+	std::vector<const float*> _P;
+};
+
+} // namespace iseg
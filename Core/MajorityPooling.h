@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+namespace iseg {
+
+/// Size of label field after pooling with an integer factor
+inline void MajorityPoolingSize(const int dims[3], int factor, int out_dims[3])
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		out_dims[k] = (dims[k] + factor - 1) / factor;
+	}
+}
+
+/** \brief Downsample a label field (x fastest) by an integer factor
+
+	Each output voxel gets the most frequent label of its factor^3 input block.
+	On ties a foreground label wins over background (0), so that thin structures
+	survive as long as possible.
+*/
+template<typename T>
+void MajorityPooling(const T* in, const int dims[3], int factor, T* out)
+{
+	int out_dims[3];
+	MajorityPoolingSize(dims, factor, out_dims);
+
+	const long long slice_size = static_cast<long long>(dims[0]) * dims[1];
+	const long long out_slice_size = static_cast<long long>(out_dims[0]) * out_dims[1];
+
+#pragma omp parallel
+	{
+		std::vector<T> block;
+		block.reserve(static_cast<size_t>(factor) * factor * factor);
+
+#pragma omp for
+		for (int k = 0; k < out_dims[2]; ++k)
+		{
+			const int z0 = k * factor, z1 = std::min(z0 + factor, dims[2]);
+			for (int j = 0; j < out_dims[1]; ++j)
+			{
+				const int y0 = j * factor, y1 = std::min(y0 + factor, dims[1]);
+				for (int i = 0; i < out_dims[0]; ++i)
+				{
+					const int x0 = i * factor, x1 = std::min(x0 + factor, dims[0]);
+
+					block.clear();
+					for (int z = z0; z < z1; ++z)
+					{
+						for (int y = y0; y < y1; ++y)
+						{
+							const T* line = in + z * slice_size + static_cast<long long>(y) * dims[0];
+							block.insert(block.end(), line + x0, line + x1);
+						}
+					}
+					std::sort(block.begin(), block.end());
+
+					// longest run in sorted block, background only wins if strictly larger
+					T best = block.front();
+					size_t best_count = 0;
+					for (size_t start = 0; start < block.size();)
+					{
+						size_t end = start + 1;
+						while (end < block.size() && block[end] == block[start])
+							++end;
+						const size_t count = end - start;
+						if (count > best_count || (count == best_count && best == T(0)))
+						{
+							best = block[start];
+							best_count = count;
+						}
+						start = end;
+					}
+
+					out[k * out_slice_size + static_cast<long long>(j) * out_dims[0] + i] = best;
+				}
+			}
+		}
+	}
+}
+
+} // namespace iseg
@@ -578,8 +578,7 @@ int OutlineSlices::print(const char* filename, tissues_size_t nr_tissues)
 
 	for (unsigned i = 0; i < nr_slices; i++)
 	{
-		fprintf(fp, "S%u\n", i);
-		slices[i].print(fp, nr_tissues);
+		printslice(fp, i, slices[i], nr_tissues);
 	}
 
 	fclose(fp);
@@ -611,13 +610,19 @@ FILE* OutlineSlices::printsection(FILE* fp, unsigned startslice,
 {
 	for (unsigned i = startslice; i <= endslice; i++)
 	{
-		fprintf(fp, "S%u\n", i + offset);
-		slices[i].print(fp, nr_tissues);
+		printslice(fp, i + offset, slices[i], nr_tissues);
 	}
 
 	return fp;
 }
 
+FILE* OutlineSlices::printslice(FILE* fp, unsigned slicenr,
+		OutlineSlice& slice, tissues_size_t nr_tissues)
+{
+	fprintf(fp, "S%u\n", slicenr);
+	return slice.print(fp, nr_tissues);
+}
+
 int OutlineSlices::read(const char* filename)
 {
 	FILE* fp;
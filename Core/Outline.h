@@ -116,6 +116,9 @@ public:
 			tissues_size_t nr_tissues);
 	FILE* printsection(FILE* fp, unsigned startslice, unsigned endslice,
 			unsigned offset, tissues_size_t nr_tissues);
+	/// writes a slice which is not part of the outlines, e.g. when writing slice by slice after printprologue
+	static FILE* printslice(FILE* fp, unsigned slicenr, OutlineSlice& slice,
+			tissues_size_t nr_tissues);
 	int read(const char* filename);
 	void set_thickness(float thick, unsigned slicenr);
 	void set_thickness(float thick);
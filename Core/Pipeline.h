@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace iseg {
+
+/** \brief First-in first-out queue with a fixed capacity, shared by a producer and a consumer thread
+
+	Push blocks while the queue is full, Pop blocks while it is empty. After Close, Push refuses new
+	items and Pop returns the remaining ones before it fails.
+*/
+template<typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : _capacity(capacity > 0 ? capacity : 1), _closed(false) {}
+
+	/// Returns false if the queue was closed, i.e. the item was not queued
+	bool Push(T item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_not_full.wait(lock, [this]() { return _closed || _items.size() < _capacity; });
+		if (_closed)
+			return false;
+		_items.push_back(std::move(item));
+		_not_empty.notify_one();
+		return true;
+	}
+
+	/// Returns false if the queue is closed and empty
+	bool Pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_not_empty.wait(lock, [this]() { return _closed || !_items.empty(); });
+		if (_items.empty())
+			return false;
+		item = std::move(_items.front());
+		_items.pop_front();
+		_not_full.notify_one();
+		return true;
+	}
+
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+		_not_full.notify_all();
+		_not_empty.notify_all();
+	}
+
+private:
+	size_t _capacity;
+	bool _closed;
+	std::deque<T> _items;
+	std::mutex _mutex;
+	std::condition_variable _not_full;
+	std::condition_variable _not_empty;
+};
+
+/** \brief Runs produce(queue) on a separate thread and consume(item) on the calling thread for each queued item
+
+	The producer stops when Push returns false. At most capacity items wait in the queue, i.e. a fast
+	producer cannot run ahead of a slow consumer (e.g. writing to a file) by more than that. Exceptions
+	of either side stop both and are rethrown on the calling thread.
+*/
+template<typename T, typename TProduce, typename TConsume>
+void RunPipeline(size_t capacity, const TProduce& produce, const TConsume& consume)
+{
+	BoundedQueue<T> queue(capacity);
+	std::exception_ptr error;
+	std::thread producer([&]() {
+		try
+		{
+			produce(queue);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		queue.Close();
+	});
+
+	try
+	{
+		T item;
+		while (queue.Pop(item))
+		{
+			consume(item);
+		}
+	}
+	catch (...)
+	{
+		queue.Close();
+		producer.join();
+		throw;
+	}
+
+	producer.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+} // namespace iseg
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "DistanceTransform.h"
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace iseg {
+
+/** \brief Shape-based interpolation of labels between two key slices (Raya & Udupa)
+
+	For each label, the signed distance to its boundary (the pixels of the label with a 4-neighbor outside
+	the label or the image) is computed in both key slices, positive inside. A voxel of an intermediate slice
+	gets the label with the largest linearly interpolated distance, if it is not negative.
+
+	The distance maps of all labels of a key slice are computed together, with the lines of all labels
+	processed in parallel. The maps of the last two key slices are kept, so interpolating a sequence of gaps
+	computes the maps of each key slice once. They are identified by the key slice pointer, call Reset if
+	the contents of a key slice changed.
+*/
+template<typename T>
+class ShapeInterpolation
+{
+public:
+	ShapeInterpolation(size_t width, size_t height, const std::vector<T>& labels)
+			: _width(width), _height(height), _labels(labels)
+	{
+		Reset();
+	}
+
+	void Reset() { _keys[0] = _keys[1] = nullptr; }
+
+	/** \brief Interpolates nrslices equidistant slices between lower and upper
+
+		Calls write(j, i, k) for each voxel i of the intermediate slice j (0 is next to lower), where k is the
+		index of the label or -1 if the voxel is outside all labels. Voxels are written in parallel.
+	*/
+	template<typename TWrite>
+	void Interpolate(const T* lower, const T* upper, size_t nrslices, const TWrite& write)
+	{
+		const float* maps1 = Maps(lower, upper);
+		const float* maps2 = Maps(upper, lower);
+		const size_t area = _width * _height;
+		const int nrlabels = static_cast<int>(_labels.size());
+
+		const int nrrows = static_cast<int>(nrslices * _height);
+#pragma omp parallel for
+		for (int r = 0; r < nrrows; ++r)
+		{
+			const size_t j = r / _height, y = r % _height;
+			const float t = static_cast<float>(j + 1) / (nrslices + 1);
+			for (size_t i = y * _width; i < (y + 1) * _width; ++i)
+			{
+				int best = -1;
+				float best_dist = 0.f;
+				for (int k = 0; k < nrlabels; ++k)
+				{
+					const float d = (1.f - t) * maps1[k * area + i] + t * maps2[k * area + i];
+					if (d >= 0.f && (best < 0 || d > best_dist))
+					{
+						best = k;
+						best_dist = d;
+					}
+				}
+				write(j, i, best);
+			}
+		}
+	}
+
+private:
+	/// Distance maps of key, computed unless cached, the maps of keep remain cached
+	const float* Maps(const T* key, const T* keep)
+	{
+		for (int s = 0; s < 2; ++s)
+		{
+			if (_keys[s] == key)
+				return _maps[s].data();
+		}
+		const int s = (_keys[0] == keep) ? 1 : 0;
+		Compute(key, _maps[s]);
+		_keys[s] = key;
+		return _maps[s].data();
+	}
+
+	void Compute(const T* key, std::vector<float>& maps) const
+	{
+		const size_t area = _width * _height;
+		const int w = static_cast<int>(_width), h = static_cast<int>(_height);
+		const int nrlabels = static_cast<int>(_labels.size());
+		maps.resize(nrlabels * area);
+
+		const int nrrows = nrlabels * h;
+#pragma omp parallel for
+		for (int r = 0; r < nrrows; ++r)
+		{
+			const int k = r / h, y = r % h;
+			const T label = _labels[k];
+			const T* row = key + y * _width;
+			float* dist = &maps[k * area + y * _width];
+			for (int x = 0; x < w; ++x)
+			{
+				const bool boundary = row[x] == label &&
+															(x == 0 || x + 1 == w || y == 0 || y + 1 == h || row[x - 1] != label ||
+																	row[x + 1] != label || row[x - w] != label || row[x + w] != label);
+				dist[x] = boundary ? 0.f : edt::Infinity();
+			}
+		}
+
+		std::vector<float*> slices(nrlabels);
+		for (int k = 0; k < nrlabels; ++k)
+			slices[k] = &maps[k * area];
+		const double spacing[3] = {1.0, 1.0, 1.0};
+		SquaredDistanceTransform(slices.data(), _width, _height, nrlabels, spacing, true);
+
+		// labels without boundary are far away, i.e. they vanish towards the other key slice
+		const float far_away = static_cast<float>(_width + _height);
+#pragma omp parallel for
+		for (int r = 0; r < nrrows; ++r)
+		{
+			const int k = r / h, y = r % h;
+			const T* row = key + y * _width;
+			float* dist = &maps[k * area + y * _width];
+			for (int x = 0; x < w; ++x)
+			{
+				const float d = (dist[x] == edt::Infinity()) ? far_away : std::sqrt(dist[x]);
+				dist[x] = (row[x] == _labels[k]) ? d : -d;
+			}
+		}
+	}
+
+	size_t _width, _height;
+	std::vector<T> _labels;
+	const T* _keys[2];
+	std::vector<float> _maps[2];
+};
+
+/** \brief Interpolation of arbitrary values between two key slices, by the distance to the nearest change of value
+
+	A voxel of the intermediate slice j takes the value of lower if j + 1 <= (nrslices + 1) d1 / (d1 + d2),
+	where d1, d2 are the distances to the closest voxels with a different 4-neighbor in the key slices.
+	Calls write(j, i, from_upper) for each voxel i of the intermediate slice j, in parallel.
+*/
+template<typename T, typename TWrite>
+void NearestValueInterpolation(const T* lower, const T* upper, size_t width, size_t height, size_t nrslices,
+		const TWrite& write)
+{
+	const size_t area = width * height;
+	std::vector<float> dist(2 * area, edt::Infinity());
+	const T* keys[2] = {lower, upper};
+	for (int s = 0; s < 2; ++s)
+	{
+		const T* key = keys[s];
+		float* d = &dist[s * area];
+		for (size_t i = 0; i + width < area; ++i)
+		{
+			if (key[i] != key[i + width])
+				d[i] = d[i + width] = 0.f;
+		}
+		for (size_t i = 0; i + 1 < area; ++i)
+		{
+			if ((i + 1) % width != 0 && key[i] != key[i + 1])
+				d[i] = d[i + 1] = 0.f;
+		}
+	}
+
+	float* slices[2] = {&dist[0], &dist[area]};
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	SquaredDistanceTransform(slices, width, height, 2, spacing, true);
+
+	const float far_away = static_cast<float>((width + height) * (width + height));
+	const int n = static_cast<int>(area);
+#pragma omp parallel for
+	for (int i = 0; i < n; ++i)
+	{
+		const float d1 = (dist[i] == edt::Infinity()) ? far_away : std::sqrt(dist[i]);
+		const float d2 = (dist[area + i] == edt::Infinity()) ? far_away : std::sqrt(dist[area + i]);
+		const float prop = (d1 + d2 != 0) ? d1 / (d1 + d2) : 0.5f;
+		const size_t n1 = static_cast<size_t>((nrslices + 1) * prop);
+		for (size_t j = 0; j < nrslices; ++j)
+		{
+			write(j, static_cast<size_t>(i), j + 1 > n1);
+		}
+	}
+}
+
+} // namespace iseg
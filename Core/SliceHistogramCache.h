@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace iseg {
+
+/// Bins of equal width covering [low, high)
+struct HistogramBinning
+{
+	HistogramBinning(size_t nrbins = 256, float low = 0.f, float high = 256.f)
+			: nrbins(nrbins), low(low), high(high), scale(nrbins / (high - low))
+	{
+	}
+
+	/// bin of v, -1 below the range (or NaN) and nrbins above
+	int bin(float v) const
+	{
+		if (!(v >= low))
+			return -1;
+		if (v >= high)
+			return static_cast<int>(nrbins);
+		const int b = static_cast<int>((v - low) * scale);
+		return b < static_cast<int>(nrbins) ? b : static_cast<int>(nrbins) - 1;
+	}
+
+	size_t nrbins;
+	float low;
+	float high;
+	float scale;
+};
+
+/// Counts per bin and of the values outside the binned range
+struct Histogram
+{
+	explicit Histogram(size_t nrbins = 0) : counts(nrbins, 0), below(0), above(0) {}
+
+	void add(const Histogram& other)
+	{
+		assert(other.counts.size() == counts.size());
+		for (size_t i = 0; i < counts.size(); ++i)
+			counts[i] += other.counts[i];
+		below += other.below;
+		above += other.above;
+	}
+
+	/// histogram with groups of factor neighboring bins merged, the number of bins must be a multiple of factor
+	Histogram coarsened(size_t factor) const
+	{
+		assert(factor > 0 && counts.size() % factor == 0);
+		Histogram h(counts.size() / factor);
+		for (size_t i = 0; i < counts.size(); ++i)
+			h.counts[i / factor] += counts[i];
+		h.below = below;
+		h.above = above;
+		return h;
+	}
+
+	std::vector<size_t> counts;
+	size_t below;
+	size_t above;
+};
+
+/// Adds the values of the rectangle [x0, x1) x [y0, y1) of an image with the given width to h
+template<typename T>
+void AccumulateHistogram(const T* values, size_t width, size_t x0, size_t y0, size_t x1, size_t y1,
+		const HistogramBinning& binning, Histogram& h)
+{
+	const int nrbins = static_cast<int>(binning.nrbins);
+	for (size_t y = y0; y < y1; ++y)
+	{
+		const T* row = values + y * width;
+		for (size_t x = x0; x < x1; ++x)
+		{
+			const int b = binning.bin(static_cast<float>(row[x]));
+			if (b < 0)
+				h.below++;
+			else if (b == nrbins)
+				h.above++;
+			else
+				h.counts[b]++;
+		}
+	}
+}
+
+/// Adds values[i] for all i < n with mask(i) true to h
+template<typename T, typename TMask>
+void AccumulateHistogram(const T* values, size_t n, const TMask& mask, const HistogramBinning& binning,
+		Histogram& h)
+{
+	const int nrbins = static_cast<int>(binning.nrbins);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (mask(i))
+		{
+			const int b = binning.bin(static_cast<float>(values[i]));
+			if (b < 0)
+				h.below++;
+			else if (b == nrbins)
+				h.above++;
+			else
+				h.counts[b]++;
+		}
+	}
+}
+
+/** \brief Per-slice histograms of a stack of images
+
+	Like SliceRangeCache, entries are marked stale when a slice is modified and only recomputed on demand,
+	i.e. after an edit only the modified slices are scanned again. The histogram of a range of slices is
+	then a sum over the cached ones, O(#slices * #bins) instead of O(#voxels). The bins are fine (4096 over
+	[0, 256) by default) and can be coarsened for display or thresholding, e.g. to the 256 bins of bmphandler.
+*/
+class SliceHistogramCache
+{
+public:
+	explicit SliceHistogramCache(const HistogramBinning& binning = HistogramBinning(4096, 0.f, 256.f))
+			: _binning(binning)
+	{
+	}
+
+	const HistogramBinning& binning() const { return _binning; }
+
+	/// change the bins, all entries are marked stale
+	void set_binning(const HistogramBinning& binning)
+	{
+		_binning = binning;
+		_counts.clear();
+		invalidate_all();
+	}
+
+	/// resize cache, all entries are marked stale
+	void resize(size_t nrslices)
+	{
+		_valid.assign(nrslices, 0);
+		_counts.clear();
+		_outside.clear();
+	}
+
+	size_t size() const { return _valid.size(); }
+
+	void invalidate(size_t slice)
+	{
+		if (slice < _valid.size())
+			_valid[slice] = 0;
+	}
+
+	void invalidate_all() { _valid.assign(_valid.size(), 0); }
+
+	bool is_valid(size_t slice) const { return _valid[slice] != 0; }
+
+	/// recomputes the stale entries of the slices [first, last) in parallel, values(slice) points to the area values of a slice
+	template<typename TValues>
+	void update(size_t first, size_t last, size_t area, const TValues& values)
+	{
+		const size_t nrbins = _binning.nrbins;
+		if (_counts.size() != _valid.size() * nrbins)
+		{
+			_counts.assign(_valid.size() * nrbins, 0);
+			_outside.assign(2 * _valid.size(), 0);
+		}
+
+		const int iN = static_cast<int>(last);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = static_cast<int>(first); i < iN; ++i)
+		{
+			if (!_valid[i])
+			{
+				Histogram h(nrbins);
+				AccumulateHistogram(values(i), area, 0, 0, area, 1, _binning, h);
+				for (size_t b = 0; b < nrbins; ++b)
+					_counts[i * nrbins + b] = static_cast<unsigned>(h.counts[b]);
+				_outside[2 * i] = static_cast<unsigned>(h.below);
+				_outside[2 * i + 1] = static_cast<unsigned>(h.above);
+				_valid[i] = 1;
+			}
+		}
+	}
+
+	/// sum of the histograms of the slices [first, last), which must be up to date
+	Histogram total(size_t first, size_t last) const
+	{
+		const size_t nrbins = _binning.nrbins;
+		Histogram h(nrbins);
+		for (size_t i = first; i < last; ++i)
+		{
+			assert(is_valid(i));
+			const unsigned* counts = &_counts[i * nrbins];
+			for (size_t b = 0; b < nrbins; ++b)
+				h.counts[b] += counts[b];
+			h.below += _outside[2 * i];
+			h.above += _outside[2 * i + 1];
+		}
+		return h;
+	}
+
+private:
+	HistogramBinning _binning;
+	// per slice counts, allocated once for all slices, i.e. updating different slices is thread safe
+	std::vector<unsigned> _counts;
+	std::vector<unsigned> _outside;
+	// not std::vector<bool>, entries are written from several threads
+	std::vector<unsigned char> _valid;
+};
+
+} // namespace iseg
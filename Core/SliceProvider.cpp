@@ -11,64 +11,50 @@
 
 #include "SliceProvider.h"
 
+#include "BufferPool.h"
+
 #include <cstdlib>
 
 namespace iseg {
 
 SliceProvider::SliceProvider(unsigned area1) { area = area1; }
 
-SliceProvider::~SliceProvider()
-{
-	while (!slicestack.empty())
-	{
-		free(slicestack.top());
-		slicestack.pop();
-	}
-}
+SliceProvider::~SliceProvider() {}
 
 float* SliceProvider::give_me()
 {
-	if (slicestack.empty())
-	{
-		return (float*)malloc(sizeof(float) * area);
-	}
-	else
-	{
-		float* result = slicestack.top();
-		slicestack.pop();
-		return result;
-	}
+	return static_cast<float*>(BufferPool::Instance().Acquire(sizeof(float) * area));
 }
 
 void SliceProvider::take_back(float* slice)
 {
-	if (slice != nullptr)
-		slicestack.push(slice);
+	BufferPool::Instance().Release(slice);
 }
 
-void SliceProvider::merge(SliceProvider* sp)
-{
-	if (area == sp->return_area())
-	{
-		while (!slicestack.empty())
-			sp->take_back(give_me());
-	}
-}
+void SliceProvider::merge(SliceProvider* /* sp */) {}
 
 unsigned SliceProvider::return_area() { return area; }
 
 unsigned short SliceProvider::return_nrslices()
 {
-	return (unsigned short)slicestack.size();
+	for (const auto& s : BufferPool::Instance().Report())
+	{
+		if (s.bytes >= sizeof(float) * area && s.bytes < sizeof(float) * area + BufferPool::kAlignment)
+			return (unsigned short)s.in_use;
+	}
+	return 0;
 }
 
 SliceProviderInstaller* SliceProviderInstaller::inst = nullptr;
 
 unsigned short SliceProviderInstaller::counter = 0;
 
+std::mutex SliceProviderInstaller::mutex;
+
 SliceProviderInstaller* SliceProviderInstaller::getinst()
 {
 	static Waechter w;
+	std::lock_guard<std::mutex> lock(mutex);
 	if (inst == nullptr)
 		inst = new SliceProviderInstaller;
 
@@ -78,15 +64,19 @@ SliceProviderInstaller* SliceProviderInstaller::getinst()
 
 void SliceProviderInstaller::return_instance()
 {
-	//	if(--counter==0) ~sliceprovider_installer();
-	//	if(--counter==0) delete this;
+	std::lock_guard<std::mutex> lock(mutex);
 	--counter;
 }
 
-bool SliceProviderInstaller::unused() { return counter == 0; }
+bool SliceProviderInstaller::unused()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counter == 0;
+}
 
 SliceProvider* SliceProviderInstaller::install(unsigned area1)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	auto it = splist.begin();
 
 	while (it != splist.end() && (it->area != area1))
@@ -110,6 +100,7 @@ SliceProvider* SliceProviderInstaller::install(unsigned area1)
 
 void SliceProviderInstaller::uninstall(SliceProvider* sp)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	auto it = splist.begin();
 	while (it != splist.end() && (it->area != sp->return_area()))
 		it++;
@@ -118,6 +109,8 @@ void SliceProviderInstaller::uninstall(SliceProvider* sp)
 	{
 		if (--(it->installnr) == 0 && delete_unused)
 		{
+			// the cached slices of this size are no longer needed
+			BufferPool::Instance().Trim(sizeof(float) * it->area);
 			delete (it->spp);
 			splist.erase(it);
 			return;
@@ -129,7 +122,7 @@ SliceProviderInstaller::~SliceProviderInstaller()
 {
 	for (auto it = splist.begin(); it != splist.end(); it++)
 	{
-		free(it->spp);
+		delete it->spp;
 	}
 
 	inst = nullptr;
@@ -138,16 +131,11 @@ SliceProviderInstaller::~SliceProviderInstaller()
 void SliceProviderInstaller::report() const
 {
 	std::map<int, int> area_counts;
-	std::map<int, int> area_counts_empty;
-	for (auto sp : splist)
 	{
-		if (sp.installnr)
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto sp : splist)
 		{
-			area_counts[sp.area]++;
-		}
-		else if (sp.spp)
-		{
-			area_counts_empty[sp.area] += sp.spp->return_nrslices();
+			area_counts[sp.area] += sp.installnr;
 		}
 	}
 
@@ -157,10 +145,10 @@ void SliceProviderInstaller::report() const
 	{
 		std::cerr << "area=" << v.first << " -> " << v.second << "\n";
 	}
-	std::cerr << "Debug: dead sliceproviders\n";
-	for (auto v : area_counts_empty)
+	std::cerr << "Debug: scratch buffers (in use / high-water mark / allocated)\n";
+	for (const auto& s : BufferPool::Instance().Report())
 	{
-		std::cerr << "area=" << v.first << " -> " << v.second << "\n";
+		std::cerr << "bytes=" << s.bytes << " -> " << s.in_use << " / " << s.high_water << " / " << s.allocated << "\n";
 	}
 	std::cerr << "Debug:-------------------\n";
 }
@@ -13,24 +13,26 @@
 
 #include <cstdlib>
 #include <list>
-#include <stack>
+#include <mutex>
 
 namespace iseg {
 
+/// Slices of area floats from the BufferPool, can be used from several threads
 class ISEG_CORE_API SliceProvider
 {
 public:
 	SliceProvider(unsigned area1);
 	~SliceProvider();
 	unsigned return_area();
+	/// number of slices handed out
 	unsigned short return_nrslices();
 	float* give_me();
+	/// the slices are shared by all providers in the pool, nothing to merge
 	void merge(SliceProvider* sp);
 	void take_back(float* slice);
 
 private:
 	unsigned area;
-	std::stack<float*> slicestack;
 };
 
 struct spobj
@@ -50,11 +52,13 @@ public:
 	bool unused();
 	~SliceProviderInstaller();
 
+	/// prints the providers and the buffers in use, cached and at most in use (high-water mark) per size
 	void report() const;
 
 private:
 	static SliceProviderInstaller* inst;
 	static unsigned short counter;
+	static std::mutex mutex;
 	std::list<spobj> splist;
 	bool delete_unused = true;
 	SliceProviderInstaller(){};
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "Pair.h"
+
+#include <cfloat>
+#include <cstddef>
+#include <vector>
+
+namespace iseg {
+
+/** \brief Per-slice cache of the value range (min/max) of a stack of images
+
+	Entries are marked stale when a slice is modified and are only recomputed
+	on demand. The range of the whole stack is then a reduction over the
+	cached per-slice values, i.e. O(#slices) instead of O(#voxels).
+*/
+class SliceRangeCache
+{
+public:
+	/// resize cache, all entries are marked stale
+	void resize(size_t nrslices)
+	{
+		_ranges.assign(nrslices, Pair{FLT_MAX, 0.f});
+		_valid.assign(nrslices, 0);
+	}
+
+	size_t size() const { return _ranges.size(); }
+
+	void invalidate(size_t slice)
+	{
+		if (slice < _valid.size())
+			_valid[slice] = 0;
+	}
+
+	void invalidate_all() { _valid.assign(_valid.size(), 0); }
+
+	bool is_valid(size_t slice) const { return _valid[slice] != 0; }
+
+	/// store range of slice, safe to call concurrently for different slices
+	void set(size_t slice, const Pair& p)
+	{
+		_ranges[slice] = p;
+		_valid[slice] = 1;
+	}
+
+	const Pair& operator[](size_t slice) const { return _ranges[slice]; }
+
+	/// combined range of all valid slices for which include(slice) is true
+	template<typename Predicate>
+	bool total(Predicate include, Pair& p) const
+	{
+		p.low = FLT_MAX;
+		p.high = 0.f;
+		bool found = false;
+		for (size_t i = 0; i < _ranges.size(); ++i)
+		{
+			if (_valid[i] && include(i))
+			{
+				found = true;
+				if (p.high < _ranges[i].high)
+					p.high = _ranges[i].high;
+				if (p.low > _ranges[i].low)
+					p.low = _ranges[i].low;
+			}
+		}
+		return found;
+	}
+
+private:
+	std::vector<Pair> _ranges;
+	// not std::vector<bool>, entries are written from several threads
+	std::vector<unsigned char> _valid;
+};
+
+} // namespace iseg
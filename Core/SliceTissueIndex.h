@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace iseg {
+
+/** \brief Per-slice index of the labels occurring in a stack of label images
+
+	For each slice the labels present are stored with their pixel count and bounding box, sorted by label,
+	i.e. the index is sparse in the number of labels. Like SliceRangeCache, entries are marked stale when a
+	slice is modified and only recomputed on demand. Questions like "which labels are used", "where is
+	label x" or "how many voxels are labeled x" are then answered in O(#slices) instead of O(#voxels).
+*/
+template<typename T>
+class SliceTissueIndex
+{
+public:
+	struct Entry
+	{
+		T label;
+		size_t count;
+		/// bounding box [x|y][min|max], both inclusive
+		unsigned short extent[2][2];
+	};
+
+	/// resize index, all entries are marked stale
+	void resize(size_t nrslices)
+	{
+		_entries.assign(nrslices, std::vector<Entry>());
+		_valid.assign(nrslices, 0);
+	}
+
+	size_t size() const { return _valid.size(); }
+
+	void invalidate(size_t slice)
+	{
+		if (slice < _valid.size())
+			_valid[slice] = 0;
+	}
+
+	void invalidate_all() { _valid.assign(_valid.size(), 0); }
+
+	bool is_valid(size_t slice) const { return _valid[slice] != 0; }
+
+	/// recomputes the stale entries of the slices [first, last) in parallel, labels(slice) points to the labels of a slice
+	template<typename TLabels>
+	void update(size_t first, size_t last, unsigned short width, unsigned short height, const TLabels& labels)
+	{
+		bool stale = false;
+		for (size_t i = first; i < last && !stale; ++i)
+			stale = !_valid[i];
+		if (!stale)
+			return;
+
+		const int iN = static_cast<int>(last);
+#pragma omp parallel
+		{
+			// position of a label in the entries of the current slice, -1 if not present yet
+			std::vector<int> slot(static_cast<size_t>(std::numeric_limits<T>::max()) + 1, -1);
+
+#pragma omp for schedule(dynamic, 1)
+			for (int i = static_cast<int>(first); i < iN; ++i)
+			{
+				if (!_valid[i])
+				{
+					_entries[i] = scan(labels(i), width, height, slot);
+					_valid[i] = 1;
+				}
+			}
+		}
+	}
+
+	/// labels occurring in slice, sorted
+	const std::vector<Entry>& operator[](size_t slice) const { return _entries[slice]; }
+
+	/// entry of label in slice or nullptr if the label does not occur in the slice
+	const Entry* find(size_t slice, T label) const
+	{
+		const std::vector<Entry>& entries = _entries[slice];
+		auto it = std::lower_bound(entries.begin(), entries.end(), label,
+				[](const Entry& e, T l) { return e.label < l; });
+		return (it != entries.end() && it->label == label) ? &*it : nullptr;
+	}
+
+	/// number of pixels labeled label in the slices [first, last)
+	size_t count(size_t first, size_t last, T label) const
+	{
+		size_t n = 0;
+		for (size_t i = first; i < last; ++i)
+		{
+			if (const Entry* e = find(i, label))
+				n += e->count;
+		}
+		return n;
+	}
+
+	/// bounding box of label in the slices [first, last) as [x|y|slice][min|max], false if the label does not occur
+	bool extent(size_t first, size_t last, T label, unsigned short extent[3][2]) const
+	{
+		bool found = false;
+		for (size_t i = first; i < last; ++i)
+		{
+			const Entry* e = find(i, label);
+			if (!e)
+				continue;
+			if (!found)
+			{
+				for (int k = 0; k < 2; ++k)
+				{
+					extent[k][0] = e->extent[k][0];
+					extent[k][1] = e->extent[k][1];
+				}
+				extent[2][0] = static_cast<unsigned short>(i);
+				found = true;
+			}
+			else
+			{
+				for (int k = 0; k < 2; ++k)
+				{
+					extent[k][0] = std::min(extent[k][0], e->extent[k][0]);
+					extent[k][1] = std::max(extent[k][1], e->extent[k][1]);
+				}
+			}
+			extent[2][1] = static_cast<unsigned short>(i);
+		}
+		return found;
+	}
+
+	/// sets is_used[label] = 1 for the labels occurring in the slices [first, last), labels beyond the end of is_used are ignored
+	void mark_used(size_t first, size_t last, std::vector<unsigned char>& is_used) const
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			for (const auto& e : _entries[i])
+			{
+				if (e.label < is_used.size())
+					is_used[e.label] = 1;
+			}
+		}
+	}
+
+private:
+	static std::vector<Entry> scan(const T* labels, unsigned short width, unsigned short height, std::vector<int>& slot)
+	{
+		std::vector<Entry> entries;
+		for (unsigned short y = 0; y < height; ++y)
+		{
+			const T* row = labels + static_cast<size_t>(y) * width;
+			unsigned short x = 0;
+			while (x < width)
+			{
+				// run of equal labels [x0, x)
+				const T v = row[x];
+				const unsigned short x0 = x;
+				while (++x < width && row[x] == v)
+				{
+				}
+
+				int& s = slot[v];
+				if (s < 0)
+				{
+					s = static_cast<int>(entries.size());
+					Entry e = {v, 0, {{x0, x0}, {y, y}}};
+					entries.push_back(e);
+				}
+				Entry& e = entries[s];
+				e.count += x - x0;
+				e.extent[0][0] = std::min(e.extent[0][0], x0);
+				e.extent[0][1] = std::max(e.extent[0][1], static_cast<unsigned short>(x - 1));
+				e.extent[1][1] = y;
+			}
+		}
+
+		for (const auto& e : entries)
+			slot[e.label] = -1;
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.label < b.label; });
+		return entries;
+	}
+
+	std::vector<std::vector<Entry>> _entries;
+	// not std::vector<bool>, entries are written from several threads
+	std::vector<unsigned char> _valid;
+};
+
+} // namespace iseg
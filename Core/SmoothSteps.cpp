@@ -11,8 +11,7 @@
 
 #include "SmoothSteps.h"
 
-#include <cstdio>
-#include <cstdlib>
+#include <algorithm>
 
 using namespace iseg;
 
@@ -21,17 +20,13 @@ SmoothSteps::SmoothSteps()
 	mask = nullptr;
 	ownmask = false;
 	masklength = 0;
-	weights = nullptr;
+	linelength = 0;
+	nrtissues = 0;
 	return;
 }
 
 SmoothSteps::~SmoothSteps()
 {
-	for (tissues_size_t i = 0; i < nrtissues; i++)
-	{
-		delete[] weights[i];
-	}
-	delete[] weights;
 	if (ownmask)
 		delete[] mask;
 	return;
@@ -39,90 +34,39 @@ SmoothSteps::~SmoothSteps()
 
 void SmoothSteps::dostepsmooth(tissues_size_t* line)
 {
-	if (mask == nullptr || weights == nullptr)
+	if (mask == nullptr || votes.empty())
 		return;
 	if (linelength < masklength || linelength < 2)
 		return;
 
-	/*int *counter=new int[linelength];
-	for(unsigned short i=0;i<linelength;i++) counter[i]=0;
-	float *counterfloat=new float[linelength];
-	for(unsigned short i=0;i<linelength;i++) counterfloat[i]=0;*/
+	input.assign(line, line + linelength);
 
-	unsigned short n1 = masklength / 2;
-	for (tissues_size_t c = 0; c < nrtissues; c++)
-	{
-		for (unsigned short i = 0; i < linelength; i++)
-			weights[c][i] = 0; //,counter[i]=0,counterfloat[i]=0;
-	}
-	unsigned short upper = linelength + 1 - masklength;
-	for (unsigned short i = 0; i < upper; i++)
-	{
-		tissues_size_t index = line[i + n1];
-		for (unsigned short j = 0; j < masklength; j++)
-		{
-			weights[index][i + j] +=
-				mask[j]; //,counter[i+j]++,counterfloat[i+j]+=mask[j];
-		}
-	}
-	for (unsigned short i = 0; i < n1; i++)
-	{
-		tissues_size_t index = line[i];
-		unsigned short k = 0;
-		for (unsigned short j = n1 - i; j < masklength; j++, k++)
-		{
-			weights[index][k] +=
-				mask[j]; //,counter[k]++,counterfloat[k]+=mask[j];
-		}
-	}
-	for (unsigned short i = linelength - masklength + n1 + 1; i < linelength;
-		 i++)
+	// weighted vote of the labels in the window, the line is extended by replicating the end values.
+	// Only the labels occurring in the window are visited and reset.
+	const int n1 = masklength / 2;
+	const int last = linelength - 1;
+	for (int i = 0; i < linelength; i++)
 	{
-		tissues_size_t index = line[i];
-		unsigned short k = i - n1;
-		for (unsigned short j = 0; k < linelength; j++, k++)
+		for (int j = 0; j < masklength; j++)
 		{
-			weights[index][k] +=
-				mask[j]; //,counter[k]++,counterfloat[k]+=mask[j];
+			tissues_size_t c = input[std::min(std::max(i + n1 - j, 0), last)];
+			if (votes[c] == 0)
+				touched.push_back(c);
+			votes[c] += mask[j];
 		}
-	}
-	tissues_size_t index = line[0];
-	upper = masklength - n1 - 1;
-	for (unsigned short i = 0; i < upper; i++)
-	{
-		for (unsigned short j = i + n1 + 1; j < masklength; j++)
-		{
-			weights[index][i] +=
-				mask[j]; //,counter[i]++,counterfloat[i]+=mask[j];
-		}
-	}
-	index = line[linelength - 1];
-	for (unsigned short i = linelength - n1, upper = 1; i < linelength;
-		 i++, upper++)
-	{
-		for (unsigned short j = 0; j < upper; j++)
-		{
-			weights[index][i] +=
-				mask[j]; //,counter[i]++,counterfloat[i]+=mask[j];
-		}
-	}
-	for (unsigned short i = 0; i < linelength; i++)
-	{
-		float valmax = 0;
-		for (tissues_size_t c = 0; c < nrtissues; c++)
+
+		// largest weight, the smallest label wins a tie
+		tissues_size_t best = touched.front();
+		for (auto c : touched)
 		{
-			if (weights[c][i] > valmax)
-			{
-				line[i] = c;
-				valmax = weights[c][i];
-			}
+			if (votes[c] > votes[best] || (votes[c] == votes[best] && c < best))
+				best = c;
 		}
+		for (auto c : touched)
+			votes[c] = 0;
+		touched.clear();
+		line[i] = best;
 	}
-	//FILE *fp3=fopen("C:\\test.txt","w");
-	//for(unsigned short i=0;i<linelength;i++) fprintf(fp3,"%i %f \n",counter[i],counterfloat[i]);
-	//fclose(fp3);
-	//delete[] counter;
-	//delete[] counterfloat;
 }
 
 void SmoothSteps::init(float* mask1, unsigned short masklength1,
@@ -134,20 +78,8 @@ void SmoothSteps::init(float* mask1, unsigned short masklength1,
 	mask = mask1;
 	masklength = masklength1;
 	linelength = linelength1;
-	if (weights != nullptr)
-	{
-		for (tissues_size_t i = 0; i < nrtissues; i++)
-		{
-			delete[] weights[i];
-		}
-		delete[] weights;
-	}
 	nrtissues = nrtissues1;
-	weights = new float*[nrtissues];
-	for (tissues_size_t i = 0; i < nrtissues; i++)
-	{
-		weights[i] = new float[linelength];
-	}
+	votes.assign(nrtissues, 0.f);
 }
 
 void SmoothSteps::init(unsigned short masklength1, unsigned short linelength1,
@@ -160,20 +92,8 @@ void SmoothSteps::init(unsigned short masklength1, unsigned short linelength1,
 	generate_binommask();
 	ownmask = true;
 	linelength = linelength1;
-	if (weights != nullptr)
-	{
-		for (tissues_size_t i = 0; i < nrtissues; i++)
-		{
-			delete[] weights[i];
-		}
-		delete[] weights;
-	}
 	nrtissues = nrtissues1;
-	weights = new float*[nrtissues];
-	for (tissues_size_t i = 0; i < nrtissues; i++)
-	{
-		weights[i] = new float[linelength];
-	}
+	votes.assign(nrtissues, 0.f);
 }
 
 void SmoothSteps::generate_binommask()
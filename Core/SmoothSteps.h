@@ -13,6 +13,8 @@
 
 #include "Data/Types.h"
 
+#include <vector>
+
 namespace iseg {
 
 class ISEG_CORE_API SmoothSteps
@@ -31,7 +33,9 @@ private:
 	unsigned short masklength;
 	unsigned short linelength;
 	tissues_size_t nrtissues;
-	float** weights;
+	std::vector<float> votes;
+	std::vector<tissues_size_t> touched;
+	std::vector<tissues_size_t> input;
 	void generate_binommask();
 	bool ownmask;
 };
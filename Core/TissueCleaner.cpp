@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ * 
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ * 
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include "Precompiled.h"
+
+#include "TissueCleaner.h"
+
+#include "ConnectedComponents.h"
+
+#include <algorithm>
+
+using namespace iseg;
+
+namespace {
+
+// sum of i and i^2 for i = 0 ... n, modulo 2^64
+uint64_t sum_to(uint64_t n)
+{
+	uint64_t a = n, b = n + 1;
+	if (a % 2 == 0)
+		a /= 2;
+	else
+		b /= 2;
+	return a * b;
+}
+
+uint64_t sum2_to(uint64_t n)
+{
+	uint64_t a = n, b = n + 1, c = 2 * n + 1;
+	if (a % 2 == 0)
+		a /= 2;
+	else
+		b /= 2;
+	if (a % 3 == 0)
+		a /= 3;
+	else if (b % 3 == 0)
+		b /= 3;
+	else
+		c /= 3;
+	return a * b * c;
+}
+
+} // namespace
+
+TissueCleaner::TissueCleaner(tissues_size_t** slices1, unsigned short n1,
+		unsigned short width1, unsigned short height1)
+{
+	slices = slices1;
+	nrslices = static_cast<size_t>(n1);
+	width = static_cast<size_t>(width1);
+	height = static_cast<size_t>(height1);
+	num_tissues = 0;
+}
+
+void TissueCleaner::SetPreviousFingerprints(const std::vector<TissueFingerprint>& previous)
+{
+	previous_fingerprints = previous;
+}
+
+void TissueCleaner::SetLockedTissues(const std::vector<char>& locked)
+{
+	locked_tissues = locked;
+}
+
+void TissueCleaner::ConnectedComponents()
+{
+	const int n = static_cast<int>(nrslices);
+	runs.assign(nrslices, std::vector<Run>());
+	row_start.assign(nrslices, std::vector<unsigned>(height + 1, 0));
+
+	// run-length encoding
+	std::vector<tissues_size_t> max_tissue(nrslices, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int z = 0; z < n; z++)
+	{
+		const tissues_size_t* tissues = slices[z];
+		for (size_t y = 0; y < height; y++)
+		{
+			row_start[z][y] = static_cast<unsigned>(runs[z].size());
+			const tissues_size_t* row = tissues + y * width;
+			size_t x = 0;
+			while (x < width)
+			{
+				Run r;
+				r.x0 = static_cast<unsigned short>(x);
+				r.tissue = row[x];
+				while (x + 1 < width && row[x + 1] == r.tissue)
+					x++;
+				r.x1 = static_cast<unsigned short>(x++);
+				runs[z].push_back(r);
+				max_tissue[z] = std::max(max_tissue[z], r.tissue);
+			}
+		}
+		row_start[z][height] = static_cast<unsigned>(runs[z].size());
+	}
+	num_tissues = max_tissue.empty() ? 1 : static_cast<size_t>(*std::max_element(max_tissue.begin(), max_tissue.end())) + 1;
+
+	slice_start.assign(nrslices + 1, 0);
+	for (size_t z = 0; z < nrslices; z++)
+		slice_start[z + 1] = slice_start[z] + runs[z].size();
+
+	// only tissues which changed since the previous run are cleaned
+	selected.assign(num_tissues, 1);
+	if (!previous_fingerprints.empty())
+	{
+		compute_fingerprints();
+		for (size_t t = 0; t < num_tissues; t++)
+		{
+			if (t < previous_fingerprints.size() && previous_fingerprints[t] == fingerprints[t])
+				selected[t] = 0;
+		}
+	}
+
+	// 6-connected runs of equal tissue, labeled in parallel per slab, roots are the smallest run index
+	component.resize(slice_start[nrslices]);
+	for (size_t i = 0; i < component.size(); i++)
+		component[i] = static_cast<unsigned>(i);
+
+	auto connect = [this](size_t z1, size_t y1, size_t z2, size_t y2) {
+		size_t a = row_start[z1][y1], a_end = row_start[z1][y1 + 1];
+		size_t b = row_start[z2][y2], b_end = row_start[z2][y2 + 1];
+		while (a < a_end && b < b_end)
+		{
+			const Run& ra = runs[z1][a];
+			const Run& rb = runs[z2][b];
+			if (ra.tissue == rb.tissue && selected[ra.tissue] && ra.x0 <= rb.x1 && rb.x0 <= ra.x1)
+			{
+				ccl::Union(component, static_cast<unsigned>(slice_start[z1] + a), static_cast<unsigned>(slice_start[z2] + b));
+			}
+			(ra.x1 < rb.x1) ? a++ : b++;
+		}
+	};
+
+	const int slab_size = 8;
+	const int num_slabs = (n + slab_size - 1) / slab_size;
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < num_slabs; s++)
+	{
+		for (int z = s * slab_size; z < std::min((s + 1) * slab_size, n); z++)
+		{
+			for (size_t y = 0; y < height; y++)
+			{
+				if (y > 0)
+					connect(z, y, z, y - 1);
+				if (z > s * slab_size)
+					connect(z, y, z - 1, y);
+			}
+		}
+	}
+
+	// merge across slab boundaries
+	for (int z = slab_size; z < n; z += slab_size)
+	{
+		for (size_t y = 0; y < height; y++)
+			connect(z, y, z - 1, y);
+	}
+
+	unsigned num_components = 0;
+	for (size_t i = 0; i < component.size(); i++)
+	{
+		component[i] = (component[i] == i) ? num_components++ : component[component[i]];
+	}
+
+	// statistics
+	tissuemap.assign(num_components, 0);
+	volumes.assign(num_components, 0);
+	totvolumes.assign(num_tissues, 0);
+	for (size_t z = 0; z < nrslices; z++)
+	{
+		for (size_t r = 0; r < runs[z].size(); r++)
+		{
+			const Run& run = runs[z][r];
+			const unsigned c = component[slice_start[z] + r];
+			tissuemap[c] = run.tissue;
+			volumes[c] += run.x1 - run.x0 + 1;
+			totvolumes[run.tissue] += run.x1 - run.x0 + 1;
+		}
+	}
+}
+
+std::vector<char> TissueCleaner::erase_components(float ratio, unsigned minsize) const
+{
+	std::vector<char> locked(num_tissues, 0);
+	for (size_t t = 0; t < num_tissues && t < locked_tissues.size(); t++)
+	{
+		locked[t] = locked_tissues[t];
+	}
+
+	std::vector<char> erasemap(tissuemap.size(), 0);
+	for (size_t i = 0; i < tissuemap.size(); i++)
+	{
+		const tissues_size_t tissue = tissuemap[i];
+		if (volumes[i] < minsize && volumes[i] < ratio * totvolumes[tissue])
+		{
+			// only remove small components if tissue is NOT locked!
+			if (selected[tissue] && !locked[tissue])
+			{
+				erasemap[i] = 1;
+			}
+		}
+	}
+	return erasemap;
+}
+
+std::vector<TissueCleaner::Report> TissueCleaner::DryRun(float ratio, unsigned minsize) const
+{
+	const auto erasemap = erase_components(ratio, minsize);
+
+	std::vector<Report> per_tissue(num_tissues);
+	for (size_t t = 0; t < num_tissues; t++)
+	{
+		per_tissue[t].tissue = static_cast<tissues_size_t>(t);
+		per_tissue[t].components = per_tissue[t].removed_components = 0;
+		per_tissue[t].removed_voxels = 0;
+	}
+	for (size_t i = 0; i < tissuemap.size(); i++)
+	{
+		Report& r = per_tissue[tissuemap[i]];
+		r.components++;
+		if (erasemap[i])
+		{
+			r.removed_components++;
+			r.removed_voxels += volumes[i];
+		}
+	}
+
+	std::vector<Report> report;
+	for (const auto& r : per_tissue)
+	{
+		if (r.components != 0 && selected[r.tissue])
+			report.push_back(r);
+	}
+	return report;
+}
+
+void TissueCleaner::Clean(float ratio, unsigned minsize)
+{
+	const auto erasemap = erase_components(ratio, minsize);
+
+	// removed runs get the tissue of the previous run in the row, which is kept
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for schedule(dynamic)
+	for (int z = 0; z < n; z++)
+	{
+		std::vector<char> cleaned(height, 0);
+		for (size_t y = 0; y < height; y++)
+		{
+			const unsigned r0 = row_start[z][y], r1 = row_start[z][y + 1];
+			unsigned first = r0;
+			while (first < r1 && erasemap[component[slice_start[z] + first]])
+				first++;
+			if (first == r1)
+			{
+				// all runs are removed, the row is filled from a neighboring row below
+				continue;
+			}
+			cleaned[y] = 1;
+
+			tissues_size_t curchar = runs[z][first].tissue;
+			tissues_size_t* row = slices[z] + y * width;
+			for (unsigned r = r0; r < r1; r++)
+			{
+				Run& run = runs[z][r];
+				if (!erasemap[component[slice_start[z] + r]])
+				{
+					curchar = run.tissue;
+				}
+				else
+				{
+					run.tissue = curchar;
+					std::fill(row + run.x0, row + run.x1 + 1, curchar);
+				}
+			}
+		}
+
+		// rows without kept runs get the tissue of the cleaned row above, the first rows that of the row below
+		const size_t first_cleaned = std::find(cleaned.begin(), cleaned.end(), 1) - cleaned.begin();
+		if (first_cleaned == height)
+		{
+			continue;
+		}
+		auto fill_from = [&](size_t y, size_t ysrc) {
+			tissues_size_t* row = slices[z] + y * width;
+			const tissues_size_t* src = slices[z] + ysrc * width;
+			for (unsigned r = row_start[z][y]; r < row_start[z][y + 1]; r++)
+			{
+				Run& run = runs[z][r];
+				run.tissue = src[run.x0];
+				std::fill(row + run.x0, row + run.x1 + 1, run.tissue);
+			}
+		};
+		for (size_t y = first_cleaned; y-- > 0;)
+		{
+			fill_from(y, y + 1);
+		}
+		for (size_t y = first_cleaned + 1; y < height; y++)
+		{
+			if (!cleaned[y])
+				fill_from(y, y - 1);
+		}
+	}
+
+	compute_fingerprints();
+}
+
+void TissueCleaner::compute_fingerprints()
+{
+	const size_t area = width * height;
+	const int n = static_cast<int>(nrslices);
+	fingerprints.assign(num_tissues, TissueFingerprint());
+
+#pragma omp parallel
+	{
+		std::vector<TissueFingerprint> local(num_tissues);
+#pragma omp for schedule(dynamic)
+		for (int z = 0; z < n; z++)
+		{
+			for (size_t y = 0; y < height; y++)
+			{
+				for (unsigned r = row_start[z][y]; r < row_start[z][y + 1]; r++)
+				{
+					const Run& run = runs[z][r];
+					const uint64_t a = z * area + y * width + run.x0;
+					const uint64_t b = z * area + y * width + run.x1;
+					TissueFingerprint& f = local[run.tissue];
+					f.count += b - a + 1;
+					f.sum += sum_to(b) - (a > 0 ? sum_to(a - 1) : 0);
+					f.sum2 += sum2_to(b) - (a > 0 ? sum2_to(a - 1) : 0);
+				}
+			}
+		}
+#pragma omp critical
+		{
+			for (size_t t = 0; t < num_tissues; t++)
+			{
+				fingerprints[t].count += local[t].count;
+				fingerprints[t].sum += local[t].sum;
+				fingerprints[t].sum2 += local[t].sum2;
+			}
+		}
+	}
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "iSegCore.h"
+
+#include "Data/Types.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace iseg {
+
+/// Voxel count and moments of the voxel indices of a tissue, to detect which tissues changed between two runs
+struct TissueFingerprint
+{
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t sum2 = 0;
+
+	bool operator==(const TissueFingerprint& other) const
+	{
+		return count == other.count && sum == other.sum && sum2 == other.sum2;
+	}
+	bool operator!=(const TissueFingerprint& other) const { return !(*this == other); }
+};
+
+/** \brief Removes small islands of tissues, i.e. 6-connected regions of equal tissue
+
+	The slices are run-length encoded, the components are labeled on the runs (in parallel per slab of slices),
+	so no label volume is needed. Removed islands are filled with the tissue to their left in the same row.
+	If all runs of a row are removed, the row is filled with the cleaned row above (or below, if there is none).
+	A slice in which no voxel is kept is left unchanged.
+*/
+class ISEG_CORE_API TissueCleaner
+{
+public:
+	/// Islands per tissue, and those which would be removed
+	struct Report
+	{
+		tissues_size_t tissue;
+		unsigned components;
+		unsigned removed_components;
+		unsigned long long removed_voxels;
+	};
+
+	TissueCleaner(tissues_size_t** slices1, unsigned short n1,
+			unsigned short width1, unsigned short height1);
+
+	/// Only tissues whose fingerprint differs from previous are cleaned, call before ConnectedComponents
+	void SetPreviousFingerprints(const std::vector<TissueFingerprint>& previous);
+	/// Islands of locked tissues are not removed, locked[t] != 0 if tissue t is locked
+	void SetLockedTissues(const std::vector<char>& locked);
+	void ConnectedComponents();
+	/// Report of the tissues which are cleaned, the slices are not modified
+	std::vector<Report> DryRun(float ratio, unsigned minsize) const;
+	void Clean(float ratio, unsigned minsize);
+	/// Fingerprints of all tissues, after Clean
+	const std::vector<TissueFingerprint>& Fingerprints() const { return fingerprints; }
+
+private:
+	struct Run
+	{
+		unsigned short x0;
+		unsigned short x1;
+		tissues_size_t tissue;
+	};
+
+	std::vector<char> erase_components(float ratio, unsigned minsize) const;
+	void compute_fingerprints();
+
+	tissues_size_t** slices;
+	size_t width, height;
+	size_t nrslices;
+
+	/// runs of each slice, the runs of row y are row_start[z][y] ... row_start[z][y + 1] - 1
+	std::vector<std::vector<Run>> runs;
+	std::vector<std::vector<unsigned>> row_start;
+	/// index of the first run of each slice in component
+	std::vector<size_t> slice_start;
+	std::vector<unsigned> component;
+	size_t num_tissues;
+	std::vector<tissues_size_t> tissuemap;
+	std::vector<unsigned long long> volumes;
+	std::vector<unsigned long long> totvolumes;
+	std::vector<char> selected;
+	std::vector<TissueFingerprint> fingerprints;
+	std::vector<TissueFingerprint> previous_fingerprints;
+	std::vector<char> locked_tissues;
+};
+
+} // namespace iseg
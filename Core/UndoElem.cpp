@@ -11,6 +11,8 @@
 
 #include "UndoElem.h"
 
+#include "BufferPool.h"
+
 #include <cstdlib>
 #include <vector>
 
@@ -27,15 +29,15 @@ UndoElem::UndoElem()
 UndoElem::~UndoElem()
 {
 	if (bmp_old != nullptr)
-		free(bmp_old);
+		BufferPool::Instance().Release(bmp_old);
 	if (work_old != nullptr)
-		free(work_old);
+		BufferPool::Instance().Release(work_old);
 	if (tissue_old != nullptr)
 		free(tissue_old);
 	if (bmp_new != nullptr)
-		free(bmp_new);
+		BufferPool::Instance().Release(bmp_new);
 	if (work_new != nullptr)
-		free(work_new);
+		BufferPool::Instance().Release(work_new);
 	if (tissue_new != nullptr)
 		free(tissue_new);
 }
@@ -47,7 +49,7 @@ void UndoElem::merge(UndoElem* ue)
 		if (ue->dataSelection.bmp)
 		{
 			if (dataSelection.bmp)
-				free(bmp_new);
+				BufferPool::Instance().Release(bmp_new);
 			else
 			{
 				bmp_old = ue->bmp_old;
@@ -59,7 +61,7 @@ void UndoElem::merge(UndoElem* ue)
 		if (ue->dataSelection.work)
 		{
 			if (dataSelection.work)
-				free(work_new);
+				BufferPool::Instance().Release(work_new);
 			else
 			{
 				work_old = ue->work_old;
@@ -151,15 +153,15 @@ MultiUndoElem::~MultiUndoElem()
 	std::vector<tissues_size_t*>::iterator it8;
 
 	for (itf = vbmp_old.begin(); itf != vbmp_old.end(); itf++)
-		free(*itf);
+		BufferPool::Instance().Release(*itf);
 	for (itf = vwork_old.begin(); itf != vwork_old.end(); itf++)
-		free(*itf);
+		BufferPool::Instance().Release(*itf);
 	for (it8 = vtissue_old.begin(); it8 != vtissue_old.end(); it8++)
 		free(*it8);
 	for (itf = vbmp_new.begin(); itf != vbmp_new.end(); itf++)
-		free(*itf);
+		BufferPool::Instance().Release(*itf);
 	for (itf = vwork_new.begin(); itf != vwork_new.end(); itf++)
-		free(*itf);
+		BufferPool::Instance().Release(*itf);
 	for (it8 = vtissue_new.begin(); it8 != vtissue_new.end(); it8++)
 		free(*it8);
 }
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace clustering {
+
+/// Weighted squared distance, the number of channels is a compile time constant so the loop is unrolled/vectorized
+template<int D>
+struct FixedDistance
+{
+	explicit FixedDistance(int) {}
+	int Dim() const { return D; }
+
+	float operator()(const float* x, const float* c, const float* w) const
+	{
+		float d = 0.f;
+		for (int n = 0; n < D; ++n)
+		{
+			const float t = x[n] - c[n];
+			d += t * t * w[n];
+		}
+		return d;
+	}
+};
+
+/// Weighted squared distance for any number of channels
+struct DynamicDistance
+{
+	explicit DynamicDistance(int dim) : _dim(dim) {}
+	int Dim() const { return _dim; }
+
+	float operator()(const float* x, const float* c, const float* w) const
+	{
+		float d = 0.f;
+		for (int n = 0; n < _dim; ++n)
+		{
+			const float t = x[n] - c[n];
+			d += t * t * w[n];
+		}
+		return d;
+	}
+
+private:
+	int _dim;
+};
+
+/// Calls f (a functor with a templated call operator) with the distance specialized for dim (1 to 4 channels)
+template<typename TFunction>
+void DispatchDistance(int dim, const TFunction& f)
+{
+	switch (dim)
+	{
+	case 1: f(FixedDistance<1>(dim)); break;
+	case 2: f(FixedDistance<2>(dim)); break;
+	case 3: f(FixedDistance<3>(dim)); break;
+	case 4: f(FixedDistance<4>(dim)); break;
+	default: f(DynamicDistance(dim));
+	}
+}
+
+/// Index of the center closest to x, centers are stored one after the other
+template<typename TDistance>
+short NearestCenter(const TDistance& distance, const float* x, const float* centers, const float* weights, short nrclasses)
+{
+	const int dim = distance.Dim();
+	short best = 0;
+	float dmin = distance(x, centers, weights);
+	for (short l = 1; l < nrclasses; ++l)
+	{
+		const float d = distance(x, centers + l * dim, weights);
+		if (d < dmin)
+		{
+			dmin = d;
+			best = l;
+		}
+	}
+	return best;
+}
+
+} // namespace clustering
+
+/** \brief Voxel values of a multi-channel image, sampled from many slices
+
+	The channels of a voxel are stored contiguously. Each slice contributes the same number of voxels,
+	which are spread evenly over the slice (one random voxel per stratum of consecutive pixels), so the
+	sample represents the whole volume and does not depend on a particular slice.
+*/
+class VoxelSample
+{
+public:
+	VoxelSample(int dim, unsigned seed = 42) : _dim(dim), _rng(seed) {}
+
+	int Dim() const { return _dim; }
+	size_t Size() const { return _values.size() / _dim; }
+	const float* Voxel(size_t j) const { return &_values[j * _dim]; }
+
+	/// Adds count voxels (at most area) of a slice, channels[n] is channel n of the slice
+	void Add(const float* const* channels, size_t area, size_t count)
+	{
+		count = std::min(count, area);
+		if (count == 0)
+			return;
+		const double stratum = static_cast<double>(area) / count;
+		std::uniform_real_distribution<double> offset(0.0, 1.0);
+		for (size_t k = 0; k < count; ++k)
+		{
+			const size_t i = std::min(static_cast<size_t>((k + offset(_rng)) * stratum), area - 1);
+			for (int n = 0; n < _dim; ++n)
+			{
+				_values.push_back(channels[n][i]);
+			}
+		}
+	}
+
+	/// Minimum and maximum of each channel
+	void Range(std::vector<float>& minvals, std::vector<float>& maxvals) const
+	{
+		minvals.assign(_dim, std::numeric_limits<float>::max());
+		maxvals.assign(_dim, -std::numeric_limits<float>::max());
+		for (size_t j = 0, n = Size(); j < n; ++j)
+		{
+			for (int c = 0; c < _dim; ++c)
+			{
+				minvals[c] = std::min(minvals[c], _values[j * _dim + c]);
+				maxvals[c] = std::max(maxvals[c], _values[j * _dim + c]);
+			}
+		}
+	}
+
+	std::mt19937& Random() { return _rng; }
+
+private:
+	int _dim;
+	std::vector<float> _values;
+	std::mt19937 _rng;
+};
+
+/** \brief k-means trained on a voxel sample of the whole volume with mini-batch updates
+
+	Each iteration is an epoch over the (shuffled) sample in mini-batches: the voxels of a batch are assigned
+	in parallel, then each center moves towards its voxels with a per-center learning rate 1 / count.
+	Training stops after maxiter epochs or when at most converged sample voxels changed class in an epoch.
+*/
+class VolumeKMeans
+{
+public:
+	VolumeKMeans(short nrclasses, int dim, const float* weights)
+			: _nrclasses(nrclasses), _dim(dim), _weights(weights, weights + dim), _centers(nrclasses * dim, 0.f) {}
+
+	/// Centers distributed uniformly within the range of the sample (on a grid for 27 classes and 3 channels)
+	void InitCenters(const VoxelSample& sample)
+	{
+		std::vector<float> minvals, maxvals;
+		sample.Range(minvals, maxvals);
+		for (short l = 0; l < _nrclasses; ++l)
+		{
+			for (int i = 0; i < _dim; ++i)
+			{
+				float t = (_nrclasses > 1) ? l / (_nrclasses - 1.0f) : 0.f;
+				if (_nrclasses == 27 && _dim == 3)
+				{
+					const int cell[3] = {l % 3, (l / 3) % 3, l / 9};
+					t = (cell[i] + .5f) / 3;
+				}
+				_centers[l * _dim + i] = maxvals[i] - t * (maxvals[i] - minvals[i]);
+			}
+		}
+	}
+
+	void SetCenters(const float* centers) { _centers.assign(centers, centers + _nrclasses * _dim); }
+	const std::vector<float>& Centers() const { return _centers; }
+
+	/// \returns the number of epochs
+	unsigned Train(VoxelSample& sample, unsigned maxiter, unsigned converged, size_t batch_size = 4096)
+	{
+		const size_t n = sample.Size();
+		std::vector<short> labels(n, -1);
+		std::vector<short> batch_labels(batch_size);
+		std::vector<unsigned long long> counts(_nrclasses, 0);
+		std::vector<size_t> order(n);
+		std::iota(order.begin(), order.end(), 0);
+
+		unsigned iter = 0;
+		size_t changed = n;
+		while (iter < maxiter && changed > converged)
+		{
+			++iter;
+			changed = 0;
+			std::shuffle(order.begin(), order.end(), sample.Random());
+			for (size_t b0 = 0; b0 < n; b0 += batch_size)
+			{
+				const int b1 = static_cast<int>(std::min(n - b0, batch_size));
+				AssignBatch assign = {this, &sample, &order[b0], b1, batch_labels.data()};
+				clustering::DispatchDistance(_dim, assign);
+
+				for (int k = 0; k < b1; ++k)
+				{
+					const size_t j = order[b0 + k];
+					const short l = batch_labels[k];
+					if (labels[j] != l)
+					{
+						labels[j] = l;
+						++changed;
+					}
+					const float eta = 1.f / ++counts[l];
+					float* c = &_centers[l * _dim];
+					const float* x = sample.Voxel(j);
+					for (int i = 0; i < _dim; ++i)
+					{
+						c[i] += eta * (x[i] - c[i]);
+					}
+				}
+			}
+		}
+		return iter;
+	}
+
+	/// Classifies the pixels of a slice (in parallel), the result is class * 255 / (nrclasses - 1)
+	void Classify(const float* const* channels, size_t area, float* result) const
+	{
+		ClassifySlice classify = {this, channels, static_cast<int>(area), result};
+		clustering::DispatchDistance(_dim, classify);
+	}
+
+private:
+	struct AssignBatch
+	{
+		const VolumeKMeans* self;
+		const VoxelSample* sample;
+		const size_t* voxels;
+		int count;
+		short* labels;
+
+		template<typename TDistance>
+		void operator()(const TDistance& distance) const
+		{
+#pragma omp parallel for
+			for (int k = 0; k < count; ++k)
+			{
+				labels[k] = clustering::NearestCenter(distance, sample->Voxel(voxels[k]),
+						self->_centers.data(), self->_weights.data(), self->_nrclasses);
+			}
+		}
+	};
+
+	struct ClassifySlice
+	{
+		const VolumeKMeans* self;
+		const float* const* channels;
+		int area;
+		float* result;
+
+		template<typename TDistance>
+		void operator()(const TDistance& distance) const
+		{
+			const short k = self->_nrclasses;
+			const float scale = (k > 1) ? 255.0f / (k - 1) : 0.f;
+#pragma omp parallel
+			{
+				std::vector<float> x(distance.Dim());
+#pragma omp for
+				for (int i = 0; i < area; ++i)
+				{
+					for (int c = 0; c < distance.Dim(); ++c)
+						x[c] = channels[c][i];
+					result[i] = scale * clustering::NearestCenter(distance, x.data(), self->_centers.data(), self->_weights.data(), k);
+				}
+			}
+		}
+	};
+
+	short _nrclasses;
+	int _dim;
+	std::vector<float> _weights;
+	std::vector<float> _centers;
+};
+
+/** \brief Gaussian mixture (one variance per class) fitted by EM to a voxel sample of the whole volume
+
+	The E-step runs in parallel over the sample. Voxels are classified by the largest likelihood
+	exp(-d / (2 dev)) / sqrt(dev), where d is the weighted squared distance to the center.
+*/
+class VolumeEM
+{
+public:
+	VolumeEM(short nrclasses, int dim, const float* weights)
+			: _nrclasses(nrclasses), _dim(dim), _weights(weights, weights + dim),
+				_centers(nrclasses * dim, 0.f), _devs(nrclasses, 1.f), _ampls(nrclasses, 1.f / nrclasses) {}
+
+	/// Centers distributed uniformly within the range of the sample, with equal variances and amplitudes
+	void InitCenters(const VoxelSample& sample)
+	{
+		std::vector<float> minvals, maxvals;
+		sample.Range(minvals, maxvals);
+		float dist = 0.f;
+		for (int i = 0; i < _dim; ++i)
+		{
+			dist += (maxvals[i] - minvals[i]) * (maxvals[i] - minvals[i]) * _weights[i];
+		}
+		for (short l = 0; l < _nrclasses; ++l)
+		{
+			const float t = (_nrclasses > 1) ? l / (_nrclasses - 1.0f) : 0.f;
+			for (int i = 0; i < _dim; ++i)
+			{
+				_centers[l * _dim + i] = maxvals[i] - t * (maxvals[i] - minvals[i]);
+			}
+			_devs[l] = std::max(dist / (_nrclasses * _nrclasses), std::numeric_limits<float>::min());
+			_ampls[l] = 1.0f / _nrclasses;
+		}
+	}
+
+	const std::vector<float>& Centers() const { return _centers; }
+	const std::vector<float>& Devs() const { return _devs; }
+	const std::vector<float>& Ampls() const { return _ampls; }
+
+	/// \returns the number of iterations, stops when at most converged sample voxels changed class
+	unsigned Train(const VoxelSample& sample, unsigned maxiter, unsigned converged)
+	{
+		const size_t n = sample.Size();
+		std::vector<short> labels(n, -1);
+		std::vector<float> responsibilities(n * _nrclasses);
+
+		unsigned iter = 0;
+		unsigned changed = static_cast<unsigned>(n);
+		while (iter < maxiter && changed > converged)
+		{
+			++iter;
+			EStep estep = {this, &sample, labels.data(), responsibilities.data(), 0};
+			clustering::DispatchDistance(_dim, estep);
+			changed = estep.changed;
+			MStep(sample, responsibilities);
+		}
+		return iter;
+	}
+
+	/// Classifies the pixels of a slice (in parallel), the result is class * 255 / (nrclasses - 1)
+	void Classify(const float* const* channels, size_t area, float* result) const
+	{
+		ClassifySlice classify = {this, channels, static_cast<int>(area), result};
+		clustering::DispatchDistance(_dim, classify);
+	}
+
+private:
+	/// Log-likelihood of x for class l, up to a constant
+	template<typename TDistance>
+	float LogLikelihood(const TDistance& distance, const float* x, short l) const
+	{
+		return -distance(x, &_centers[l * _dim], _weights.data()) / (2 * _devs[l]) - 0.5f * std::log(_devs[l]);
+	}
+
+	/// Classes and responsibilities of the sample voxels
+	struct EStep
+	{
+		const VolumeEM* self;
+		const VoxelSample* sample;
+		short* labels;
+		float* responsibilities;
+		mutable unsigned changed;
+
+		template<typename TDistance>
+		void operator()(const TDistance& distance) const
+		{
+			const short k = self->_nrclasses;
+			const int n = static_cast<int>(sample->Size());
+			unsigned count = 0;
+#pragma omp parallel for reduction(+ : count)
+			for (int j = 0; j < n; ++j)
+			{
+				const float* x = sample->Voxel(j);
+				float* w = responsibilities + static_cast<size_t>(j) * k;
+				short best = 0;
+				float best_loglik = -std::numeric_limits<float>::max();
+				float wmax = -std::numeric_limits<float>::max();
+				for (short l = 0; l < k; ++l)
+				{
+					const float loglik = self->LogLikelihood(distance, x, l);
+					if (loglik > best_loglik)
+					{
+						best_loglik = loglik;
+						best = l;
+					}
+					w[l] = loglik + std::log(self->_ampls[l]);
+					wmax = std::max(wmax, w[l]);
+				}
+				if (labels[j] != best)
+				{
+					labels[j] = best;
+					++count;
+				}
+
+				// normalized relative to the largest term, to avoid underflow
+				float wsum = 0.f;
+				for (short l = 0; l < k; ++l)
+				{
+					w[l] = std::exp(w[l] - wmax);
+					wsum += w[l];
+				}
+				for (short l = 0; l < k; ++l)
+					w[l] /= wsum;
+			}
+			changed = count;
+		}
+	};
+
+	/// Amplitudes, centers and variances (around the new centers) from the responsibilities
+	void MStep(const VoxelSample& sample, const std::vector<float>& responsibilities)
+	{
+		const int n = static_cast<int>(sample.Size());
+		const short k = _nrclasses;
+		std::vector<double> sw(k, 0.0), swx(k * _dim, 0.0);
+		for (int j = 0; j < n; ++j)
+		{
+			const float* x = sample.Voxel(j);
+			for (short l = 0; l < k; ++l)
+			{
+				const double r = responsibilities[static_cast<size_t>(j) * k + l];
+				sw[l] += r;
+				for (int c = 0; c < _dim; ++c)
+					swx[l * _dim + c] += r * x[c];
+			}
+		}
+
+		std::vector<double> swd(k, 0.0);
+		for (short l = 0; l < k; ++l)
+		{
+			_ampls[l] = static_cast<float>(sw[l] / n);
+			if (sw[l] != 0)
+			{
+				for (int c = 0; c < _dim; ++c)
+					_centers[l * _dim + c] = static_cast<float>(swx[l * _dim + c] / sw[l]);
+			}
+		}
+		clustering::DynamicDistance distance(_dim);
+		for (int j = 0; j < n; ++j)
+		{
+			const float* x = sample.Voxel(j);
+			for (short l = 0; l < k; ++l)
+				swd[l] += responsibilities[static_cast<size_t>(j) * k + l] * distance(x, &_centers[l * _dim], _weights.data());
+		}
+		for (short l = 0; l < k; ++l)
+		{
+			// keep the previous variance if it would be 0
+			if (sw[l] != 0 && swd[l] != 0)
+				_devs[l] = static_cast<float>(swd[l] / sw[l]);
+		}
+	}
+
+	struct ClassifySlice
+	{
+		const VolumeEM* self;
+		const float* const* channels;
+		int area;
+		float* result;
+
+		template<typename TDistance>
+		void operator()(const TDistance& distance) const
+		{
+			const short k = self->_nrclasses;
+			const float scale = (k > 1) ? 255.0f / (k - 1) : 0.f;
+#pragma omp parallel
+			{
+				std::vector<float> x(distance.Dim());
+#pragma omp for
+				for (int i = 0; i < area; ++i)
+				{
+					for (int c = 0; c < distance.Dim(); ++c)
+						x[c] = channels[c][i];
+					short best = 0;
+					float best_loglik = self->LogLikelihood(distance, x.data(), 0);
+					for (short l = 1; l < k; ++l)
+					{
+						const float loglik = self->LogLikelihood(distance, x.data(), l);
+						if (loglik > best_loglik)
+						{
+							best_loglik = loglik;
+							best = l;
+						}
+					}
+					result[i] = scale * best;
+				}
+			}
+		}
+	};
+
+	short _nrclasses;
+	int _dim;
+	std::vector<float> _weights;
+	std::vector<float> _centers;
+	std::vector<float> _devs;
+	std::vector<float> _ampls;
+};
+
+} // namespace iseg
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include "ConnectedComponents.h"
+
+#include "Data/ProgressInfo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#ifndef NO_OPENMP_SUPPORT
+#	include <omp.h>
+#endif
+
+namespace iseg {
+
+namespace wshed {
+
+/// Basin index of voxels which have not been flooded yet
+const unsigned kUnvisited = std::numeric_limits<unsigned>::max();
+
+/// The region of basin child is merged into the region of basin parent when the water reaches level
+struct MergeEvent
+{
+	unsigned child;
+	unsigned parent;
+	unsigned level;
+};
+
+/// All neighbor offsets (dx, dy, dz) of a connectivity
+inline std::vector<std::ptrdiff_t> NeighborOffsets(eConnectivity connectivity)
+{
+	auto offsets = ccl::BackwardOffsets(connectivity);
+	const size_t n = offsets.size();
+	for (size_t i = 0; i < n; ++i)
+	{
+		offsets.push_back(-offsets[i]);
+	}
+	return offsets;
+}
+
+/// Linear mapping of [lo, hi] to the levels 0..num_levels-1
+inline unsigned short Quantize(float v, float lo, float hi, unsigned num_levels)
+{
+	const float scale = (hi > lo) ? (num_levels - 1) / (hi - lo) : 0.f;
+	const float l = std::floor((v - lo) * scale + 0.5f);
+	return static_cast<unsigned short>(std::min(std::max(l, 0.f), static_cast<float>(num_levels - 1)));
+}
+
+/** \brief Voxel indices (slice * width * height + pixel) sorted by level
+
+	Counting sort (bucket queue), stable w.r.t. raster order. The histogram and the scatter are done in parallel
+	over blocks of voxels.
+*/
+inline void BucketSort(const std::vector<unsigned short>& levels, unsigned num_levels, std::vector<size_t>& sorted)
+{
+	const size_t n = levels.size();
+	sorted.resize(n);
+	if (n == 0)
+		return;
+
+#ifdef NO_OPENMP_SUPPORT
+	const size_t num_threads = 1;
+#else
+	const size_t num_threads = static_cast<size_t>(omp_get_max_threads());
+#endif
+	const size_t block_size = std::max<size_t>((n + 4 * num_threads - 1) / (4 * num_threads), 1);
+	const int num_blocks = static_cast<int>((n + block_size - 1) / block_size);
+
+	std::vector<size_t> offsets(static_cast<size_t>(num_blocks) * num_levels, 0);
+#pragma omp parallel for
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		size_t* count = &offsets[static_cast<size_t>(b) * num_levels];
+		const size_t end = std::min(n, (b + 1) * block_size);
+		for (size_t i = b * block_size; i < end; ++i)
+			count[levels[i]]++;
+	}
+
+	// offsets ordered by level first, then by block
+	size_t sum = 0;
+	for (unsigned l = 0; l < num_levels; ++l)
+	{
+		for (int b = 0; b < num_blocks; ++b)
+		{
+			size_t& o = offsets[static_cast<size_t>(b) * num_levels + l];
+			const size_t count = o;
+			o = sum;
+			sum += count;
+		}
+	}
+
+#pragma omp parallel for
+	for (int b = 0; b < num_blocks; ++b)
+	{
+		size_t* offset = &offsets[static_cast<size_t>(b) * num_levels];
+		const size_t end = std::min(n, (b + 1) * block_size);
+		for (size_t i = b * block_size; i < end; ++i)
+			sorted[offset[levels[i]]++] = i;
+	}
+}
+
+/// Quantized copy of a stack of slices, in parallel over slices
+inline void QuantizeSlices(const float* const* slices, size_t slice_size, size_t nrslices, float lo, float hi, unsigned num_levels, std::vector<unsigned short>& levels)
+{
+	levels.resize(slice_size * nrslices);
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int k = 0; k < n; ++k)
+	{
+		unsigned short* l = &levels[k * slice_size];
+		for (size_t i = 0; i < slice_size; ++i)
+			l[i] = Quantize(slices[k][i], lo, hi, num_levels);
+	}
+}
+
+} // namespace wshed
+
+/** \brief Merge tree of a watershed flooding
+
+	Each basin starts at the level of its minimum. When two regions meet, the one with the shallower minimum
+	is merged into the deeper one. The events are stored in the order of flooding, i.e. by increasing level.
+*/
+struct WatershedHierarchy
+{
+	/// level of the minimum of each basin
+	std::vector<unsigned> minimum;
+	/// merge events ordered by level
+	std::vector<wshed::MergeEvent> merges;
+
+	size_t NumberOfBasins() const { return minimum.size(); }
+
+	void Clear()
+	{
+		minimum.clear();
+		merges.clear();
+	}
+
+	/** \brief Label of each basin if regions whose depth (merge level - minimum) is at most h are merged
+
+		markers contains a label for each basin (0 if unmarked). Regions with different non-zero labels are
+		never merged, unmarked regions take the label of the region they are merged into.
+	*/
+	std::vector<unsigned> Cut(unsigned h, const std::vector<unsigned>& markers) const
+	{
+		std::vector<unsigned> parent(minimum.size());
+		std::iota(parent.begin(), parent.end(), 0);
+		std::vector<unsigned> labels(markers);
+		labels.resize(minimum.size(), 0);
+
+		for (const auto& m : merges)
+		{
+			const unsigned k = ccl::FindRoot(parent, m.child);
+			const unsigned a = ccl::FindRoot(parent, m.parent);
+			if (k == a || h < m.level - minimum[k])
+				continue;
+			if (labels[a] == 0 || labels[k] == 0 || labels[a] == labels[k])
+			{
+				parent[k] = a;
+				if (labels[a] == 0)
+					labels[a] = labels[k];
+			}
+		}
+
+		for (size_t b = 0; b < labels.size(); ++b)
+		{
+			labels[b] = labels[ccl::FindRoot(parent, static_cast<unsigned>(b))];
+		}
+		return labels;
+	}
+};
+
+/** \brief Hierarchical watershed by flooding
+
+	The image is quantized to num_levels levels between lo and hi. Voxels are flooded in order of increasing level
+	(bucket queue). A voxel without flooded neighbor starts a new basin, otherwise it is added to the neighboring
+	basin whose region has the deepest minimum and all other regions touching the voxel are merged into this
+	region. basins receives the basin index of each voxel, hierarchy the minima and merge events.
+
+	\note Returns false if canceled via progress.
+*/
+inline bool WatershedFlooding(const float* const* slices, size_t width, size_t height, size_t nrslices,
+		float lo, float hi, unsigned num_levels, eConnectivity connectivity,
+		unsigned* const* basins, WatershedHierarchy& hierarchy, ProgressInfo* progress = nullptr)
+{
+	hierarchy.Clear();
+	const size_t slice_size = width * height;
+
+	std::vector<unsigned short> levels;
+	wshed::QuantizeSlices(slices, slice_size, nrslices, lo, hi, num_levels, levels);
+	std::vector<size_t> sorted;
+	wshed::BucketSort(levels, num_levels, sorted);
+
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int k = 0; k < n; ++k)
+	{
+		std::fill(basins[k], basins[k] + slice_size, wshed::kUnvisited);
+	}
+
+	if (progress)
+	{
+		progress->setValue(20);
+		if (progress->wasCanceled())
+			return false;
+	}
+
+	const auto offsets = wshed::NeighborOffsets(connectivity);
+	const size_t num_offsets = offsets.size() / 3;
+	std::vector<unsigned> root;
+	std::vector<unsigned> neighbor_basins, neighbor_roots;
+	neighbor_basins.reserve(num_offsets);
+	neighbor_roots.reserve(num_offsets);
+
+	for (size_t idx : sorted)
+	{
+		const size_t z = idx / slice_size, i = idx % slice_size;
+		const size_t x = i % width, y = i / width;
+		const unsigned level = levels[idx];
+
+		neighbor_basins.clear();
+		neighbor_roots.clear();
+		for (size_t o = 0; o < num_offsets; ++o)
+		{
+			const std::ptrdiff_t nx = static_cast<std::ptrdiff_t>(x) + offsets[3 * o];
+			const std::ptrdiff_t ny = static_cast<std::ptrdiff_t>(y) + offsets[3 * o + 1];
+			const std::ptrdiff_t nz = static_cast<std::ptrdiff_t>(z) + offsets[3 * o + 2];
+			if (nx < 0 || ny < 0 || nz < 0 || nx >= static_cast<std::ptrdiff_t>(width) ||
+					ny >= static_cast<std::ptrdiff_t>(height) || nz >= static_cast<std::ptrdiff_t>(nrslices))
+				continue;
+			const unsigned b = basins[nz][ny * width + nx];
+			if (b == wshed::kUnvisited)
+				continue;
+			neighbor_basins.push_back(b);
+			neighbor_roots.push_back(ccl::FindRoot(root, b));
+		}
+
+		if (neighbor_basins.empty())
+		{
+			const unsigned b = static_cast<unsigned>(hierarchy.minimum.size());
+			hierarchy.minimum.push_back(level);
+			root.push_back(b);
+			basins[z][i] = b;
+			continue;
+		}
+
+		// deepest region, ties are broken by the basin index
+		size_t best = 0;
+		for (size_t j = 1; j < neighbor_roots.size(); ++j)
+		{
+			const unsigned r = neighbor_roots[j], rb = neighbor_roots[best];
+			if (hierarchy.minimum[r] < hierarchy.minimum[rb] || (hierarchy.minimum[r] == hierarchy.minimum[rb] && r < rb))
+				best = j;
+		}
+		const unsigned deepest = neighbor_roots[best];
+		basins[z][i] = neighbor_basins[best];
+
+		for (size_t j = 0; j < neighbor_roots.size(); ++j)
+		{
+			// a region can touch the voxel several times
+			const unsigned r = ccl::FindRoot(root, neighbor_roots[j]);
+			if (r != deepest)
+			{
+				wshed::MergeEvent m;
+				m.child = r;
+				m.parent = deepest;
+				m.level = level;
+				hierarchy.merges.push_back(m);
+				root[r] = deepest;
+			}
+		}
+	}
+
+	if (progress)
+	{
+		progress->setValue(100);
+	}
+	return true;
+}
+
+/** \brief Marker-controlled watershed (Meyer's flooding with a bucket queue)
+
+	On input labels contains the seeds (label > 0), all other voxels must be 0. The image is quantized as in
+	WatershedFlooding. Starting from the seeds, voxels are flooded in order of increasing level and get the label
+	of the region which reaches them first. Voxels not connected to any seed remain 0.
+
+	\note Returns false if canceled via progress.
+*/
+inline bool MarkerWatershed(const float* const* slices, size_t width, size_t height, size_t nrslices,
+		float lo, float hi, unsigned num_levels, eConnectivity connectivity,
+		unsigned* const* labels, ProgressInfo* progress = nullptr)
+{
+	const size_t slice_size = width * height;
+
+	std::vector<unsigned short> levels;
+	wshed::QuantizeSlices(slices, slice_size, nrslices, lo, hi, num_levels, levels);
+
+	// seeds, collected in parallel per slice to keep the raster order
+	std::vector<std::vector<size_t>> slice_seeds(nrslices);
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int k = 0; k < n; ++k)
+	{
+		for (size_t i = 0; i < slice_size; ++i)
+		{
+			if (labels[k][i] != 0)
+				slice_seeds[k].push_back(k * slice_size + i);
+		}
+	}
+
+	std::vector<std::vector<size_t>> buckets(num_levels);
+	for (const auto& seeds : slice_seeds)
+	{
+		for (size_t idx : seeds)
+			buckets[levels[idx]].push_back(idx);
+	}
+	std::vector<std::vector<size_t>>().swap(slice_seeds);
+
+	if (progress)
+	{
+		progress->setValue(20);
+		if (progress->wasCanceled())
+			return false;
+	}
+
+	const auto offsets = wshed::NeighborOffsets(connectivity);
+	const size_t num_offsets = offsets.size() / 3;
+
+	for (unsigned level = 0; level < num_levels; ++level)
+	{
+		// the bucket of the current level can grow while it is processed
+		auto& bucket = buckets[level];
+		for (size_t q = 0; q < bucket.size(); ++q)
+		{
+			const size_t idx = bucket[q];
+			const size_t z = idx / slice_size, i = idx % slice_size;
+			const size_t x = i % width, y = i / width;
+			const unsigned label = labels[z][i];
+
+			for (size_t o = 0; o < num_offsets; ++o)
+			{
+				const std::ptrdiff_t nx = static_cast<std::ptrdiff_t>(x) + offsets[3 * o];
+				const std::ptrdiff_t ny = static_cast<std::ptrdiff_t>(y) + offsets[3 * o + 1];
+				const std::ptrdiff_t nz = static_cast<std::ptrdiff_t>(z) + offsets[3 * o + 2];
+				if (nx < 0 || ny < 0 || nz < 0 || nx >= static_cast<std::ptrdiff_t>(width) ||
+						ny >= static_cast<std::ptrdiff_t>(height) || nz >= static_cast<std::ptrdiff_t>(nrslices))
+					continue;
+				const size_t ni = ny * width + nx;
+				if (labels[nz][ni] != 0)
+					continue;
+				labels[nz][ni] = label;
+				const size_t nidx = nz * slice_size + ni;
+				buckets[std::max<unsigned>(levels[nidx], level)].push_back(nidx);
+			}
+		}
+		std::vector<size_t>().swap(bucket);
+
+		if (progress && (level % 16) == 0)
+		{
+			progress->setValue(20 + (80 * level) / num_levels);
+			if (progress->wasCanceled())
+				return false;
+		}
+	}
+
+	if (progress)
+	{
+		progress->setValue(100);
+	}
+	return true;
+}
+
+/// Gradient magnitude (central differences, one-sided at the border), in parallel over slices
+inline void GradientMagnitude(const float* const* slices, size_t width, size_t height, size_t nrslices,
+		const double spacing[3], float* const* gradient)
+{
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int k = 0; k < n; ++k)
+	{
+		const float* prev = slices[k > 0 ? k - 1 : k];
+		const float* next = slices[k + 1 < n ? k + 1 : k];
+		const float* cur = slices[k];
+		const double dz = (k > 0 && k + 1 < n) ? 2 * spacing[2] : spacing[2];
+		for (size_t y = 0; y < height; ++y)
+		{
+			const size_t y0 = (y > 0) ? y - 1 : y, y1 = (y + 1 < height) ? y + 1 : y;
+			const double dy = (y1 - y0) * spacing[1];
+			for (size_t x = 0; x < width; ++x)
+			{
+				const size_t x0 = (x > 0) ? x - 1 : x, x1 = (x + 1 < width) ? x + 1 : x;
+				const double dx = (x1 - x0) * spacing[0];
+				const size_t i = y * width + x;
+				const double gx = (x1 != x0) ? (cur[y * width + x1] - cur[y * width + x0]) / dx : 0.0;
+				const double gy = (y1 != y0) ? (cur[y1 * width + x] - cur[y0 * width + x]) / dy : 0.0;
+				const double gz = (n > 1) ? (next[i] - prev[i]) / dz : 0.0;
+				gradient[k][i] = static_cast<float>(std::sqrt(gx * gx + gy * gy + gz * gz));
+			}
+		}
+	}
+}
+
+} // namespace iseg
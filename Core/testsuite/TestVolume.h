@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace test {
+
+/// Slices of an image, as passed to the filters via Pointers
+typedef std::vector<std::vector<float>> Volume;
+
+/// Uniformly distributed values in [lo, hi), rounded down if integral
+inline Volume RandomVolume(size_t w, size_t h, size_t d, float lo, float hi, unsigned seed, bool integral = false)
+{
+	std::mt19937 gen(seed);
+	std::uniform_real_distribution<float> value(lo, hi);
+	Volume v(d, std::vector<float>(w * h));
+	for (auto& slice : v)
+		for (auto& x : slice)
+			x = integral ? std::floor(value(gen)) : value(gen);
+	return v;
+}
+
+/// Slice pointers, as used by the Core filters
+template<typename T>
+std::vector<T*> Pointers(std::vector<std::vector<T>>& slices)
+{
+	std::vector<T*> p;
+	for (auto& s : slices)
+		p.push_back(s.data());
+	return p;
+}
+
+} // namespace test
+
+} // namespace iseg
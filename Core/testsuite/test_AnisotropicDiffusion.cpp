@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../AnisotropicDiffusion.h"
+#include "TestVolume.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+using test::Pointers;
+using test::RandomVolume;
+using test::Volume;
+
+// explicit scheme computing the flux of each pair of neighbors once, as in the original 2D filter
+template<typename TConductance>
+void Reference(Volume& v, const Volume& original, size_t w, size_t h, const float a[3], float dt, float tau,
+		int iterations, float restraint, const TConductance& g)
+{
+	const int d = static_cast<int>(v.size());
+	for (int it = 0; it < iterations; ++it)
+	{
+		Volume in = v;
+		for (int z = 0; z < d; ++z)
+			for (size_t i = 0; i < w * h; ++i)
+				v[z][i] += dt * restraint * (original[z][i] - in[z][i]);
+
+		auto exchange = [&](int z0, size_t i0, int z1, size_t i1, float a) {
+			const float f = diffusion::Flux(g, in[z1][i1] - in[z0][i0], a);
+			v[z0][i0] += tau * f;
+			v[z1][i1] -= tau * f;
+		};
+		for (int z = 0; z < d; ++z)
+			for (size_t y = 0; y < h; ++y)
+				for (size_t x = 0; x < w; ++x)
+				{
+					const size_t i = y * w + x;
+					if (x + 1 < w)
+						exchange(z, i, z, i + 1, a[0]);
+					if (y + 1 < h)
+						exchange(z, i, z, i + w, a[1]);
+					if (z + 1 < d)
+						exchange(z, i, z + 1, i, a[2]);
+				}
+	}
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(AnisotropicDiffusion_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/AnisotropicDiffusion_suite --log_level=message
+BOOST_AUTO_TEST_CASE(Slice)
+{
+	const size_t w = 23, h = 17;
+	const float spacing[3] = {1.f, 1.f, 1.f}, a[3] = {1.f, 1.f, 0.f};
+	Volume original = RandomVolume(w, h, 1, 0.f, 100.f, 3);
+	Volume expected = original, result = original;
+
+	const diffusion::RationalConductance g(20.f);
+	Reference(expected, original, w, h, a, 0.2f, 0.2f, 10, 0.1f, g);
+
+	auto ptrs = Pointers(result);
+	auto orig_ptrs = Pointers(original);
+	AnisotropicDiffusion(ptrs.data(), orig_ptrs.data(), w, h, 1, spacing, 0.2f, 10, 0.1f, g);
+
+	for (size_t i = 0; i < w * h; ++i)
+		BOOST_REQUIRE_CLOSE(result[0][i], expected[0][i], 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(VolumeWithSpacing)
+{
+	// more slices than slabs, so fluxes across slab borders are tested
+	const size_t w = 11, h = 9, d = 70;
+	const float spacing[3] = {0.5f, 0.5f, 0.625f};
+	const float a[3] = {1.f, 1.f, 0.8f};
+	const float tau = 0.15f * 2.f / (1.f + 1.f + 0.64f);
+	Volume original = RandomVolume(w, h, d, 0.f, 100.f, 3);
+	Volume expected = original, result = original;
+
+	const diffusion::ExponentialConductance g(30.f);
+	Reference(expected, original, w, h, a, 0.15f, tau, 5, 0.f, g);
+
+	auto ptrs = Pointers(result);
+	auto orig_ptrs = Pointers(original);
+	AnisotropicDiffusion(ptrs.data(), orig_ptrs.data(), w, h, d, spacing, 0.15f, 5, 0.f, g);
+
+	for (size_t z = 0; z < d; ++z)
+		for (size_t i = 0; i < w * h; ++i)
+			BOOST_REQUIRE_CLOSE(result[z][i], expected[z][i], 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(ZeroContrast)
+{
+	// no diffusion across any edge, only the restraint towards the original
+	const size_t w = 8, h = 8;
+	const float spacing[3] = {1.f, 1.f, 1.f};
+	Volume original = RandomVolume(w, h, 1, 0.f, 100.f, 3);
+	Volume result(1, std::vector<float>(w * h, 50.f));
+
+	auto ptrs = Pointers(result);
+	auto orig_ptrs = Pointers(original);
+	AnisotropicDiffusion(ptrs.data(), orig_ptrs.data(), w, h, 1, spacing, 1.f, 1, 0.5f, diffusion::kRational, 0.f);
+
+	for (size_t i = 0; i < w * h; ++i)
+		BOOST_REQUIRE_CLOSE(result[0][i], 0.5f * (50.f + original[0][i]), 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../BrickSurfaceCache.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+typedef std::array<float, 10> Triangle;
+
+vtkSmartPointer<vtkImageData> MakeLabels(int nx, int ny, int nz)
+{
+	auto image = vtkSmartPointer<vtkImageData>::New();
+	image->SetDimensions(nx, ny, nz);
+	image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+	auto labels = static_cast<unsigned char*>(image->GetScalarPointer());
+	size_t i = 0;
+	for (int z = 0; z < nz; ++z)
+		for (int y = 0; y < ny; ++y)
+			for (int x = 0; x < nx; ++x, ++i)
+			{
+				const int r1 = (x - 14) * (x - 14) + (y - 15) * (y - 15) + (z - 12) * (z - 12);
+				const int r2 = (x - 26) * (x - 26) + (y - 18) * (y - 18) + (z - 16) * (z - 16);
+				labels[i] = (r1 < 100) ? 1 : ((r2 < 64) ? 2 : 0);
+			}
+	return image;
+}
+
+void FillBox(vtkImageData* image, const int box[6], unsigned char label)
+{
+	int dims[3];
+	image->GetDimensions(dims);
+	auto labels = static_cast<unsigned char*>(image->GetScalarPointer());
+	for (int z = box[4]; z <= box[5]; ++z)
+		for (int y = box[2]; y <= box[3]; ++y)
+			for (int x = box[0]; x <= box[1]; ++x)
+				labels[(static_cast<size_t>(z) * dims[1] + y) * dims[0] + x] = label;
+	image->Modified();
+}
+
+// triangles with sorted corners and their label, without the degenerate (free) ones
+std::vector<Triangle> Triangles(vtkPolyData* surface)
+{
+	std::vector<Triangle> triangles;
+	vtkDataArray* labels = surface->GetPointData()->GetScalars();
+	vtkIdType npts;
+	vtkIdType* pts;
+	vtkCellArray* polys = surface->GetPolys();
+	for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+	{
+		BOOST_REQUIRE_EQUAL(npts, 3);
+		if (pts[0] == pts[1] && pts[1] == pts[2])
+			continue;
+
+		std::array<std::array<float, 3>, 3> corners;
+		for (int j = 0; j < 3; ++j)
+		{
+			double p[3];
+			surface->GetPoint(pts[j], p);
+			for (int k = 0; k < 3; ++k)
+				corners[j][k] = static_cast<float>(p[k]);
+		}
+		std::sort(corners.begin(), corners.end());
+
+		Triangle t;
+		for (int j = 0; j < 3; ++j)
+			for (int k = 0; k < 3; ++k)
+				t[3 * j + k] = corners[j][k];
+		t[9] = static_cast<float>(labels->GetTuple1(pts[0]));
+		triangles.push_back(t);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+std::vector<Triangle> FullExtraction(vtkImageData* image)
+{
+	auto cubes = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
+	cubes->SetInputData(image);
+	cubes->ComputeScalarsOn();
+	cubes->GenerateValues(3, 1, 3);
+	cubes->Update();
+	return Triangles(cubes->GetOutput());
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(BrickSurfaceCache_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/BrickSurfaceCache_suite --log_level=message
+BOOST_AUTO_TEST_CASE(InitialUpdate)
+{
+	auto image = MakeLabels(40, 36, 30);
+
+	BrickSurfaceCache cache(8);
+	cache.set_input(image);
+	BOOST_REQUIRE(cache.update());
+
+	const auto expected = FullExtraction(image);
+	BOOST_REQUIRE(!expected.empty());
+	BOOST_CHECK(Triangles(cache.get_output()) == expected);
+	BOOST_CHECK_EQUAL(cache.number_of_remeshed_bricks(), 5 * 5 * 4);
+}
+
+BOOST_AUTO_TEST_CASE(RemeshChangedBricks)
+{
+	auto image = MakeLabels(40, 36, 30);
+
+	BrickSurfaceCache cache(8);
+	cache.set_input(image);
+	BOOST_REQUIRE(cache.update());
+	vtkPolyData* output = cache.get_output();
+
+	// an edit in two slices only re-meshes the bricks it touches
+	const int box[6] = {10, 20, 12, 19, 12, 13};
+	FillBox(image, box, 3);
+	cache.invalidate_slices(12, 13);
+	BOOST_REQUIRE(cache.update());
+	BOOST_CHECK(cache.get_output() == output);
+	BOOST_CHECK(cache.number_of_remeshed_bricks() > 0);
+	BOOST_CHECK(cache.number_of_remeshed_bricks() <= 3 * 3 * 2);
+	BOOST_CHECK(cache.changed_labels().count(3) == 1);
+	BOOST_CHECK(Triangles(output) == FullExtraction(image));
+
+	// unchanged slices are not re-meshed
+	cache.invalidate_slices(25, 28);
+	BOOST_REQUIRE(cache.update());
+	BOOST_CHECK_EQUAL(cache.number_of_remeshed_bricks(), 0);
+
+	// repeated edits reuse the freed points and triangles, or compact the output
+	for (int i = 0; i < 6; ++i)
+	{
+		const int moved[6] = {10 + i, 20 + i, 12, 19, 12 + i, 13 + i};
+		FillBox(image, moved, static_cast<unsigned char>(i % 2 ? 0 : 2));
+		cache.invalidate_slices(moved[4], moved[5]);
+		BOOST_REQUIRE(cache.update());
+		BOOST_CHECK(Triangles(output) == FullExtraction(image));
+	}
+
+	// same result as a full extraction by a new cache
+	BrickSurfaceCache full(8);
+	full.set_input(image);
+	BOOST_REQUIRE(full.update());
+	BOOST_CHECK(Triangles(full.get_output()) == Triangles(output));
+}
+
+BOOST_AUTO_TEST_CASE(Cancel)
+{
+	auto image = MakeLabels(40, 36, 30);
+
+	BrickSurfaceCache cache(8);
+	cache.set_input(image);
+	BOOST_CHECK(!cache.update([]() { return true; }));
+	BOOST_CHECK_EQUAL(cache.number_of_remeshed_bricks(), 0);
+
+	// the remaining bricks are meshed by the next update
+	BOOST_REQUIRE(cache.update());
+	BOOST_CHECK(Triangles(cache.get_output()) == FullExtraction(image));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
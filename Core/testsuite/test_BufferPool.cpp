@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../BufferPool.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+BufferPool::Statistics ClassOf(size_t bytes)
+{
+	for (const auto& s : BufferPool::Instance().Report())
+	{
+		if (s.bytes == bytes)
+			return s;
+	}
+	BufferPool::Statistics none = {bytes, 0, 0, 0};
+	return none;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(BufferPool_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/BufferPool_suite --log_level=message
+BOOST_AUTO_TEST_CASE(ReuseAndAlignment)
+{
+	BufferPool& pool = BufferPool::Instance();
+
+	void* a = pool.Acquire(1000);
+	BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(a) % BufferPool::kAlignment, 0);
+	pool.Release(a);
+
+	// same size class (1000 and 1010 bytes are both rounded to 1024)
+	void* b = pool.Acquire(1010);
+	BOOST_CHECK_EQUAL(a, b);
+
+	// different size class
+	void* c = pool.Acquire(1100);
+	BOOST_CHECK(c != b);
+	pool.Release(b);
+	pool.Release(c);
+
+	BOOST_CHECK_EQUAL(ClassOf(1024).in_use, 0);
+	BOOST_CHECK_EQUAL(ClassOf(1024).high_water, 1);
+	BOOST_CHECK_EQUAL(ClassOf(1152).allocated, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Leases)
+{
+	const size_t bytes = 4096 * sizeof(float);
+	{
+		ScratchLease<float> a(4096);
+		ScratchLease<float> b(4096);
+		a[0] = 1.f;
+		b[4095] = 2.f;
+		BOOST_CHECK(a.get() != b.get());
+		BOOST_CHECK_EQUAL(a.size(), 4096);
+		BOOST_CHECK_EQUAL(ClassOf(bytes).in_use, 2);
+
+		ScratchLease<float> c(std::move(a));
+		BOOST_CHECK(a.get() == nullptr);
+		BOOST_CHECK_EQUAL(c[0], 1.f);
+	}
+	BOOST_CHECK_EQUAL(ClassOf(bytes).in_use, 0);
+	BOOST_CHECK_EQUAL(ClassOf(bytes).high_water, 2);
+}
+
+BOOST_AUTO_TEST_CASE(ParallelLeases)
+{
+	const int n = 2000;
+	std::vector<int> ok(n, 0);
+#pragma omp parallel for
+	for (int i = 0; i < n; ++i)
+	{
+		ScratchLease<int> a(777), b(333 + i % 7);
+		for (size_t k = 0; k < a.size(); ++k)
+			a[k] = i;
+		for (size_t k = 0; k < b.size(); ++k)
+			b[k] = -i;
+		bool same = true;
+		for (size_t k = 0; k < a.size(); ++k)
+			same = same && a[k] == i;
+		ok[i] = same ? 1 : 0;
+	}
+	for (int i = 0; i < n; ++i)
+		BOOST_REQUIRE_EQUAL(ok[i], 1);
+	BOOST_CHECK_EQUAL(ClassOf(3136).in_use, 0);
+}
+
+BOOST_AUTO_TEST_CASE(ForeignBuffers)
+{
+	BufferPool& pool = BufferPool::Instance();
+	void* a = pool.Acquire(3000);
+	BOOST_CHECK(pool.Owns(a));
+	BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(a) % BufferPool::kAlignment, 0);
+	BOOST_CHECK_EQUAL(ClassOf(3008).in_use, 1);
+	BOOST_CHECK_EQUAL(ClassOf(3008).allocated, 1);
+
+	// a malloc'd buffer is freed, not added to the 3008 bytes class
+	void* b = malloc(3000);
+	BOOST_CHECK(!pool.Owns(b));
+	pool.Release(b);
+	BOOST_CHECK_EQUAL(ClassOf(3008).in_use, 1);
+	BOOST_CHECK_EQUAL(ClassOf(3008).allocated, 1);
+
+	pool.Release(a);
+	BOOST_CHECK_EQUAL(ClassOf(3008).in_use, 0);
+	void* c = pool.Acquire(3008);
+	BOOST_CHECK_EQUAL(c, a);
+	void* d = pool.Acquire(3008);
+	BOOST_CHECK(pool.Owns(d));
+	BOOST_CHECK_EQUAL(ClassOf(3008).in_use, 2);
+	BOOST_CHECK_EQUAL(ClassOf(3008).allocated, 2);
+	pool.Release(c);
+	pool.Release(d);
+}
+
+BOOST_AUTO_TEST_CASE(TrimThreadCaches)
+{
+	BufferPool& pool = BufferPool::Instance();
+	const size_t bytes = 5008 * sizeof(float);
+
+	// buffers released by other threads are in their caches, Trim frees them too
+#pragma omp parallel for
+	for (int i = 0; i < 64; ++i)
+	{
+		ScratchLease<float> a(5008);
+		a[0] = 1.f;
+	}
+	BOOST_CHECK_EQUAL(ClassOf(bytes).in_use, 0);
+	BOOST_CHECK(ClassOf(bytes).allocated > 0);
+	pool.Trim(bytes);
+	BOOST_CHECK_EQUAL(ClassOf(bytes).allocated, 0);
+
+	// large buffers bypass the thread cache
+	const size_t large = size_t(20) << 20;
+	void* p = pool.Acquire(large);
+	pool.Release(p);
+	pool.Trim(large);
+	BOOST_CHECK_EQUAL(ClassOf(large).allocated, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
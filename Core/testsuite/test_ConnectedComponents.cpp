@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../ConnectedComponents.h"
+
+#include <vector>
+
+namespace iseg {
+
+namespace {
+template<typename T>
+std::vector<T*> slice_pointers(std::vector<T>& data, size_t slice_size)
+{
+	std::vector<T*> slices;
+	for (size_t i = 0; i < data.size(); i += slice_size)
+		slices.push_back(&data[i]);
+	return slices;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(ConnectedComponents_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/ConnectedComponents_suite/Connectivity2D_test --log_level=message
+BOOST_AUTO_TEST_CASE(Connectivity2D_test)
+{
+	// two diagonal neighbors and one isolated pixel
+	const size_t w = 5, h = 4;
+	std::vector<unsigned char> image = {
+			1, 0, 0, 0, 0,
+			0, 1, 0, 0, 1,
+			0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0};
+	std::vector<unsigned> labels(w * h);
+	auto in = slice_pointers(image, w * h);
+	auto out = slice_pointers(labels, w * h);
+
+	auto is_set = [](unsigned char v) { return v != 0; };
+	auto same = [](unsigned char a, unsigned char b) { return a == b; };
+
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, 1, kConnectivity4, out.data(), is_set, same), 3);
+	BOOST_CHECK_EQUAL(labels[0], 1);
+	BOOST_CHECK_EQUAL(labels[6], 2);
+	BOOST_CHECK_EQUAL(labels[9], 3);
+	BOOST_CHECK_EQUAL(labels[1], 0);
+
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, 1, kConnectivity8, out.data(), is_set, same), 2);
+	BOOST_CHECK_EQUAL(labels[6], 1);
+	BOOST_CHECK_EQUAL(labels[9], 2);
+
+	// all pixels labeled, background is one region
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, 1, kConnectivity8, out.data()), 3);
+	BOOST_CHECK_EQUAL(labels[1], 2);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/ConnectedComponents_suite/Connectivity3D_test --log_level=message
+BOOST_AUTO_TEST_CASE(Connectivity3D_test)
+{
+	const size_t w = 3, h = 3, d = 2;
+	std::vector<int> image(w * h * d, 0);
+	image[0] = 1;             // (0,0,0)
+	image[w * h + 1] = 1;     // (1,0,1): edge neighbor of (0,0,0)
+	image[w + 2] = 1;         // (2,1,0): vertex neighbor of (1,0,1)
+	image[w * h + 2 * w] = 1; // (0,2,1): isolated
+
+	std::vector<unsigned> labels(image.size());
+	auto in = slice_pointers(image, w * h);
+	auto out = slice_pointers(labels, w * h);
+
+	auto is_set = [](int v) { return v != 0; };
+	auto same = [](int a, int b) { return a == b; };
+
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, d, kConnectivity6, out.data(), is_set, same), 4);
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, d, kConnectivity18, out.data(), is_set, same), 3);
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, d, kConnectivity26, out.data(), is_set, same), 2);
+	// slice-wise labeling
+	BOOST_CHECK_EQUAL(ConnectedComponents(in.data(), w, h, d, kConnectivity8, out.data(), is_set, same), 4);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/ConnectedComponents_suite/BlockMerge_test --log_level=message
+BOOST_AUTO_TEST_CASE(BlockMerge_test)
+{
+	// random labels, components cross many block boundaries. Compare to sequential flood fill
+	const size_t w = 37, h = 23, d = 41;
+	std::vector<unsigned short> image(w * h * d);
+	for (size_t i = 0; i < image.size(); ++i)
+	{
+		image[i] = static_cast<unsigned short>((i * 2654435761u >> 7) % 3);
+	}
+	std::vector<unsigned> labels(image.size());
+	auto in = slice_pointers(image, w * h);
+	auto out = slice_pointers(labels, w * h);
+
+	unsigned n = ConnectedComponents(in.data(), w, h, d, kConnectivity6, out.data());
+
+	// reference: flood fill, labels by first appearance
+	std::vector<unsigned> ref(image.size(), 0);
+	unsigned next = 0;
+	std::vector<size_t> stack;
+	for (size_t s = 0; s < image.size(); ++s)
+	{
+		if (ref[s] != 0)
+			continue;
+		ref[s] = ++next;
+		stack.push_back(s);
+		while (!stack.empty())
+		{
+			size_t p = stack.back();
+			stack.pop_back();
+			size_t x = p % w, y = (p / w) % h, z = p / (w * h);
+			size_t nbs[6];
+			int k = 0;
+			if (x > 0)
+				nbs[k++] = p - 1;
+			if (x + 1 < w)
+				nbs[k++] = p + 1;
+			if (y > 0)
+				nbs[k++] = p - w;
+			if (y + 1 < h)
+				nbs[k++] = p + w;
+			if (z > 0)
+				nbs[k++] = p - w * h;
+			if (z + 1 < d)
+				nbs[k++] = p + w * h;
+			for (int j = 0; j < k; ++j)
+			{
+				if (ref[nbs[j]] == 0 && image[nbs[j]] == image[p])
+				{
+					ref[nbs[j]] = next;
+					stack.push_back(nbs[j]);
+				}
+			}
+		}
+	}
+
+	BOOST_CHECK_EQUAL(n, next);
+	BOOST_CHECK(labels == ref);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../DistanceTransform.h"
+
+#include <vector>
+
+namespace iseg {
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(DistanceTransform_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/DistanceTransform_suite/BruteForce_test --log_level=message
+BOOST_AUTO_TEST_CASE(BruteForce_test)
+{
+	const size_t w = 17, h = 11, d = 7;
+	const double spacing[3] = {0.5, 1.0, 2.5};
+
+	std::vector<unsigned char> image(w * h * d, 0);
+	image[3 + 4 * w + 1 * w * h] = 1;
+	image[15 + 9 * w + 5 * w * h] = 1;
+	image[0 + 0 * w + 6 * w * h] = 1;
+
+	std::vector<float> dist(image.size());
+	std::vector<const unsigned char*> in;
+	std::vector<float*> out;
+	for (size_t k = 0; k < d; ++k)
+	{
+		in.push_back(&image[k * w * h]);
+		out.push_back(&dist[k * w * h]);
+	}
+
+	DistanceTransform(in.data(), w, h, d, spacing, [](unsigned char v) { return v != 0; }, out.data());
+
+	for (size_t i = 0; i < image.size(); ++i)
+	{
+		double best = 1e30;
+		for (size_t j = 0; j < image.size(); ++j)
+		{
+			if (image[j] == 0)
+				continue;
+			double dx = spacing[0] * (double(i % w) - double(j % w));
+			double dy = spacing[1] * (double(i / w % h) - double(j / w % h));
+			double dz = spacing[2] * (double(i / (w * h)) - double(j / (w * h)));
+			best = std::min(best, std::sqrt(dx * dx + dy * dy + dz * dz));
+		}
+		BOOST_REQUIRE_CLOSE(dist[i] + 1.0, best + 1.0, 1e-3);
+	}
+}
+
+// TestRunner.exe --run_test=iSeg_suite/DistanceTransform_suite/NoFeature_test --log_level=message
+BOOST_AUTO_TEST_CASE(NoFeature_test)
+{
+	const size_t w = 5, h = 4;
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	std::vector<float> image(w * h, 0.f);
+	std::vector<float> dist(w * h);
+	const float* in = image.data();
+	float* out = dist.data();
+
+	DistanceTransform(&in, w, h, 1, spacing, [](float v) { return v != 0.f; }, &out);
+	for (auto v : dist)
+	{
+		BOOST_CHECK_EQUAL(v, edt::Infinity());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
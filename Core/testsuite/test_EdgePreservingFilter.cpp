@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../EdgePreservingFilter.h"
+#include "TestVolume.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+using test::Pointers;
+using test::Volume;
+
+// 12 bit values, as in CT images
+Volume RandomVolume(size_t w, size_t h, size_t d, bool integral)
+{
+	return test::RandomVolume(w, h, d, -1024.f, 3071.f, 5, integral);
+}
+
+// direct sigma filter with the window clipped at the borders
+float Reference(const Volume& v, size_t w, size_t h, int x, int y, int z, float sigma, int rx, int ry, int rz)
+{
+	const float c = v[z][y * w + x];
+	double sum = 0;
+	int count = 0;
+	for (int k = std::max(z - rz, 0); k <= std::min(z + rz, static_cast<int>(v.size()) - 1); ++k)
+		for (int j = std::max(y - ry, 0); j <= std::min(y + ry, static_cast<int>(h) - 1); ++j)
+			for (int i = std::max(x - rx, 0); i <= std::min(x + rx, static_cast<int>(w) - 1); ++i)
+			{
+				const float val = v[k][j * w + i];
+				if (val < c + sigma && val > c - sigma)
+				{
+					sum += val;
+					++count;
+				}
+			}
+	return static_cast<float>(sum / count);
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(EdgePreservingFilter_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/EdgePreservingFilter_suite --log_level=message
+BOOST_AUTO_TEST_CASE(SigmaFilterSlice)
+{
+	const size_t w = 37, h = 29;
+	Volume image = RandomVolume(w, h, 1, true);
+	Volume result(1, std::vector<float>(w * h));
+	auto in = Pointers(image), out = Pointers(result);
+
+	for (float sigma : {0.5f, 40.f, 300.5f, 5000.f})
+	{
+		SigmaFilter(in.data(), out.data(), w, h, 1, sigma, 7, 5, 1);
+		for (int y = 0; y < static_cast<int>(h); ++y)
+			for (int x = 0; x < static_cast<int>(w); ++x)
+				BOOST_REQUIRE_CLOSE(result[0][y * w + x], Reference(image, w, h, x, y, 0, sigma, 3, 2, 0), 1e-4);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(SigmaFilterVolume)
+{
+	// window larger than the image along x
+	const size_t w = 6, h = 11, d = 9;
+	Volume image = RandomVolume(w, h, d, true);
+	Volume result(d, std::vector<float>(w * h));
+	auto in = Pointers(image), out = Pointers(result);
+
+	SigmaFilter(in.data(), out.data(), w, h, d, 700.f, 15, 3, 5);
+	for (int z = 0; z < static_cast<int>(d); ++z)
+		for (int y = 0; y < static_cast<int>(h); ++y)
+			for (int x = 0; x < static_cast<int>(w); ++x)
+				BOOST_REQUIRE_CLOSE(result[z][y * w + x], Reference(image, w, h, x, y, z, 700.f, 7, 1, 2), 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(SigmaFilterQuantized)
+{
+	// non-integer values are quantized, only values very close to +-sigma can be classified differently
+	const size_t w = 20, h = 20;
+	Volume image = RandomVolume(w, h, 1, false);
+	Volume result(1, std::vector<float>(w * h));
+	auto in = Pointers(image), out = Pointers(result);
+
+	SigmaFilter(in.data(), out.data(), w, h, 1, 250.f, 5, 5, 1);
+	int differences = 0;
+	for (int y = 0; y < static_cast<int>(h); ++y)
+		for (int x = 0; x < static_cast<int>(w); ++x)
+			if (std::abs(result[0][y * w + x] - Reference(image, w, h, x, y, 0, 250.f, 2, 2, 0)) > 1e-2f)
+				++differences;
+	BOOST_CHECK_LE(differences, 2);
+}
+
+BOOST_AUTO_TEST_CASE(BilateralPreservesEdges)
+{
+	// noisy step edge, the bilateral filter removes the noise but keeps the step
+	const size_t w = 40, h = 30, d = 8;
+	std::mt19937 gen(11);
+	std::normal_distribution<float> noise(0.f, 5.f);
+	Volume image(d, std::vector<float>(w * h));
+	for (size_t z = 0; z < d; ++z)
+		for (size_t i = 0; i < w * h; ++i)
+			image[z][i] = ((i % w) < w / 2 ? 0.f : 1000.f) + noise(gen);
+	Volume result(d, std::vector<float>(w * h));
+	auto in = Pointers(image), out = Pointers(result);
+
+	for (float sz : {0.f, 2.f})
+	{
+		const float sigma_space[3] = {2.f, 2.f, sz};
+		BilateralFilter(in.data(), out.data(), w, h, d, sigma_space, 30.f);
+
+		double error_in = 0, error_out = 0;
+		for (size_t z = 0; z < d; ++z)
+			for (size_t i = 0; i < w * h; ++i)
+			{
+				const float truth = (i % w) < w / 2 ? 0.f : 1000.f;
+				BOOST_REQUIRE_LT(std::abs(result[z][i] - truth), 25.f);
+				error_in += std::abs(image[z][i] - truth);
+				error_out += std::abs(result[z][i] - truth);
+			}
+		BOOST_CHECK_LT(error_out, 0.5 * error_in);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ConstantImage)
+{
+	const size_t w = 5, h = 4;
+	Volume image(1, std::vector<float>(w * h, 2.5f));
+	Volume result(1, std::vector<float>(w * h));
+	auto in = Pointers(image), out = Pointers(result);
+
+	SigmaFilter(in.data(), out.data(), w, h, 1, 1.f, 3, 3, 1);
+	for (float v : result[0])
+		BOOST_CHECK_EQUAL(v, 2.5f);
+
+	const float sigma_space[3] = {1.f, 1.f, 0.f};
+	BilateralFilter(in.data(), out.data(), w, h, 1, sigma_space, 1.f);
+	for (float v : result[0])
+		BOOST_CHECK_EQUAL(v, 2.5f);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../LabelKernels.h"
+
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+// per pixel search, as bmphandler::threshold
+std::vector<float> Search(const std::vector<float>& in, const std::vector<float>& thresholds, float leveldiff)
+{
+	std::vector<float> out(in.size());
+	for (size_t i = 0; i < in.size(); ++i)
+	{
+		unsigned short j = 0;
+		while (j < thresholds.size() && in[i] > thresholds[j])
+			j++;
+		out[i] = j * leveldiff;
+	}
+	return out;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(LabelKernels_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/LabelKernels_suite --log_level=message
+BOOST_AUTO_TEST_CASE(Threshold)
+{
+	std::mt19937 gen(3);
+	std::uniform_real_distribution<float> value(-10.f, 300.f);
+	std::vector<float> in(1000);
+	for (auto& v : in)
+		v = value(gen);
+	in[5] = 50.f; // on a threshold
+	in[6] = std::numeric_limits<float>::quiet_NaN();
+
+	const std::vector<std::vector<float>> cases = {
+			{}, {128.f}, {50.f, 100.f, 200.f}, {50.f, 50.f, 250.f}, {200.f, 50.f, 100.f}};
+	for (const auto& thresholds : cases)
+	{
+		const float leveldiff = thresholds.empty() ? 0.f : 255.f / thresholds.size();
+		std::vector<float> out(in.size(), -1.f);
+		ThresholdToLevels(in.data(), out.data(), in.size(), thresholds.data(), thresholds.size(), leveldiff);
+		const auto expected = Search(in, thresholds, leveldiff);
+		for (size_t i = 0; i < in.size(); ++i)
+			BOOST_REQUIRE_EQUAL(out[i], expected[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ComposedMap)
+{
+	typedef unsigned short T;
+	std::mt19937 gen(5);
+	std::uniform_int_distribution<int> label(0, 40);
+	std::vector<T> labels(2000);
+	for (auto& v : labels)
+		v = static_cast<T>(label(gen));
+
+	const std::vector<T> indexMap = {0, 2, 1, 4, 3};
+	const std::vector<T> olds = {7, 9, 7}, news = {8, 1, 10};
+	const std::set<T> removed = {0, 2, 8, 30};
+
+	LabelMap<T> map;
+	BOOST_CHECK(map.is_identity());
+	map.map(indexMap).group(olds, news).remove(removed).cap(20);
+	BOOST_CHECK(!map.is_identity());
+
+	std::vector<T> remapped = labels;
+	RemapLabels(remapped.data(), remapped.size(), map);
+
+	for (size_t i = 0; i < labels.size(); ++i)
+	{
+		T v = labels[i];
+		if (v < indexMap.size())
+			v = indexMap[v];
+		if (v == 7)
+			v = 10;
+		else if (v == 9)
+			v = 1;
+		if (v == 2 || v == 8 || v == 30)
+			v = 0;
+		else
+			v -= (v > 2) + (v > 8) + (v > 30);
+		if (v > 20)
+			v = 0;
+		BOOST_REQUIRE_EQUAL(remapped[i], v);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RemoveSingle)
+{
+	// as bmphandler::remove_tissue, i.e. over the full range of labels
+	LabelMap<unsigned char> map;
+	map.remove(std::set<unsigned char>{3});
+	for (int v = 0; v < 256; ++v)
+	{
+		const int expected = (v == 3) ? 0 : (v > 3 ? v - 1 : v);
+		BOOST_REQUIRE_EQUAL(map[static_cast<unsigned char>(v)], expected);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
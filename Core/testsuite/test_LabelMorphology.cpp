@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../LabelMorphology.h"
+#include "TestVolume.h"
+
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+using test::Pointers;
+
+typedef unsigned short label_type;
+
+// random blobs of labels 0..4
+std::vector<std::vector<label_type>> RandomLabels(size_t w, size_t h, size_t d)
+{
+	std::mt19937 gen(42);
+	std::vector<std::vector<label_type>> slices(d, std::vector<label_type>(w * h, 0));
+	for (int blob = 0; blob < 12; ++blob)
+	{
+		const int cx = gen() % w, cy = gen() % h, cz = gen() % d, r = 1 + gen() % 4;
+		const label_type l = static_cast<label_type>(gen() % 5);
+		for (int z = 0; z < int(d); ++z)
+			for (int y = 0; y < int(h); ++y)
+				for (int x = 0; x < int(w); ++x)
+					if ((x - cx) * (x - cx) + (y - cy) * (y - cy) + (z - cz) * (z - cz) <= r * r)
+						slices[z][y * w + x] = l;
+	}
+	return slices;
+}
+
+// erosion and dilation of a single label with a brute force ball
+std::vector<std::vector<char>> BruteForce(const std::vector<std::vector<label_type>>& slices, size_t w, size_t h,
+		const double spacing[3], double radius, label_type l, bool erode)
+{
+	const int d = static_cast<int>(slices.size());
+	std::vector<std::vector<char>> out(d, std::vector<char>(w * h, 0));
+	const int rx = int(radius / spacing[0]), ry = int(radius / spacing[1]), rz = int(radius / spacing[2]);
+	for (int z = 0; z < d; ++z)
+		for (int y = 0; y < int(h); ++y)
+			for (int x = 0; x < int(w); ++x)
+			{
+				bool all = true, any = false;
+				for (int dz = -rz; dz <= rz; ++dz)
+					for (int dy = -ry; dy <= ry; ++dy)
+						for (int dx = -rx; dx <= rx; ++dx)
+						{
+							const int qx = x + dx, qy = y + dy, qz = z + dz;
+							if (qx < 0 || qy < 0 || qz < 0 || qx >= int(w) || qy >= int(h) || qz >= d)
+								continue;
+							const double d2 = dx * dx * spacing[0] * spacing[0] + dy * dy * spacing[1] * spacing[1] +
+															dz * dz * spacing[2] * spacing[2];
+							if (static_cast<float>(d2) > static_cast<float>(radius * radius))
+								continue;
+							const bool in = slices[qz][qy * w + qx] == l;
+							all = all && in;
+							any = any || in;
+						}
+				out[z][y * w + x] = erode ? all : any;
+			}
+	return out;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(LabelMorphology_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/LabelMorphology_suite --log_level=message
+BOOST_AUTO_TEST_CASE(ErodeAllLabels)
+{
+	const size_t w = 20, h = 18, d = 9;
+	const double spacing[3] = {1.0, 0.7, 1.5};
+	const double radius = 2.1;
+	auto labels = RandomLabels(w, h, d);
+	auto result = labels;
+	auto ptrs = Pointers(result);
+
+	std::vector<char> selected = {0, 1, 1, 1, 1}, locked(5, 0);
+	LabelMorphology(ptrs.data(), w, h, d, spacing, radius, morphology::kErode, selected, locked);
+
+	for (label_type l = 1; l < 5; ++l)
+	{
+		auto expected = BruteForce(labels, w, h, spacing, radius, l, true);
+		for (size_t z = 0; z < d; ++z)
+			for (size_t i = 0; i < w * h; ++i)
+				if (labels[z][i] == l)
+					BOOST_REQUIRE_EQUAL(result[z][i] == l, expected[z][i] != 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(DilateSelectedLabel)
+{
+	const size_t w = 20, h = 18, d = 9;
+	const double spacing[3] = {1.0, 1.0, 2.0};
+	const double radius = 3.0;
+	auto labels = RandomLabels(w, h, d);
+	auto result = labels;
+	auto ptrs = Pointers(result);
+
+	// label 2 is dilated, label 3 is locked
+	std::vector<char> selected = {0, 0, 1, 0, 0}, locked = {0, 0, 0, 1, 0};
+	LabelMorphology(ptrs.data(), w, h, d, spacing, radius, morphology::kDilate, selected, locked);
+
+	auto expected = BruteForce(labels, w, h, spacing, radius, 2, false);
+	for (size_t z = 0; z < d; ++z)
+		for (size_t i = 0; i < w * h; ++i)
+		{
+			if (labels[z][i] == 3)
+				BOOST_REQUIRE_EQUAL(result[z][i], 3);
+			else
+				BOOST_REQUIRE_EQUAL(result[z][i] == 2, expected[z][i] != 0);
+		}
+}
+
+BOOST_AUTO_TEST_CASE(OpenAndClose)
+{
+	const size_t w = 20, h = 18, d = 9;
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	const double radius = 1.5;
+	auto labels = RandomLabels(w, h, d);
+	std::vector<char> selected = {0, 1, 1, 1, 1}, locked(5, 0);
+
+	// opening only removes voxels, closing only adds voxels
+	auto opened = labels;
+	auto opened_ptrs = Pointers(opened);
+	LabelMorphology(opened_ptrs.data(), w, h, d, spacing, radius, morphology::kOpen, selected, locked);
+
+	auto closed = labels;
+	auto closed_ptrs = Pointers(closed);
+	LabelMorphology(closed_ptrs.data(), w, h, d, spacing, radius, morphology::kClose, selected, locked);
+
+	// opening of a single label is the dilation of its erosion
+	for (label_type l = 1; l < 5; ++l)
+	{
+		std::vector<std::vector<label_type>> eroded(d, std::vector<label_type>(w * h));
+		auto mask = BruteForce(labels, w, h, spacing, radius, l, true);
+		for (size_t z = 0; z < d; ++z)
+			for (size_t i = 0; i < w * h; ++i)
+				eroded[z][i] = mask[z][i] ? l : 0;
+		auto expected = BruteForce(eroded, w, h, spacing, radius, l, false);
+		for (size_t z = 0; z < d; ++z)
+			for (size_t i = 0; i < w * h; ++i)
+				if (labels[z][i] == l)
+					BOOST_REQUIRE_EQUAL(opened[z][i] == l, expected[z][i] != 0);
+	}
+
+	for (size_t z = 0; z < d; ++z)
+		for (size_t i = 0; i < w * h; ++i)
+		{
+			BOOST_REQUIRE(opened[z][i] == labels[z][i] || opened[z][i] == 0);
+			BOOST_REQUIRE(closed[z][i] == labels[z][i] || labels[z][i] == 0);
+		}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../LevelSet.h"
+#include "TestVolume.h"
+
+#include <cmath>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+using test::Pointers;
+
+// level set which is positive inside a sphere, but is not a distance function
+std::vector<std::vector<float>> Sphere(size_t w, size_t h, size_t d, float r)
+{
+	std::vector<std::vector<float>> phi(d, std::vector<float>(w * h));
+	for (size_t z = 0; z < d; ++z)
+		for (size_t y = 0; y < h; ++y)
+			for (size_t x = 0; x < w; ++x)
+			{
+				const float dx = x - 0.5f * w, dy = y - 0.5f * h, dz = (d > 1) ? z - 0.5f * d : 0.f;
+				phi[z][y * w + x] = 2.f * (r - std::sqrt(dx * dx + dy * dy + dz * dz));
+			}
+	return phi;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(LevelSet_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/LevelSet_suite --log_level=message
+BOOST_AUTO_TEST_CASE(Redistancing)
+{
+	const size_t w = 32, h = 32, d = 32;
+	const float r = 10.f;
+	auto phi0 = Sphere(w, h, d, r);
+	auto phi0_ptrs = Pointers(phi0);
+
+	NarrowBandLevelSet levelset;
+	levelset.Init(w, h, d, phi0_ptrs.data());
+
+	// only voxels close to the surface are in the band
+	BOOST_CHECK(levelset.Band().size() < w * h * d / 4);
+
+	for (size_t idx : levelset.Band())
+	{
+		const size_t z = idx / (w * h), i = idx % (w * h);
+		const float exact = phi0[z][i] / 2.f;
+		BOOST_REQUIRE_SMALL(levelset.Value(z, i) - exact, 0.6f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BalloonForce)
+{
+	const size_t w = 64, h = 64;
+	const float r = 8.f;
+	auto phi0 = Sphere(w, h, 1, r);
+	auto phi0_ptrs = Pointers(phi0);
+
+	std::vector<std::vector<float>> k(1, std::vector<float>(w * h, 1.f)), P(1, std::vector<float>(w * h, 0.f));
+	auto k_ptrs = Pointers(k);
+	auto P_ptrs = Pointers(P);
+
+	NarrowBandLevelSet levelset;
+	levelset.Init(w, h, 1, phi0_ptrs.data());
+	levelset.SetSpeed(k_ptrs.data());
+	levelset.SetPotential(P_ptrs.data());
+	levelset.SetParameters(1.f, 0.f, 0.25f);
+	levelset.Iterate(40, 0);
+
+	// the circle grows by 40 * 0.25 = 10 pixels
+	std::vector<float> phi(w * h);
+	float* phi_ptr = phi.data();
+	levelset.GetLevelSet(&phi_ptr);
+	size_t inside = 0;
+	for (float v : phi)
+		inside += (v > 0) ? 1 : 0;
+	const float expected = 3.14159f * (r + 10.f) * (r + 10.f);
+	BOOST_CHECK_CLOSE(static_cast<float>(inside), expected, 5.f);
+}
+
+BOOST_AUTO_TEST_CASE(Shrink3D)
+{
+	const size_t w = 24, h = 24, d = 24;
+	const float r = 9.f;
+	auto phi0 = Sphere(w, h, d, r);
+	auto phi0_ptrs = Pointers(phi0);
+
+	std::vector<std::vector<float>> k(d, std::vector<float>(w * h, 1.f)), P(d, std::vector<float>(w * h, 0.f));
+	auto k_ptrs = Pointers(k);
+	auto P_ptrs = Pointers(P);
+
+	NarrowBandLevelSet levelset;
+	levelset.Init(w, h, d, phi0_ptrs.data());
+	levelset.SetSpeed(k_ptrs.data());
+	levelset.SetPotential(P_ptrs.data());
+	levelset.SetParameters(-1.f, 0.f, 0.25f);
+	levelset.Iterate(16, 5);
+
+	// the sphere shrinks by 16 * 0.25 = 4 voxels
+	size_t inside = 0;
+	for (size_t z = 0; z < d; ++z)
+		for (size_t i = 0; i < w * h; ++i)
+			inside += (levelset.Value(z, i) > 0) ? 1 : 0;
+	const float expected = 4.f / 3.f * 3.14159f * (r - 4.f) * (r - 4.f) * (r - 4.f);
+	BOOST_CHECK_CLOSE(static_cast<float>(inside), expected, 10.f);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../MajorityPooling.h"
+
+#include <map>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+// most frequent label of each block, counted with a map
+std::vector<unsigned short> Reference(const std::vector<unsigned short>& in, const int dims[3], int factor)
+{
+	int out_dims[3];
+	MajorityPoolingSize(dims, factor, out_dims);
+	std::vector<unsigned short> out;
+	for (int k = 0; k < out_dims[2]; ++k)
+		for (int j = 0; j < out_dims[1]; ++j)
+			for (int i = 0; i < out_dims[0]; ++i)
+			{
+				std::map<unsigned short, int> count;
+				for (int z = k * factor; z < std::min((k + 1) * factor, dims[2]); ++z)
+					for (int y = j * factor; y < std::min((j + 1) * factor, dims[1]); ++y)
+						for (int x = i * factor; x < std::min((i + 1) * factor, dims[0]); ++x)
+							count[in[(z * dims[1] + y) * dims[0] + x]]++;
+
+				// the smallest foreground label with the highest count, background only if strictly more frequent
+				unsigned short best = 0;
+				int best_count = 0;
+				for (const auto& c : count)
+				{
+					if (c.first != 0 && c.second > best_count)
+					{
+						best = c.first;
+						best_count = c.second;
+					}
+				}
+				if (count[0] > best_count)
+					best = 0;
+				out.push_back(best);
+			}
+	return out;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(MajorityPooling_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/MajorityPooling_suite/Size --log_level=message
+BOOST_AUTO_TEST_CASE(Size)
+{
+	const int dims[3] = {5, 4, 1};
+	int out_dims[3];
+	MajorityPoolingSize(dims, 2, out_dims);
+	BOOST_CHECK_EQUAL(out_dims[0], 3);
+	BOOST_CHECK_EQUAL(out_dims[1], 2);
+	BOOST_CHECK_EQUAL(out_dims[2], 1);
+
+	MajorityPoolingSize(dims, 1, out_dims);
+	BOOST_CHECK_EQUAL(out_dims[0], 5);
+	BOOST_CHECK_EQUAL(out_dims[1], 4);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/MajorityPooling_suite/Ties --log_level=message
+BOOST_AUTO_TEST_CASE(Ties)
+{
+	// 2x2x1 blocks of a 6x2x1 image
+	const int dims[3] = {6, 2, 1};
+	const std::vector<unsigned char> in = {
+			0, 3, /**/ 0, 0, /**/ 5, 2,
+			3, 0, /**/ 0, 4, /**/ 2, 5};
+	std::vector<unsigned char> out(3);
+	MajorityPooling(in.data(), dims, 2, out.data());
+
+	// a tie with the background keeps the foreground label
+	BOOST_CHECK_EQUAL(out[0], 3);
+	// the background wins if it is strictly more frequent
+	BOOST_CHECK_EQUAL(out[1], 0);
+	// between foreground labels the smaller one wins
+	BOOST_CHECK_EQUAL(out[2], 2);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/MajorityPooling_suite/PartialBlocks --log_level=message
+BOOST_AUTO_TEST_CASE(PartialBlocks)
+{
+	// the last block in x, y and z only has one voxel in that direction
+	const int dims[3] = {3, 3, 3};
+	std::vector<unsigned short> in(27, 1);
+	in[(2 * 3 + 2) * 3 + 2] = 7;
+	in[(2 * 3 + 2) * 3 + 0] = 6;
+	std::vector<unsigned short> out(8, 99);
+	MajorityPooling(in.data(), dims, 2, out.data());
+
+	BOOST_CHECK_EQUAL(out[0], 1);
+	// single voxel block
+	BOOST_CHECK_EQUAL(out[7], 7);
+	// 2x1x1 block with 6 and 1
+	BOOST_CHECK_EQUAL(out[6], 1);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/MajorityPooling_suite/RandomLabels --log_level=message
+BOOST_AUTO_TEST_CASE(RandomLabels)
+{
+	const int dims[3] = {17, 11, 9};
+	std::mt19937 gen(13);
+	std::uniform_int_distribution<int> label(0, 4);
+	std::vector<unsigned short> in(dims[0] * dims[1] * dims[2]);
+	for (auto& v : in)
+		v = static_cast<unsigned short>(label(gen));
+
+	for (int factor = 1; factor <= 4; ++factor)
+	{
+		int out_dims[3];
+		MajorityPoolingSize(dims, factor, out_dims);
+		std::vector<unsigned short> out(out_dims[0] * out_dims[1] * out_dims[2]);
+		MajorityPooling(in.data(), dims, factor, out.data());
+		BOOST_CHECK(out == Reference(in, dims, factor));
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
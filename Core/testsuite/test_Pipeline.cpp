@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../Pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace iseg {
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(Pipeline_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/Pipeline_suite --log_level=message
+BOOST_AUTO_TEST_CASE(OrderAndBound)
+{
+	const int n = 1000, capacity = 3;
+	std::atomic<int> produced(0);
+	std::vector<int> consumed;
+	int max_ahead = 0;
+
+	RunPipeline<std::vector<int>>(capacity,
+			[&](BoundedQueue<std::vector<int>>& queue) {
+				for (int i = 0; i < n; ++i)
+				{
+					++produced;
+					if (!queue.Push(std::vector<int>(1 + i % 5, i)))
+						break;
+				}
+			},
+			[&](const std::vector<int>& item) {
+				consumed.push_back(item.front());
+				// the one being consumed, the queued ones and the one waiting in Push
+				max_ahead = std::max(max_ahead, produced.load() - static_cast<int>(consumed.size()));
+			});
+
+	BOOST_REQUIRE_EQUAL(consumed.size(), n);
+	for (int i = 0; i < n; ++i)
+		BOOST_REQUIRE_EQUAL(consumed[i], i);
+	BOOST_CHECK_LE(max_ahead, capacity + 1);
+}
+
+BOOST_AUTO_TEST_CASE(ProducerThrows)
+{
+	int consumed = 0;
+	BOOST_CHECK_THROW(RunPipeline<int>(2,
+												[](BoundedQueue<int>& queue) {
+													queue.Push(1);
+													queue.Push(2);
+													throw std::runtime_error("trace failed");
+												},
+												[&](int) { ++consumed; }),
+			std::runtime_error);
+	BOOST_CHECK_EQUAL(consumed, 2);
+}
+
+BOOST_AUTO_TEST_CASE(ConsumerThrows)
+{
+	// the producer is stopped by the closed queue instead of blocking forever
+	bool stopped = false;
+	BOOST_CHECK_THROW(RunPipeline<int>(1,
+												[&](BoundedQueue<int>& queue) {
+													for (int i = 0; i < 100000; ++i)
+													{
+														if (!queue.Push(i))
+														{
+															stopped = true;
+															return;
+														}
+													}
+												},
+												[](int i) {
+													if (i == 10)
+														throw std::runtime_error("disk full");
+												}),
+			std::runtime_error);
+	BOOST_CHECK(stopped);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../ShapeInterpolation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+typedef std::vector<unsigned short> Slice;
+
+Slice Disk(int w, int h, int cx, int cy, int r, unsigned short label, Slice s = Slice())
+{
+	if (s.empty())
+		s.assign(w * h, 0);
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+			if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= r * r)
+				s[y * w + x] = label;
+	return s;
+}
+
+// signed distance to the boundary pixels of label, by brute force
+std::vector<float> SignedDistance(const Slice& s, int w, int h, unsigned short label)
+{
+	auto inside = [&](int x, int y) { return x >= 0 && y >= 0 && x < w && y < h && s[y * w + x] == label; };
+	std::vector<int> boundary;
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+			if (inside(x, y) && !(inside(x - 1, y) && inside(x + 1, y) && inside(x, y - 1) && inside(x, y + 1)))
+				boundary.push_back(y * w + x);
+
+	std::vector<float> d(w * h, static_cast<float>(w + h));
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x)
+		{
+			if (!boundary.empty())
+			{
+				int best = w * w + h * h;
+				for (int b : boundary)
+				{
+					const int dx = b % w - x, dy = b / w - y;
+					best = std::min(best, dx * dx + dy * dy);
+				}
+				d[y * w + x] = std::sqrt(static_cast<float>(best));
+			}
+			if (!inside(x, y))
+				d[y * w + x] = -d[y * w + x];
+		}
+	return d;
+}
+
+struct Collect
+{
+	Collect(std::vector<Slice>& out, const std::vector<unsigned short>& labels) : out(out), labels(labels) {}
+	void operator()(size_t j, size_t i, int k) const { out[j][i] = (k < 0) ? 0 : labels[k]; }
+	std::vector<Slice>& out;
+	const std::vector<unsigned short>& labels;
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(ShapeInterpolation_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/ShapeInterpolation_suite --log_level=message
+BOOST_AUTO_TEST_CASE(SingleLabel)
+{
+	const int w = 31, h = 23, n = 4;
+	std::mt19937 gen(13);
+	std::bernoulli_distribution coin(0.3);
+	Slice lower = Disk(w, h, 10, 10, 6, 3), upper(w * h, 0);
+	for (auto& v : upper)
+		v = coin(gen) ? 3 : 0;
+	upper = Disk(w, h, 20, 12, 5, 3, upper);
+
+	const std::vector<unsigned short> labels = {3};
+	std::vector<Slice> result(n, Slice(w * h, 99));
+	ShapeInterpolation<unsigned short> interpolation(w, h, labels);
+	interpolation.Interpolate(lower.data(), upper.data(), n, Collect(result, labels));
+
+	const auto d1 = SignedDistance(lower, w, h, 3), d2 = SignedDistance(upper, w, h, 3);
+	for (int j = 0; j < n; ++j)
+		for (int i = 0; i < w * h; ++i)
+		{
+			const float t = (j + 1.f) / (n + 1);
+			const unsigned short expected = ((1.f - t) * d1[i] + t * d2[i] >= 0.f) ? 3 : 0;
+			BOOST_REQUIRE_EQUAL(result[j][i], expected);
+		}
+}
+
+BOOST_AUTO_TEST_CASE(GrowingDisk)
+{
+	const int w = 40, h = 40, n = 5;
+	const std::vector<unsigned short> labels = {1};
+	Slice lower = Disk(w, h, 20, 20, 4, 1), upper = Disk(w, h, 20, 20, 14, 1);
+	std::vector<Slice> result(n, Slice(w * h));
+	ShapeInterpolation<unsigned short> interpolation(w, h, labels);
+	interpolation.Interpolate(lower.data(), upper.data(), n, Collect(result, labels));
+
+	int previous = 0;
+	for (int j = 0; j < n; ++j)
+	{
+		int area = 0;
+		for (auto v : result[j])
+			area += (v == 1);
+		BOOST_CHECK_EQUAL(result[j][20 * w + 20], 1);
+		BOOST_CHECK_GT(area, previous);
+		previous = area;
+	}
+	BOOST_CHECK_LT(previous, 3.15 * 14 * 14);
+}
+
+BOOST_AUTO_TEST_CASE(LabelsAndCachedKeys)
+{
+	// two labels, interpolated over two consecutive gaps, the maps of the middle key slice are reused
+	const int w = 30, h = 20, n = 3;
+	const std::vector<unsigned short> labels = {1, 2};
+	const Slice a = Disk(w, h, 8, 10, 5, 2, Disk(w, h, 20, 10, 6, 1));
+	const Slice b = Disk(w, h, 10, 10, 7, 2, Disk(w, h, 21, 10, 4, 1));
+	const Slice c = Disk(w, h, 12, 8, 4, 2);
+
+	std::vector<Slice> ab(n, Slice(w * h)), bc(n, Slice(w * h)), fresh(n, Slice(w * h));
+	ShapeInterpolation<unsigned short> interpolation(w, h, labels);
+	interpolation.Interpolate(a.data(), b.data(), n, Collect(ab, labels));
+	interpolation.Interpolate(b.data(), c.data(), n, Collect(bc, labels));
+
+	ShapeInterpolation<unsigned short> other(w, h, labels);
+	other.Interpolate(b.data(), c.data(), n, Collect(fresh, labels));
+	BOOST_CHECK(bc == fresh);
+
+	// label 1 vanishes towards c, the centers keep their labels in between a and b
+	for (int j = 0; j < n; ++j)
+	{
+		BOOST_CHECK_EQUAL(ab[j][10 * w + 9], 2);
+		BOOST_CHECK_EQUAL(ab[j][10 * w + 20], 1);
+		BOOST_CHECK_EQUAL(ab[j][0], 0);
+	}
+	for (auto v : bc[n - 1])
+		BOOST_REQUIRE_NE(v, 1);
+}
+
+BOOST_AUTO_TEST_CASE(NearestValue)
+{
+	const int w = 8, h = 6, n = 3;
+	const Slice lower(w * h, 1), upper(w * h, 2);
+	std::vector<Slice> result(n, Slice(w * h));
+	NearestValueInterpolation(lower.data(), upper.data(), w, h, n, [&](size_t j, size_t i, bool from_upper) {
+		result[j][i] = from_upper ? upper[i] : lower[i];
+	});
+	// no change of value in either key slice, i.e. half of the slices from each
+	for (int i = 0; i < w * h; ++i)
+	{
+		BOOST_CHECK_EQUAL(result[0][i], 1);
+		BOOST_CHECK_EQUAL(result[1][i], 1);
+		BOOST_CHECK_EQUAL(result[2][i], 2);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../SliceHistogramCache.h"
+#include "TestVolume.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+using test::Volume;
+
+Volume RandomVolume(size_t area, size_t nrslices)
+{
+	return test::RandomVolume(area, 1, nrslices, -20.f, 280.f, 7);
+}
+
+struct SliceValues
+{
+	SliceValues(const Volume& v) : v(v) {}
+	const float* operator()(size_t slice) const { return v[slice].data(); }
+	const Volume& v;
+};
+
+// 256 bins of width 1 over [0, 256), as bmphandler::make_histogram
+Histogram Direct(const Volume& v, size_t first, size_t last)
+{
+	Histogram h(256);
+	for (size_t s = first; s < last; ++s)
+		for (float x : v[s])
+		{
+			if (x < 0)
+				h.below++;
+			else if (x >= 256)
+				h.above++;
+			else
+				h.counts[static_cast<int>(x)]++;
+		}
+	return h;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(SliceHistogramCache_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/SliceHistogramCache_suite --log_level=message
+BOOST_AUTO_TEST_CASE(Binning)
+{
+	HistogramBinning b(4096, 0.f, 256.f);
+	BOOST_CHECK_EQUAL(b.bin(0.f), 0);
+	BOOST_CHECK_EQUAL(b.bin(1.f / 16), 1);
+	BOOST_CHECK_EQUAL(b.bin(255.99f), 4095);
+	BOOST_CHECK_EQUAL(b.bin(256.f), 4096);
+	BOOST_CHECK_EQUAL(b.bin(-0.001f), -1);
+	BOOST_CHECK_EQUAL(b.bin(std::numeric_limits<float>::quiet_NaN()), -1);
+
+	HistogramBinning c(10, -1.f, 1.f);
+	BOOST_CHECK_EQUAL(c.bin(-1.f), 0);
+	BOOST_CHECK_EQUAL(c.bin(0.f), 5);
+	BOOST_CHECK_EQUAL(c.bin(0.999999f), 9);
+}
+
+BOOST_AUTO_TEST_CASE(CoarsenedMatchesDirect)
+{
+	const size_t area = 500, n = 12;
+	Volume v = RandomVolume(area, n);
+
+	SliceHistogramCache cache;
+	cache.resize(n);
+	cache.update(0, n, area, SliceValues(v));
+
+	for (size_t first : {0, 3})
+	{
+		const Histogram h = cache.total(first, n).coarsened(16);
+		const Histogram d = Direct(v, first, n);
+		BOOST_CHECK(h.counts == d.counts);
+		BOOST_CHECK_EQUAL(h.below, d.below);
+		BOOST_CHECK_EQUAL(h.above, d.above);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalUpdate)
+{
+	const size_t area = 300, n = 6;
+	Volume v = RandomVolume(area, n);
+
+	SliceHistogramCache cache(HistogramBinning(256, 0.f, 256.f));
+	cache.resize(n);
+	cache.update(0, n, area, SliceValues(v));
+
+	// changed slice is ignored until it is invalidated
+	for (auto& x : v[2])
+		x = 7.5f;
+	cache.update(0, n, area, SliceValues(v));
+	BOOST_CHECK(cache.total(0, n).counts != Direct(v, 0, n).counts);
+
+	cache.invalidate(2);
+	BOOST_CHECK(!cache.is_valid(2));
+	BOOST_CHECK(cache.is_valid(3));
+	cache.update(0, n, area, SliceValues(v));
+	BOOST_CHECK(cache.total(0, n).counts == Direct(v, 0, n).counts);
+	BOOST_CHECK_EQUAL(cache.total(2, 3).counts[7], area);
+}
+
+BOOST_AUTO_TEST_CASE(RectangleAndMask)
+{
+	const size_t w = 20, h = 15;
+	Volume v = RandomVolume(w * h, 1);
+	const HistogramBinning binning(64, 0.f, 256.f);
+
+	Histogram roi(binning.nrbins), masked(binning.nrbins);
+	AccumulateHistogram(v[0].data(), w, 3, 4, 11, 9, binning, roi);
+	AccumulateHistogram(v[0].data(), w * h, [&](size_t i) { return i % w >= 3 && i % w < 11 && i / w >= 4 && i / w < 9; },
+			binning, masked);
+
+	BOOST_CHECK(roi.counts == masked.counts);
+	BOOST_CHECK_EQUAL(roi.below, masked.below);
+	BOOST_CHECK_EQUAL(roi.above, masked.above);
+
+	size_t total = roi.below + roi.above;
+	for (size_t c : roi.counts)
+		total += c;
+	BOOST_CHECK_EQUAL(total, 8 * 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
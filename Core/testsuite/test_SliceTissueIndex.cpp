@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../SliceTissueIndex.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+typedef unsigned short T;
+typedef std::vector<std::vector<T>> Volume;
+
+// sparse random labels on a background of 0, in blobs to get runs
+Volume RandomVolume(unsigned short w, unsigned short h, size_t nrslices)
+{
+	std::mt19937 gen(11);
+	std::uniform_int_distribution<int> label(1, 30), pos(0, w * h - 1), len(1, 6);
+	Volume v(nrslices, std::vector<T>(w * h, 0));
+	for (auto& slice : v)
+		for (int k = 0; k < 15; ++k)
+		{
+			const T l = static_cast<T>(label(gen));
+			for (int p = pos(gen), n = len(gen); n > 0 && p < w * h; --n, ++p)
+				slice[p] = l;
+		}
+	return v;
+}
+
+struct SliceLabels
+{
+	SliceLabels(const Volume& v) : v(v) {}
+	const T* operator()(size_t slice) const { return v[slice].data(); }
+	const Volume& v;
+};
+
+// brute force, as SlicesHandler::get_extent
+bool DirectExtent(const Volume& v, unsigned short w, size_t first, size_t last, T label, unsigned short extent[3][2], size_t& count)
+{
+	bool found = false;
+	count = 0;
+	for (size_t s = first; s < last; ++s)
+		for (size_t i = 0; i < v[s].size(); ++i)
+		{
+			if (v[s][i] != label)
+				continue;
+			const unsigned short x = i % w, y = i / w, z = static_cast<unsigned short>(s);
+			if (!found)
+			{
+				extent[0][0] = extent[0][1] = x;
+				extent[1][0] = extent[1][1] = y;
+				extent[2][0] = extent[2][1] = z;
+				found = true;
+			}
+			extent[0][0] = std::min(extent[0][0], x);
+			extent[0][1] = std::max(extent[0][1], x);
+			extent[1][0] = std::min(extent[1][0], y);
+			extent[1][1] = std::max(extent[1][1], y);
+			extent[2][1] = z;
+			count++;
+		}
+	return found;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(SliceTissueIndex_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/SliceTissueIndex_suite --log_level=message
+BOOST_AUTO_TEST_CASE(MatchesScan)
+{
+	const unsigned short w = 23, h = 17;
+	const size_t n = 9;
+	Volume v = RandomVolume(w, h, n);
+
+	SliceTissueIndex<T> index;
+	index.resize(n);
+	index.update(0, n, w, h, SliceLabels(v));
+
+	for (T label = 0; label <= 32; ++label)
+	{
+		for (size_t first : {0, 4})
+		{
+			unsigned short expected[3][2], extent[3][2];
+			size_t count;
+			const bool found = DirectExtent(v, w, first, n, label, expected, count);
+			BOOST_REQUIRE_EQUAL(index.extent(first, n, label, extent), found);
+			BOOST_REQUIRE_EQUAL(index.count(first, n, label), count);
+			if (found)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					BOOST_CHECK_EQUAL(extent[k][0], expected[k][0]);
+					BOOST_CHECK_EQUAL(extent[k][1], expected[k][1]);
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> is_used(32, 0);
+	index.mark_used(0, n, is_used);
+	for (T label = 0; label < 32; ++label)
+	{
+		size_t count;
+		unsigned short extent[3][2];
+		BOOST_CHECK_EQUAL(is_used[label] != 0, DirectExtent(v, w, 0, n, label, extent, count));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalUpdate)
+{
+	const unsigned short w = 10, h = 8;
+	const size_t n = 4;
+	Volume v(n, std::vector<T>(w * h, 0));
+	v[1][3 * w + 2] = 5;
+
+	SliceTissueIndex<T> index;
+	index.resize(n);
+	index.update(0, n, w, h, SliceLabels(v));
+	BOOST_REQUIRE(index.find(1, 5) != nullptr);
+	BOOST_CHECK(index.find(2, 5) == nullptr);
+	BOOST_CHECK_EQUAL(index[0].size(), 1);
+
+	// changed slice is ignored until it is invalidated
+	v[1][3 * w + 2] = 0;
+	v[2].assign(w * h, 5);
+	index.update(0, n, w, h, SliceLabels(v));
+	BOOST_CHECK(index.find(1, 5) != nullptr);
+
+	index.invalidate(1);
+	index.invalidate(2);
+	BOOST_CHECK(!index.is_valid(1));
+	BOOST_CHECK(index.is_valid(3));
+	index.update(0, n, w, h, SliceLabels(v));
+	BOOST_CHECK(index.find(1, 5) == nullptr);
+	BOOST_CHECK(index.find(2, 0) == nullptr);
+	BOOST_REQUIRE(index.find(2, 5) != nullptr);
+	BOOST_CHECK_EQUAL(index.find(2, 5)->count, w * h);
+	BOOST_CHECK_EQUAL(index.find(2, 5)->extent[0][1], w - 1);
+	BOOST_CHECK_EQUAL(index.find(2, 5)->extent[1][1], h - 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
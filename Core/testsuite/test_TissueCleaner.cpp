@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../TissueCleaner.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+const unsigned short w = 6, h = 5, d = 20;
+
+struct Volume
+{
+	std::vector<std::vector<tissues_size_t>> slices;
+	std::vector<tissues_size_t*> pointers;
+
+	Volume() : slices(d, std::vector<tissues_size_t>(w * h, 0))
+	{
+		for (auto& s : slices)
+			pointers.push_back(s.data());
+	}
+
+	tissues_size_t& at(size_t x, size_t y, size_t z) { return slices[z][y * w + x]; }
+};
+
+// tissue 1: a column through all slabs and a single voxel island
+// tissue 2: a single small component, kept because of the ratio
+// tissue 3: two small components, locked
+void Fill(Volume& v)
+{
+	for (size_t z = 0; z < d; z++)
+		v.at(1, 1, z) = 1;
+	v.at(4, 3, 10) = 1;
+	v.at(3, 0, 3) = v.at(4, 0, 3) = v.at(3, 0, 4) = v.at(4, 0, 4) = 2;
+	v.at(0, 4, 7) = 3;
+	v.at(5, 4, 12) = 3;
+}
+
+const TissueCleaner::Report* Find(const std::vector<TissueCleaner::Report>& report, tissues_size_t tissue)
+{
+	for (const auto& r : report)
+	{
+		if (r.tissue == tissue)
+			return &r;
+	}
+	return nullptr;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(TissueCleaner_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/TissueCleaner_suite/RemoveIslands --log_level=message
+BOOST_AUTO_TEST_CASE(RemoveIslands)
+{
+	Volume v;
+	Fill(v);
+
+	TissueCleaner tc(v.pointers.data(), d, w, h);
+	std::vector<char> locked(4, 0);
+	locked[3] = 1;
+	tc.SetLockedTissues(locked);
+	tc.ConnectedComponents();
+
+	const auto report = tc.DryRun(1.0f, 5);
+	BOOST_REQUIRE(Find(report, 1));
+	BOOST_CHECK_EQUAL(Find(report, 1)->components, 2);
+	BOOST_CHECK_EQUAL(Find(report, 1)->removed_components, 1);
+	BOOST_CHECK_EQUAL(Find(report, 1)->removed_voxels, 1);
+	BOOST_REQUIRE(Find(report, 2));
+	BOOST_CHECK_EQUAL(Find(report, 2)->removed_components, 0);
+	BOOST_REQUIRE(Find(report, 3));
+	BOOST_CHECK_EQUAL(Find(report, 3)->components, 2);
+	BOOST_CHECK_EQUAL(Find(report, 3)->removed_components, 0);
+
+	// the dry run does not modify the slices
+	BOOST_CHECK_EQUAL(v.at(4, 3, 10), 1);
+
+	tc.Clean(1.0f, 5);
+	BOOST_CHECK_EQUAL(v.at(4, 3, 10), 0);
+	for (size_t z = 0; z < d; z++)
+		BOOST_CHECK_EQUAL(v.at(1, 1, z), 1);
+	BOOST_CHECK_EQUAL(v.at(3, 0, 3), 2);
+	BOOST_CHECK_EQUAL(v.at(0, 4, 7), 3);
+
+	const auto& fingerprints = tc.Fingerprints();
+	BOOST_REQUIRE_EQUAL(fingerprints.size(), 4);
+	BOOST_CHECK_EQUAL(fingerprints[1].count, d);
+	BOOST_CHECK_EQUAL(fingerprints[2].count, 4);
+	BOOST_CHECK_EQUAL(fingerprints[0].count + fingerprints[1].count + fingerprints[2].count + fingerprints[3].count, w * h * d);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/TissueCleaner_suite/ChangedTissuesOnly --log_level=message
+BOOST_AUTO_TEST_CASE(ChangedTissuesOnly)
+{
+	Volume v;
+	Fill(v);
+
+	TissueCleaner first(v.pointers.data(), d, w, h);
+	first.ConnectedComponents();
+	first.Clean(1.0f, 4);
+
+	// nothing changed, nothing is selected
+	TissueCleaner unchanged(v.pointers.data(), d, w, h);
+	unchanged.SetPreviousFingerprints(first.Fingerprints());
+	unchanged.ConnectedComponents();
+	BOOST_CHECK(unchanged.DryRun(1.0f, 4).empty());
+
+	// a new island of tissue 2
+	v.at(0, 3, 17) = 2;
+	TissueCleaner changed(v.pointers.data(), d, w, h);
+	changed.SetPreviousFingerprints(first.Fingerprints());
+	changed.ConnectedComponents();
+	const auto report = changed.DryRun(1.0f, 4);
+	BOOST_CHECK(!Find(report, 1));
+	BOOST_CHECK(!Find(report, 3));
+	BOOST_REQUIRE(Find(report, 2));
+	BOOST_CHECK_EQUAL(Find(report, 2)->components, 2);
+	BOOST_CHECK_EQUAL(Find(report, 2)->removed_components, 1);
+
+	changed.Clean(1.0f, 4);
+	BOOST_CHECK_EQUAL(v.at(0, 3, 17), 0);
+	BOOST_CHECK(changed.Fingerprints()[2] == first.Fingerprints()[2]);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/TissueCleaner_suite/RemovedRow --log_level=message
+BOOST_AUTO_TEST_CASE(RemovedRow)
+{
+	// the first row of slice 0 is a removed island, the second row is 0 except for the column of tissue 1
+	Volume v;
+	Fill(v);
+	for (size_t x = 0; x < w; x++)
+		v.at(x, 0, 0) = 4;
+	for (size_t z = 15; z < 17; z++)
+		v.at(3, 3, z) = v.at(4, 3, z) = v.at(3, 4, z) = v.at(4, 4, z) = 4;
+
+	TissueCleaner tc(v.pointers.data(), d, w, h);
+	tc.ConnectedComponents();
+	tc.Clean(1.0f, 7);
+
+	// the run of the removed row gets the tissue of the row below at its first voxel
+	for (size_t x = 0; x < w; x++)
+		BOOST_CHECK_EQUAL(v.at(x, 0, 0), 0);
+	BOOST_CHECK_EQUAL(v.at(3, 3, 15), 4);
+	BOOST_CHECK_EQUAL(tc.Fingerprints()[4].count, 8);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
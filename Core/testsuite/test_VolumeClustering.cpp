@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../VolumeClustering.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+// slices with nrclasses intensity classes (in each of dim channels), the class of a voxel depends on z and y
+struct TestVolume
+{
+	TestVolume(size_t w, size_t h, size_t d, int dim, int nrclasses) : area(w * h)
+	{
+		std::mt19937 gen(7);
+		std::normal_distribution<float> noise(0.f, 3.f);
+		channels.assign(d, std::vector<std::vector<float>>(dim, std::vector<float>(area)));
+		classes.assign(d, std::vector<int>(area));
+		for (size_t z = 0; z < d; ++z)
+			for (size_t i = 0; i < area; ++i)
+			{
+				const int c = static_cast<int>((i / w + z) % nrclasses);
+				classes[z][i] = c;
+				for (int n = 0; n < dim; ++n)
+					channels[z][n][i] = 100.f * (c + 1) + 10.f * n + noise(gen);
+			}
+	}
+
+	std::vector<const float*> Slice(size_t z) const
+	{
+		std::vector<const float*> p;
+		for (auto& c : channels[z])
+			p.push_back(c.data());
+		return p;
+	}
+
+	size_t area;
+	std::vector<std::vector<std::vector<float>>> channels;
+	std::vector<std::vector<int>> classes;
+};
+
+// classes are recovered up to a permutation, i.e. the mapping class -> result is one-to-one
+template<typename TClassifier>
+void CheckClassification(const TClassifier& classifier, const TestVolume& volume, int nrclasses)
+{
+	std::vector<float> result(volume.area);
+	std::vector<int> mapping(nrclasses, -1);
+	for (size_t z = 0; z < volume.classes.size(); ++z)
+	{
+		classifier.Classify(volume.Slice(z).data(), volume.area, result.data());
+		for (size_t i = 0; i < volume.area; ++i)
+		{
+			const int c = volume.classes[z][i];
+			const int r = static_cast<int>(result[i] + 0.5f);
+			if (mapping[c] < 0)
+				mapping[c] = r;
+			BOOST_REQUIRE_EQUAL(mapping[c], r);
+		}
+	}
+	std::sort(mapping.begin(), mapping.end());
+	BOOST_CHECK(std::unique(mapping.begin(), mapping.end()) == mapping.end());
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(VolumeClustering_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/VolumeClustering_suite --log_level=message
+BOOST_AUTO_TEST_CASE(KMeansChannels)
+{
+	// fixed size kernels and the generic kernel (5 channels)
+	for (int dim : {1, 2, 3, 5})
+	{
+		const int nrclasses = 3;
+		TestVolume volume(16, 12, 6, dim, nrclasses);
+		const std::vector<float> weights(dim, 1.f);
+
+		VoxelSample sample(dim);
+		for (size_t z = 0; z < 6; ++z)
+			sample.Add(volume.Slice(z).data(), volume.area, volume.area / 3);
+		BOOST_CHECK_EQUAL(sample.Size(), 6 * (volume.area / 3));
+
+		VolumeKMeans kmeans(nrclasses, dim, weights.data());
+		kmeans.InitCenters(sample);
+		kmeans.Train(sample, 20, 0, 64);
+		CheckClassification(kmeans, volume, nrclasses);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(KMeansCenters)
+{
+	// the class of a voxel is the nearest center
+	const float weights[2] = {1.f, 4.f};
+	const float centers[6] = {0.f, 0.f, 10.f, 0.f, 0.f, 10.f};
+	VolumeKMeans kmeans(3, 2, weights);
+	kmeans.SetCenters(centers);
+
+	const float x[4] = {1.f, 6.f, 0.f, 9.f}, y[4] = {1.f, 2.f, 6.f, 3.f};
+	const float* channels[2] = {x, y};
+	float result[4];
+	kmeans.Classify(channels, 4, result);
+	BOOST_CHECK_EQUAL(result[0], 0.f);
+	BOOST_CHECK_EQUAL(result[1], 127.5f);
+	BOOST_CHECK_EQUAL(result[2], 255.f);
+	BOOST_CHECK_EQUAL(result[3], 127.5f);
+}
+
+BOOST_AUTO_TEST_CASE(ExpectationMaximization)
+{
+	for (int dim : {1, 3})
+	{
+		const int nrclasses = 3;
+		TestVolume volume(16, 12, 6, dim, nrclasses);
+		const std::vector<float> weights(dim, 1.f);
+
+		VoxelSample sample(dim);
+		for (size_t z = 0; z < 6; ++z)
+			sample.Add(volume.Slice(z).data(), volume.area, volume.area);
+
+		VolumeEM em(nrclasses, dim, weights.data());
+		em.InitCenters(sample);
+		em.Train(sample, 50, 0);
+		CheckClassification(em, volume, nrclasses);
+
+		float sum = 0.f;
+		for (float a : em.Ampls())
+			sum += a;
+		BOOST_CHECK_CLOSE(sum, 1.f, 1e-3);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
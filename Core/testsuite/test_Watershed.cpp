@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../Watershed.h"
+
+#include <vector>
+
+namespace iseg {
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(Watershed_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/Watershed_suite/Hierarchy_test --log_level=message
+BOOST_AUTO_TEST_CASE(Hierarchy_test)
+{
+	// two valleys separated by a ridge of height 5
+	std::vector<float> image = {0, 1, 2, 5, 2, 1, 0};
+	std::vector<unsigned> basins(image.size());
+	const float* in = image.data();
+	unsigned* out = basins.data();
+
+	WatershedHierarchy hierarchy;
+	BOOST_REQUIRE(WatershedFlooding(&in, image.size(), 1, 1, 0.f, 255.f, 256, kConnectivity4, &out, hierarchy));
+
+	BOOST_REQUIRE_EQUAL(hierarchy.NumberOfBasins(), 2);
+	BOOST_REQUIRE_EQUAL(hierarchy.merges.size(), 1);
+	BOOST_CHECK_EQUAL(hierarchy.merges[0].child, 1);
+	BOOST_CHECK_EQUAL(hierarchy.merges[0].parent, 0);
+	BOOST_CHECK_EQUAL(hierarchy.merges[0].level, 5);
+	BOOST_CHECK_EQUAL(basins[2], 0);
+	BOOST_CHECK_EQUAL(basins[4], 1);
+
+	// unmarked basin takes the label of the region it is merged into
+	std::vector<unsigned> markers = {1, 0};
+	BOOST_CHECK_EQUAL(hierarchy.Cut(4, markers)[1], 0);
+	BOOST_CHECK_EQUAL(hierarchy.Cut(5, markers)[1], 1);
+
+	// differently marked regions are never merged
+	markers = {1, 2};
+	BOOST_CHECK_EQUAL(hierarchy.Cut(100, markers)[0], 1);
+	BOOST_CHECK_EQUAL(hierarchy.Cut(100, markers)[1], 2);
+}
+
+// TestRunner.exe --run_test=iSeg_suite/Watershed_suite/Marker2D_test --log_level=message
+BOOST_AUTO_TEST_CASE(Marker2D_test)
+{
+	std::vector<float> image = {0, 1, 2, 5, 2, 1, 0};
+	std::vector<unsigned> labels = {1, 0, 0, 0, 0, 0, 2};
+	const float* in = image.data();
+	unsigned* out = labels.data();
+
+	BOOST_REQUIRE(MarkerWatershed(&in, image.size(), 1, 1, 0.f, 255.f, 256, kConnectivity4, &out));
+
+	std::vector<unsigned> expected = {1, 1, 1, 1, 2, 2, 2};
+	BOOST_CHECK_EQUAL_COLLECTIONS(labels.begin(), labels.end(), expected.begin(), expected.end());
+}
+
+// TestRunner.exe --run_test=iSeg_suite/Watershed_suite/Marker3D_test --log_level=message
+BOOST_AUTO_TEST_CASE(Marker3D_test)
+{
+	// ridge on the plane x == 2, seeds in different slices
+	const size_t w = 5, h = 4, d = 3;
+	std::vector<float> image(w * h * d, 0.f);
+	std::vector<unsigned> labels(w * h * d, 0);
+	for (size_t k = 0; k < d; ++k)
+		for (size_t y = 0; y < h; ++y)
+			image[k * w * h + y * w + 2] = 100.f;
+	labels[0] = 1;
+	labels[2 * w * h + 3 * w + 4] = 2;
+
+	std::vector<const float*> in;
+	std::vector<unsigned*> out;
+	for (size_t k = 0; k < d; ++k)
+	{
+		in.push_back(&image[k * w * h]);
+		out.push_back(&labels[k * w * h]);
+	}
+
+	BOOST_REQUIRE(MarkerWatershed(in.data(), w, h, d, 0.f, 100.f, 256, kConnectivity6, out.data()));
+
+	for (size_t i = 0; i < labels.size(); ++i)
+	{
+		const size_t x = i % w;
+		if (x < 2)
+			BOOST_CHECK_EQUAL(labels[i], 1);
+		else if (x > 2)
+			BOOST_CHECK_EQUAL(labels[i], 2);
+		else
+			BOOST_CHECK(labels[i] == 1 || labels[i] == 2);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
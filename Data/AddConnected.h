@@ -8,91 +8,44 @@
  *  https://opensource.org/licenses/MIT
  */
 
-#pragma
+#pragma once
+
+#include "RegionGrowing.h"
 
 #include <vector>
 
 namespace iseg {
 
-template<typename T1, typename T2, typename TWritable>
-void add_connected_2d(T1* source, T2* target, unsigned width, unsigned height, unsigned position, T2 new_value, const TWritable& writable)
+/// Set targets to new_value in the 6-connected region of writable(z, i) voxels containing position in slice
+template<typename T, typename TWritable>
+void add_connected_3d(const std::vector<T*>& targets, unsigned width, unsigned height, unsigned slice, unsigned position, T new_value, const TWritable& writable)
 {
-	//T1 f = work_bits[position];
+	std::vector<std::vector<growing::Span>> seeds(targets.size());
+	growing::Span seed;
+	seed.y = position / width;
+	seed.x0 = seed.x1 = position % width;
+	seeds[slice].push_back(seed);
 
-	const unsigned char kObject = 1;
-	const unsigned char kBackground = 0;
-	const unsigned char kWritable = -1;
-	const unsigned area = width * height;
-	std::vector<unsigned char> results(area + 2 * width + 2 * height + 4);
+	auto filled = RegionGrowing(width, height, targets.size(), writable, false, seeds);
 
-	unsigned i = width + 3;
-	unsigned i1 = 0;
-	for (unsigned j = 0; j < height; j++, i += 2)
+	// written after the fill, writable may depend on the target
+	const size_t area = static_cast<size_t>(width) * height;
+	for (size_t z = 0; z < targets.size(); ++z)
 	{
-		for (unsigned k = 0; k < width; k++, i++, i1++)
+		for (size_t i = 0; i < area; ++i)
 		{
-			//if (work_bits[i1] == f && (tissues[i1] == 0 || (override && !TissueInfos::GetTissueLocked(tissues[i1]))))
-			if (writable(i1))
-			{
-				results[i] = kWritable;
-			}
-			else
-			{
-				results[i] = kBackground;
-			}
-		}
-	}
-
-	for (unsigned j = 0; j < width + 2; j++)
-		results[j] = results[j + (width + 2) * (height + 1)] = 0;
-	for (unsigned j = 0; j <= (width + 2) * (height + 1); j += width + 2)
-		results[j] = results[j + width + 1] = 0;
-
-	std::vector<unsigned> s;
-	s.push_back(position % width + 1 + (position / width + 1) * (width + 2));
-	if (results[s.back()] == kWritable)
-		results[s.back()] = kObject;
-
-	unsigned w = width + 2;
-
-	while (!s.empty())
-	{
-		i = s.back();
-		s.pop_back();
-		if (results[i - 1] == kWritable)
-		{
-			results[i - 1] = kObject;
-			s.push_back(i - 1);
-		}
-		if (results[i + 1] == kWritable)
-		{
-			results[i + 1] = kObject;
-			s.push_back(i + 1);
-		}
-		if (results[i - w] == kWritable)
-		{
-			results[i - w] = kObject;
-			s.push_back(i - w);
-		}
-		if (results[i + w] == kWritable)
-		{
-			results[i + w] = kObject;
-			s.push_back(i + w);
+			if (filled[z].Test(i))
+				targets[z][i] = new_value;
 		}
 	}
+}
 
-	i = width + 3;
-	unsigned i2 = 0;
-	for (unsigned j = 0; j < height; j++, i += 2)
-	{
-		for (unsigned k = 0; k < width; k++, i++, i2++)
-		{
-			if (results[i] == kObject)
-			{
-				target[i2] = new_value;
-			}
-		}
-	}
+/// Set target to new_value in the 4-connected region of writable pixels containing position
+template<typename T1, typename T2, typename TWritable>
+void add_connected_2d(T1* source, T2* target, unsigned width, unsigned height, unsigned position, T2 new_value, const TWritable& writable)
+{
+	std::vector<T2*> targets(1, target);
+	add_connected_3d(targets, width, height, 0, position, new_value, [&](size_t, size_t i) { return writable(static_cast<unsigned>(i)); });
 }
 
 } // namespace iseg
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace iseg {
+
+/// Bit-packed mask, one bit per voxel of a slice
+class BitMask
+{
+public:
+	BitMask() = default;
+	explicit BitMask(size_t n) : _bits((n + 63) / 64, 0) {}
+
+	bool Test(size_t i) const { return (_bits[i >> 6] >> (i & 63)) & 1; }
+	void Set(size_t i) { _bits[i >> 6] |= (uint64_t(1) << (i & 63)); }
+
+	/// Set bits i0..i1 (inclusive)
+	void SetRange(size_t i0, size_t i1)
+	{
+		for (size_t w = i0 >> 6; w <= (i1 >> 6); ++w)
+		{
+			const size_t lo = std::max(i0, w << 6) & 63;
+			const size_t hi = std::min(i1, (w << 6) + 63) & 63;
+			const uint64_t upper = (hi == 63) ? ~uint64_t(0) : ((uint64_t(1) << (hi + 1)) - 1);
+			_bits[w] |= upper & ~((uint64_t(1) << lo) - 1);
+		}
+	}
+
+	bool Empty() const { return _bits.empty(); }
+
+private:
+	std::vector<uint64_t> _bits;
+};
+
+namespace growing {
+
+/// Pixels x0..x1 (inclusive) of row y, which should be checked for growing
+struct Span
+{
+	unsigned y;
+	unsigned x0;
+	unsigned x1;
+};
+
+/// Spans of consecutive pixels in a slice for which seed(i) is true
+template<typename TSeed>
+void CollectSpans(size_t width, size_t height, TSeed seed, std::vector<Span>& spans)
+{
+	for (size_t y = 0; y < height; ++y)
+	{
+		size_t x = 0;
+		while (x < width)
+		{
+			if (!seed(y * width + x))
+			{
+				++x;
+				continue;
+			}
+			Span s;
+			s.y = static_cast<unsigned>(y);
+			s.x0 = static_cast<unsigned>(x);
+			while (x + 1 < width && seed(y * width + x + 1))
+				++x;
+			s.x1 = static_cast<unsigned>(x);
+			spans.push_back(s);
+			++x;
+		}
+	}
+}
+
+/** \brief Scanline flood fill of one slice
+
+	Starts from the spans in todo, grown runs are marked in visited. Runs which are filled are also pushed to
+	next, since they are the seeds for the neighboring slices.
+*/
+template<typename TGrow>
+void FillSlice(size_t width, size_t height, size_t z, TGrow& grow, bool diagonal,
+		std::vector<Span>& todo, BitMask& visited, std::vector<Span>& next)
+{
+	const unsigned d = diagonal ? 1 : 0;
+	auto can_grow = [&](size_t i) { return !visited.Test(i) && grow(z, i); };
+
+	while (!todo.empty())
+	{
+		const Span s = todo.back();
+		todo.pop_back();
+
+		const size_t row = static_cast<size_t>(s.y) * width;
+		size_t x = s.x0;
+		while (x <= s.x1)
+		{
+			if (!can_grow(row + x))
+			{
+				++x;
+				continue;
+			}
+
+			// extend the run to the left and right
+			size_t l = x, r = x;
+			while (l > 0 && can_grow(row + l - 1))
+				--l;
+			while (r + 1 < width && can_grow(row + r + 1))
+				++r;
+			visited.SetRange(row + l, row + r);
+
+			Span run;
+			run.x0 = static_cast<unsigned>(l);
+			run.x1 = static_cast<unsigned>(r);
+			run.y = s.y;
+			next.push_back(run);
+
+			// rows above and below, including the diagonal neighbors if requested
+			run.x0 = static_cast<unsigned>(l >= d ? l - d : 0);
+			run.x1 = static_cast<unsigned>(std::min(r + d, width - 1));
+			if (s.y > 0)
+			{
+				run.y = s.y - 1;
+				todo.push_back(run);
+			}
+			if (s.y + 1 < height)
+			{
+				run.y = s.y + 1;
+				todo.push_back(run);
+			}
+			x = r + 1;
+		}
+	}
+}
+
+} // namespace growing
+
+/** \brief 3D region growing with scanline flood fill and parallel wavefront expansion
+
+	grow(z, i) returns true if voxel i of slice z may be added to the region (e.g. thresholds and tissue locks).
+	seeds contains the start spans of each slice, the seed voxels themselves must also satisfy grow. Voxels are
+	connected to their 4 (or 8 if diagonal) neighbors in the slice and to the voxels above and below.
+
+	Each round fills all slices with pending spans in parallel (one thread per slice), the runs filled in a
+	slice are the spans to check in the neighboring slices in the next round. The result does not depend
+	on the order of the expansion.
+
+	\returns a bit mask per slice with the grown voxels
+*/
+template<typename TGrow>
+std::vector<BitMask> RegionGrowing(size_t width, size_t height, size_t nrslices, TGrow grow, bool diagonal,
+		std::vector<std::vector<growing::Span>> seeds)
+{
+	const size_t slice_size = width * height;
+	std::vector<BitMask> visited(nrslices, BitMask(slice_size));
+	if (slice_size == 0)
+		return visited;
+
+	seeds.resize(nrslices);
+	std::vector<std::vector<growing::Span>> filled(nrslices);
+	const int n = static_cast<int>(nrslices);
+
+	bool pending = true;
+	while (pending)
+	{
+#pragma omp parallel for schedule(dynamic)
+		for (int z = 0; z < n; ++z)
+		{
+			filled[z].clear();
+			if (!seeds[z].empty())
+			{
+				growing::FillSlice(width, height, z, grow, diagonal, seeds[z], visited[z], filled[z]);
+			}
+		}
+
+		pending = false;
+		for (int z = 0; z < n; ++z)
+		{
+			if (z > 0)
+				seeds[z].insert(seeds[z].end(), filled[z - 1].begin(), filled[z - 1].end());
+			if (z + 1 < n)
+				seeds[z].insert(seeds[z].end(), filled[z + 1].begin(), filled[z + 1].end());
+			pending = pending || !seeds[z].empty();
+		}
+	}
+	return visited;
+}
+
+} // namespace iseg
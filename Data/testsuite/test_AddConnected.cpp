@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ * 
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ * 
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../AddConnected.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace iseg {
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(AddConnected_suite);
+// TestRunner.exe --run_test=iSeg_suite/AddConnected_suite --log_level=message
+
+BOOST_AUTO_TEST_CASE(add_connected_2d_test)
+{
+	// U-shaped object, the right column is not connected to the rest
+	const unsigned w = 5, h = 4;
+	std::vector<unsigned char> source = {
+			1, 0, 1, 0, 1,
+			1, 0, 1, 0, 1,
+			1, 0, 1, 0, 1,
+			1, 1, 1, 0, 1};
+	std::vector<unsigned char> target(w * h, 0);
+
+	add_connected_2d(source.data(), target.data(), w, h, 2, (unsigned char)7,
+			[&](unsigned i) { return source[i] != 0; });
+
+	BOOST_CHECK_EQUAL(std::count(target.begin(), target.end(), 7), 9);
+	BOOST_CHECK_EQUAL(target[4], 0);
+	BOOST_CHECK_EQUAL(target[15], 7);
+}
+
+BOOST_AUTO_TEST_CASE(add_connected_3d_test)
+{
+	// two slices, connected through a single voxel
+	const unsigned w = 3, h = 3;
+	std::vector<int> slice0 = {
+			1, 1, 0,
+			0, 0, 0,
+			0, 0, 1};
+	std::vector<int> slice1 = {
+			0, 1, 0,
+			0, 1, 0,
+			0, 1, 1};
+	std::vector<int*> slices = {slice0.data(), slice1.data()};
+
+	// the writable condition depends on the target itself
+	add_connected_3d(slices, w, h, 0, 0, 2, [&](unsigned z, unsigned i) { return slices[z][i] == 1; });
+
+	std::vector<int> expected0 = {2, 2, 0, 0, 0, 0, 0, 0, 2};
+	std::vector<int> expected1 = {0, 2, 0, 0, 2, 0, 0, 2, 2};
+	BOOST_CHECK(slice0 == expected0);
+	BOOST_CHECK(slice1 == expected1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2018 The Foundation for Research on Information Technologies in Society (IT'IS).
+ *
+ * This file is part of iSEG
+ * (see https://github.com/ITISFoundation/osparc-iseg).
+ *
+ * This software is released under the MIT License.
+ *  https://opensource.org/licenses/MIT
+ */
+#include <boost/test/unit_test.hpp>
+
+#include "../RegionGrowing.h"
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace iseg {
+
+namespace {
+std::vector<char> FloodFill(const std::vector<char>& mask, size_t w, size_t h, size_t d, bool diagonal, size_t seed)
+{
+	std::vector<char> visited(mask.size(), 0);
+	std::vector<size_t> stack(1, seed);
+	visited[seed] = 1;
+	while (!stack.empty())
+	{
+		size_t i = stack.back();
+		stack.pop_back();
+		const int x = static_cast<int>(i % w), y = static_cast<int>(i / w % h), z = static_cast<int>(i / (w * h));
+		for (int dz = -1; dz <= 1; ++dz)
+			for (int dy = -1; dy <= 1; ++dy)
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					const int nz = std::abs(dz), nxy = std::abs(dx) + std::abs(dy);
+					if (nz + nxy == 0 || (nz == 1 && nxy > 0) || (!diagonal && nxy > 1))
+						continue;
+					if (x + dx < 0 || y + dy < 0 || z + dz < 0 || x + dx >= int(w) || y + dy >= int(h) || z + dz >= int(d))
+						continue;
+					size_t j = (z + dz) * w * h + (y + dy) * w + x + dx;
+					if (mask[j] && !visited[j])
+					{
+						visited[j] = 1;
+						stack.push_back(j);
+					}
+				}
+	}
+	return visited;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(iSeg_suite);
+BOOST_AUTO_TEST_SUITE(RegionGrowing_suite);
+
+// TestRunner.exe --run_test=iSeg_suite/RegionGrowing_suite/BitMask_test --log_level=message
+BOOST_AUTO_TEST_CASE(BitMask_test)
+{
+	BitMask mask(200);
+	mask.SetRange(3, 130);
+	mask.Set(199);
+	for (size_t i = 0; i < 200; ++i)
+	{
+		BOOST_CHECK_EQUAL(mask.Test(i), (i >= 3 && i <= 130) || i == 199);
+	}
+}
+
+// TestRunner.exe --run_test=iSeg_suite/RegionGrowing_suite/FloodFill_test --log_level=message
+BOOST_AUTO_TEST_CASE(FloodFill_test)
+{
+	const size_t w = 23, h = 17, d = 9;
+	std::mt19937 gen(42);
+	std::bernoulli_distribution coin(0.6);
+	std::vector<char> mask(w * h * d);
+	for (auto& m : mask)
+		m = coin(gen) ? 1 : 0;
+
+	const size_t seed = 4 * w * h + 8 * w + 11;
+	mask[seed] = 1;
+
+	for (bool diagonal : {false, true})
+	{
+		std::vector<std::vector<growing::Span>> seeds(d);
+		growing::Span s;
+		s.y = 8;
+		s.x0 = s.x1 = 11;
+		seeds[4].push_back(s);
+
+		auto grown = RegionGrowing(w, h, d, [&](size_t z, size_t i) { return mask[z * w * h + i] != 0; }, diagonal, seeds);
+		auto expected = FloodFill(mask, w, h, d, diagonal, seed);
+
+		for (size_t i = 0; i < mask.size(); ++i)
+		{
+			BOOST_REQUIRE_EQUAL(grown[i / (w * h)].Test(i % (w * h)), expected[i] != 0);
+		}
+	}
+}
+
+// TestRunner.exe --run_test=iSeg_suite/RegionGrowing_suite/Seeds_test --log_level=message
+BOOST_AUTO_TEST_CASE(Seeds_test)
+{
+	// strong voxels (2) are seeds, weak voxels (1) are only added if connected to a seed
+	const size_t w = 6, h = 1, d = 2;
+	std::vector<char> image = {2, 1, 0, 1, 1, 0, 0, 0, 0, 0, 1, 1};
+	std::vector<std::vector<growing::Span>> seeds(d);
+	for (size_t z = 0; z < d; ++z)
+	{
+		growing::CollectSpans(w, h, [&](size_t i) { return image[z * w + i] == 2; }, seeds[z]);
+	}
+
+	auto grown = RegionGrowing(w, h, d, [&](size_t z, size_t i) { return image[z * w + i] != 0; }, false, seeds);
+
+	std::vector<bool> expected = {1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+	for (size_t i = 0; i < image.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(grown[i / w].Test(i % w), expected[i]);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace iseg
@@ -358,7 +358,7 @@ void ImageViewerWidget::init(SlicesHandler* hand3D, bool bmporwork1)
 
 void ImageViewerWidget::update_range()
 {
-	// Recompute ranges for all slices
+	// Recompute ranges of all modified slices
 	if (bmporwork)
 	{
 		handler3D->compute_bmprange_mode1(&range_mode1);
@@ -11,6 +11,7 @@
 
 #include "InterpolationWidget.h"
 #include "SlicesHandler.h"
+#include "TissueInfos.h"
 
 #include "Data/BrushInteraction.h"
 
@@ -37,6 +38,7 @@ InterpolationWidget::InterpolationWidget(SlicesHandler* hand3D, QWidget* parent,
 	setToolTip(Format("Interpolate/extrapolate between segmented slices."));
 
 	brush = nullptr;
+	startselected = false;
 
 	nrslices = handler3D->num_slices();
 
@@ -54,10 +56,16 @@ InterpolationWidget::InterpolationWidget(SlicesHandler* hand3D, QWidget* parent,
 	rb_batchinter->setToolTip(Format(
 			"Select the stride of (distance between) segmented slices and the "
 			"start slice to batch segment multiple slices."));
+	rb_allgaps = new QRadioButton(QString("All Gaps"), vboxmethods);
+	rb_allgaps->setToolTip(Format(
+			"Interpolates the tissue (or all tissues) between all pairs of "
+			"consecutive slices which contain it. The interpolated tissues "
+			"are only added to unassigned pixels."));
 	modegroup = new QButtonGroup(this);
 	modegroup->insert(rb_inter);
 	modegroup->insert(rb_extra);
 	modegroup->insert(rb_batchinter);
+	modegroup->insert(rb_allgaps);
 	rb_inter->setChecked(TRUE);
 
 	// Data selection
@@ -190,7 +198,8 @@ void InterpolationWidget::init()
 		nrslices = handler3D->num_slices();
 		sb_slicenr->setMaxValue((int)nrslices);
 		sb_batchstride->setMaxValue((int)nrslices - 1);
-		pushexec->setEnabled(false);
+		startselected = false;
+		pushexec->setEnabled(rb_allgaps->isOn());
 	}
 
 	if (!brush)
@@ -224,12 +233,14 @@ void InterpolationWidget::handler3D_changed()
 		sb_slicenr->setMaxValue((int)nrslices);
 		sb_batchstride->setMaxValue((int)nrslices - 1);
 	}
-	pushexec->setEnabled(false);
+	startselected = false;
+	pushexec->setEnabled(rb_allgaps->isOn());
 }
 
 void InterpolationWidget::startslice_pressed()
 {
 	startnr = handler3D->active_slice();
+	startselected = true;
 	pushexec->setEnabled(true);
 }
 
@@ -275,6 +286,30 @@ void InterpolationWidget::execute()
 	unsigned short batchstride = (unsigned short)sb_batchstride->value();
 	bool const connected = cb_connectedshapebased->isVisible() && cb_connectedshapebased->isChecked();
 
+	if (rb_allgaps->isOn())
+	{
+		std::vector<tissues_size_t> tissuetypes;
+		if (rb_tissueall->isOn())
+		{
+			for (tissues_size_t i = 1; i <= TissueInfos::GetTissueCount(); i++)
+			{
+				tissuetypes.push_back(i);
+			}
+		}
+		else
+		{
+			tissuetypes.push_back(tissuenr);
+		}
+
+		iseg::DataSelection dataSelection;
+		dataSelection.allSlices = true;
+		dataSelection.tissues = true;
+		emit begin_datachange(dataSelection, this);
+		handler3D->interpolatetissue_allgaps(tissuetypes);
+		emit end_datachange(this);
+		return;
+	}
+
 	unsigned short current = handler3D->active_slice();
 	if (current != startnr)
 	{
@@ -456,6 +491,7 @@ void InterpolationWidget::execute()
 			}
 			emit end_datachange(this);
 		}
+		startselected = false;
 		pushexec->setEnabled(false);
 	}
 }
@@ -471,6 +507,8 @@ void InterpolationWidget::brush_changed()
 
 void InterpolationWidget::method_changed()
 {
+	pushstart->setEnabled(!rb_allgaps->isOn());
+	pushexec->setEnabled(startselected || rb_allgaps->isOn());
 	if (rb_extra->isOn())
 	{
 		hboxextra->show();
@@ -504,6 +542,20 @@ void InterpolationWidget::method_changed()
 			rb_8connectivity->hide();
 		}
 	}
+	else if (rb_allgaps->isOn())
+	{
+		hboxextra->hide();
+		hboxbatch->hide();
+		cb_medianset->hide();
+		cb_connectedshapebased->hide();
+		rb_4connectivity->hide();
+		rb_8connectivity->hide();
+		if (rb_work->isChecked())
+		{
+			rb_tissue->setChecked(true);
+		}
+		rb_tissueall->setEnabled(true);
+	}
 	else if (rb_batchinter->isOn())
 	{
 		hboxextra->hide();
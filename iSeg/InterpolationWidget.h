@@ -84,6 +84,7 @@ private:
 	//	QRadioButton *rb_intergrey;
 	QRadioButton *rb_extra;
 	QRadioButton *rb_batchinter;
+	QRadioButton *rb_allgaps;
 	QButtonGroup *modegroup;
 	QRadioButton *rb_4connectivity;
 	QRadioButton *rb_8connectivity;
@@ -92,6 +93,7 @@ private:
 	QCheckBox *cb_connectedshapebased;
 	QLineEdit *brush_radius;
 	unsigned short startnr;
+	bool startselected;
 	unsigned short nrslices;
 	unsigned short tissuenr;
 
@@ -11,7 +11,7 @@
 
 #include "Data/Point.h"
 
-#include "Core/SliceProvider.h"
+#include "Core/LevelSet.h"
 
 #include <vector>
 
@@ -39,34 +39,11 @@ public:
 	~Levelset();
 
 private:
-	bool loaded;
-	bool ownlvlset;
 	bmphandler* image;
-	void reinitialize();
-	void make_step();
-	float stepsize;
-	float epsilon;
-	float balloon1;
 	unsigned short width;
 	unsigned short height;
 	unsigned area;
-	//		float *levset;
-	float* devx;
-	float* devy;
-	float* devxx;
-	float* devxy;
-	float* devyy;
-	float* kbits;
-	float* Pbits;
-	float* Px;
-	float* Py;
-	void diffx(float* input, float* output);
-	void diffy(float* input, float* output);
-	void diffxx(float* input, float* output);
-	void diffxy(float* input, float* output);
-	void diffyy(float* input, float* output);
-	SliceProvider* sliceprovide;
-	SliceProviderInstaller* sliceprovide_installer;
+	NarrowBandLevelSet levelset;
 };
 
 } // namespace iseg
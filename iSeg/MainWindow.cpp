@@ -35,7 +35,6 @@
 #include "StdStringToQString.h"
 #include "SurfaceViewerWidget.h"
 #include "ThresholdWidget.h"
-#include "TissueCleaner.h"
 #include "TissueInfos.h"
 #include "TissueTreeWidget.h"
 #include "TransformWidget.h"
@@ -4251,6 +4250,8 @@ void MainWindow::execute_loadtissues()
 		}
 		else if (msgBox.clickedButton() == replaceButton)
 		{
+			// the removal and the cap are applied to the tissues in one pass
+			std::set<tissues_size_t> removeTissues;
 			if (TissueInfos::LoadTissuesReadable(loadfilename.ascii(), handler3D,
 							removeTissuesRange))
 			{
@@ -4266,35 +4267,41 @@ void MainWindow::execute_loadtissues()
 							QMessageBox::Yes | QMessageBox::Default, QMessageBox::No);
 					if (ret == QMessageBox::Yes)
 					{
-						std::set<tissues_size_t> removeTissues;
 						for (tissues_size_t type = 1; type <= removeTissuesRange; ++type)
 						{
 							removeTissues.insert(type);
 						}
-						iseg::DataSelection dataSelection;
-						dataSelection.allSlices = true;
-						dataSelection.tissues = true;
-						emit begin_datachange(dataSelection, this, false);
-						handler3D->remove_tissues(removeTissues);
-						emit end_datachange(this, iseg::ClearUndo);
 					}
 #else
-					std::set<tissues_size_t> removeTissues;
 					for (tissues_size_t type = 1; type <= removeTissuesRange; ++type)
 					{
 						removeTissues.insert(type);
 					}
-					iseg::DataSelection dataSelection;
-					dataSelection.allSlices = true;
-					dataSelection.tissues = true;
-					emit begin_datachange(dataSelection, this, false);
-					handler3D->remove_tissues(removeTissues);
-					emit end_datachange(this, iseg::ClearUndo);
 #endif
 				}
 			}
-			tissues_size_t tissueCount = TissueInfos::GetTissueCount();
-			handler3D->cap_tissue(tissueCount);
+
+			LabelMap<tissues_size_t> map;
+			if (!removeTissues.empty())
+			{
+				map.remove(removeTissues);
+				TissueInfos::RemoveTissues(removeTissues);
+			}
+			map.cap(TissueInfos::GetTissueCount());
+
+			if (!removeTissues.empty())
+			{
+				iseg::DataSelection dataSelection;
+				dataSelection.allSlices = true;
+				dataSelection.tissues = true;
+				emit begin_datachange(dataSelection, this, false);
+				handler3D->remap_tissues(map);
+				emit end_datachange(this, iseg::ClearUndo);
+			}
+			else
+			{
+				handler3D->remap_tissues(map);
+			}
 
 			tissueTreeWidget->update_tree_widget();
 			tissuenr_changed(tissueTreeWidget->get_current_type() - 1);
@@ -6617,6 +6624,8 @@ void MainWindow::execute_undo()
 		// Update ranges
 		update_ranges_helper();
 
+		update_surfaceviewer_helper(selectedData);
+
 		//	if(undotype & )
 		slice_changed();
 
@@ -6646,6 +6655,8 @@ void MainWindow::execute_redo()
 	// Update ranges
 	update_ranges_helper();
 
+	update_surfaceviewer_helper(selectedData);
+
 	//	if(undotype & )
 	slice_changed();
 
@@ -7392,38 +7403,63 @@ void MainWindow::execute_remove_unused_tissues()
 
 void MainWindow::execute_cleanup()
 {
-	tissues_size_t** slices = new tissues_size_t*[handler3D->end_slice() - handler3D->start_slice()];
+	int rate, minsize;
+	bool changed_only;
+	CleanerParams CP(&rate, &minsize, &changed_only);
+	CP.exec();
+	if (rate == 0 && minsize == 0)
+		return;
+
+	std::vector<tissues_size_t*> slices;
 	tissuelayers_size_t activelayer = handler3D->active_tissuelayer();
 	for (unsigned short i = handler3D->start_slice(); i < handler3D->end_slice(); i++)
 	{
-		slices[i - handler3D->start_slice()] = handler3D->return_tissues(activelayer, i);
+		slices.push_back(handler3D->return_tissues(activelayer, i));
 	}
 	TissueCleaner TC(
-			slices, handler3D->end_slice() - handler3D->start_slice(),
+			slices.data(), handler3D->end_slice() - handler3D->start_slice(),
 			handler3D->width(), handler3D->height());
-	if (!TC.Allocate())
+	TC.SetLockedTissues(handler3D->tissue_lock_table());
+	if (changed_only && rate == cleanup_rate && minsize == cleanup_minsize)
 	{
-		QMessageBox::information(this, "iSeg", "Not enough memory.\nThis operation cannot be performed.\n");
+		TC.SetPreviousFingerprints(cleanup_fingerprints);
 	}
-	else
+	TC.ConnectedComponents();
+
+	// dry run, report what would be removed
+	unsigned num_tissues = 0, num_islands = 0;
+	unsigned long long num_voxels = 0;
+	for (const auto& r : TC.DryRun(1.0f / rate, minsize))
 	{
-		int rate, minsize;
-		CleanerParams CP(&rate, &minsize);
-		CP.exec();
-		if (rate == 0 && minsize == 0)
-			return;
+		if (r.removed_components != 0)
+		{
+			num_tissues++;
+			num_islands += r.removed_components;
+			num_voxels += r.removed_voxels;
+		}
+	}
+	if (num_islands == 0)
+	{
+		QMessageBox::information(this, "iSeg", "No islands found.");
+		return;
+	}
+	int ret = QMessageBox::question(this, "iSeg",
+			QString("Remove %1 islands (%2 voxels) in %3 tissues?").arg(num_islands).arg(num_voxels).arg(num_tissues),
+			QMessageBox::Yes | QMessageBox::Default, QMessageBox::Cancel | QMessageBox::Escape);
+	if (ret != QMessageBox::Yes)
+		return;
 
-		iseg::DataSelection dataSelection;
-		dataSelection.allSlices = true;
-		dataSelection.tissues = true;
-		emit begin_datachange(dataSelection, this);
+	iseg::DataSelection dataSelection;
+	dataSelection.allSlices = true;
+	dataSelection.tissues = true;
+	emit begin_datachange(dataSelection, this);
 
-		TC.ConnectedComponents();
-		TC.MakeStat();
-		TC.Clean(1.0f / rate, minsize);
+	TC.Clean(1.0f / rate, minsize);
+	cleanup_fingerprints = TC.Fingerprints();
+	cleanup_rate = rate;
+	cleanup_minsize = minsize;
 
-		emit end_datachange(this);
-	}
+	emit end_datachange(this);
 }
 
 void MainWindow::wheelrotated(int delta)
@@ -7518,6 +7554,9 @@ void MainWindow::handle_begin_datachange(iseg::DataSelection& dataSelection,
 	undoStarted = beginUndo || undoStarted;
 	changeData = dataSelection;
 
+	// Cached ranges of modified slices need to be recomputed
+	handler3D->invalidate_ranges(changeData);
+
 	// Handle pending transforms
 	if (methodTab->currentWidget() == transform_widget && sender != transform_widget)
 	{
@@ -7598,6 +7637,8 @@ void MainWindow::handle_end_datachange(QWidget* sender,
 	// Update ranges
 	update_ranges_helper();
 
+	update_surfaceviewer_helper(changeData);
+
 	// Block changed data signals for visible widget
 	if (sender == methodTab->currentWidget())
 	{
@@ -7692,6 +7733,14 @@ void MainWindow::update_ranges_helper()
 	}
 }
 
+void MainWindow::update_surfaceviewer_helper(const iseg::DataSelection& selection)
+{
+	if (surface_viewer != nullptr)
+	{
+		surface_viewer->slices_modified(selection);
+	}
+}
+
 void MainWindow::cancel_transform_helper()
 {
 	QObject::disconnect(
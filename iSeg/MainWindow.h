@@ -15,6 +15,8 @@
 #include "Data/DataSelection.h"
 #include "Data/Point.h"
 
+#include "Core/TissueCleaner.h"
+
 #include <qdir.h>
 #include <qmainwindow.h>
 #include <qmenu.h>
@@ -116,6 +118,7 @@ protected:
 	void end_undo_helper(iseg::EndUndoAction undoAction);
 	void cancel_transform_helper();
 	void update_ranges_helper();
+	void update_surfaceviewer_helper(const iseg::DataSelection& selection);
 	void pixelsize_changed();
 	void do_undostepdone();
 	void do_clearundo();
@@ -245,6 +248,10 @@ private:
 	bits_stack* bitstack_widget;
 	extoverlay_widget* overlay_widget;
 	MultiDataset_widget* multidataset_widget;
+	/// tissues and parameters after the last cleanup, to only clean changed tissues
+	std::vector<TissueFingerprint> cleanup_fingerprints;
+	int cleanup_rate = 0;
+	int cleanup_minsize = 0;
 	QCheckBox* cb_bmptissuevisible;
 	QCheckBox* cb_bmpcrosshairvisible;
 	QCheckBox* cb_bmpoutlinevisible;
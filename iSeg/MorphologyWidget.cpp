@@ -11,6 +11,7 @@
 
 #include "MorphologyWidget.h"
 #include "SlicesHandler.h"
+#include "TissueInfos.h"
 #include "bmp_read_1.h"
 
 #include "Data/Point.h"
@@ -74,6 +75,13 @@ MorphologyWidget::MorphologyWidget(SlicesHandler* hand3D, QWidget* parent,
 	all_slices = new QCheckBox;
 	all_slices->setToolTip(Format("Apply to active slices in 3D or to current slice"));
 
+	apply_tissues = new QCheckBox;
+	apply_tissues->setToolTip(Format("Apply to all tissues at once instead of the Target image. Locked tissues are not modified."));
+
+	selected_tissues = new QCheckBox;
+	selected_tissues->setEnabled(false);
+	selected_tissues->setToolTip(Format("Only apply to the tissues selected in the tissue list."));
+
 	execute_button = new QPushButton("Execute");
 
 	// setup layout
@@ -83,12 +91,15 @@ MorphologyWidget::MorphologyWidget(SlicesHandler* hand3D, QWidget* parent,
 	top_layout->addRow(QString("Radius in pixels"), pixel_units);
 	top_layout->addRow(QString("Full connectivity"), node_connectivity);
 	top_layout->addRow(QString("Apply to all slices"), all_slices);
+	top_layout->addRow(QString("Apply to tissues"), apply_tissues);
+	top_layout->addRow(QString("Selected tissues only"), selected_tissues);
 	top_layout->addRow(execute_button);
 	setLayout(top_layout);
 
 	// connect signal-slots
 	QObject::connect(pixel_units, SIGNAL(stateChanged(int)), this, SLOT(units_changed()));
 	QObject::connect(all_slices, SIGNAL(stateChanged(int)), this, SLOT(all_slices_changed()));
+	QObject::connect(apply_tissues, SIGNAL(stateChanged(int)), this, SLOT(apply_tissues_changed()));
 	QObject::connect(execute_button, SIGNAL(clicked()), this, SLOT(execute()));
 }
 
@@ -97,9 +108,8 @@ void MorphologyWidget::execute()
 	bool connect8 = node_connectivity->isChecked();
 
 	iseg::DataSelection dataSelection;
-	dataSelection.work = true;
 
-	if (all_slices->isChecked())
+	if (apply_tissues->isChecked())
 	{
 		boost::variant<int, float> radius;
 		if (pixel_units->isChecked())
@@ -111,6 +121,45 @@ void MorphologyWidget::execute()
 			radius = operation_radius->text().toFloat();
 		}
 
+		std::vector<char> selected(TissueInfos::GetTissueCount() + 1, 1);
+		selected[0] = 0;
+		if (selected_tissues->isChecked())
+		{
+			std::fill(selected.begin(), selected.end(), 0);
+			for (auto tissue : TissueInfos::GetSelectedTissues())
+			{
+				selected[tissue] = 1;
+			}
+		}
+
+		morphology::eOperation operation = morphology::kDilate;
+		if (rb_open->isOn())
+			operation = morphology::kOpen;
+		else if (rb_close->isOn())
+			operation = morphology::kClose;
+		else if (rb_erode->isOn())
+			operation = morphology::kErode;
+
+		dataSelection.tissues = true;
+		dataSelection.allSlices = all_slices->isChecked();
+		dataSelection.sliceNr = handler3D->active_slice();
+		emit begin_datachange(dataSelection, this);
+
+		handler3D->tissue_morphology(operation, radius, selected, all_slices->isChecked());
+	}
+	else if (all_slices->isChecked())
+	{
+		dataSelection.work = true;
+		boost::variant<int, float> radius;
+		if (pixel_units->isChecked())
+		{
+			radius = static_cast<int>(operation_radius->text().toFloat());
+		}
+		else
+		{
+			radius = operation_radius->text().toFloat();
+		}
+
 		dataSelection.allSlices = true;
 		emit begin_datachange(dataSelection, this);
 
@@ -135,6 +184,7 @@ void MorphologyWidget::execute()
 	{
 		auto radius = static_cast<int>(operation_radius->text().toFloat());
 
+		dataSelection.work = true;
 		dataSelection.sliceNr = handler3D->active_slice();
 		emit begin_datachange(dataSelection, this);
 
@@ -295,5 +345,11 @@ void iseg::MorphologyWidget::units_changed()
 
 void iseg::MorphologyWidget::all_slices_changed()
 {
-	node_connectivity->setEnabled(!all_slices->isChecked());
+	node_connectivity->setEnabled(!all_slices->isChecked() && !apply_tissues->isChecked());
+}
+
+void iseg::MorphologyWidget::apply_tissues_changed()
+{
+	selected_tissues->setEnabled(apply_tissues->isChecked());
+	all_slices_changed();
 }
@@ -55,6 +55,8 @@ private:
 	QLineEdit* operation_radius;
 	QCheckBox* pixel_units;
 	QCheckBox* all_slices;
+	QCheckBox* apply_tissues;
+	QCheckBox* selected_tissues;
 	QPushButton* execute_button;
 
 private slots:
@@ -62,6 +64,7 @@ private slots:
 	void execute();
 	void units_changed();
 	void all_slices_changed();
+	void apply_tissues_changed();
 };
 
 } // namespace iseg
@@ -308,32 +308,16 @@ void SaveOutlinesWidget::save_pushed()
 			{
 				Pair pair1 = handler3D->get_pixelsize();
 				handler3D->set_pixelsize(pair1.high / 2, pair1.low / 2);
-				//				handler3D->extract_contours2(sb_minsize->value(), vtissues);
-				if (rb_dougpeuck->isOn())
-				{
-					handler3D->extract_contours2_xmirrored(
-						sb_minsize->value(), vtissues, sl_f->value() * 0.05f);
-					//					handler3D->dougpeuck_line(sl_f->value()*0.05f*2);
-				}
-				else if (rb_dist->isOn())
-				{
-					handler3D->extract_contours2_xmirrored(sb_minsize->value(),
-														   vtissues);
-				}
-				else if (rb_none->isOn())
-				{
-					handler3D->extract_contours2_xmirrored(sb_minsize->value(),
-														   vtissues);
-				}
-				handler3D->shift_contours(-(int)handler3D->width(),
-										  -(int)handler3D->height());
+				int top = 1, bottom = 1;
 				if (cb_extrusion->isChecked())
 				{
-					handler3D->setextrusion_contours(
-						sb_topextrusion->value() - 1,
-						sb_bottomextrusion->value() - 1);
+					top = sb_topextrusion->value() - 1;
+					bottom = sb_bottomextrusion->value() - 1;
 				}
-				handler3D->save_contours(loadfilename.ascii());
+				// traced, simplified and written slice by slice
+				handler3D->extractsave_contours2_xmirrored(
+					sb_minsize->value(), vtissues, rb_dougpeuck->isOn(),
+					sl_f->value() * 0.05f, loadfilename.ascii(), top, bottom);
 #define ROTTERDAM
 #ifdef ROTTERDAM
 				FILE* fp = fopen(loadfilename.ascii(), "a");
@@ -361,10 +345,6 @@ void SaveOutlinesWidget::save_pushed()
 				fclose(fp);
 #endif
 				handler3D->set_pixelsize(pair1.high, pair1.low);
-				if (cb_extrusion->isChecked())
-				{
-					handler3D->resetextrusion_contours();
-				}
 			}
 			else
 			{
@@ -17,7 +17,6 @@
 #include "AvwReader.h"
 #include "ChannelExtractor.h"
 #include "DicomReader.h"
-#include "Morpho.h"
 #include "TestingMacros.h"
 #include "TissueHierarchy.h"
 #include "TissueInfos.h"
@@ -28,12 +27,16 @@
 #include "vtkGenericDataSetWriter.h"
 #include "vtkImageExtractCompatibleMesher.h"
 
-#include "Data/ItkProgressObserver.h"
+#include "Data/AddConnected.h"
+#include "Data/RegionGrowing.h"
 #include "Data/SliceHandlerItkWrapper.h"
 #include "Data/Transform.h"
 
+#include "Core/BufferPool.h"
 #include "Core/ColorLookupTable.h"
+#include "Core/ConnectedComponents.h"
 #include "Core/ConnectedShapeBasedInterpolation.h"
+#include "Core/DistanceTransform.h"
 #include "Core/ExpectationMaximization.h"
 #include "Core/HDF5Writer.h"
 #include "Core/ImageForestingTransform.h"
@@ -43,14 +46,18 @@
 #include "Core/MatlabExport.h"
 #include "Core/MultidimensionalGamma.h"
 #include "Core/Outline.h"
+#include "Core/Pipeline.h"
 #include "Core/ProjectVersion.h"
 #include "Core/RTDoseIODModule.h"
 #include "Core/RTDoseReader.h"
 #include "Core/RTDoseWriter.h"
+#include "Core/ShapeInterpolation.h"
 #include "Core/SliceProvider.h"
 #include "Core/SmoothSteps.h"
 #include "Core/Treaps.h"
+#include "Core/VolumeClustering.h"
 #include "Core/VoxelSurface.h"
+#include "Core/Watershed.h"
 
 #include "vtkMyGDCMPolyDataReader.h"
 
@@ -68,8 +75,6 @@
 #include <vtkTransformPolyDataFilter.h>
 #include <vtkWindowedSincPolyDataFilter.h>
 
-#include <itkConnectedComponentImageFilter.h>
-
 #include <boost/format.hpp>
 
 #include <qdir.h>
@@ -77,6 +82,9 @@
 #include <qmessagebox.h>
 #include <qprogressdialog.h>
 
+#include <map>
+#include <stdexcept>
+
 #ifndef NO_OPENMP_SUPPORT
 #	include <omp.h>
 #endif
@@ -302,7 +310,10 @@ int SlicesHandler::LoadDIBitmap(std::vector<const char*> filenames)
 		// Ranges
 		Pair dummy;
 		_slice_ranges.resize(_nrslices);
+		_slice_histograms.resize(_nrslices);
+		_slice_tissues.resize(_nrslices);
 		_slice_bmpranges.resize(_nrslices);
+		_slice_bmphistograms.resize(_nrslices);
 		compute_range_mode1(&dummy);
 		compute_bmprange_mode1(&dummy);
 
@@ -339,7 +350,10 @@ int SlicesHandler::LoadDIBitmap(std::vector<const char*> filenames, Point p,
 		// Ranges
 		Pair dummy;
 		_slice_ranges.resize(_nrslices);
+		_slice_histograms.resize(_nrslices);
+		_slice_tissues.resize(_nrslices);
 		_slice_bmpranges.resize(_nrslices);
+		_slice_bmphistograms.resize(_nrslices);
 		compute_range_mode1(&dummy);
 		compute_bmprange_mode1(&dummy);
 
@@ -400,7 +414,10 @@ int SlicesHandler::LoadPng(std::vector<const char*> filenames)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -443,7 +460,10 @@ int SlicesHandler::LoadPng(std::vector<const char*> filenames, Point p,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -493,7 +513,10 @@ int SlicesHandler::LoadDIJpg(std::vector<const char*> filenames)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -536,7 +559,10 @@ int SlicesHandler::LoadDIJpg(std::vector<const char*> filenames, Point p,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -577,7 +603,10 @@ int SlicesHandler::ReadRaw(const char* filename, short unsigned w,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -815,7 +844,10 @@ int SlicesHandler::ReadRTdose(const char* filename)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -853,6 +885,12 @@ bool SlicesHandler::LoadSurface(const char* filename,
 
 int SlicesHandler::LoadAllHDF(const char* filename)
 {
+	_slice_ranges.invalidate_all();
+	_slice_histograms.invalidate_all();
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+	_slice_tissues.invalidate_all();
+
 	unsigned w, h, nrofslices;
 	float* pixsize;
 	float* tr_1d;
@@ -913,6 +951,12 @@ void SlicesHandler::UpdateColorLookupTable(
 
 int SlicesHandler::LoadAllXdmf(const char* filename)
 {
+	_slice_ranges.invalidate_all();
+	_slice_histograms.invalidate_all();
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+	_slice_tissues.invalidate_all();
+
 	unsigned w, h, nrofslices;
 	QStringList arrayNames;
 
@@ -1169,7 +1213,10 @@ int SlicesHandler::ReadAvw(const char* filename)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -1212,7 +1259,10 @@ int SlicesHandler::ReadRaw(const char* filename, short unsigned w,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -1253,7 +1303,10 @@ int SlicesHandler::ReadRawFloat(const char* filename, short unsigned w,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -1297,7 +1350,10 @@ int SlicesHandler::ReadRawFloat(const char* filename, short unsigned w,
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -1315,6 +1371,9 @@ int SlicesHandler::ReadRawFloat(const char* filename, short unsigned w,
 
 int SlicesHandler::ReloadDIBitmap(std::vector<const char*> filenames)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1369,6 +1428,9 @@ int SlicesHandler::ReloadDIBitmap(std::vector<const char*> filenames)
 
 int SlicesHandler::ReloadDIBitmap(std::vector<const char*> filenames, Point p)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1409,6 +1471,9 @@ int SlicesHandler::ReloadDIBitmap(std::vector<const char*> filenames, Point p)
 
 int SlicesHandler::ReloadRaw(const char* filename, unsigned bitdepth, unsigned short slicenr)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1425,6 +1490,9 @@ int SlicesHandler::ReloadRaw(const char* filename, unsigned bitdepth, unsigned s
 
 int SlicesHandler::ReloadImage(const char* filename, unsigned short slicenr)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	unsigned w, h, nrofslices;
@@ -1450,6 +1518,9 @@ int SlicesHandler::ReloadImage(const char* filename, unsigned short slicenr)
 
 int SlicesHandler::ReloadRTdose(const char* filename, unsigned short slicenr)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 #if 0
@@ -1638,6 +1709,9 @@ int SlicesHandler::ReloadRTdose(const char* filename, unsigned short slicenr)
 
 int SlicesHandler::ReloadAVW(const char* filename, unsigned short slicenr)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	unsigned short w, h, nrofslices;
@@ -1662,6 +1736,9 @@ int SlicesHandler::ReloadRaw(const char* filename, short unsigned w,
 		short unsigned h, unsigned bitdepth,
 		unsigned short slicenr, Point p)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1694,6 +1771,9 @@ std::vector<float*> SlicesHandler::LoadRawFloat(const char* filename,
 
 int SlicesHandler::ReloadRawFloat(const char* filename, unsigned short slicenr)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1711,6 +1791,9 @@ int SlicesHandler::ReloadRawFloat(const char* filename, short unsigned w,
 		short unsigned h, unsigned short slicenr,
 		Point p)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	UpdateColorLookupTable(nullptr);
 
 	int j = 0;
@@ -1729,6 +1812,7 @@ int SlicesHandler::ReloadRawTissues(const char* filename, unsigned bitdepth,
 		unsigned short slicenr)
 {
 	UpdateColorLookupTable(nullptr);
+	_slice_tissues.invalidate_all();
 
 	int j = 0;
 	for (unsigned short i = _startslice; i < _endslice; i++)
@@ -1747,6 +1831,7 @@ int SlicesHandler::ReloadRawTissues(const char* filename, short unsigned w,
 		unsigned short slicenr, Point p)
 {
 	UpdateColorLookupTable(nullptr);
+	_slice_tissues.invalidate_all();
 
 	int j = 0;
 	for (unsigned short i = _startslice; i < _endslice; i++)
@@ -2098,7 +2183,10 @@ FILE* SlicesHandler::LoadProject(const char* filename, int& tissuesVersion)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(_nrslices);
+	_slice_histograms.resize(_nrslices);
+	_slice_tissues.resize(_nrslices);
 	_slice_bmpranges.resize(_nrslices);
+	_slice_bmphistograms.resize(_nrslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -2157,7 +2245,10 @@ bool SlicesHandler::LoadS4Llink(const char* filename, int& tissuesVersion)
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -3395,7 +3486,10 @@ void SlicesHandler::newbmp(unsigned short width1, unsigned short height1, unsign
 	// Ranges
 	Pair dummy;
 	_slice_ranges.resize(nrofslices);
+	_slice_histograms.resize(nrofslices);
+	_slice_tissues.resize(nrofslices);
 	_slice_bmpranges.resize(nrofslices);
+	_slice_bmphistograms.resize(nrofslices);
 	compute_range_mode1(&dummy);
 	compute_bmprange_mode1(&dummy);
 
@@ -3510,25 +3604,30 @@ void SlicesHandler::copyfromtissuepadded(unsigned short slicenr,
 unsigned int SlicesHandler::make_histogram(bool includeoutofrange)
 {
 	// \note unused function
-	unsigned int histogram[256];
-	unsigned int* dummy;
-	unsigned int l = 0;
-
-	for (unsigned short i = _startslice; i < _endslice; i++)
-		l += _image_slices[i].make_histogram(includeoutofrange);
+	const Histogram h = histogram(false, _startslice, _endslice);
+	return (unsigned int)(h.below + h.above);
+}
 
-	dummy = (_image_slices[_startslice]).return_histogram();
-	for (unsigned short i = 0; i < 255; i++)
-		histogram[i] = dummy[i];
+unsigned int SlicesHandler::make_histogram(unsigned short slicenr, bool bmp, bool includeoutofrange)
+{
+	const Histogram h = histogram(bmp, slicenr, slicenr + 1);
+	const SliceHistogramCache& cache = bmp ? _slice_bmphistograms : _slice_histograms;
+	return _image_slices[slicenr].set_histogram(h.coarsened(cache.binning().nrbins / 256), includeoutofrange);
+}
 
-	for (unsigned short j = _startslice + 1; j < _endslice; j++)
+Histogram SlicesHandler::histogram(bool bmp, unsigned short first, unsigned short last)
+{
+	// Update histograms of modified slices only
+	SliceHistogramCache& cache = bmp ? _slice_bmphistograms : _slice_histograms;
+	if (cache.size() != _nrslices)
 	{
-		dummy = _image_slices[j].return_histogram();
-		for (unsigned short i = 0; i < 255; i++)
-			histogram[i] += dummy[i];
+		cache.resize(_nrslices);
 	}
 
-	return l;
+	cache.update(first, last, _area, [this, bmp](size_t i) -> const float* {
+		return bmp ? _image_slices[i].return_bmp() : _image_slices[i].return_work();
+	});
+	return cache.total(first, last);
 }
 
 unsigned int SlicesHandler::return_area()
@@ -3560,10 +3659,13 @@ bool SlicesHandler::isloaded() { return _loaded; }
 
 void SlicesHandler::gaussian(float sigma)
 {
-	for (unsigned short i = _startslice; i < _endslice; i++)
-		_image_slices[i].gaussian(sigma);
+	int const iN = _endslice;
 
-	return;
+#pragma omp parallel for
+	for (int i = _startslice; i < iN; i++)
+	{
+		_image_slices[i].gaussian(sigma);
+	}
 }
 
 void SlicesHandler::fill_holes(float f, int minsize)
@@ -3851,272 +3953,192 @@ void SlicesHandler::fill_unassignedtissue(tissues_size_t f)
 	}
 }
 
-void SlicesHandler::kmeans(unsigned short slicenr, short nrtissues, unsigned int iternr, unsigned int converge)
+namespace {
+/// Adds the same number of voxels of each slice to the sample, load(z) fills the channels of slice z
+template<typename TLoad>
+bool sample_slices(VoxelSample& sample, unsigned short startslice, unsigned short endslice,
+		unsigned area, const std::vector<const float*>& channels, TLoad load)
 {
-	if (slicenr >= _startslice && slicenr < _endslice)
+	const unsigned nrslices = endslice - startslice;
+	const unsigned per_slice = (area + nrslices - 1) / nrslices;
+	for (unsigned short z = startslice; z < endslice; z++)
 	{
-		KMeans kmeans;
-		float* bits[1];
-		bits[0] = _image_slices[slicenr].return_bmp();
-		float weights[1];
-		weights[0] = 1;
-		kmeans.init(_width, _height, nrtissues, 1, bits, weights);
-		kmeans.make_iter(iternr, converge);
-		kmeans.return_m(_image_slices[slicenr].return_work());
-		_image_slices[slicenr].set_mode(2, false);
+		if (!load(z))
+			return false;
+		sample.Add(channels.data(), area, per_slice);
+	}
+	return true;
+}
 
-		for (unsigned short i = _startslice; i < slicenr; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
-		for (unsigned short i = slicenr + 1; i < _endslice; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
+/// Classifies each slice into its work image
+template<typename TClassifier, typename TLoad>
+bool classify_slices(const TClassifier& classifier, std::vector<bmphandler>& image_slices, unsigned short startslice,
+		unsigned short endslice, unsigned area, const std::vector<const float*>& channels, TLoad load)
+{
+	for (unsigned short z = startslice; z < endslice; z++)
+	{
+		if (!load(z))
+			return false;
+		classifier.Classify(channels.data(), area, image_slices[z].return_work());
+		image_slices[z].set_mode(2, false);
 	}
+	return true;
 }
+} // namespace
 
-void SlicesHandler::kmeans_mhd(unsigned short slicenr, short nrtissues,
-		short dim, std::vector<std::string> mhdfiles,
-		float* weights, unsigned int iternr,
-		unsigned int converge)
+void SlicesHandler::kmeans(short nrtissues, unsigned int iternr, unsigned int converge)
+{
+	std::vector<const float*> bits(1);
+	auto load = [&](unsigned short z) {
+		bits[0] = _image_slices[z].return_bmp();
+		return true;
+	};
+
+	VoxelSample sample(1);
+	sample_slices(sample, _startslice, _endslice, _area, bits, load);
+
+	float weights[1] = {1};
+	VolumeKMeans kmeans(nrtissues, 1, weights);
+	kmeans.InitCenters(sample);
+	kmeans.Train(sample, iternr, converge);
+	classify_slices(kmeans, _image_slices, _startslice, _endslice, _area, bits, load);
+}
+
+void SlicesHandler::kmeans_mhd(short nrtissues, short dim,
+		std::vector<std::string> mhdfiles, float* weights,
+		unsigned int iternr, unsigned int converge)
 {
 	if (mhdfiles.size() + 1 < dim)
 		return;
-	if (slicenr >= _startslice && slicenr < _endslice)
-	{
-		KMeans kmeans;
-		float** bits = new float*[dim];
-		for (unsigned short j = 0; j + 1 < dim; j++)
-		{
-			bits[j + 1] = new float[_area];
-			if (bits[j + 1] == nullptr)
-			{
-				for (unsigned short i = 1; i < j; i++)
-					delete[] bits[i];
-				delete[] bits;
-				return;
-			}
-		}
 
-		bits[0] = _image_slices[slicenr].return_bmp();
-		for (unsigned short i = 0; i + 1 < dim; i++)
+	std::vector<std::vector<float>> buffers(dim - 1, std::vector<float>(_area));
+	std::vector<const float*> bits(dim);
+	for (unsigned short k = 0; k + 1 < dim; k++)
+		bits[k + 1] = buffers[k].data();
+	auto load = [&](unsigned short z) {
+		bits[0] = _image_slices[z].return_bmp();
+		for (unsigned short k = 0; k + 1 < dim; k++)
 		{
-			if (!ImageReader::getSlice(mhdfiles[i].c_str(), bits[i + 1],
-							slicenr, _width, _height))
-			{
-				for (unsigned short j = 1; j < dim; j++)
-					delete[] bits[j];
-				delete[] bits;
-				return;
-			}
+			if (!ImageReader::getSlice(mhdfiles[k].c_str(), buffers[k].data(), z, _width, _height))
+				return false;
 		}
-		kmeans.init(_width, _height, nrtissues, dim, bits, weights);
-		kmeans.make_iter(iternr, converge);
-		kmeans.return_m(_image_slices[slicenr].return_work());
-		_image_slices[slicenr].set_mode(2, false);
+		return true;
+	};
 
-		for (unsigned short i = _startslice; i < slicenr; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			for (unsigned short k = 0; k + 1 < dim; k++)
-			{
-				if (!ImageReader::getSlice(mhdfiles[k].c_str(), bits[k + 1], i,
-								_width, _height))
-				{
-					for (unsigned short j = 1; j < dim; j++)
-						delete[] bits[j];
-					delete[] bits;
-					return;
-				}
-			}
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
-		for (unsigned short i = slicenr + 1; i < _endslice; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			for (unsigned short k = 0; k + 1 < dim; k++)
-			{
-				if (!ImageReader::getSlice(mhdfiles[k].c_str(), bits[k + 1], i,
-								_width, _height))
-				{
-					for (unsigned short j = 1; j < dim; j++)
-						delete[] bits[j];
-					delete[] bits;
-					return;
-				}
-			}
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
+	VoxelSample sample(dim);
+	if (!sample_slices(sample, _startslice, _endslice, _area, bits, load))
+		return;
 
-		for (unsigned short j = 1; j < dim; j++)
-			delete[] bits[j];
-		delete[] bits;
-	}
+	VolumeKMeans kmeans(nrtissues, dim, weights);
+	kmeans.InitCenters(sample);
+	kmeans.Train(sample, iternr, converge);
+	classify_slices(kmeans, _image_slices, _startslice, _endslice, _area, bits, load);
 }
 
-void SlicesHandler::kmeans_png(unsigned short slicenr, short nrtissues,
-		short dim, std::vector<std::string> pngfiles,
+void SlicesHandler::kmeans_png(short nrtissues, short dim,
+		std::vector<std::string> pngfiles,
 		std::vector<int> exctractChannel, float* weights,
 		unsigned int iternr, unsigned int converge,
 		const std::string initCentersFile)
 {
-	if (pngfiles.size() + 1 < dim)
+	if (pngfiles.size() + 1 < dim || exctractChannel.size() + 1 < dim)
 		return;
-	if (slicenr >= _startslice && slicenr < _endslice)
-	{
-		float** bits = new float*[dim];
-		for (unsigned short j = 0; j + 1 < dim; j++)
-		{
-			bits[j + 1] = new float[_area];
-			if (bits[j + 1] == nullptr)
-			{
-				for (unsigned short i = 1; i < j; i++)
-					delete[] bits[i];
-				delete[] bits;
-				return;
-			}
-		}
-
-		bits[0] = _image_slices[slicenr].return_bmp();
-		for (unsigned short i = 0; i + 1 < dim; i++)
-		{
-			if (!ChannelExtractor::getSlice(pngfiles[0].c_str(), bits[i + 1],
-							exctractChannel[i], slicenr, _width,
-							_height))
-			{
-				for (unsigned short j = 1; j < dim; j++)
-					delete[] bits[j];
-				delete[] bits;
-				return;
-			}
-		}
 
-		KMeans kmeans;
-		if (initCentersFile != "")
-		{
-			float* centers = nullptr;
-			int dimensions;
-			int nrClasses;
-			if (kmeans.get_centers_from_file(initCentersFile, centers,
-							dimensions, nrClasses))
-			{
-				dim = dimensions;
-				nrtissues = nrClasses;
-				kmeans.init(_width, _height, nrtissues, dim, bits, weights,
-						centers);
-			}
-			else
-			{
-				QMessageBox msgBox;
-				msgBox.setText("ERROR: reading centers initialization file.");
-				msgBox.exec();
-				return;
-			}
-		}
-		else
+	std::vector<float> init_centers;
+	if (initCentersFile != "")
+	{
+		KMeans reader;
+		float* centers = nullptr;
+		int dimensions;
+		int nrClasses;
+		if (!reader.get_centers_from_file(initCentersFile, centers, dimensions, nrClasses) || dimensions != dim)
 		{
-			kmeans.init(_width, _height, nrtissues, dim, bits, weights);
+			free(centers);
+			QMessageBox msgBox;
+			msgBox.setText("ERROR: reading centers initialization file.");
+			msgBox.exec();
+			return;
 		}
-		kmeans.make_iter(iternr, converge);
-		kmeans.return_m(_image_slices[slicenr].return_work());
-		_image_slices[slicenr].set_mode(2, false);
+		nrtissues = nrClasses;
+		init_centers.assign(centers, centers + dimensions * nrClasses);
+		free(centers);
+	}
 
-		for (unsigned short i = _startslice; i < slicenr; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			for (unsigned short k = 0; k + 1 < dim; k++)
-			{
-				if (!ChannelExtractor::getSlice(pngfiles[0].c_str(),
-								bits[i + 1], exctractChannel[i],
-								i, _width, _height))
-				{
-					for (unsigned short j = 1; j < dim; j++)
-						delete[] bits[j];
-					delete[] bits;
-					return;
-				}
-			}
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
-		for (unsigned short i = slicenr + 1; i < _endslice; i++)
+	std::vector<std::vector<float>> buffers(dim - 1, std::vector<float>(_area));
+	std::vector<const float*> bits(dim);
+	for (unsigned short k = 0; k + 1 < dim; k++)
+		bits[k + 1] = buffers[k].data();
+	auto load = [&](unsigned short z) {
+		bits[0] = _image_slices[z].return_bmp();
+		for (unsigned short k = 0; k + 1 < dim; k++)
 		{
-			bits[0] = _image_slices[i].return_bmp();
-			for (unsigned short k = 0; k + 1 < dim; k++)
-			{
-				if (!ChannelExtractor::getSlice(pngfiles[0].c_str(),
-								bits[i + 1], exctractChannel[i],
-								i, _width, _height))
-				{
-					for (unsigned short j = 1; j < dim; j++)
-						delete[] bits[j];
-					delete[] bits;
-					return;
-				}
-			}
-			kmeans.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
+			if (!ChannelExtractor::getSlice(pngfiles[0].c_str(), buffers[k].data(), exctractChannel[k], z, _width, _height))
+				return false;
 		}
+		return true;
+	};
 
-		for (unsigned short j = 1; j < dim; j++)
-			delete[] bits[j];
-		delete[] bits;
-	}
+	VolumeKMeans kmeans(nrtissues, dim, weights);
+	VoxelSample sample(dim);
+	if (!sample_slices(sample, _startslice, _endslice, _area, bits, load))
+		return;
+	if (init_centers.empty())
+		kmeans.InitCenters(sample);
+	else
+		kmeans.SetCenters(init_centers.data());
+	kmeans.Train(sample, iternr, converge);
+	classify_slices(kmeans, _image_slices, _startslice, _endslice, _area, bits, load);
 }
 
-void SlicesHandler::em(unsigned short slicenr, short nrtissues,
-		unsigned int iternr, unsigned int converge)
+void SlicesHandler::em(short nrtissues, unsigned int iternr, unsigned int converge)
 {
-	if (slicenr >= _startslice && slicenr < _endslice)
-	{
-		ExpectationMaximization em;
-		float* bits[1];
-		bits[0] = _image_slices[slicenr].return_bmp();
-		float weights[1];
-		weights[0] = 1;
-		em.init(_width, _height, nrtissues, 1, bits, weights);
-		em.make_iter(iternr, converge);
-		em.classify(_image_slices[slicenr].return_work());
-		_image_slices[slicenr].set_mode(2, false);
+	std::vector<const float*> bits(1);
+	auto load = [&](unsigned short z) {
+		bits[0] = _image_slices[z].return_bmp();
+		return true;
+	};
 
-		for (unsigned short i = _startslice; i < slicenr; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			em.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
-		for (unsigned short i = slicenr + 1; i < _endslice; i++)
-		{
-			bits[0] = _image_slices[i].return_bmp();
-			em.apply_to(bits, _image_slices[i].return_work());
-			_image_slices[i].set_mode(2, false);
-		}
-	}
+	VoxelSample sample(1);
+	sample_slices(sample, _startslice, _endslice, _area, bits, load);
+
+	float weights[1] = {1};
+	VolumeEM em(nrtissues, 1, weights);
+	em.InitCenters(sample);
+	em.Train(sample, iternr, converge);
+	classify_slices(em, _image_slices, _startslice, _endslice, _area, bits, load);
 }
 
-void SlicesHandler::aniso_diff(float dt, int n, float (*f)(float, float),
+void SlicesHandler::aniso_diff(float dt, int n, diffusion::eConductance f,
 		float k, float restraint)
 {
-	for (unsigned short i = _startslice; i < _endslice; i++)
-		_image_slices[i].aniso_diff(dt, n, f, k, restraint);
+	int const iN = _endslice;
 
-	return;
+#pragma omp parallel for
+	for (int i = _startslice; i < iN; i++)
+	{
+		_image_slices[i].bmp2work();
+	}
+
+	cont_anisodiff(dt, n, f, k, restraint);
 }
 
-void SlicesHandler::cont_anisodiff(float dt, int n, float (*f)(float, float),
+void SlicesHandler::cont_anisodiff(float dt, int n, diffusion::eConductance f,
 		float k, float restraint)
 {
+	std::vector<float*> works;
+	std::vector<const float*> bmps;
 	for (unsigned short i = _startslice; i < _endslice; i++)
-		_image_slices[i].cont_anisodiff(dt, n, f, k, restraint);
+	{
+		works.push_back(_image_slices[i].return_work());
+		bmps.push_back(_image_slices[i].return_bmp());
+	}
+	const float spacing[3] = {_dx, _dy, _thickness};
+	AnisotropicDiffusion(works.data(), bmps.data(), _width, _height, works.size(), spacing, dt, n, restraint, f, k);
 
-	return;
+	for (unsigned short i = _startslice; i < _endslice; i++)
+	{
+		_image_slices[i].set_mode(1, false);
+	}
 }
 
 void SlicesHandler::median_interquartile(bool median)
@@ -4127,15 +4149,57 @@ void SlicesHandler::median_interquartile(bool median)
 
 void SlicesHandler::average(unsigned short n)
 {
-	for (unsigned short i = _startslice; i < _endslice; i++)
+	int const iN = _endslice;
+
+#pragma omp parallel for
+	for (int i = _startslice; i < iN; i++)
+	{
 		_image_slices[i].average(n);
+	}
 }
 
 void SlicesHandler::sigmafilter(float sigma, unsigned short nx,
-		unsigned short ny)
+		unsigned short ny, unsigned short nz)
+{
+	if (nx % 2 == 0)
+		nx++;
+	if (ny % 2 == 0)
+		ny++;
+	if (nz % 2 == 0)
+		nz++;
+
+	std::vector<const float*> bmps;
+	std::vector<float*> works;
+	for (unsigned short i = _startslice; i < _endslice; i++)
+	{
+		bmps.push_back(_image_slices[i].return_bmp());
+		works.push_back(_image_slices[i].return_work());
+	}
+	SigmaFilter(bmps.data(), works.data(), _width, _height, bmps.size(), sigma, nx, ny, nz);
+
+	for (unsigned short i = _startslice; i < _endslice; i++)
+	{
+		_image_slices[i].set_mode(1, false);
+	}
+}
+
+void SlicesHandler::bilateral(float sigma_space, float sigma_range, bool in3d)
 {
+	std::vector<const float*> bmps;
+	std::vector<float*> works;
+	for (unsigned short i = _startslice; i < _endslice; i++)
+	{
+		bmps.push_back(_image_slices[i].return_bmp());
+		works.push_back(_image_slices[i].return_work());
+	}
+	const float sigma[3] = {sigma_space, sigma_space * _dx / _dy,
+			in3d ? sigma_space * _dx / _thickness : 0.0f};
+	BilateralFilter(bmps.data(), works.data(), _width, _height, bmps.size(), sigma, sigma_range);
+
 	for (unsigned short i = _startslice; i < _endslice; i++)
-		_image_slices[i].sigmafilter(sigma, nx, ny);
+	{
+		_image_slices[i].set_mode(1, false);
+	}
 }
 
 void SlicesHandler::threshold(float* thresholds)
@@ -4153,196 +4217,256 @@ void SlicesHandler::extractinterpolatesave_contours(
 		int minsize, std::vector<tissues_size_t>& tissuevec, unsigned short between,
 		bool dp, float epsilon, const char* filename)
 {
-	/*	os.clear();
-	os.set_sizenr((between+1)*nrslices-between);
-	os.set_thickness(thickness/(between+1));*/
+	extractinterpolatesave_outlines(minsize, tissuevec, between, dp, epsilon, filename, false);
+}
 
-	std::vector<std::vector<Point>> v1, v2;
-	std::vector<Point_type> vP;
+void SlicesHandler::extractinterpolatesave_contours2_xmirrored(
+		int minsize, std::vector<tissues_size_t>& tissuevec, unsigned short between,
+		bool dp, float epsilon, const char* filename)
+{
+	extractinterpolatesave_outlines(minsize, tissuevec, between, dp, epsilon, filename, true);
+}
 
+void SlicesHandler::extractinterpolatesave_outlines(
+		int minsize, std::vector<tissues_size_t>& tissuevec, unsigned short between,
+		bool dp, float epsilon, const char* filename, bool xmirrored)
+{
 	SlicesHandler dummy3D;
 	dummy3D.newbmp((unsigned short)(_image_slices[0].return_width()),
 			(unsigned short)(_image_slices[0].return_height()),
 			between + 2);
 	dummy3D.set_slicethickness(_thickness / (between + 1));
 	Pair pair1 = get_pixelsize();
-	dummy3D.set_pixelsize(pair1.high, pair1.low);
+	if (xmirrored)
+		dummy3D.set_pixelsize(pair1.high / 2, pair1.low / 2);
+	else
+		dummy3D.set_pixelsize(pair1.high, pair1.low);
 
 	FILE* fp = dummy3D.save_contourprologue(filename,
 			(between + 1) * _nrslices - between);
+	if (fp == nullptr)
+		return;
 
-	for (unsigned short j = 0; j + 1 < _nrslices; j++)
-	{
-		dummy3D.copy2tissue(0, _image_slices[j].return_tissues(_active_tissuelayer));
-		dummy3D.copy2tissue(between + 1, _image_slices[j + 1].return_tissues(
-																				 _active_tissuelayer));
-		dummy3D.interpolatetissuegrey(0, between + 1); // TODO: Use interpolatetissuegrey_medianset?
+	const tissues_size_t nr_tissues = TissueInfos::GetTissueCount();
+	const tissuelayers_size_t idx = _active_tissuelayer;
+	const float thickness = _thickness / (between + 1);
+	std::set<tissues_size_t> tissueIndices;
+	unsigned slicenr = 0;
+
+	// the next gaps are interpolated and traced while the outlines of the previous ones are written
+	RunPipeline<std::vector<OutlineSlice>>(4,
+			[&](BoundedQueue<std::vector<OutlineSlice>>& queue) {
+				const int n = between + 1;
+				for (unsigned short j = 0; j + 1 < _nrslices; j++)
+				{
+					dummy3D.copy2tissue(0, _image_slices[j].return_tissues(idx));
+					dummy3D.copy2tissue(between + 1, _image_slices[j + 1].return_tissues(idx));
+					dummy3D.interpolatetissuegrey(0, between + 1); // TODO: Use interpolatetissuegrey_medianset?
 
-		dummy3D.extract_contours(minsize, tissuevec);
-		if (dp)
-			dummy3D.dougpeuck_line(epsilon);
-		fp = dummy3D.save_contoursection(fp, 0, between, (between + 1) * j);
-	}
+					std::vector<OutlineSlice> outlines(n);
+#pragma omp parallel for
+					for (int i = 0; i < n; i++)
+					{
+						outlines[i] = dummy3D.trace_outline(dummy3D._image_slices[i], tissuevec,
+								minsize, xmirrored, dp, epsilon, thickness);
+					}
+					if (!queue.Push(std::move(outlines)))
+						return;
+				}
 
-	fp = dummy3D.save_contoursection(fp, 0, 0, (between + 1) * (_nrslices - 1));
+				dummy3D.copy2tissue(between + 1, _image_slices[_nrslices - 1].return_tissues(idx));
+				std::vector<OutlineSlice> last(1, dummy3D.trace_outline(dummy3D._image_slices[between + 1],
+															tissuevec, minsize, xmirrored, dp, epsilon, thickness));
+				queue.Push(std::move(last));
+			},
+			[&](std::vector<OutlineSlice>& outlines) {
+				for (size_t i = 0; i < outlines.size(); i++, slicenr++)
+				{
+					OutlineSlices::printslice(fp, slicenr, outlines[i], nr_tissues);
+					outlines[i].insert_tissue_indices(tissueIndices);
+				}
+			});
 
-	fp = dummy3D.save_tissuenamescolors(fp);
+	fp = save_tissuenamescolors(fp, tissueIndices);
 
 	fclose(fp);
 }
 
-void SlicesHandler::extractinterpolatesave_contours2_xmirrored(
-		int minsize, std::vector<tissues_size_t>& tissuevec, unsigned short between,
-		bool dp, float epsilon, const char* filename)
+bool SlicesHandler::extractsave_contours2_xmirrored(int minsize,
+		std::vector<tissues_size_t>& tissuevec, bool dp, float epsilon,
+		const char* filename, int top, int bottom)
 {
-	std::vector<std::vector<Point>> v1, v2;
-	std::vector<Point_type> vP;
+	FILE* fp = save_contourprologue(filename, _nrslices);
+	if (fp == nullptr)
+		return false;
 
-	SlicesHandler dummy3D;
-	dummy3D.newbmp((unsigned short)(_image_slices[0].return_width()),
-			(unsigned short)(_image_slices[0].return_height()),
-			between + 2);
-	dummy3D.set_slicethickness(_thickness / (between + 1));
-	Pair pair1 = get_pixelsize();
-	dummy3D.set_pixelsize(pair1.high / 2, pair1.low / 2);
+	const tissues_size_t nr_tissues = TissueInfos::GetTissueCount();
+	std::set<tissues_size_t> tissueIndices;
+	unsigned slicenr = 0;
 
-	FILE* fp = dummy3D.save_contourprologue(filename,
-			(between + 1) * _nrslices - between);
+	// chunks of slices are traced in parallel while the previous ones are written
+	RunPipeline<std::vector<OutlineSlice>>(4,
+			[&](BoundedQueue<std::vector<OutlineSlice>>& queue) {
+				const int chunk = 16;
+				for (int start = 0; start < _nrslices; start += chunk)
+				{
+					const int n = std::min(chunk, _nrslices - start);
+					std::vector<OutlineSlice> outlines(n);
+#pragma omp parallel for schedule(dynamic, 1)
+					for (int i = 0; i < n; i++)
+					{
+						float thickness = _thickness;
+						if (start + i == 0)
+							thickness = bottom * _thickness;
+						else if (start + i + 1 == _nrslices)
+							thickness = top * _thickness;
+						outlines[i] = trace_outline(_image_slices[start + i], tissuevec,
+								minsize, true, dp, epsilon, thickness);
+					}
+					if (!queue.Push(std::move(outlines)))
+						return;
+				}
+			},
+			[&](std::vector<OutlineSlice>& outlines) {
+				for (size_t i = 0; i < outlines.size(); i++, slicenr++)
+				{
+					OutlineSlices::printslice(fp, slicenr, outlines[i], nr_tissues);
+					outlines[i].insert_tissue_indices(tissueIndices);
+				}
+			});
 
-	for (unsigned short j = 0; j + 1 < _nrslices; j++)
-	{
-		dummy3D.copy2tissue(0,
-				_image_slices[j].return_tissues(_active_tissuelayer));
-		dummy3D.copy2tissue(between + 1, _image_slices[j + 1].return_tissues(
-																				 _active_tissuelayer));
-		dummy3D.interpolatetissuegrey(
-				0, between + 1); // TODO: Use interpolatetissuegrey_medianset?
+	fp = save_tissuenamescolors(fp, tissueIndices);
+	fclose(fp);
+	return true;
+}
 
-		//		dummy3D.extract_contours2(minsize, tissuevec);
-		if (dp)
-		{
-			//			dummy3D.dougpeuck_line(epsilon*2);
-			dummy3D.extract_contours2_xmirrored(minsize, tissuevec, epsilon);
-		}
-		else
-		{
-			dummy3D.extract_contours2_xmirrored(minsize, tissuevec);
-		}
-		dummy3D.shift_contours(-(int)dummy3D.width(),
-				-(int)dummy3D.height());
-		fp = dummy3D.save_contoursection(fp, 0, between, (between + 1) * j);
+namespace {
+/// Tissues in the order of their first occurrence. The contours are collected per tissue, so a tissue listed
+/// twice would only get outlines in one of its slots.
+std::vector<tissues_size_t> unique_tissues(const std::vector<tissues_size_t>& tissuevec)
+{
+	std::vector<tissues_size_t> tissues;
+	std::set<tissues_size_t> listed;
+	for (auto t : tissuevec)
+	{
+		if (listed.insert(t).second)
+			tissues.push_back(t);
 	}
+	return tissues;
+}
+} // namespace
 
-	fp = dummy3D.save_contoursection(fp, 0, 0, (between + 1) * (_nrslices - 1));
+OutlineSlice SlicesHandler::trace_outline(bmphandler& slice,
+		const std::vector<tissues_size_t>& tissuelist, int minsize, bool xmirrored,
+		bool dp, float epsilon, float thickness) const
+{
+	const std::vector<tissues_size_t> tissuevec = unique_tissues(tissuelist);
+	std::vector<std::vector<std::vector<Point>>> outer, inner;
+	if (!xmirrored)
+		slice.get_tissuecontours(_active_tissuelayer, tissuevec, outer, inner, minsize);
+	else if (dp)
+		slice.get_tissuecontours2_xmirrored(_active_tissuelayer, tissuevec, outer, inner, minsize, epsilon);
+	else
+		slice.get_tissuecontours2_xmirrored(_active_tissuelayer, tissuevec, outer, inner, minsize);
 
-	fp = dummy3D.save_tissuenamescolors(fp);
+	OutlineSlice outline(thickness);
+	for (size_t k = 0; k < tissuevec.size(); k++)
+	{
+		for (std::vector<std::vector<Point>>::iterator it = outer[k].begin();
+				 it != outer[k].end(); it++)
+			outline.add_line(tissuevec[k], &(*it), true);
+		for (std::vector<std::vector<Point>>::iterator it = inner[k].begin();
+				 it != inner[k].end(); it++)
+			outline.add_line(tissuevec[k], &(*it), false);
+	}
 
-	fclose(fp);
+	if (xmirrored)
+		outline.shift_contours(-(int)_width, -(int)_height);
+	else if (dp)
+		outline.doug_peuck(epsilon, true);
+	return outline;
 }
 
-void SlicesHandler::extract_contours(int minsize,
-		std::vector<tissues_size_t>& tissuevec)
+void SlicesHandler::extract_tissuecontours(
+		const std::vector<tissues_size_t>& tissuevec,
+		const std::function<void(bmphandler&, const std::vector<tissues_size_t>&, std::vector<std::vector<std::vector<Point>>>&,
+				std::vector<std::vector<std::vector<Point>>>&)>& trace)
 {
 	_os.clear();
-	std::vector<std::vector<Point>> v1, v2;
-	std::vector<Point_type> vP;
 
-	for (std::vector<tissues_size_t>::iterator it1 = tissuevec.begin();
-			 it1 != tissuevec.end(); it1++)
+	const std::vector<tissues_size_t> tissues = unique_tissues(tissuevec);
+
+	// OutlineSlices is not thread safe, slices are traced in parallel in chunks and merged in order
+	const int chunk = 64;
+	std::vector<std::vector<std::vector<std::vector<Point>>>> outer(chunk), inner(chunk);
+	for (int start = 0; start < _nrslices; start += chunk)
 	{
-		for (unsigned short i = 0; i < _nrslices; i++)
+		const int n = std::min(chunk, _nrslices - start);
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < n; i++)
 		{
-			v1.clear();
-			v2.clear();
-			_image_slices[i]
-					.get_tissuecontours(_active_tissuelayer, *it1, &v1, &v2,
-							minsize);
-			for (std::vector<std::vector<Point>>::iterator it = v1.begin();
-					 it != v1.end(); it++)
-			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,true);
-				_os.add_line(i, *it1, &(*it), true);
-			}
-			for (std::vector<std::vector<Point>>::iterator it = v2.begin();
-					 it != v2.end(); it++)
+			trace(_image_slices[start + i], tissues, outer[i], inner[i]);
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			for (size_t k = 0; k < tissues.size(); k++)
 			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,false);
-				_os.add_line(i, *it1, &(*it), false);
+				for (std::vector<std::vector<Point>>::iterator it = outer[i][k].begin();
+						 it != outer[i][k].end(); it++)
+					_os.add_line(start + i, tissues[k], &(*it), true);
+				for (std::vector<std::vector<Point>>::iterator it = inner[i][k].begin();
+						 it != inner[i][k].end(); it++)
+					_os.add_line(start + i, tissues[k], &(*it), false);
 			}
 		}
 	}
 }
 
-void SlicesHandler::extract_contours2_xmirrored(
-		int minsize, std::vector<tissues_size_t>& tissuevec)
+const SliceTissueIndex<tissues_size_t>& SlicesHandler::update_tissue_index()
 {
-	_os.clear();
-	std::vector<std::vector<Point>> v1, v2;
-	std::vector<Point_type> vP;
-
-	for (std::vector<tissues_size_t>::iterator it1 = tissuevec.begin();
-			 it1 != tissuevec.end(); it1++)
+	if (_slice_tissues.size() != _nrslices)
 	{
-		for (unsigned short i = 0; i < _nrslices; i++)
-		{
-			v1.clear();
-			v2.clear();
-			_image_slices[i]
-					.get_tissuecontours2_xmirrored(_active_tissuelayer, *it1, &v1,
-							&v2, minsize);
-			for (std::vector<std::vector<Point>>::iterator it = v1.begin();
-					 it != v1.end(); it++)
-			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,true);
-				_os.add_line(i, *it1, &(*it), true);
-			}
-			for (std::vector<std::vector<Point>>::iterator it = v2.begin();
-					 it != v2.end(); it++)
-			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,false);
-				_os.add_line(i, *it1, &(*it), false);
-			}
-		}
+		_slice_tissues.resize(_nrslices);
 	}
+
+	_slice_tissues.update(0, _nrslices, _width, _height, [this](size_t i) -> const tissues_size_t* {
+		return _image_slices[i].return_tissues(_active_tissuelayer);
+	});
+	return _slice_tissues;
+}
+
+void SlicesHandler::extract_contours(int minsize,
+		std::vector<tissues_size_t>& tissuevec)
+{
+	const tissuelayers_size_t idx = _active_tissuelayer;
+	extract_tissuecontours(tissuevec,
+			[&](bmphandler& slice, const std::vector<tissues_size_t>& tissues, std::vector<std::vector<std::vector<Point>>>& outer,
+					std::vector<std::vector<std::vector<Point>>>& inner) {
+				slice.get_tissuecontours(idx, tissues, outer, inner, minsize);
+			});
 }
 
 void SlicesHandler::extract_contours2_xmirrored(
-		int minsize, std::vector<tissues_size_t>& tissuevec, float epsilon)
+		int minsize, std::vector<tissues_size_t>& tissuevec)
 {
-	_os.clear();
-	std::vector<std::vector<Point>> v1, v2;
-	std::vector<Point_type> vP;
+	const tissuelayers_size_t idx = _active_tissuelayer;
+	extract_tissuecontours(tissuevec,
+			[&](bmphandler& slice, const std::vector<tissues_size_t>& tissues, std::vector<std::vector<std::vector<Point>>>& outer,
+					std::vector<std::vector<std::vector<Point>>>& inner) {
+				slice.get_tissuecontours2_xmirrored(idx, tissues, outer, inner, minsize);
+			});
+}
 
-	for (std::vector<tissues_size_t>::iterator it1 = tissuevec.begin();
-			 it1 != tissuevec.end(); it1++)
-	{
-		for (unsigned short i = 0; i < _nrslices; i++)
-		{
-			v1.clear();
-			v2.clear();
-			_image_slices[i]
-					.get_tissuecontours2_xmirrored(_active_tissuelayer, *it1, &v1,
-							&v2, minsize, epsilon);
-			for (std::vector<std::vector<Point>>::iterator it = v1.begin();
-					 it != v1.end(); it++)
-			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,true);
-				_os.add_line(i, *it1, &(*it), true);
-			}
-			for (std::vector<std::vector<Point>>::iterator it = v2.begin();
-					 it != v2.end(); it++)
-			{
-				//			Pointconvert(*it,vP);
-				//			os.add_line(i,tissuetype,&vP,false);
-				_os.add_line(i, *it1, &(*it), false);
-			}
-		}
-	}
+void SlicesHandler::extract_contours2_xmirrored(
+		int minsize, std::vector<tissues_size_t>& tissuevec, float epsilon)
+{
+	const tissuelayers_size_t idx = _active_tissuelayer;
+	extract_tissuecontours(tissuevec,
+			[&](bmphandler& slice, const std::vector<tissues_size_t>& tissues, std::vector<std::vector<std::vector<Point>>>& outer,
+					std::vector<std::vector<std::vector<Point>>>& inner) {
+				slice.get_tissuecontours2_xmirrored(idx, tissues, outer, inner, minsize, epsilon);
+			});
 }
 
 void SlicesHandler::extract_contours(float f, int minsize,
@@ -4466,42 +4590,25 @@ void SlicesHandler::get_range(Pair* pp)
 
 void SlicesHandler::compute_range_mode1(Pair* pp)
 {
-	// Update ranges for all mode 1 slices and compute total range
-	pp->low = FLT_MAX;
-	pp->high = 0.f;
-
-#pragma omp parallel
+	// Update ranges for all modified mode 1 slices and compute total range
+	if (_slice_ranges.size() != _nrslices)
 	{
-		// this data is thread private
-		Pair p;
-		float low = FLT_MAX;
-		float high = 0.f;
-
-		const int iN = _nrslices;
-#pragma omp for
-		for (int i = 0; i < iN; i++)
-		{
-			if (_image_slices[i].return_mode(false) == 1)
-			{
-				_image_slices[i].get_range(&p);
-				_slice_ranges[i] = p;
-				if (high < p.high)
-					high = p.high;
-				if (low > p.low)
-					low = p.low;
-			}
-		}
+		_slice_ranges.resize(_nrslices);
+	}
 
-#pragma omp critical
+	const int iN = _nrslices;
+#pragma omp parallel for
+	for (int i = 0; i < iN; i++)
+	{
+		if (_image_slices[i].return_mode(false) == 1 && !_slice_ranges.is_valid(i))
 		{
-			if (low < pp->low)
-				pp->low = low;
-			if (high > pp->high)
-				pp->high = high;
+			Pair p;
+			_image_slices[i].get_range(&p);
+			_slice_ranges.set(i, p);
 		}
 	}
 
-	if (pp->high < pp->low)
+	if (!_slice_ranges.total([this](size_t i) { return _image_slices[i].return_mode(false) == 1; }, *pp))
 	{
 		// No mode 1 slices: Set to mode 2 range
 		pp->low = 255.0f;
@@ -4510,31 +4617,10 @@ void SlicesHandler::compute_range_mode1(Pair* pp)
 
 void SlicesHandler::compute_range_mode1(unsigned short updateSlicenr, Pair* pp)
 {
-	// Update range for single mode 1 slice
-	if (_image_slices[updateSlicenr].return_mode(false) == 1)
-	{
-		_image_slices[updateSlicenr].get_range(&_slice_ranges[updateSlicenr]);
-	}
-
-	// Compute total range
-	pp->high = 0.0f;
-	pp->low = FLT_MAX;
-	for (unsigned short i = 0; i < _nrslices; ++i)
-	{
-		if (_image_slices[i].return_mode(false) != 1)
-			continue;
-		Pair p = _slice_ranges[i];
-		if (pp->high < p.high)
-			pp->high = p.high;
-		if (pp->low > p.low)
-			pp->low = p.low;
-	}
-
-	if (pp->high == 0.0f && pp->low == FLT_MAX)
-	{
-		// No mode 1 slices: Set to mode 2 range
-		pp->low = 255.0f;
-	}
+	// Update range for single mode 1 slice, other slices are only recomputed if modified
+	_slice_ranges.invalidate(updateSlicenr);
+	_slice_histograms.invalidate(updateSlicenr);
+	compute_range_mode1(pp);
 }
 
 void SlicesHandler::get_bmprange(Pair* pp)
@@ -4554,41 +4640,25 @@ void SlicesHandler::get_bmprange(Pair* pp)
 
 void SlicesHandler::compute_bmprange_mode1(Pair* pp)
 {
-	// Update ranges for all mode 1 slices and compute total range
-	pp->low = FLT_MAX;
-	pp->high = 0.f;
-
-#pragma omp parallel
+	// Update ranges for all modified mode 1 slices and compute total range
+	if (_slice_bmpranges.size() != _nrslices)
 	{
-		// this data is thread private
-		Pair p;
-		float low = FLT_MAX;
-		float high = 0.f;
-
-		const int iN = _nrslices;
-#pragma omp for
-		for (int i = 0; i < iN; ++i)
-		{
-			if (_image_slices[i].return_mode(true) == 1)
-			{
-				_image_slices[i].get_bmprange(&p);
-				_slice_bmpranges[i] = p;
-
-				high = std::max(high, p.high);
-				low = std::min(low, p.low);
-			}
-		}
+		_slice_bmpranges.resize(_nrslices);
+	}
 
-#pragma omp critical
+	const int iN = _nrslices;
+#pragma omp parallel for
+	for (int i = 0; i < iN; ++i)
+	{
+		if (_image_slices[i].return_mode(true) == 1 && !_slice_bmpranges.is_valid(i))
 		{
-			if (low < pp->low)
-				pp->low = low;
-			if (high > pp->high)
-				pp->high = high;
+			Pair p;
+			_image_slices[i].get_bmprange(&p);
+			_slice_bmpranges.set(i, p);
 		}
 	}
 
-	if (pp->high < pp->low)
+	if (!_slice_bmpranges.total([this](size_t i) { return _image_slices[i].return_mode(true) == 1; }, *pp))
 	{
 		// No mode 1 slices: Set to mode 2 range
 		pp->low = 255.0f;
@@ -4597,30 +4667,47 @@ void SlicesHandler::compute_bmprange_mode1(Pair* pp)
 
 void SlicesHandler::compute_bmprange_mode1(unsigned short updateSlicenr, Pair* pp)
 {
-	// Update range for single mode 1 slice
-	if (_image_slices[updateSlicenr].return_mode(true) == 1)
-	{
-		_image_slices[updateSlicenr].get_bmprange(&_slice_bmpranges[updateSlicenr]);
-	}
+	// Update range for single mode 1 slice, other slices are only recomputed if modified
+	_slice_bmpranges.invalidate(updateSlicenr);
+	_slice_bmphistograms.invalidate(updateSlicenr);
+	compute_bmprange_mode1(pp);
+}
 
-	// Compute total range
-	pp->high = 0.0f;
-	pp->low = FLT_MAX;
-	for (unsigned short i = 0; i < _nrslices; ++i)
+void SlicesHandler::invalidate_ranges(const DataSelection& dataSelection)
+{
+	if (dataSelection.allSlices)
 	{
-		if (_image_slices[i].return_mode(true) != 1)
-			continue;
-		Pair p = _slice_bmpranges[i];
-		if (pp->high < p.high)
-			pp->high = p.high;
-		if (pp->low > p.low)
-			pp->low = p.low;
+		if (dataSelection.bmp)
+		{
+			_slice_bmpranges.invalidate_all();
+			_slice_bmphistograms.invalidate_all();
+		}
+		if (dataSelection.work)
+		{
+			_slice_ranges.invalidate_all();
+			_slice_histograms.invalidate_all();
+		}
+		if (dataSelection.tissues)
+		{
+			_slice_tissues.invalidate_all();
+		}
 	}
-
-	if (pp->high < pp->low)
+	else
 	{
-		// No mode 1 slices: Set to mode 2 range
-		pp->low = 255.0f;
+		if (dataSelection.bmp)
+		{
+			_slice_bmpranges.invalidate(dataSelection.sliceNr);
+			_slice_bmphistograms.invalidate(dataSelection.sliceNr);
+		}
+		if (dataSelection.work)
+		{
+			_slice_ranges.invalidate(dataSelection.sliceNr);
+			_slice_histograms.invalidate(dataSelection.sliceNr);
+		}
+		if (dataSelection.tissues)
+		{
+			_slice_tissues.invalidate(dataSelection.sliceNr);
+		}
 	}
 }
 
@@ -4688,6 +4775,14 @@ FILE* SlicesHandler::save_contoursection(FILE* fp, unsigned startslice1, unsigne
 }
 
 FILE* SlicesHandler::save_tissuenamescolors(FILE* fp)
+{
+	// Collect used tissue indices in ascending order
+	std::set<tissues_size_t> tissueIndices;
+	_os.insert_tissue_indices(tissueIndices);
+	return save_tissuenamescolors(fp, tissueIndices);
+}
+
+FILE* SlicesHandler::save_tissuenamescolors(FILE* fp, const std::set<tissues_size_t>& tissueIndices)
 {
 	tissues_size_t tissueCount = TissueInfos::GetTissueCount();
 	TissueInfo* tissueInfo;
@@ -4696,11 +4791,7 @@ FILE* SlicesHandler::save_tissuenamescolors(FILE* fp)
 
 	if (tissueCount > 255)
 	{ // Only print tissue indices which contain outlines
-
-		// Collect used tissue indices in ascending order
-		std::set<tissues_size_t> tissueIndices;
-		_os.insert_tissue_indices(tissueIndices);
-		std::set<tissues_size_t>::iterator idxIt;
+		std::set<tissues_size_t>::const_iterator idxIt;
 		for (idxIt = tissueIndices.begin(); idxIt != tissueIndices.end();
 				 ++idxIt)
 		{
@@ -4820,123 +4911,58 @@ void SlicesHandler::thresholded_growing(
 {
 	if (slicenr >= _startslice && slicenr < _endslice)
 	{
-		unsigned position = p.px + p.py * (unsigned)_width;
-		std::vector<posit> s;
-		posit p1;
+		auto all_bmp = source_slices();
+		std::vector<const float*> bmp(all_bmp.begin() + _startslice, all_bmp.begin() + _endslice);
+		auto all_tissues = tissue_slices(active_tissuelayer());
+		std::vector<const tissues_size_t*> tissues(all_tissues.begin() + _startslice, all_tissues.begin() + _endslice);
+		const std::vector<char> locked = tissue_lock_table();
 
-		for (unsigned short z = _startslice; z < _endslice; z++)
-		{
-			float* work = _image_slices[z].return_work();
-			float* bmp = _image_slices[z].return_bmp();
-			int i = 0;
-			for (unsigned short j = 0; j < _height; j++)
-			{
-				for (unsigned short k = 0; k < _width; k++)
-				{
-					if (bmp[i] > thresh_high || bmp[i] < thresh_low)
-						work[i] = 0;
-					else
-						work[i] = -1;
-					i++;
-				}
-			}
-		}
+		auto grow = [&](size_t z, size_t i) {
+			return bmp[z][i] >= thresh_low && bmp[z][i] <= thresh_high && !locked[tissues[z][i]];
+		};
 
-		p1.pxy = position;
-		p1.pz = slicenr;
+		std::vector<std::vector<growing::Span>> seeds(bmp.size());
+		growing::Span seed;
+		seed.y = p.py;
+		seed.x0 = seed.x1 = p.px;
+		seeds[slicenr - _startslice].push_back(seed);
 
-		s.push_back(p1);
-		float* work = _image_slices[slicenr].return_work();
-		work[position] = set_to;
+		auto grown = RegionGrowing(_width, _height, bmp.size(), grow, false, seeds);
+		write_mask_to_work(grown, set_to);
+	}
 
-		//	hysteretic_growth(results,&s,width+2,height+2,connectivity,set_to);
-		posit i, j;
+	return;
+}
 
-		while (!s.empty())
-		{
-			i = s.back();
-			s.pop_back();
+void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
+		bool override)
+{
+	if (_activeslice >= _startslice && _activeslice < _endslice)
+	{
+		unsigned position = p.px + p.py * (unsigned)_width;
+		auto all_work = target_slices();
+		std::vector<const float*> work(all_work.begin() + _startslice, all_work.begin() + _endslice);
+		auto all_tissues = tissue_slices(_active_tissuelayer);
+		std::vector<tissues_size_t*> tissues(all_tissues.begin() + _startslice, all_tissues.begin() + _endslice);
+		const std::vector<char> locked = tissue_lock_table();
+		const float f = work[_activeslice - _startslice][position];
 
-			work = _image_slices[i.pz].return_work();
-			if (i.pxy % _width != 0 && work[i.pxy - 1] == -1)
-			{
-				work[i.pxy - 1] = set_to;
-				j.pxy = i.pxy - 1;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if ((i.pxy + 1) % _width != 0 && work[i.pxy + 1] == -1)
-			{
-				work[i.pxy + 1] = set_to;
-				j.pxy = i.pxy + 1;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pxy >= _width && work[i.pxy - _width] == -1)
-			{
-				work[i.pxy - _width] = set_to;
-				j.pxy = i.pxy - _width;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pxy < _area - _width && work[i.pxy + _width] == -1)
-			{
-				work[i.pxy + _width] = set_to;
-				j.pxy = i.pxy + _width;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pz > _startslice)
-			{
-				work = _image_slices[i.pz - 1].return_work();
-				if (work[i.pxy] == -1)
-				{
-					work[i.pxy] = set_to;
-					j.pxy = i.pxy;
-					j.pz = i.pz - 1;
-					s.push_back(j);
-				}
-				//			if(connectivity){
-				//			}
-			}
-			if (i.pz + 1 < _endslice)
-			{
-				work = _image_slices[i.pz + 1].return_work();
-				if (work[i.pxy] == -1)
-				{
-					work[i.pxy] = set_to;
-					j.pxy = i.pxy;
-					j.pz = i.pz + 1;
-					s.push_back(j);
-				}
-				//			if(connectivity){
-				//			}
-			}
-			/*		if(connectivity){
-			if(i.pxy%width!=0&&work[i.pxy-width-1]==-1) {work[i.pxy-w-1]=set_to; s.push(i-w-1);}
-			if(i.pxy%width!=0&&work[i.pxy+width+1]==-1) {work[i.pxy+w+1]=set_to; s.push(i+w+1);}
-			if(i.pxy%width!=0&&work[i.pxy-width+1]==-1) {work[i.pxy-w+1]=set_to; s.push(i-w+1);}
-			if(i.pxy%width!=0&&work[i.pxy+width-1]==-1) {work[i.pxy+w-1]=set_to; s.push(i+w-1);}
-			}*/
-		}
+		// the tissues are only written after the fill
+		auto writable = [&](unsigned z, unsigned i) {
+			tissues_size_t t = tissues[z][i];
+			return work[z][i] == f && (t == 0 || (override && !locked[t]));
+		};
 
-		for (unsigned short z = _startslice; z < _endslice; z++)
-		{
-			work = _image_slices[z].return_work();
-			for (unsigned i1 = 0; i1 < _area; i1++)
-				if (work[i1] == -1)
-					work[i1] = 0;
-			_image_slices[z].set_mode(2, false);
-		}
+		add_connected_3d(tissues, _width, _height, _activeslice - _startslice, position, tissuetype, writable);
 	}
 
 	return;
 }
 
-void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
-		bool override)
+void SlicesHandler::subtract_tissueall_connected(tissues_size_t tissuetype,
+		Point p)
 {
-	if (_activeslice >= _startslice && _activeslice < _endslice)
+	if (_activeslice < _endslice && _activeslice >= _startslice)
 	{
 		float set_to = (float)123E10;
 		unsigned position = p.px + p.py * (unsigned)_width;
@@ -4951,10 +4977,9 @@ void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
 		float f = work[position];
 		tissues_size_t* tissue =
 				_image_slices[_activeslice].return_tissues(_active_tissuelayer);
-		bool tissueLocked = TissueInfos::GetTissueLocked(tissue[position]);
-		if (tissue[position] == 0 || (override && tissueLocked == false))
+		if (tissue[position] == tissuetype)
 			tissue[position] = tissuetype;
-		if (tissue[position] == 0 || (override && tissueLocked == false))
+		if (tissue[position] == tissuetype)
 			work[position] = set_to;
 
 		posit i, j;
@@ -4966,50 +4991,38 @@ void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
 
 			work = _image_slices[i.pz].return_work();
 			tissue = _image_slices[i.pz].return_tissues(_active_tissuelayer);
-			//if(i.pxy%width!=0&&work[i.pxy-1]==f&&(override||tissue[i.pxy-1]==0)) {
 			if (i.pxy % _width != 0 && work[i.pxy - 1] == f &&
-					(tissue[i.pxy - 1] == 0 ||
-							(override &&
-									TissueInfos::GetTissueLocked(tissue[i.pxy - 1]) == false)))
+					tissue[i.pxy - 1] == tissuetype)
 			{
 				work[i.pxy - 1] = set_to;
-				tissue[i.pxy - 1] = tissuetype;
+				tissue[i.pxy - 1] = 0;
 				j.pxy = i.pxy - 1;
 				j.pz = i.pz;
 				s.push_back(j);
 			}
-			//if((i.pxy+1)%width!=0&&work[i.pxy+1]==f&&(override||tissue[i.pxy+1]==0)) {
 			if ((i.pxy + 1) % _width != 0 && work[i.pxy + 1] == f &&
-					(tissue[i.pxy + 1] == 0 ||
-							(override &&
-									TissueInfos::GetTissueLocked(tissue[i.pxy + 1]) == false)))
+					tissue[i.pxy + 1] == tissuetype)
 			{
 				work[i.pxy + 1] = set_to;
-				tissue[i.pxy + 1] = tissuetype;
+				tissue[i.pxy + 1] = 0;
 				j.pxy = i.pxy + 1;
 				j.pz = i.pz;
 				s.push_back(j);
 			}
-			//if(i.pxy>=width&&work[i.pxy-width]==f&&(override||tissue[i.pxy-width]==0)) {
 			if (i.pxy >= _width && work[i.pxy - _width] == f &&
-					(tissue[i.pxy - _width] == 0 ||
-							(override && TissueInfos::GetTissueLocked(
-															 tissue[i.pxy - _width]) == false)))
+					tissue[i.pxy - _width] == tissuetype)
 			{
 				work[i.pxy - _width] = set_to;
-				tissue[i.pxy - _width] = tissuetype;
+				tissue[i.pxy - _width] = 0;
 				j.pxy = i.pxy - _width;
 				j.pz = i.pz;
 				s.push_back(j);
 			}
-			//if(i.pxy<=area-width&&work[i.pxy+width]==f&&(override||tissue[i.pxy+width]==0)) {
 			if (i.pxy < _area - _width && work[i.pxy + _width] == f &&
-					(tissue[i.pxy + _width] == 0 ||
-							(override && TissueInfos::GetTissueLocked(
-															 tissue[i.pxy + _width]) == false)))
+					tissue[i.pxy + _width] == tissuetype)
 			{
 				work[i.pxy + _width] = set_to;
-				tissue[i.pxy + _width] = tissuetype;
+				tissue[i.pxy + _width] = 0;
 				j.pxy = i.pxy + _width;
 				j.pz = i.pz;
 				s.push_back(j);
@@ -5019,36 +5032,32 @@ void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
 				work = _image_slices[i.pz - 1].return_work();
 				tissue =
 						_image_slices[i.pz - 1].return_tissues(_active_tissuelayer);
-				//if(work[i.pxy]==f&&(override||tissue[i.pxy]==0)) {
-				if (work[i.pxy] == f &&
-						(tissue[i.pxy] == 0 ||
-								(override &&
-										TissueInfos::GetTissueLocked(tissue[i.pxy]) == false)))
+				if (work[i.pxy] == f && tissue[i.pxy] == tissuetype)
 				{
 					work[i.pxy] = set_to;
-					tissue[i.pxy] = tissuetype;
+					tissue[i.pxy] = 0;
 					j.pxy = i.pxy;
 					j.pz = i.pz - 1;
 					s.push_back(j);
 				}
+				//			if(connectivity){
+				//			}
 			}
 			if (i.pz + 1 < _endslice)
 			{
 				work = _image_slices[i.pz + 1].return_work();
 				tissue =
 						_image_slices[i.pz + 1].return_tissues(_active_tissuelayer);
-				//if(work[i.pxy]==f&&(override||tissue[i.pxy]==0)) {
-				if (work[i.pxy] == f &&
-						(tissue[i.pxy] == 0 ||
-								(override &&
-										TissueInfos::GetTissueLocked(tissue[i.pxy]) == false)))
+				if (work[i.pxy] == f && tissue[i.pxy] == tissuetype)
 				{
 					work[i.pxy] = set_to;
-					tissue[i.pxy] = tissuetype;
+					tissue[i.pxy] = 0;
 					j.pxy = i.pxy;
 					j.pz = i.pz + 1;
 					s.push_back(j);
 				}
+				//			if(connectivity){
+				//			}
 			}
 		}
 
@@ -5064,137 +5073,23 @@ void SlicesHandler::add2tissueall_connected(tissues_size_t tissuetype, Point p,
 	return;
 }
 
-void SlicesHandler::subtract_tissueall_connected(tissues_size_t tissuetype,
-		Point p)
+void SlicesHandler::double_hysteretic(float thresh_low_l, float thresh_low_h,
+		float thresh_high_l, float thresh_high_h,
+		bool connectivity,
+		unsigned short nrpasses)
 {
-	if (_activeslice < _endslice && _activeslice >= _startslice)
-	{
-		float set_to = (float)123E10;
-		unsigned position = p.px + p.py * (unsigned)_width;
-		std::vector<posit> s;
-		posit p1;
-
-		p1.pxy = position;
-		p1.pz = _activeslice;
-
-		s.push_back(p1);
-		float* work = _image_slices[_activeslice].return_work();
-		float f = work[position];
-		tissues_size_t* tissue =
-				_image_slices[_activeslice].return_tissues(_active_tissuelayer);
-		if (tissue[position] == tissuetype)
-			tissue[position] = tissuetype;
-		if (tissue[position] == tissuetype)
-			work[position] = set_to;
+	float setvalue = 255;
+	unsigned short slicenr = _startslice;
 
-		posit i, j;
+	clear_work();
 
-		while (!s.empty())
-		{
-			i = s.back();
-			s.pop_back();
-
-			work = _image_slices[i.pz].return_work();
-			tissue = _image_slices[i.pz].return_tissues(_active_tissuelayer);
-			if (i.pxy % _width != 0 && work[i.pxy - 1] == f &&
-					tissue[i.pxy - 1] == tissuetype)
-			{
-				work[i.pxy - 1] = set_to;
-				tissue[i.pxy - 1] = 0;
-				j.pxy = i.pxy - 1;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if ((i.pxy + 1) % _width != 0 && work[i.pxy + 1] == f &&
-					tissue[i.pxy + 1] == tissuetype)
-			{
-				work[i.pxy + 1] = set_to;
-				tissue[i.pxy + 1] = 0;
-				j.pxy = i.pxy + 1;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pxy >= _width && work[i.pxy - _width] == f &&
-					tissue[i.pxy - _width] == tissuetype)
-			{
-				work[i.pxy - _width] = set_to;
-				tissue[i.pxy - _width] = 0;
-				j.pxy = i.pxy - _width;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pxy < _area - _width && work[i.pxy + _width] == f &&
-					tissue[i.pxy + _width] == tissuetype)
-			{
-				work[i.pxy + _width] = set_to;
-				tissue[i.pxy + _width] = 0;
-				j.pxy = i.pxy + _width;
-				j.pz = i.pz;
-				s.push_back(j);
-			}
-			if (i.pz > _startslice)
-			{
-				work = _image_slices[i.pz - 1].return_work();
-				tissue =
-						_image_slices[i.pz - 1].return_tissues(_active_tissuelayer);
-				if (work[i.pxy] == f && tissue[i.pxy] == tissuetype)
-				{
-					work[i.pxy] = set_to;
-					tissue[i.pxy] = 0;
-					j.pxy = i.pxy;
-					j.pz = i.pz - 1;
-					s.push_back(j);
-				}
-				//			if(connectivity){
-				//			}
-			}
-			if (i.pz + 1 < _endslice)
-			{
-				work = _image_slices[i.pz + 1].return_work();
-				tissue =
-						_image_slices[i.pz + 1].return_tissues(_active_tissuelayer);
-				if (work[i.pxy] == f && tissue[i.pxy] == tissuetype)
-				{
-					work[i.pxy] = set_to;
-					tissue[i.pxy] = 0;
-					j.pxy = i.pxy;
-					j.pz = i.pz + 1;
-					s.push_back(j);
-				}
-				//			if(connectivity){
-				//			}
-			}
-		}
-
-		for (unsigned short z = _startslice; z < _endslice; z++)
-		{
-			work = _image_slices[z].return_work();
-			for (unsigned i1 = 0; i1 < _area; i1++)
-				if (work[i1] == set_to)
-					work[i1] = f;
-		}
-	}
-
-	return;
-}
-
-void SlicesHandler::double_hysteretic(float thresh_low_l, float thresh_low_h,
-		float thresh_high_l, float thresh_high_h,
-		bool connectivity,
-		unsigned short nrpasses)
-{
-	float setvalue = 255;
-	unsigned short slicenr = _startslice;
-
-	clear_work();
-
-	_image_slices[slicenr].double_hysteretic(thresh_low_l, thresh_low_h,
-			thresh_high_l, thresh_high_h,
-			connectivity, setvalue);
-	//	if(nrslices>1) {
-	for (unsigned short i = 0; i < nrpasses; i++)
-	{
-		while (++slicenr < _endslice)
+	_image_slices[slicenr].double_hysteretic(thresh_low_l, thresh_low_h,
+			thresh_high_l, thresh_high_h,
+			connectivity, setvalue);
+	//	if(nrslices>1) {
+	for (unsigned short i = 0; i < nrpasses; i++)
+	{
+		while (++slicenr < _endslice)
 		{
 			_image_slices[slicenr].double_hysteretic(
 					thresh_low_l, thresh_low_h, thresh_high_l, thresh_high_h,
@@ -5230,86 +5125,145 @@ void SlicesHandler::double_hysteretic_allslices(float thresh_low_l,
 		float thresh_high_h,
 		bool connectivity, float set_to)
 {
-	for (unsigned short i = _startslice; i < _endslice; i++)
+	auto all_bmp = source_slices();
+	std::vector<const float*> bmp(all_bmp.begin() + _startslice, all_bmp.begin() + _endslice);
+	auto all_tissues = tissue_slices(active_tissuelayer());
+	std::vector<const tissues_size_t*> tissues(all_tissues.begin() + _startslice, all_tissues.begin() + _endslice);
+	const std::vector<char> locked = tissue_lock_table();
+
+	// voxels in [thresh_low_h, thresh_high_l] are seeds, the region grows into [thresh_low_l, thresh_high_h]
+	auto grow = [&](size_t z, size_t i) {
+		return bmp[z][i] >= thresh_low_l && bmp[z][i] <= thresh_high_h && !locked[tissues[z][i]];
+	};
+
+	const int n = static_cast<int>(bmp.size());
+	std::vector<std::vector<growing::Span>> seeds(n);
+#pragma omp parallel for
+	for (int z = 0; z < n; ++z)
+	{
+		growing::CollectSpans(_width, _height, [&](size_t i) { return bmp[z][i] >= thresh_low_h && bmp[z][i] <= thresh_high_l && grow(z, i); }, seeds[z]);
+	}
+
+	auto grown = RegionGrowing(_width, _height, bmp.size(), grow, connectivity, seeds);
+	write_mask_to_work(grown, set_to);
+}
+
+std::vector<char> SlicesHandler::tissue_lock_table() const
+{
+	// one entry per possible tissue value, out of range tissues are never locked
+	std::vector<char> locked(TISSUES_SIZE_MAX + 1, 0);
+	for (tissues_size_t i = 1; i <= TissueInfos::GetTissueCount(); i++)
+	{
+		locked[i] = TissueInfos::GetTissueLocked(i) ? 1 : 0;
+	}
+	return locked;
+}
+
+void SlicesHandler::write_mask_to_work(const std::vector<BitMask>& mask, float set_to)
+{
+	const int n = static_cast<int>(mask.size());
+#pragma omp parallel for
+	for (int z = 0; z < n; ++z)
 	{
-		_image_slices[i].double_hysteretic(thresh_low_l, thresh_low_h, thresh_high_l, thresh_high_h, connectivity, set_to);
+		float* work = _image_slices[_startslice + z].return_work();
+		for (unsigned i = 0; i < _area; i++)
+		{
+			work[i] = mask[z].Test(i) ? set_to : 0.0f;
+		}
+		_image_slices[_startslice + z].set_mode(2, false);
 	}
 }
 
 namespace {
-class MyVisitor : public boost::static_visitor<itk::FlatStructuringElement<3>>
+/// radius in pixels (int) or length units (float), sets the matching spacing
+class RadiusVisitor : public boost::static_visitor<double>
 {
 public:
-	MyVisitor(const itk::ImageBase<3>::SpacingType& spacing) : _spacing(spacing) {}
+	RadiusVisitor(double* spacing, float dx, float dy, float thickness) : _spacing(spacing), _pixel{dx, dy, thickness} {}
 
-	itk::FlatStructuringElement<3> operator()(int r) const
+	double operator()(int r) const
 	{
-		itk::Size<3> radius;
-		radius.Fill(r);
-
-		return morpho::MakeBall<3>(radius);
+		_spacing[0] = _spacing[1] = _spacing[2] = 1.0;
+		return static_cast<double>(r);
 	}
 
-	itk::FlatStructuringElement<3> operator()(float r) const
+	double operator()(float r) const
 	{
-		return morpho::MakeBall<3>(_spacing, static_cast<double>(r));
+		std::copy(_pixel, _pixel + 3, _spacing);
+		return static_cast<double>(r);
 	}
 
 private:
-	itk::ImageBase<3>::SpacingType _spacing;
+	double* _spacing;
+	double _pixel[3];
 };
 } // namespace
 
-void SlicesHandler::erosion(boost::variant<int, float> radius, bool connectivity)
+void SlicesHandler::target_morphology(morphology::eOperation operation, boost::variant<int, float> radius)
 {
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTarget(false);
+	double spacing[3];
+	const double r = boost::apply_visitor(RadiusVisitor(spacing, _dx, _dy, _thickness), radius);
 
-	auto ball = boost::apply_visitor(MyVisitor(all_slices->GetSpacing()), radius);
+	const int n = _endslice - _startslice;
+	std::vector<std::vector<unsigned char>> mask(n, std::vector<unsigned char>(_area));
+	std::vector<unsigned char*> mask_slices(n);
+#pragma omp parallel for
+	for (int z = 0; z < n; ++z)
+	{
+		const float* work = _image_slices[_startslice + z].return_work();
+		for (unsigned i = 0; i < _area; i++)
+		{
+			mask[z][i] = (work[i] >= 0.001f) ? 1 : 0; // background is '0'
+		}
+		mask_slices[z] = mask[z].data();
+	}
 
-	auto output = morpho::MorphologicalOperation<float>(
-			all_slices, ball, morpho::kErode, _startslice, _endslice);
+	const std::vector<char> selected = {0, 1}, locked;
+	LabelMorphology(mask_slices.data(), _width, _height, n, spacing, r, operation, selected, locked);
 
-	iseg::Paste<unsigned char, float>(output, all_slices, _startslice, _endslice);
+#pragma omp parallel for
+	for (int z = 0; z < n; ++z)
+	{
+		float* work = _image_slices[_startslice + z].return_work();
+		for (unsigned i = 0; i < _area; i++)
+		{
+			work[i] = mask[z][i] ? 255.0f : 0.0f;
+		}
+		_image_slices[_startslice + z].set_mode(2, false);
+	}
 }
 
-void SlicesHandler::dilation(boost::variant<int, float> radius, bool connectivity)
+void SlicesHandler::tissue_morphology(morphology::eOperation operation, boost::variant<int, float> radius, const std::vector<char>& selected, bool all_slices)
 {
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTarget(false);
-
-	auto ball = boost::apply_visitor(MyVisitor(all_slices->GetSpacing()), radius);
+	double spacing[3];
+	const double r = boost::apply_visitor(RadiusVisitor(spacing, _dx, _dy, _thickness), radius);
 
-	auto output = morpho::MorphologicalOperation<float>(
-			all_slices, ball, morpho::kDilate, _startslice, _endslice);
+	auto all_tissues = tissue_slices(_active_tissuelayer);
+	const unsigned short start = all_slices ? _startslice : _activeslice;
+	const unsigned short end = all_slices ? _endslice : _activeslice + 1;
+	std::vector<tissues_size_t*> tissues(all_tissues.begin() + start, all_tissues.begin() + end);
 
-	iseg::Paste<unsigned char, float>(output, all_slices, _startslice, _endslice);
+	LabelMorphology(tissues.data(), _width, _height, tissues.size(), spacing, r, operation, selected, tissue_lock_table());
 }
 
-void SlicesHandler::closure(boost::variant<int, float> radius, bool connectivity)
+void SlicesHandler::erosion(boost::variant<int, float> radius, bool connectivity)
 {
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTarget(false);
-
-	auto ball = boost::apply_visitor(MyVisitor(all_slices->GetSpacing()), radius);
+	target_morphology(morphology::kErode, radius);
+}
 
-	auto output = morpho::MorphologicalOperation<float>(
-			all_slices, ball, morpho::kClose, _startslice, _endslice);
+void SlicesHandler::dilation(boost::variant<int, float> radius, bool connectivity)
+{
+	target_morphology(morphology::kDilate, radius);
+}
 
-	iseg::Paste<unsigned char, float>(output, all_slices, _startslice, _endslice);
+void SlicesHandler::closure(boost::variant<int, float> radius, bool connectivity)
+{
+	target_morphology(morphology::kClose, radius);
 }
 
 void SlicesHandler::open(boost::variant<int, float> radius, bool connectivity)
 {
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTarget(false);
-
-	auto ball = boost::apply_visitor(MyVisitor(all_slices->GetSpacing()), radius);
-
-	auto output = morpho::MorphologicalOperation<float>(
-			all_slices, ball, morpho::kOpen, _startslice, _endslice);
-
-	iseg::Paste<unsigned char, float>(output, all_slices, _startslice, _endslice);
+	target_morphology(morphology::kOpen, radius);
 }
 
 void SlicesHandler::interpolateworkgrey(unsigned short slice1, unsigned short slice2, bool connected)
@@ -5326,56 +5280,21 @@ void SlicesHandler::interpolateworkgrey(unsigned short slice1, unsigned short sl
 	const short n = slice2 - slice1;
 	if (!connected)
 	{
-		_image_slices[slice1].pushstack_bmp();
-		_image_slices[slice2].pushstack_bmp();
-
-		_image_slices[slice1].swap_bmpwork();
-		_image_slices[slice2].swap_bmpwork();
-
-		_image_slices[slice2].dead_reckoning();
-		_image_slices[slice1].dead_reckoning();
-
-		float* bmp1 = _image_slices[slice1].return_bmp();
-		float* bmp2 = _image_slices[slice2].return_bmp();
-		float* work1 = _image_slices[slice1].return_work();
-		float* work2 = _image_slices[slice2].return_work();
-
-		Point p;
-		float prop;
-		unsigned short n1;
-		unsigned i1 = 0;
-
-		for (p.py = 0; p.py < _height; p.py++)
+		const float* work1 = _image_slices[slice1].return_work();
+		const float* work2 = _image_slices[slice2].return_work();
+		std::vector<float*> works;
+		for (unsigned short j = 1; j < n; j++)
 		{
-			for (p.px = 0; p.px < _width; p.px++)
-			{
-				if (work2[i1] + work1[i1] != 0)
-					prop = work1[i1] / (work2[i1] + work1[i1]);
-				else
-					prop = 0.5f;
-				n1 = (unsigned short)n * prop;
-				for (unsigned short j = 1; j <= n1 && j < n; j++)
-				{
-					_image_slices[slice1 + j].set_work_pt(p, bmp1[i1]);
-				}
-				for (unsigned short j = n1 + 1; j < n; j++)
-				{
-					_image_slices[slice1 + j].set_work_pt(p, bmp2[i1]);
-				}
-				i1++;
-			}
+			works.push_back(_image_slices[slice1 + j].return_work());
 		}
 
-		_image_slices[slice1].swap_bmpwork();
-		_image_slices[slice2].swap_bmpwork();
+		NearestValueInterpolation(work1, work2, _width, _height, works.size(),
+				[&](size_t j, size_t i, bool from_upper) { works[j][i] = from_upper ? work2[i] : work1[i]; });
 
 		for (unsigned short j = 1; j < n; j++)
 		{
 			_image_slices[slice1 + j].set_mode(2, false);
 		}
-
-		_image_slices[slice2].popstack_bmp();
-		_image_slices[slice1].popstack_bmp();
 	}
 	else
 	{
@@ -5632,64 +5551,21 @@ void SlicesHandler::interpolatetissuegrey(unsigned short slice1,
 
 	if (n > 0)
 	{
-		_image_slices[slice1].pushstack_bmp();
-		_image_slices[slice2].pushstack_bmp();
-		_image_slices[slice1].pushstack_work();
-		_image_slices[slice2].pushstack_work();
-
-		_image_slices[slice1].tissue2work(_active_tissuelayer);
-		_image_slices[slice2].tissue2work(_active_tissuelayer);
-
-		_image_slices[slice1].swap_bmpwork();
-		_image_slices[slice2].swap_bmpwork();
-
-		_image_slices[slice2].dead_reckoning();
-		_image_slices[slice1].dead_reckoning();
-
-		tissues_size_t* bmp1 =
-				_image_slices[slice1].return_tissues(_active_tissuelayer);
-		tissues_size_t* bmp2 =
-				_image_slices[slice2].return_tissues(_active_tissuelayer);
-		float* work1 = _image_slices[slice1].return_work();
-		float* work2 = _image_slices[slice2].return_work();
-
-		Point p;
-		float prop;
-		unsigned short n1;
-		unsigned i1 = 0;
-
-		for (p.py = 0; p.py < _height; p.py++)
+		const tissues_size_t* tissue1 = _image_slices[slice1].return_tissues(_active_tissuelayer);
+		const tissues_size_t* tissue2 = _image_slices[slice2].return_tissues(_active_tissuelayer);
+		std::vector<tissues_size_t*> tissues;
+		for (unsigned short j = 1; j < n; j++)
 		{
-			for (p.px = 0; p.px < _width; p.px++)
-			{
-				if (work2[i1] + work1[i1] != 0)
-					prop = work1[i1] / (work2[i1] + work1[i1]);
-				else
-					prop = 0.5f;
-				n1 = (unsigned short)n * prop;
-				for (unsigned short j = 1; j <= n1 && j < n; j++)
-				{
-					_image_slices[slice1 + j].set_tissue_pt(_active_tissuelayer,
-							p, bmp1[i1]);
-				}
-				for (unsigned short j = n1 + 1; j < n; j++)
-				{
-					_image_slices[slice1 + j].set_tissue_pt(_active_tissuelayer,
-							p, bmp2[i1]);
-				}
-				i1++;
-			}
+			tissues.push_back(_image_slices[slice1 + j].return_tissues(_active_tissuelayer));
 		}
 
+		NearestValueInterpolation(tissue1, tissue2, _width, _height, tissues.size(),
+				[&](size_t j, size_t i, bool from_upper) { tissues[j][i] = from_upper ? tissue2[i] : tissue1[i]; });
+
 		for (unsigned short j = 1; j < n; j++)
 		{
 			_image_slices[slice1 + j].set_mode(2, false);
 		}
-
-		_image_slices[slice1].popstack_work();
-		_image_slices[slice2].popstack_work();
-		_image_slices[slice2].popstack_bmp();
-		_image_slices[slice1].popstack_bmp();
 	}
 }
 
@@ -6034,63 +5910,29 @@ void SlicesHandler::interpolatetissue(unsigned short slice1, unsigned short slic
 	const short n = slice2 - slice1;
 	if (!connected)
 	{
-		tissues_size_t* tissue1 = _image_slices[slice1].return_tissues(_active_tissuelayer);
-		tissues_size_t* tissue2 = _image_slices[slice2].return_tissues(_active_tissuelayer);
-		_image_slices[slice1].pushstack_bmp();
-		_image_slices[slice2].pushstack_bmp();
-		float* bmp1 = _image_slices[slice1].return_bmp();
-		float* bmp2 = _image_slices[slice2].return_bmp();
-		for (unsigned int i = 0; i < _area; i++)
-		{
-			bmp1[i] = (float)tissue1[i];
-			bmp2[i] = (float)tissue2[i];
-		}
-
-		_image_slices[slice2].dead_reckoning((float)tissuetype);
-		_image_slices[slice1].dead_reckoning((float)tissuetype);
-
-		bmp1 = _image_slices[slice1].return_work();
-		bmp2 = _image_slices[slice2].return_work();
-		const short n = slice2 - slice1;
-		Point p;
-		float delta;
-		unsigned i1 = 0;
-
-		for (p.py = 0; p.py < _height; p.py++)
+		const tissues_size_t* tissue1 = _image_slices[slice1].return_tissues(_active_tissuelayer);
+		const tissues_size_t* tissue2 = _image_slices[slice2].return_tissues(_active_tissuelayer);
+		std::vector<float*> works;
+		for (unsigned short j = 0; j <= n; j++)
 		{
-			for (p.px = 0; p.px < _width; p.px++)
-			{
-				delta = (bmp2[i1] - bmp1[i1]) / n;
-				for (unsigned short j = 1; j < n; j++)
-				{
-					if (bmp1[i1] + delta * j >= 0)
-						_image_slices[slice1 + j].set_work_pt(p, 255.0f);
-					else
-						_image_slices[slice1 + j].set_work_pt(p, 0.0f);
-				}
-				i1++;
-			}
+			works.push_back(_image_slices[slice1 + j].return_work());
 		}
 
+		// the key slices show the tissue itself
 		for (unsigned i = 0; i < _area; i++)
 		{
-			if (bmp1[i] < 0)
-				bmp1[i] = 0;
-			else
-				bmp1[i] = 255.0f;
-			if (bmp2[i] < 0)
-				bmp2[i] = 0;
-			else
-				bmp2[i] = 255.0f;
+			works.front()[i] = (tissue1[i] == tissuetype) ? 255.0f : 0.0f;
+			works.back()[i] = (tissue2[i] == tissuetype) ? 255.0f : 0.0f;
 		}
 
+		ShapeInterpolation<tissues_size_t> interpolation(_width, _height, std::vector<tissues_size_t>(1, tissuetype));
+		interpolation.Interpolate(tissue1, tissue2, n - 1,
+				[&](size_t j, size_t i, int k) { works[j + 1][i] = (k < 0) ? 0.0f : 255.0f; });
+
 		for (unsigned short j = 1; j < n; j++)
 		{
 			_image_slices[slice1 + j].set_mode(2, false);
 		}
-
-		_image_slices[slice2].popstack_bmp();
-		_image_slices[slice1].popstack_bmp();
 	}
 	else
 	{
@@ -6134,35 +5976,112 @@ void SlicesHandler::interpolatetissue_medianset(unsigned short slice1,
 	interpolateworkgrey_medianset(slice1, slice2, connectivity, true);
 }
 
-void SlicesHandler::extrapolatetissue(unsigned short origin1,
-		unsigned short origin2,
-		unsigned short target,
-		tissues_size_t tissuetype)
+void SlicesHandler::interpolatetissue_allgaps(const std::vector<tissues_size_t>& tissuetypes)
 {
-	if (origin2 < origin1)
+	const std::vector<char> locked = tissue_lock_table();
+	std::vector<tissues_size_t> labels;
+	std::vector<char> selected(locked.size(), 0);
+	for (auto t : tissuetypes)
 	{
-		unsigned short dummy = origin1;
-		origin1 = origin2;
-		origin2 = dummy;
+		if (t != 0 && !locked.at(t) && !selected[t])
+		{
+			labels.push_back(t);
+			selected[t] = 1;
+		}
+	}
+	if (labels.empty())
+	{
+		return;
 	}
 
-	tissues_size_t* tissue1 =
-			_image_slices[origin1].return_tissues(_active_tissuelayer);
-	tissues_size_t* tissue2 =
-			_image_slices[origin2].return_tissues(_active_tissuelayer);
-	_image_slices[origin1].pushstack_bmp();
-	_image_slices[origin2].pushstack_bmp();
-	_image_slices[origin1].pushstack_work();
-	_image_slices[origin2].pushstack_work();
-	float* bmp1 = _image_slices[origin1].return_bmp();
-	float* bmp2 = _image_slices[origin2].return_bmp();
-	for (unsigned int i = 0; i < _area; i++)
+	// key slices of each tissue are the slices it occurs in
+	const SliceTissueIndex<tissues_size_t>& index = update_tissue_index();
+	std::vector<int> position(selected.size(), -1);
+	for (size_t k = 0; k < labels.size(); ++k)
 	{
-		bmp1[i] = (float)tissue1[i];
-		bmp2[i] = (float)tissue2[i];
+		position[labels[k]] = static_cast<int>(k);
+	}
+	std::vector<std::vector<int>> keys(labels.size());
+	for (int z = _startslice; z < _endslice; ++z)
+	{
+		for (const auto& e : index[z])
+		{
+			if (e.label < position.size() && position[e.label] >= 0)
+			{
+				keys[position[e.label]].push_back(z);
+			}
+		}
 	}
 
-	_image_slices[origin1].dead_reckoning((float)tissuetype);
+	// tissues with the same key slices are interpolated together, i.e. only the tissues present in both key slices of a gap
+	std::map<std::vector<int>, std::vector<tissues_size_t>> groups;
+	for (size_t k = 0; k < labels.size(); ++k)
+	{
+		if (keys[k].size() > 1)
+		{
+			groups[keys[k]].push_back(labels[k]);
+		}
+	}
+
+	auto tissues = tissue_slices(_active_tissuelayer);
+	for (const auto& group : groups)
+	{
+		const std::vector<int>& key = group.first;
+		const std::vector<tissues_size_t>& group_labels = group.second;
+
+		// consecutive gaps share a key slice, whose distance maps are computed once
+		ShapeInterpolation<tissues_size_t> interpolation(_width, _height, group_labels);
+		for (size_t g = 1; g < key.size(); ++g)
+		{
+			const int lower = key[g - 1], upper = key[g];
+			if (upper - lower > 1)
+			{
+				const unsigned short first = lower + 1;
+				interpolation.Interpolate(tissues[lower], tissues[upper], upper - lower - 1,
+						[&](size_t j, size_t i, int k) {
+							tissues_size_t& t = tissues[first + j][i];
+							if (k >= 0 && t == 0)
+								t = group_labels[k];
+						});
+			}
+		}
+	}
+
+	if (!groups.empty())
+	{
+		_slice_tissues.invalidate_all();
+	}
+}
+
+void SlicesHandler::extrapolatetissue(unsigned short origin1,
+		unsigned short origin2,
+		unsigned short target,
+		tissues_size_t tissuetype)
+{
+	if (origin2 < origin1)
+	{
+		unsigned short dummy = origin1;
+		origin1 = origin2;
+		origin2 = dummy;
+	}
+
+	tissues_size_t* tissue1 =
+			_image_slices[origin1].return_tissues(_active_tissuelayer);
+	tissues_size_t* tissue2 =
+			_image_slices[origin2].return_tissues(_active_tissuelayer);
+	_image_slices[origin1].pushstack_bmp();
+	_image_slices[origin2].pushstack_bmp();
+	_image_slices[origin1].pushstack_work();
+	_image_slices[origin2].pushstack_work();
+	float* bmp1 = _image_slices[origin1].return_bmp();
+	float* bmp2 = _image_slices[origin2].return_bmp();
+	for (unsigned int i = 0; i < _area; i++)
+	{
+		bmp1[i] = (float)tissue1[i];
+		bmp2[i] = (float)tissue2[i];
+	}
+
+	_image_slices[origin1].dead_reckoning((float)tissuetype);
 	_image_slices[origin2].dead_reckoning((float)tissuetype);
 
 	bmp1 = _image_slices[origin1].return_work();
@@ -6826,7 +6745,6 @@ int SlicesHandler::extract_tissue_surfaces(
 		contour->SetInputData(labelField);
 		contour->SetOutputScalarName(tissueIndexArrayName);
 		contour->UseTemplatesOn();
-		contour->UseOctreeLocatorOff();
 		contour->FiveTetrahedraPerVoxelOn();
 		contour->SetBackgroundLabel(
 				0); /// \todo this will not be extracted! is this correct?
@@ -6892,6 +6810,7 @@ int SlicesHandler::extract_tissue_surfaces(
 		simplify->SetMinimumEdgeLength(minEdgeLength);
 		simplify->FlipEdgesOn();
 		simplify->SetIntersectionCheckLevel(0);
+		simplify->UseParallelCollapseOn();
 		simplify->Update();
 		output = simplify->GetOutput();
 
@@ -7127,17 +7046,19 @@ void SlicesHandler::prev_slice()
 unsigned short SlicesHandler::get_next_featuring_slice(tissues_size_t type,
 		bool& found)
 {
+	const SliceTissueIndex<tissues_size_t>& index = update_tissue_index();
+
 	found = true;
 	for (unsigned i = _activeslice + 1; i < _nrslices; i++)
 	{
-		if (_image_slices[i].has_tissue(_active_tissuelayer, type))
+		if (index.find(i, type))
 		{
 			return i;
 		}
 	}
 	for (unsigned i = 0; i <= _activeslice; i++)
 	{
-		if (_image_slices[i].has_tissue(_active_tissuelayer, type))
+		if (index.find(i, type))
 		{
 			return i;
 		}
@@ -7177,6 +7098,7 @@ void SlicesHandler::set_active_tissuelayer(tissuelayers_size_t idx)
 {
 	// TODO: Signaling, range checking
 	_active_tissuelayer = idx;
+	_slice_tissues.invalidate_all();
 }
 
 unsigned SlicesHandler::pushstack_bmp()
@@ -7407,7 +7329,7 @@ bool SlicesHandler::start_undo(iseg::DataSelection& dataSelection,
 		}
 		else
 		{
-			free(_uelem);
+			delete _uelem;
 			_uelem = nullptr;
 		}
 	}
@@ -7419,7 +7341,7 @@ void SlicesHandler::abort_undo()
 {
 	if (_uelem != nullptr)
 	{
-		free(_uelem);
+		delete _uelem;
 		_uelem = nullptr;
 	}
 }
@@ -7576,7 +7498,9 @@ iseg::DataSelection SlicesHandler::undo()
 								_image_slices[current_slice].return_mode(true));
 						_image_slices[current_slice].copy2bmp(
 								uelem1->vbmp_old[i], uelem1->vmode1_old[i]);
-						free(uelem1->vbmp_old[i]);
+						_slice_bmpranges.invalidate(current_slice);
+						_slice_bmphistograms.invalidate(current_slice);
+						BufferPool::Instance().Release(uelem1->vbmp_old[i]);
 					}
 					if (dataSelection.work)
 					{
@@ -7586,7 +7510,9 @@ iseg::DataSelection SlicesHandler::undo()
 								_image_slices[current_slice].return_mode(false));
 						_image_slices[current_slice].copy2work(
 								uelem1->vwork_old[i], uelem1->vmode2_old[i]);
-						free(uelem1->vwork_old[i]);
+						_slice_ranges.invalidate(current_slice);
+						_slice_histograms.invalidate(current_slice);
+						BufferPool::Instance().Release(uelem1->vwork_old[i]);
 					}
 					if (dataSelection.tissues)
 					{
@@ -7595,6 +7521,7 @@ iseg::DataSelection SlicesHandler::undo()
 										_active_tissuelayer));
 						_image_slices[current_slice].copy2tissue(
 								_active_tissuelayer, uelem1->vtissue_old[i]);
+						_slice_tissues.invalidate(current_slice);
 						free(uelem1->vtissue_old[i]);
 					}
 					if (dataSelection.vvm)
@@ -7649,7 +7576,7 @@ iseg::DataSelection SlicesHandler::undo()
 							_image_slices[dataSelection.sliceNr].return_mode(true);
 					_image_slices[dataSelection.sliceNr].copy2bmp(
 							_uelem->bmp_old, _uelem->mode1_old);
-					free(_uelem->bmp_old);
+					BufferPool::Instance().Release(_uelem->bmp_old);
 					_uelem->bmp_old = nullptr;
 				}
 
@@ -7661,7 +7588,7 @@ iseg::DataSelection SlicesHandler::undo()
 							_image_slices[dataSelection.sliceNr].return_mode(false);
 					_image_slices[dataSelection.sliceNr].copy2work(
 							_uelem->work_old, _uelem->mode2_old);
-					free(_uelem->work_old);
+					BufferPool::Instance().Release(_uelem->work_old);
 					_uelem->work_old = nullptr;
 				}
 
@@ -7706,6 +7633,7 @@ iseg::DataSelection SlicesHandler::undo()
 					_uelem->marks_old.clear();
 				}
 
+				invalidate_ranges(dataSelection);
 				set_active_slice(dataSelection.sliceNr);
 
 				_uelem = nullptr;
@@ -7746,7 +7674,9 @@ iseg::DataSelection SlicesHandler::redo()
 								_image_slices[current_slice].return_mode(true));
 						_image_slices[current_slice].copy2bmp(
 								uelem1->vbmp_new[i], uelem1->vmode1_new[i]);
-						free(uelem1->vbmp_new[i]);
+						_slice_bmpranges.invalidate(current_slice);
+						_slice_bmphistograms.invalidate(current_slice);
+						BufferPool::Instance().Release(uelem1->vbmp_new[i]);
 					}
 					if (dataSelection.work)
 					{
@@ -7756,7 +7686,9 @@ iseg::DataSelection SlicesHandler::redo()
 								_image_slices[current_slice].return_mode(false));
 						_image_slices[current_slice].copy2work(
 								uelem1->vwork_new[i], uelem1->vmode2_new[i]);
-						free(uelem1->vwork_new[i]);
+						_slice_ranges.invalidate(current_slice);
+						_slice_histograms.invalidate(current_slice);
+						BufferPool::Instance().Release(uelem1->vwork_new[i]);
 					}
 					if (dataSelection.tissues)
 					{
@@ -7765,6 +7697,7 @@ iseg::DataSelection SlicesHandler::redo()
 										_active_tissuelayer));
 						_image_slices[current_slice].copy2tissue(
 								_active_tissuelayer, uelem1->vtissue_new[i]);
+						_slice_tissues.invalidate(current_slice);
 						free(uelem1->vtissue_new[i]);
 					}
 					if (dataSelection.vvm)
@@ -7817,7 +7750,7 @@ iseg::DataSelection SlicesHandler::redo()
 							_image_slices[dataSelection.sliceNr].return_mode(true);
 					_image_slices[dataSelection.sliceNr].copy2bmp(
 							_uelem->bmp_new, _uelem->mode1_new);
-					free(_uelem->bmp_new);
+					BufferPool::Instance().Release(_uelem->bmp_new);
 					_uelem->bmp_new = nullptr;
 				}
 
@@ -7829,7 +7762,7 @@ iseg::DataSelection SlicesHandler::redo()
 							_image_slices[dataSelection.sliceNr].return_mode(false);
 					_image_slices[dataSelection.sliceNr].copy2work(
 							_uelem->work_new, _uelem->mode2_new);
-					free(_uelem->work_new);
+					BufferPool::Instance().Release(_uelem->work_new);
 					_uelem->work_new = nullptr;
 				}
 
@@ -7874,6 +7807,7 @@ iseg::DataSelection SlicesHandler::redo()
 					_uelem->marks_new.clear();
 				}
 
+				invalidate_ranges(dataSelection);
 				set_active_slice(dataSelection.sliceNr);
 
 				_uelem = nullptr;
@@ -8014,7 +7948,10 @@ int SlicesHandler::LoadDICOM(std::vector<const char*> lfilename)
 		// Ranges
 		Pair dummy;
 		_slice_ranges.resize(_nrslices);
+		_slice_histograms.resize(_nrslices);
+		_slice_tissues.resize(_nrslices);
 		_slice_bmpranges.resize(_nrslices);
+		_slice_bmphistograms.resize(_nrslices);
 		compute_range_mode1(&dummy);
 		compute_bmprange_mode1(&dummy);
 
@@ -8079,7 +8016,10 @@ int SlicesHandler::LoadDICOM(std::vector<const char*> lfilename, Point p,
 			// Ranges
 			Pair dummy;
 			_slice_ranges.resize(_nrslices);
+			_slice_histograms.resize(_nrslices);
+			_slice_tissues.resize(_nrslices);
 			_slice_bmpranges.resize(_nrslices);
+			_slice_bmphistograms.resize(_nrslices);
 			compute_range_mode1(&dummy);
 			compute_bmprange_mode1(&dummy);
 
@@ -8150,7 +8090,10 @@ int SlicesHandler::LoadDICOM(std::vector<const char*> lfilename, Point p,
 		// Ranges
 		Pair dummy;
 		_slice_ranges.resize(_nrslices);
+		_slice_histograms.resize(_nrslices);
+		_slice_tissues.resize(_nrslices);
 		_slice_bmpranges.resize(_nrslices);
+		_slice_bmphistograms.resize(_nrslices);
 		compute_range_mode1(&dummy);
 		compute_bmprange_mode1(&dummy);
 
@@ -8162,6 +8105,9 @@ int SlicesHandler::LoadDICOM(std::vector<const char*> lfilename, Point p,
 
 int SlicesHandler::ReloadDICOM(std::vector<const char*> lfilename)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	if ((_endslice - _startslice) == (unsigned short)lfilename.size())
 	{
 		int j = 0;
@@ -8235,6 +8181,9 @@ int SlicesHandler::ReloadDICOM(std::vector<const char*> lfilename)
 
 int SlicesHandler::ReloadDICOM(std::vector<const char*> lfilename, Point p)
 {
+	_slice_bmpranges.invalidate_all();
+	_slice_bmphistograms.invalidate_all();
+
 	if ((_endslice - _startslice) == (unsigned short)lfilename.size())
 	{
 		int j = 0;
@@ -8378,47 +8327,43 @@ void SlicesHandler::GetDICOMseriesnr(std::vector<const char*>* vnames,
 	std::sort(dicomseriesnr->begin(), dicomseriesnr->end());
 }
 
-void SlicesHandler::map_tissue_indices(const std::vector<tissues_size_t>& indexMap)
+void SlicesHandler::remap_tissues(const LabelMap<tissues_size_t>& map)
 {
+	if (map.is_identity())
+		return;
+
+	_slice_tissues.invalidate_all();
 	int const iN = _nrslices;
 
 #pragma omp parallel for
 	for (int i = 0; i < iN; i++)
 	{
-		_image_slices[i].map_tissue_indices(indexMap);
+		_image_slices[i].remap_tissues(map);
 	}
 }
 
-void SlicesHandler::remove_tissue(tissues_size_t tissuenr)
+void SlicesHandler::map_tissue_indices(const std::vector<tissues_size_t>& indexMap)
 {
-	int const iN = _nrslices;
+	remap_tissues(LabelMap<tissues_size_t>().map(indexMap));
+}
 
-#pragma omp parallel for
-	for (int i = 0; i < iN; i++)
-	{
-		_image_slices[i].remove_tissue(tissuenr);
-	}
+void SlicesHandler::remove_tissue(tissues_size_t tissuenr)
+{
+	std::set<tissues_size_t> tissuenrs;
+	tissuenrs.insert(tissuenr);
+	remap_tissues(LabelMap<tissues_size_t>().remove(tissuenrs));
 	TissueInfos::RemoveTissue(tissuenr);
 }
 
 void SlicesHandler::remove_tissues(const std::set<tissues_size_t>& tissuenrs)
 {
-	std::vector<bool> isSelected(TissueInfos::GetTissueCount() + 1, false);
 	for (auto id : tissuenrs)
 	{
-		isSelected.at(id) = true;
-	}
-
-	std::vector<tissues_size_t> idxMap(isSelected.size(), 0);
-	for (tissues_size_t oldIdx = 1, newIdx = 1; oldIdx < idxMap.size(); ++oldIdx)
-	{
-		if (!isSelected[oldIdx])
-		{
-			idxMap[oldIdx] = newIdx++;
-		}
+		if (id > TissueInfos::GetTissueCount())
+			throw std::out_of_range("remove_tissues: invalid tissue index");
 	}
 
-	map_tissue_indices(idxMap);
+	remap_tissues(LabelMap<tissues_size_t>().remove(tissuenrs));
 
 	TissueInfos::RemoveTissues(tissuenrs);
 }
@@ -8429,6 +8374,7 @@ void SlicesHandler::remove_tissueall()
 	{
 		_image_slices[i].cleartissuesall();
 	}
+	_slice_tissues.invalidate_all();
 	TissueInfos::RemoveAllTissues();
 	TissueInfo tissue;
 	tissue.locked = false;
@@ -8439,10 +8385,7 @@ void SlicesHandler::remove_tissueall()
 
 void SlicesHandler::cap_tissue(tissues_size_t maxval)
 {
-	for (short unsigned i = 0; i < _nrslices; i++)
-	{
-		_image_slices[i].cap_tissue(maxval);
-	}
+	remap_tissues(LabelMap<tissues_size_t>().cap(maxval));
 }
 
 void SlicesHandler::buildmissingtissues(tissues_size_t j)
@@ -8468,15 +8411,7 @@ void SlicesHandler::buildmissingtissues(tissues_size_t j)
 std::vector<tissues_size_t> SlicesHandler::find_unused_tissues()
 {
 	std::vector<unsigned char> is_used(TissueInfos::GetTissueCount() + 1, 0);
-
-	for (int i = 0, iN = _nrslices; i < iN; i++)
-	{
-		auto tissues = _image_slices[i].return_tissues(_active_tissuelayer);
-		for (unsigned k = 0; k < _area; ++k)
-		{
-			is_used[tissues[k]] = 1;
-		}
-	}
+	update_tissue_index().mark_used(0, _nrslices, is_used);
 
 	std::vector<tissues_size_t> unused_tissues;
 	for (size_t i = 1; i < is_used.size(); ++i)
@@ -8493,12 +8428,14 @@ std::vector<tissues_size_t> SlicesHandler::find_unused_tissues()
 
 void SlicesHandler::group_tissues(std::vector<tissues_size_t>& olds, std::vector<tissues_size_t>& news)
 {
+	const LabelMap<tissues_size_t> map = LabelMap<tissues_size_t>().group(olds, news);
+	_slice_tissues.invalidate_all();
 	int const iN = _nrslices;
 
 #pragma omp parallel for
 	for (int i = 0; i < iN; i++)
 	{
-		_image_slices[i].group_tissues(_active_tissuelayer, olds, news);
+		_image_slices[i].remap_tissues(_active_tissuelayer, map);
 	}
 }
 void SlicesHandler::set_modeall(unsigned char mode, bool bmporwork)
@@ -8823,206 +8760,43 @@ bool SlicesHandler::print_tissueindex(const char* filename,
 bool SlicesHandler::get_extent(tissues_size_t tissuenr, bool onlyactiveslices,
 		unsigned short extent[3][2])
 {
-	bool found = false;
-	unsigned short extent1[2][2];
-	unsigned short startslice1, endslice1;
-	startslice1 = 0;
-	endslice1 = _nrslices;
 	if (onlyactiveslices)
 	{
-		startslice1 = _startslice;
-		endslice1 = _endslice;
-	}
-	for (unsigned short i = startslice1; i < endslice1; i++)
-	{
-		if (!found)
-		{
-			found = _image_slices[i].get_extent(_active_tissuelayer, tissuenr,
-					extent1);
-			if (found)
-			{
-				extent[2][0] = i;
-				extent[2][1] = i;
-				extent[0][0] = extent1[0][0];
-				extent[1][0] = extent1[1][0];
-				extent[0][1] = extent1[0][1];
-				extent[1][1] = extent1[1][1];
-			}
-		}
-		else
-		{
-			if (_image_slices[i].get_extent(_active_tissuelayer, tissuenr,
-							extent1))
-			{
-				if (extent1[0][0] < extent[0][0])
-					extent[0][0] = extent1[0][0];
-				if (extent1[1][0] < extent[1][0])
-					extent[1][0] = extent1[1][0];
-				if (extent1[0][1] > extent[0][1])
-					extent[0][1] = extent1[0][1];
-				if (extent1[1][1] > extent[1][1])
-					extent[1][1] = extent1[1][1];
-				extent[2][1] = i;
-			}
-		}
+		return update_tissue_index().extent(_startslice, _endslice, tissuenr, extent);
 	}
-
-	return found;
+	return update_tissue_index().extent(0, _nrslices, tissuenr, extent);
 }
 
 void SlicesHandler::add_skin3D(int ix, int iy, int iz, float setto)
 {
 	// ix,iy,iz are in pixels
 
-	//Create skin in each slice as same way is done in the 2D AddSkin process
-	for (unsigned short z = _startslice; z < _endslice; z++)
-	{
-		float* work;
-		work = _image_slices[z].return_work();
-		unsigned i = 0, pos, y, x;
-
-		//Create a binary vector noTissue/Tissue
-		std::vector<int> s;
-		for (int j = 0; j < _height; j++)
-		{
-			for (int k = 0; k < _width; k++)
-			{
-				if (work[i] == 0)
-					s.push_back(-1);
-				else
-					s.push_back(0);
-				i++;
-			}
-		}
-
-		// i4 itetations through  y, -y, x, -x converting, each time a tissue beginning is find, one tissue pixel into skin
-		//!! It is assumed that ix and iy are the same
-		bool convertSkin = true;
-		for (i = 1; i < ix + 1; i++)
-		{
-			for (y = 0; y < _height; y++)
-			{
-				pos = y * _width;
-				while (pos < (y + 1) * _width)
-				{
-					if (s[pos] == 0)
-					{
-						if (convertSkin)
-							s[pos] = 256;
-						convertSkin = false;
-					}
-					else
-						convertSkin = true;
-
-					pos++;
-				}
-
-				pos = (y + 1) * _width - 1;
-				while (pos > y * _width)
-				{
-					if (s[pos] == 0)
-					{
-						if (convertSkin)
-							s[pos] = 256;
-						convertSkin = false;
-					}
-					else
-						convertSkin = true;
-
-					pos--;
-				}
-			}
-
-			for (x = 0; x < _width; x++)
-			{
-				pos = x;
-				while (pos < _height * _width)
-				{
-					if (s[pos] == 0)
-					{
-						if (convertSkin)
-							s[pos] = 256;
-						convertSkin = false;
-					}
-					else
-						convertSkin = true;
-
-					pos += _width;
-				}
-
-				pos = _width * (_height - 1) + x;
-				while (pos > _width)
-				{
-					if (s[pos] == 0)
-					{
-						if (convertSkin)
-							s[pos] = 256;
-						convertSkin = false;
-					}
-					else
-						convertSkin = true;
+	// tissue voxels within the ellipsoid with radii ix,iy,iz around a background voxel become skin.
+	// A radius of 0 is mapped to a spacing > 1, i.e. no skin is added along this axis.
+	const double spacing[3] = {ix > 0 ? 1.0 / ix : 2.0, iy > 0 ? 1.0 / iy : 2.0, iz > 0 ? 1.0 / iz : 2.0};
 
-					pos -= _width;
-				}
-			}
-		}
-
-		//go over the vector and set the skin pixel at the source pointer
-		i = 0;
-		for (int j = 0; j < _height; j++)
-		{
-			for (int k = 0; k < _width; k++)
-			{
-				if (s[i] == 256)
-					work[i] = setto;
-				i++;
-			}
-		}
-	}
-
-	// To create skin in 3D, it is check if where there is tissue, in the thickness (up&down) distance there is neither tissue nor skin
-	//The conversion is already done.
-	//int checkSliceDistance = int(iz/thickness);
-	int checkSliceDistance = iz;
-
-	for (unsigned short z = _startslice; z < _endslice - checkSliceDistance; z++)
+	const unsigned short nrslices = _endslice - _startslice;
+	std::vector<float> dist(static_cast<size_t>(_area) * nrslices);
+	std::vector<const float*> work(nrslices);
+	std::vector<float*> dist_slices(nrslices);
+	for (unsigned short z = 0; z < nrslices; z++)
 	{
-		float* work1;
-		float* work2;
-		work1 = _image_slices[z].return_work();
-		work2 = _image_slices[z + checkSliceDistance].return_work();
-
-		unsigned i = 0;
-		for (int j = 0; j < _height; j++)
-		{
-			for (int k = 0; k < _width; k++)
-			{
-				if (work1[i] != 0 && work1[i] != setto)
-					if (work2[i] == 0)
-						work1[i] = setto;
-				i++;
-			}
-		}
+		work[z] = _image_slices[_startslice + z].return_work();
+		dist_slices[z] = &dist[static_cast<size_t>(z) * _area];
 	}
 
-	for (unsigned short z = _endslice - 1; z > _startslice + checkSliceDistance;
-			 z--)
-	{
-		float* work1;
-		float* work2;
-		work1 = _image_slices[z].return_work();
-		work2 = _image_slices[z - checkSliceDistance].return_work();
+	DistanceTransform(work.data(), _width, _height, nrslices, spacing, [](float v) { return v == 0; }, dist_slices.data(), true);
 
-		unsigned i = 0;
-		for (int j = 0; j < _height; j++)
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int z = 0; z < n; z++)
+	{
+		float* w = _image_slices[_startslice + z].return_work();
+		const float* d = dist_slices[z];
+		for (unsigned i = 0; i < _area; i++)
 		{
-			for (int k = 0; k < _width; k++)
-			{
-				if (work1[i] != 0 && work1[i] != setto)
-					if (work2[i] == 0)
-						work1[i] = setto;
-				i++;
-			}
+			if (w[i] != 0 && d[i] <= 1.0f + 1e-4f)
+				w[i] = setto;
 		}
 	}
 }
@@ -9057,252 +8831,109 @@ void SlicesHandler::add_skin3D_outside(int ix, int iy, int iz, float setto)
 			}
 		}
 	}
-	for (unsigned short z = _endslice - 1; z > _startslice; z--)
-	{
-		work1 = _image_slices[z].return_work();
-		work2 = _image_slices[z - 1].return_work();
-		for (unsigned long i = 0; i < _area; i++)
-		{
-			if (work1[i] == 0 && work2[i] == set_to)
-			{
-				work1[i] = set_to;
-				p1.pxy = i;
-				p1.pz = z;
-				s.push_back(p1);
-			}
-		}
-	}
-
-	posit i, j;
-	float* work;
-
-	while (!s.empty())
-	{
-		i = s.back();
-		s.pop_back();
-
-		work = _image_slices[i.pz].return_work();
-		if (i.pxy % _width != 0 && work[i.pxy - 1] == 0)
-		{
-			work[i.pxy - 1] = set_to;
-			j.pxy = i.pxy - 1;
-			j.pz = i.pz;
-			s.push_back(j);
-		}
-		if ((i.pxy + 1) % _width != 0 && work[i.pxy + 1] == 0)
-		{
-			work[i.pxy + 1] = set_to;
-			j.pxy = i.pxy + 1;
-			j.pz = i.pz;
-			s.push_back(j);
-		}
-		if (i.pxy >= _width && work[i.pxy - _width] == 0)
-		{
-			work[i.pxy - _width] = set_to;
-			j.pxy = i.pxy - _width;
-			j.pz = i.pz;
-			s.push_back(j);
-		}
-		if (i.pxy < _area - _width && work[i.pxy + _width] == 0)
-		{
-			work[i.pxy + _width] = set_to;
-			j.pxy = i.pxy + _width;
-			j.pz = i.pz;
-			s.push_back(j);
-		}
-		if (i.pz > _startslice)
-		{
-			work = _image_slices[i.pz - 1].return_work();
-			if (work[i.pxy] == 0)
-			{
-				work[i.pxy] = set_to;
-				j.pxy = i.pxy;
-				j.pz = i.pz - 1;
-				s.push_back(j);
-			}
-		}
-		if (i.pz + 1 < _endslice)
-		{
-			work = _image_slices[i.pz + 1].return_work();
-			if (work[i.pxy] == 0)
-			{
-				work[i.pxy] = set_to;
-				j.pxy = i.pxy;
-				j.pz = i.pz + 1;
-				s.push_back(j);
-			}
-		}
-	}
-
-	unsigned short x, y;
-	unsigned long pos;
-	unsigned short i1;
-	for (unsigned short z = _startslice; z < _endslice; z++)
-	{
-		work = _image_slices[z].return_work();
-
-		for (y = 0; y < _height; y++)
-		{
-			pos = y * _width;
-			i1 = 0;
-			while (pos < (unsigned long)(y + 1) * _width)
-			{
-				if (work[pos] != set_to)
-					i1 = ix;
-				else
-				{
-					if (i1 > 0)
-					{
-						work[pos] = setto;
-						i1--;
-					}
-				}
-				pos++;
-			}
-		}
-
-		for (y = 0; y < _height; y++)
-		{
-			pos = (y + 1) * _width - 1;
-			i1 = 0;
-			while (pos > (unsigned long)y * _width)
-			{
-				if (work[pos] != set_to)
-					i1 = ix;
-				else
-				{
-					if (i1 > 0)
-					{
-						work[pos] = setto;
-						i1--;
-					}
-				}
-				pos--;
-			}
-			if (work[pos] != set_to)
-				i1 = ix;
-			else
-			{
-				if (i1 > 0)
-				{
-					work[pos] = setto;
-					i1--;
-				}
-			}
-		}
-
-		for (x = 0; x < _width; x++)
-		{
-			pos = x;
-			i1 = 0;
-			while (pos < _area)
-			{
-				if (work[pos] != set_to)
-					i1 = iy;
-				else
-				{
-					if (i1 > 0)
-					{
-						work[pos] = setto;
-						i1--;
-					}
-				}
-				pos += _width;
-			}
-		}
-
-		for (x = 0; x < _width; x++)
-		{
-			pos = _area + x - _width;
-			i1 = 0;
-			while (pos > _width)
-			{
-				if (work[pos] != set_to)
-					i1 = iy;
-				else
-				{
-					if (i1 > 0)
-					{
-						work[pos] = setto;
-						i1--;
-					}
-				}
-				pos -= _width;
-			}
-			if (work[pos] != set_to)
-				i1 = iy;
-			else
-			{
-				if (i1 > 0)
-				{
-					work[pos] = setto;
-					i1--;
-				}
-			}
-		}
-	}
-
-	unsigned short* counter = (unsigned short*)malloc(sizeof(unsigned short) * _area);
-	for (unsigned i1 = 0; i1 < _area; i1++)
-		counter[i1] = 0;
-	for (unsigned short z = _startslice; z < _endslice; z++)
+	for (unsigned short z = _endslice - 1; z > _startslice; z--)
 	{
-		work = _image_slices[z].return_work();
-		for (pos = 0; pos < _area; pos++)
+		work1 = _image_slices[z].return_work();
+		work2 = _image_slices[z - 1].return_work();
+		for (unsigned long i = 0; i < _area; i++)
 		{
-			if (work[pos] != set_to)
-				counter[pos] = iz;
-			else
+			if (work1[i] == 0 && work2[i] == set_to)
 			{
-				if (counter[pos] > 0)
-				{
-					work[pos] = setto;
-					counter[pos]--;
-				}
+				work1[i] = set_to;
+				p1.pxy = i;
+				p1.pz = z;
+				s.push_back(p1);
 			}
 		}
 	}
-	for (unsigned i1 = 0; i1 < _area; i1++)
-		counter[i1] = 0;
-	for (unsigned short z = _endslice - 1; z > _startslice; z--)
+
+	posit i, j;
+	float* work;
+
+	while (!s.empty())
 	{
-		work = _image_slices[z].return_work();
-		for (pos = 0; pos < _area; pos++)
+		i = s.back();
+		s.pop_back();
+
+		work = _image_slices[i.pz].return_work();
+		if (i.pxy % _width != 0 && work[i.pxy - 1] == 0)
 		{
-			if (work[pos] != set_to)
-				counter[pos] = iz;
-			else
+			work[i.pxy - 1] = set_to;
+			j.pxy = i.pxy - 1;
+			j.pz = i.pz;
+			s.push_back(j);
+		}
+		if ((i.pxy + 1) % _width != 0 && work[i.pxy + 1] == 0)
+		{
+			work[i.pxy + 1] = set_to;
+			j.pxy = i.pxy + 1;
+			j.pz = i.pz;
+			s.push_back(j);
+		}
+		if (i.pxy >= _width && work[i.pxy - _width] == 0)
+		{
+			work[i.pxy - _width] = set_to;
+			j.pxy = i.pxy - _width;
+			j.pz = i.pz;
+			s.push_back(j);
+		}
+		if (i.pxy < _area - _width && work[i.pxy + _width] == 0)
+		{
+			work[i.pxy + _width] = set_to;
+			j.pxy = i.pxy + _width;
+			j.pz = i.pz;
+			s.push_back(j);
+		}
+		if (i.pz > _startslice)
+		{
+			work = _image_slices[i.pz - 1].return_work();
+			if (work[i.pxy] == 0)
 			{
-				if (counter[pos] > 0)
-				{
-					work[pos] = setto;
-					counter[pos]--;
-				}
+				work[i.pxy] = set_to;
+				j.pxy = i.pxy;
+				j.pz = i.pz - 1;
+				s.push_back(j);
 			}
 		}
-	}
-	work = _image_slices[_startslice].return_work();
-	for (pos = 0; pos < _area; pos++)
-	{
-		if (work[pos] != set_to)
-			counter[pos] = iz;
-		else
+		if (i.pz + 1 < _endslice)
 		{
-			if (counter[pos] > 0)
+			work = _image_slices[i.pz + 1].return_work();
+			if (work[i.pxy] == 0)
 			{
-				work[pos] = setto;
-				counter[pos]--;
+				work[i.pxy] = set_to;
+				j.pxy = i.pxy;
+				j.pz = i.pz + 1;
+				s.push_back(j);
 			}
 		}
 	}
-	free(counter);
 
-	for (unsigned short z = _startslice; z < _endslice; z++)
+	// exterior voxels within the ellipsoid with radii ix,iy,iz around the object become skin
+	const double spacing[3] = {ix > 0 ? 1.0 / ix : 2.0, iy > 0 ? 1.0 / iy : 2.0, iz > 0 ? 1.0 / iz : 2.0};
+
+	const unsigned short nrslices = _endslice - _startslice;
+	std::vector<float> dist(static_cast<size_t>(_area) * nrslices);
+	std::vector<const float*> work_slices(nrslices);
+	std::vector<float*> dist_slices(nrslices);
+	for (unsigned short z = 0; z < nrslices; z++)
 	{
-		work = _image_slices[z].return_work();
+		work_slices[z] = _image_slices[_startslice + z].return_work();
+		dist_slices[z] = &dist[static_cast<size_t>(z) * _area];
+	}
+
+	DistanceTransform(work_slices.data(), _width, _height, nrslices, spacing, [set_to](float v) { return v != set_to; }, dist_slices.data(), true);
+
+	const int n = static_cast<int>(nrslices);
+#pragma omp parallel for
+	for (int z = 0; z < n; z++)
+	{
+		float* w = _image_slices[_startslice + z].return_work();
+		const float* d = dist_slices[z];
 		for (unsigned i1 = 0; i1 < _area; i1++)
-			if (work[i1] == set_to)
-				work[i1] = 0;
+		{
+			if (w[i1] == set_to)
+				w[i1] = (d[i1] <= 1.0f + 1e-4f) ? setto : 0;
+		}
 	}
 }
 
@@ -10909,39 +10540,11 @@ void SlicesHandler::fill_skin_3d(int thicknessX, int thicknessY, int thicknessZ,
 
 	double max_d = skinThick == 1 ? 1.75 * skinThick : 1.2 * skinThick;
 
-	//Create the relative neighborhood
-	std::vector<std::vector<int>> offsetsSlices;
-	for (int z = -skinThick; z <= skinThick; z++)
-	{
-		std::vector<int> offsets;
-		for (int y = -skinThick; y <= skinThick; y++)
-		{
-			for (int x = -skinThick; x <= skinThick; x++)
-			{
-				if (sqrt(x * x + y * y + z * z) < max_d)
-				{
-					int shift = x + y * dims[0];
-					if (shift != 0)
-					{
-						offsets.push_back(shift);
-					}
-				}
-			}
-		}
-		offsetsSlices.push_back(offsets);
-	}
-
-	struct changesToMakeStruct
-	{
-		size_t sliceNumber;
-		int positionConvert;
-
-		bool operator==(const changesToMakeStruct& m) const
-		{
-			return ((m.sliceNumber == sliceNumber) &&
-							(m.positionConvert == positionConvert));
-		}
-	};
+	// distances are measured in units of skinThick voxels along x
+	const double spacing[3] = {
+			thicknessX > 0 ? double(skinThick) / thicknessX : 2.0 * max_d,
+			thicknessY > 0 ? double(skinThick) / thicknessY : 2.0 * max_d,
+			thicknessZ > 0 ? double(skinThick) / thicknessZ : 2.0 * max_d};
 
 	bool thereIsBG = false;
 	bool thereIsSkin = false;
@@ -10964,158 +10567,42 @@ void SlicesHandler::fill_skin_3d(int thicknessX, int thicknessY, int thicknessZ,
 			break;
 	}
 
-	if (!thereIsBG || !thereIsSkin)
+	if (!thereIsBG || !thereIsSkin || skinThick <= 0)
 	{
 		progress.setValue(numTasks);
 		return;
 	}
 
-	std::vector<tissues_size_t*> tissuesVector;
-	for (int i = 0; i < _image_slices.size(); i++)
-		tissuesVector.push_back(_image_slices[i].return_tissues(0));
-
+	// background voxels which are close to the skin and to another tissue are filled
+	std::vector<const tissues_size_t*> tissues(dims[2]);
+	std::vector<float*> skin_dist(dims[2]), other_dist(dims[2]);
+	std::vector<float> skin_buffer(static_cast<size_t>(_area) * dims[2]);
+	std::vector<float> other_buffer(static_cast<size_t>(_area) * dims[2]);
 	for (int i = 0; i < dims[2]; i++)
 	{
-		float* bmp1 = _image_slices[i].return_bmp();
-
-		tissues_size_t* tissue1 = _image_slices[i].return_tissues(0);
-		_image_slices[i].pushstack_bmp();
-
-		for (unsigned int j = 0; j < _area; j++)
-		{
-			bmp1[j] = (float)tissue1[j];
-		}
-
-		_image_slices[i].dead_reckoning((float)0);
-		bmp1 = _image_slices[i].return_work();
+		tissues[i] = _image_slices[i].return_tissues(0);
+		skin_dist[i] = &skin_buffer[static_cast<size_t>(i) * _area];
+		other_dist[i] = &other_buffer[static_cast<size_t>(i) * _area];
 	}
 
-#ifdef NO_OPENMP_SUPPORT
-	const int numberThreads = 1;
-#else
-	const int numberThreads = omp_get_max_threads();
-#endif
-	int sliceCounter = 0;
-	std::vector<std::vector<changesToMakeStruct>> partialChangesThreads;
+	DistanceTransform(tissues.data(), _width, _height, dims[2], spacing,
+			[skinID](tissues_size_t v) { return v == skinID; }, skin_dist.data(), true);
+	progress.setValue(numTasks / 2);
 
-	for (int i = 0; i < numberThreads; i++)
-	{
-		changesToMakeStruct sample;
-		sample.sliceNumber = -1;
-		sample.positionConvert = -1;
-		std::vector<changesToMakeStruct> samplePerThread;
-		samplePerThread.push_back(sample);
-		partialChangesThreads.push_back(samplePerThread);
-	}
+	DistanceTransform(tissues.data(), _width, _height, dims[2], spacing,
+			[backgroundID, skinID](tissues_size_t v) { return v != backgroundID && v != skinID; }, other_dist.data(), true);
 
-	//if(skinPixels<bgPixels/neighbors)
-	{
+	const float max_d2 = static_cast<float>(max_d * max_d);
 #pragma omp parallel for
-		for (int k = skinThick; k < dims[2] - skinThick; k++)
-		{
-			std::vector<changesToMakeStruct> partialChanges;
-
-			Point p;
-			for (int j = skinThick; j < dims[1] - skinThick; j++)
-			{
-				for (int i = skinThick; i < dims[0] - skinThick; i++)
-				{
-					int pos = i + j * dims[0];
-					if (tissuesVector[k][pos] == skinID)
-					{
-						for (int z = 0; z < offsetsSlices.size(); z++)
-						{
-							size_t neighborSlice = z - ((offsetsSlices.size() - 1) / 2);
-
-							//iterate through neighbors of pixel
-							//if any of these are not
-							for (int l = 0; l < offsetsSlices[z].size(); l++)
-							{
-								int idx = pos + offsetsSlices[z][l];
-								assert(idx >= 0 && idx < _area);
-								p.px = i;
-								p.py = j;
-								tissues_size_t value = tissuesVector[k + neighborSlice][idx];
-								if (value == backgroundID)
-								{
-									for (int y = 0; y < offsetsSlices.size(); y++)
-									{
-										size_t neighborSlice2 = y - ((offsetsSlices.size() - 1) / 2);
-
-										//iterate through neighbors of pixel
-										//if any of these are not
-										for (int m = 0; m < offsetsSlices[y].size(); m++)
-										{
-											int idx2 = idx + offsetsSlices[y][m];
-											assert(idx2 >= 0 && idx2 < _area);
-											if (k + neighborSlice + neighborSlice2 < dims[2]) // && k + neighborSlice + neighborSlice2 >= 0 (always true)
-											{
-												tissues_size_t value2 = tissuesVector[k + neighborSlice + neighborSlice2][idx2];
-												if (value2 != backgroundID && value2 != skinID)
-												{
-													changesToMakeStruct changes;
-													changes.sliceNumber = k + neighborSlice;
-													changes.positionConvert = idx;
-													if (std::find(partialChanges.begin(), partialChanges.end(), changes) == partialChanges.end())
-														partialChanges.push_back(changes);
-													//image_slices[k+neighborSlice].return_work()[idx]=255.0f;
-													break;
-												}
-											}
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-			}
-
-#ifdef NO_OPENMP_SUPPORT
-			int thread_id = 0;
-#else
-			int thread_id = omp_get_thread_num();
-#endif
-
-			for (int i = 0; i < partialChanges.size(); i++)
-			{
-				partialChangesThreads[thread_id].push_back(partialChanges[i]);
-			}
-
-			if (0 == thread_id)
-			{
-				sliceCounter++;
-				progress.setValue(numberThreads * sliceCounter);
-			}
-		}
-	}
-
-	for (int i = 0; i < partialChangesThreads.size(); i++)
+	for (int k = 0; k < dims[2]; k++)
 	{
-		for (int j = 0; j < partialChangesThreads[i].size(); j++)
+		float* work1 = _image_slices[k].return_work();
+		for (unsigned pos = 0; pos < _area; pos++)
 		{
-			if (partialChangesThreads[i][j].sliceNumber != -1)
-			{
-				size_t slice = partialChangesThreads[i][j].sliceNumber;
-				int pos = partialChangesThreads[i][j].positionConvert;
-				_image_slices[slice].return_work()[pos] = 255.0f;
-			}
-		}
-	}
-	for (int i = dims[2] - 1; i >= 0; i--)
-	{
-		float* bmp1 = _image_slices[i].return_bmp();
-
-		for (unsigned k = 0; k < _area; k++)
-		{
-			if (bmp1[k] < 0)
-				bmp1[k] = 0;
-			else
-				bmp1[k] = 255.0f;
+			const bool fill = tissues[k][pos] == backgroundID && skin_dist[k][pos] < max_d2 && other_dist[k][pos] < max_d2;
+			work1[pos] = fill ? 255.0f : 0.0f;
 		}
-
-		_image_slices[i].set_mode(2, false);
-		_image_slices[i].popstack_bmp();
+		_image_slices[k].set_mode(2, false);
 	}
 
 	progress.setValue(numTasks);
@@ -11134,10 +10621,8 @@ float SlicesHandler::calculate_volume(Point p, unsigned short slicenr)
 float SlicesHandler::calculate_tissuevolume(Point p, unsigned short slicenr)
 {
 	Pair p1 = get_pixelsize();
-	unsigned long count = 0;
 	tissues_size_t c = get_tissue_pt(p, slicenr);
-	for (unsigned short j = _startslice; j < _endslice; j++)
-		count += _image_slices[j].return_tissuepixelcount(_active_tissuelayer, c);
+	size_t count = update_tissue_index().count(_startslice, _endslice, c);
 	return get_slicethickness() * p1.high * p1.low * count;
 }
 
@@ -11155,6 +10640,11 @@ void SlicesHandler::inversesliceorder()
 			image_slices[rcounter]=dummy;*/
 		}
 		reverse_undosliceorder();
+		_slice_ranges.invalidate_all();
+		_slice_histograms.invalidate_all();
+		_slice_bmpranges.invalidate_all();
+		_slice_bmphistograms.invalidate_all();
+		_slice_tissues.invalidate_all();
 	}
 }
 
@@ -11212,104 +10702,112 @@ void SlicesHandler::stepsmooth_z(unsigned short n)
 {
 	if (n > (_endslice - _startslice))
 		return;
-	SmoothSteps stepsm;
-	unsigned short linelength1 = _endslice - _startslice;
-	tissues_size_t* line = new tissues_size_t[linelength1];
-	stepsm.init(n, linelength1, TissueInfos::GetTissueCount() + 1);
-	for (unsigned long i = 0; i < _area; i++)
+
+	auto all_tissues = tissue_slices(_active_tissuelayer);
+	std::vector<tissues_size_t*> tissues(all_tissues.begin() + _startslice, all_tissues.begin() + _endslice);
+	const unsigned short linelength1 = _endslice - _startslice;
+	const tissues_size_t nrtissues = TissueInfos::GetTissueCount() + 1;
+
+	// the z-lines of a tile of consecutive pixels are gathered into a contiguous slab,
+	// so that each slice is read and written row-wise
+	const unsigned tile_size = 256;
+	const int nrtiles = static_cast<int>((_area + tile_size - 1) / tile_size);
+#pragma omp parallel
 	{
-		unsigned short k = 0;
-		for (unsigned short j = _startslice; j < _endslice; j++, k++)
-		{
-			line[k] = (_image_slices[j].return_tissues(_active_tissuelayer))[i];
-		}
-		stepsm.dostepsmooth(line);
-		k = 0;
-		for (unsigned short j = _startslice; j < _endslice; j++, k++)
+		SmoothSteps stepsm;
+		stepsm.init(n, linelength1, nrtissues);
+		std::vector<tissues_size_t> slab(size_t(tile_size) * linelength1);
+
+#pragma omp for schedule(dynamic)
+		for (int t = 0; t < nrtiles; t++)
 		{
-			(_image_slices[j].return_tissues(_active_tissuelayer))[i] = line[k];
+			const unsigned i0 = t * tile_size;
+			const unsigned len = std::min(tile_size, _area - i0);
+
+			for (unsigned short k = 0; k < linelength1; k++)
+			{
+				const tissues_size_t* row = tissues[k] + i0;
+				for (unsigned i = 0; i < len; i++)
+					slab[size_t(i) * linelength1 + k] = row[i];
+			}
+
+			for (unsigned i = 0; i < len; i++)
+				stepsm.dostepsmooth(&slab[size_t(i) * linelength1]);
+
+			for (unsigned short k = 0; k < linelength1; k++)
+			{
+				tissues_size_t* row = tissues[k] + i0;
+				for (unsigned i = 0; i < len; i++)
+					row[i] = slab[size_t(i) * linelength1 + k];
+			}
 		}
 	}
-	delete[] line;
 }
 
 void SlicesHandler::smooth_tissues(unsigned short n)
 {
 	// TODO: Implement criterion: Cells must be contiguous to the center of the specified filter
-	std::map<tissues_size_t, unsigned short> tissuecount;
-	tissues_size_t* tissuesnew =
-			(tissues_size_t*)malloc(sizeof(tissues_size_t) * _area);
 	if (n % 2 == 0)
 		n++;
-	unsigned short filtersize = n * n;
+	const unsigned short filtersize = n * n;
+	const unsigned short halffiltersize = (unsigned short)(0.5f * filtersize + 0.5f);
 	n = (unsigned short)(0.5f * n);
+	if (2 * n >= _width || 2 * n >= _height)
+		return;
 
-	for (unsigned short j = _startslice; j < _endslice; j++)
+	const tissues_size_t nrtissues = TissueInfos::GetTissueCount() + 1;
+	const int startslice = _startslice, endslice = _endslice;
+#pragma omp parallel
 	{
-		_image_slices[j].copyfromtissue(_active_tissuelayer, tissuesnew);
-		tissues_size_t* tissuesold =
-				_image_slices[j].return_tissues(_active_tissuelayer);
-		for (unsigned short y = n; y < _height - n; y++)
+		// tissue count within filter size, only the tissues in the window are reset
+		std::vector<unsigned short> tissuecount(nrtissues, 0);
+		std::vector<tissues_size_t> touched;
+		std::vector<tissues_size_t> tissuesnew(_area);
+
+#pragma omp for schedule(dynamic)
+		for (int z = startslice; z < endslice; z++)
 		{
-			for (unsigned short x = n; x < _width - n; x++)
+			_image_slices[z].copyfromtissue(_active_tissuelayer, tissuesnew.data());
+			const tissues_size_t* tissuesold = _image_slices[z].return_tissues(_active_tissuelayer);
+			for (unsigned short y = n; y < _height - n; y++)
 			{
-				// Tissue count within filter size
-				tissuecount.clear();
-				for (short i = -n; i <= n; i++)
+				for (unsigned short x = n; x < _width - n; x++)
 				{
-					for (short j = -n; j <= n; j++)
+					for (unsigned short wy = y - n; wy <= y + n; wy++)
 					{
-						tissues_size_t currtissue =
-								tissuesold[(y + i) * _width + (x + j)];
-						if (tissuecount.find(currtissue) == tissuecount.end())
-						{
-							tissuecount.insert(
-									std::pair<tissues_size_t, unsigned short>(
-											currtissue, 1));
-						}
-						else
+						const tissues_size_t* row = tissuesold + wy * _width;
+						for (unsigned short wx = x - n; wx <= x + n; wx++)
 						{
-							tissuecount[currtissue]++;
+							if (tissuecount[row[wx]]++ == 0)
+								touched.push_back(row[wx]);
 						}
 					}
-				}
-#if 0 // Majority                                                              \
-			// Find tissue with majority
-				tissues_size_t tissuemajor = tissuesold[y*width+x];
-				unsigned short tissuemajorcount = tissuecount[tissuemajor];
-				for (std::map<tissues_size_t, unsigned short>::iterator iter = tissuecount.begin();
-					iter != tissuecount.end(); ++iter) {
-					if (iter->second > tissuemajorcount) {
-						tissuemajor = iter->first;
-						tissuemajorcount = iter->second;
-					}
-				}
-#else // Majority and half or more                                             \
-			// Find tissue covering at least half of the pixels
-				unsigned short halffiltersize =
-						(unsigned short)(0.5f * filtersize + 0.5f);
-				tissues_size_t tissuemajor = tissuesold[y * _width + x];
-				unsigned short tissuemajorcount = tissuecount[tissuemajor];
-				for (std::map<tissues_size_t, unsigned short>::iterator iter =
-								 tissuecount.begin();
-						 iter != tissuecount.end(); ++iter)
-				{
-					if (iter->second > tissuemajorcount &&
-							iter->second >= halffiltersize)
+
+					// Majority and half or more: find tissue covering at least half of the pixels,
+					// the smallest tissue wins a tie
+					tissues_size_t tissuemajor = tissuesold[y * _width + x];
+					const unsigned short centercount = tissuecount[tissuemajor];
+					tissues_size_t best = tissuemajor;
+					for (auto c : touched)
 					{
-						tissuemajor = iter->first;
-						tissuemajorcount = iter->second;
+						if (tissuecount[c] > tissuecount[best] ||
+								(tissuecount[c] == tissuecount[best] && c < best))
+							best = c;
 					}
+					if (tissuecount[best] > centercount && tissuecount[best] >= halffiltersize)
+						tissuemajor = best;
+
+					for (auto c : touched)
+						tissuecount[c] = 0;
+					touched.clear();
+
+					// Assign new tissue
+					tissuesnew[y * _width + x] = tissuemajor;
 				}
-#endif
-				// Assign new tissue
-				tissuesnew[y * _width + x] = tissuemajor;
 			}
+			_image_slices[z].copy2tissue(_active_tissuelayer, tissuesnew.data());
 		}
-		_image_slices[j].copy2tissue(_active_tissuelayer, tissuesnew);
 	}
-
-	free(tissuesnew);
 }
 
 void SlicesHandler::regrow(unsigned short sourceslicenr,
@@ -11496,123 +10994,172 @@ void SlicesHandler::get_color(size_t idx, unsigned char& r, unsigned char& g, un
 
 bool SlicesHandler::compute_target_connectivity(ProgressInfo* progress)
 {
-	using input_type = SliceHandlerItkWrapper::image_ref_type;
-	using image_type = itk::Image<unsigned, 3>;
+	auto all_slices = target_slices();
+	std::vector<const float*> slices(all_slices.begin() + _startslice, all_slices.begin() + _endslice);
 
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTarget(true);
+	const size_t slice_size = static_cast<size_t>(_width) * _height;
+	std::vector<unsigned> labels(slice_size * slices.size());
+	std::vector<unsigned*> label_slices(slices.size());
+	for (size_t i = 0; i < slices.size(); ++i)
+	{
+		label_slices[i] = labels.data() + i * slice_size;
+	}
 
-	auto observer = ItkProgressObserver::New();
+	// all non-zero voxels are foreground, fully connected
+	ConnectedComponents(
+			slices.data(), _width, _height, slices.size(), kConnectivity26, label_slices.data(),
+			[](float v) { return v != 0.f; },
+			[](float, float) { return true; },
+			progress);
 
-	auto filter = itk::ConnectedComponentImageFilter<input_type, image_type>::New();
-	filter->SetInput(all_slices);
-	filter->SetFullyConnected(true);
-	if (progress)
+	if (progress && progress->wasCanceled())
 	{
-		observer->SetProgressInfo(progress);
-		filter->AddObserver(itk::ProgressEvent(), observer);
+		return false;
 	}
-	try
+
+	// copy result back
+	const int num_slices = static_cast<int>(slices.size());
+#pragma omp parallel for
+	for (int i = 0; i < num_slices; ++i)
 	{
-		filter->Update();
+		std::copy(label_slices[i], label_slices[i] + slice_size, all_slices[_startslice + i]);
+	}
 
-		if (!progress || (progress && !progress->wasCanceled()))
-		{
-			// copy result back
-			iseg::Paste<image_type, input_type>(filter->GetOutput(), all_slices);
+	// auto-scale target rendering
+	set_target_fixed_range(false);
 
-			// auto-scale target rendering
-			set_target_fixed_range(false);
+	return true;
+}
 
-			return true;
+bool SlicesHandler::compute_marker_watershed(ProgressInfo* progress)
+{
+	auto all_slices = source_slices();
+	std::vector<const float*> slices(all_slices.begin() + _startslice, all_slices.begin() + _endslice);
+
+	const size_t slice_size = static_cast<size_t>(_width) * _height;
+	std::vector<float> gradient(slice_size * slices.size());
+	std::vector<float*> gradient_slices(slices.size());
+	std::vector<unsigned> labels(slice_size * slices.size(), 0);
+	std::vector<unsigned*> label_slices(slices.size());
+	for (size_t i = 0; i < slices.size(); ++i)
+	{
+		gradient_slices[i] = gradient.data() + i * slice_size;
+		label_slices[i] = labels.data() + i * slice_size;
+	}
+
+	// the marks of all active slices are the seeds
+	unsigned max_label = 0;
+	for (unsigned short z = _startslice; z < _endslice; z++)
+	{
+		auto marks = _image_slices[z].return_marks();
+		for (auto it = marks->begin(); it != marks->end(); ++it)
+		{
+			label_slices[z - _startslice][it->p.px + it->p.py * static_cast<size_t>(_width)] = it->mark;
+			max_label = std::max(max_label, it->mark);
 		}
 	}
-	catch (itk::ExceptionObject& e)
+	if (max_label == 0)
 	{
-		ISEG_ERROR("Exception occurred: " << e.what());
+		return false;
 	}
-	return false;
+
+	const double spacing[3] = {_dx, _dy, _thickness};
+	GradientMagnitude(slices.data(), _width, _height, slices.size(), spacing, gradient_slices.data());
+
+	const auto range = std::minmax_element(gradient.begin(), gradient.end());
+	if (!MarkerWatershed(gradient_slices.data(), _width, _height, slices.size(), *range.first, *range.second, 256,
+					kConnectivity6, label_slices.data(), progress))
+	{
+		return false;
+	}
+
+	// same scaling as the 2D watershed labels
+	const float d = 255.0f / max_label;
+	auto targets = target_slices();
+	const int num_slices = static_cast<int>(slices.size());
+#pragma omp parallel for
+	for (int i = 0; i < num_slices; ++i)
+	{
+		float* work = targets[_startslice + i];
+		for (size_t j = 0; j < slice_size; ++j)
+		{
+			work[j] = d * label_slices[i][j];
+		}
+		_image_slices[_startslice + i].set_mode(2, false);
+	}
+
+	return true;
 }
 
 bool SlicesHandler::compute_split_tissues(tissues_size_t tissue, ProgressInfo* progress)
 {
-	using input_type = SliceHandlerItkWrapper::tissues_ref_type;
-	using internal_type = itk::Image<unsigned char, 3>;
-	using image_type = itk::Image<unsigned, 3>;
-
-	SliceHandlerItkWrapper wrapper(this);
-	auto all_slices = wrapper.GetTissues(true);
+	auto all_slices = tissue_slices(active_tissuelayer());
+	std::vector<tissues_size_t*> slices(all_slices.begin() + _startslice, all_slices.begin() + _endslice);
 
-	auto observer = ItkProgressObserver::New();
+	const size_t slice_size = static_cast<size_t>(_width) * _height;
+	std::vector<unsigned> labels(slice_size * slices.size());
+	std::vector<unsigned*> label_slices(slices.size());
+	for (size_t i = 0; i < slices.size(); ++i)
+	{
+		label_slices[i] = labels.data() + i * slice_size;
+	}
 
-	auto threshold = itk::BinaryThresholdImageFilter<input_type, internal_type>::New();
-	threshold->SetLowerThreshold(tissue);
-	threshold->SetUpperThreshold(tissue);
-	threshold->SetInput(all_slices);
+	auto N = ConnectedComponents(
+			slices.data(), _width, _height, slices.size(), kConnectivity26, label_slices.data(),
+			[tissue](tissues_size_t v) { return v == tissue; },
+			[](tissues_size_t, tissues_size_t) { return true; },
+			progress);
 
-	auto filter = itk::ConnectedComponentImageFilter<internal_type, image_type>::New();
-	filter->SetInput(threshold->GetOutput());
-	filter->SetFullyConnected(true);
-	if (progress)
+	if (progress && progress->wasCanceled())
 	{
-		observer->SetProgressInfo(progress);
-		filter->AddObserver(itk::ProgressEvent(), observer);
+		return false;
 	}
-	try
-	{
-		filter->Update();
-		auto components = filter->GetOutput();
 
-		if (!progress || (progress && !progress->wasCanceled()))
+	tissues_size_t Ninitial = TissueInfos::GetTissueCount();
+
+	// add tissue infos
+	if (N > 1)
+	{
+		// find which object is largest -> this one will keep its original name & color
+		std::vector<size_t> hist(N + 1, 0);
+		for (auto label : labels)
 		{
-			tissues_size_t Ninitial = TissueInfos::GetTissueCount();
+			hist[label]++;
+		}
+		hist[0] = 0;
+		const size_t max_label = std::distance(hist.begin(), std::max_element(hist.begin(), hist.end()));
 
-			// add tissue infos
-			auto N = filter->GetObjectCount();
-			if (N > 1)
+		// mapping from object number to new tissue index
+		std::vector<tissues_size_t> object2index(N + 1, 0);
+		object2index[max_label] = tissue;
+		tissues_size_t idx = 1;
+		for (unsigned i = 1; i <= N; ++i)
+		{
+			if (i != max_label)
 			{
-				// find which object is largest -> this one will keep its original name & color
-				std::vector<size_t> hist(N + 1, 0);
-				itk::ImageRegionConstIterator<image_type> it(components, components->GetLargestPossibleRegion());
-				for (it.GoToBegin(); !it.IsAtEnd(); ++it)
-				{
-					hist[it.Get()]++;
-				}
-				hist[0] = 0;
-				const size_t max_label = std::distance(hist.begin(), std::max_element(hist.begin(), hist.end()));
-
-				// mapping from object number to new tissue index
-				std::vector<tissues_size_t> object2index(N + 1, 0);
-				object2index[max_label] = tissue;
-				tissues_size_t idx = 1;
-				for (tissues_size_t i = 1; i <= N; ++i)
-				{
-					if (i != max_label)
-					{
-						TissueInfo info(*TissueInfos::GetTissueInfo(tissue));
-						info.name += (boost::format("_%d") % static_cast<int>(idx)).str();
-						TissueInfos::AddTissue(info);
-						object2index.at(i) = Ninitial + idx++;
-					}
-				}
+				TissueInfo info(*TissueInfos::GetTissueInfo(tissue));
+				info.name += (boost::format("_%d") % static_cast<int>(idx)).str();
+				TissueInfos::AddTissue(info);
+				object2index.at(i) = Ninitial + idx++;
+			}
+		}
 
-				// iterate over connected components, add to tissues
-				itk::ImageRegionIterator<input_type> ot(all_slices, all_slices->GetLargestPossibleRegion());
-				for (it.GoToBegin(), ot.GoToBegin(); !it.IsAtEnd(); ++it, ++ot)
+		// iterate over connected components, add to tissues
+		const int num_slices = static_cast<int>(slices.size());
+#pragma omp parallel for
+		for (int i = 0; i < num_slices; ++i)
+		{
+			const unsigned* label = label_slices[i];
+			tissues_size_t* tissues = slices[i];
+			for (size_t j = 0; j < slice_size; ++j)
+			{
+				if (label[j] != 0)
 				{
-					if (it.Get() != 0)
-					{
-						ot.Set(object2index.at(it.Get()));
-					}
+					tissues[j] = object2index[label[j]];
 				}
 			}
-
-			return true;
 		}
 	}
-	catch (itk::ExceptionObject& e)
-	{
-		ISEG_ERROR("Exception occurred: " << e.what());
-	}
-	return false;
+
+	return true;
 }
@@ -12,8 +12,14 @@
 #include "Data/SlicesHandlerInterface.h"
 #include "Data/Transform.h"
 
+#include "Core/AnisotropicDiffusion.h"
+#include "Core/LabelKernels.h"
+#include "Core/LabelMorphology.h"
 #include "Core/Outline.h" // BL TODO get rid of this
 #include "Core/RGB.h"
+#include "Core/SliceHistogramCache.h"
+#include "Core/SliceRangeCache.h"
+#include "Core/SliceTissueIndex.h"
 #include "Core/UndoElem.h"
 #include "Core/UndoQueue.h"
 
@@ -38,6 +44,7 @@ class Transform;
 class TissueHiearchy;
 class ColorLookupTable;
 class bmphandler;
+class BitMask;
 class ProgressInfo;
 
 class SlicesHandler : public SliceHandlerInterface
@@ -173,6 +180,7 @@ public:
 	FILE* save_contourprologue(const char* filename, unsigned nr_slices);
 	FILE* save_contoursection(FILE* fp, unsigned startslice1, unsigned endslice1, unsigned offset);
 	FILE* save_tissuenamescolors(FILE* fp);
+	FILE* save_tissuenamescolors(FILE* fp, const std::set<tissues_size_t>& tissueIndices);
 	void work2bmp();
 	void bmp2work();
 	void swap_bmpwork();
@@ -212,6 +220,11 @@ public:
 	tissues_size_t get_tissue_pt(Point p, unsigned short slicenr);
 	void set_tissue_pt(Point p, unsigned short slicenr, tissues_size_t f);
 	unsigned int make_histogram(bool includeoutofrange);
+	/// 256-bin histogram of the source (bmp) or target of a slice, stored in the slice (see bmphandler::make_histogram),
+	/// from the cached per-slice histograms, i.e. the slice is only scanned if it changed
+	unsigned int make_histogram(unsigned short slicenr, bool bmp, bool includeoutofrange);
+	/// fine histogram (see SliceHistogramCache) of the source or target of the slices [first, last)
+	Histogram histogram(bool bmp, unsigned short first, unsigned short last);
 	unsigned int return_area();
 	unsigned short width() const override;
 	unsigned short height() const override;
@@ -238,17 +251,23 @@ public:
 	void get_bmprange(Pair* pp);
 	void compute_bmprange_mode1(Pair* pp);
 	void compute_bmprange_mode1(unsigned short updateSlicenr, Pair* pp);
+	void invalidate_ranges(const DataSelection& dataSelection);
 	void get_rangetissue(tissues_size_t* pp);
 	void gaussian(float sigma);
 	void average(unsigned short n);
 	void median_interquartile(bool median);
-	void aniso_diff(float dt, int n, float (*f)(float, float), float k,
+	/// 3D anisotropic diffusion of the active slices, with the slice thickness and pixel size
+	void aniso_diff(float dt, int n, diffusion::eConductance f, float k,
 			float restraint);
-	void cont_anisodiff(float dt, int n, float (*f)(float, float), float k,
+	void cont_anisodiff(float dt, int n, diffusion::eConductance f, float k,
 			float restraint);
 	void stepsmooth_z(unsigned short n);
 	void smooth_tissues(unsigned short n);
-	void sigmafilter(float sigma, unsigned short nx, unsigned short ny);
+	/// Sigma filter of the active slices, with a nx x ny x nz window (nz = 1 filters each slice separately)
+	void sigmafilter(float sigma, unsigned short nx, unsigned short ny,
+			unsigned short nz = 1);
+	/// Bilateral filter of the active slices, sigma_space in pixels, in 3D scaled by the pixel size and slice thickness
+	void bilateral(float sigma_space, float sigma_range, bool in3d = false);
 	void hysteretic(float thresh_low, float thresh_high, bool connectivity,
 			unsigned short nrpasses);
 	void double_hysteretic(float thresh_low_l, float thresh_low_h,
@@ -267,6 +286,8 @@ public:
 	void dilation(boost::variant<int, float> radius, bool connectivity);
 	void closure(boost::variant<int, float> radius, bool connectivity);
 	void open(boost::variant<int, float> radius, bool connectivity);
+	/// morphology of the selected tissues (indexed by tissue) of the active layer, locked tissues are not changed
+	void tissue_morphology(morphology::eOperation operation, boost::variant<int, float> radius, const std::vector<char>& selected, bool all_slices);
 	void add_mark(Point p, unsigned label);
 	void add_mark(Point p, unsigned label, std::string str);
 	void clear_marks();
@@ -286,18 +307,17 @@ public:
 	bool remove_limit(Point p, unsigned radius, unsigned short slicenr);
 	void zero_crossings(bool connectivity);
 	void dougpeuck_line(float epsilon);
-	void kmeans(unsigned short slicenr, short nrtissues, unsigned int iternr,
-			unsigned int converge);
-	void kmeans_mhd(unsigned short slicenr, short nrtissues, short dim,
+	/// k-means and EM are trained on a sample of all active slices (converge: number of sample voxels changing class)
+	void kmeans(short nrtissues, unsigned int iternr, unsigned int converge);
+	void kmeans_mhd(short nrtissues, short dim,
 			std::vector<std::string> mhdfiles, float* weights,
 			unsigned int iternr, unsigned int converge);
-	void kmeans_png(unsigned short slicenr, short nrtissues, short dim,
+	void kmeans_png(short nrtissues, short dim,
 			std::vector<std::string> pngfiles,
 			std::vector<int> exctractChannel, float* weights,
 			unsigned int iternr, unsigned int converge,
 			const std::string initCentersFile = "");
-	void em(unsigned short slicenr, short nrtissues, unsigned int iternr,
-			unsigned int converge);
+	void em(short nrtissues, unsigned int iternr, unsigned int converge);
 	void extract_contours(int minsize, std::vector<tissues_size_t>& tissuevec);
 	void extract_contours2_xmirrored(int minsize,
 			std::vector<tissues_size_t>& tissuevec);
@@ -312,6 +332,10 @@ public:
 	void extractinterpolatesave_contours2_xmirrored(
 			int minsize, std::vector<tissues_size_t>& tissuevec,
 			unsigned short between, bool dp, float epsilon, const char* filename);
+	/// same output as extract_contours2_xmirrored, shift_contours(-width, -height), setextrusion_contours(top, bottom) and
+	/// save_contours, but the slices are written while the next ones are traced and the outlines are not kept
+	bool extractsave_contours2_xmirrored(int minsize, std::vector<tissues_size_t>& tissuevec,
+			bool dp, float epsilon, const char* filename, int top = 1, int bottom = 1);
 	void add2tissue(tissues_size_t tissuetype, Point p, bool override);
 	void add2tissueall(tissues_size_t tissuetype, Point p, bool override);
 	void add2tissueall(tissues_size_t tissuetype, Point p,
@@ -340,6 +364,9 @@ public:
 	void cleartissues();
 	void cleartissues3D();
 	void interpolatetissue(unsigned short slice1, unsigned short slice2, tissues_size_t tissuetype, bool connected);
+	/// Shape-based interpolation of the tissues between all consecutive slices which contain any of them,
+	/// the interpolated tissues are only added to background voxels
+	void interpolatetissue_allgaps(const std::vector<tissues_size_t>& tissuetypes);
 	void interpolatetissue_medianset(unsigned short slice1,
 			unsigned short slice2,
 			tissues_size_t tissuetype,
@@ -363,6 +390,7 @@ public:
 
 	bool compute_target_connectivity(ProgressInfo* progress = nullptr);
 	bool compute_split_tissues(tissues_size_t tissue, ProgressInfo* progress = nullptr);
+	bool compute_marker_watershed(ProgressInfo* progress = nullptr);
 
 	void set_slicethickness(float t);
 	float get_slicethickness();
@@ -468,6 +496,8 @@ public:
 	void set_undo3D(bool undo3D1);
 	void set_undonr(unsigned nr);
 	void set_undoarraynr(unsigned nr);
+	/// applies map to all tissue layers in one pass, see LabelMap for composing several renumberings
+	void remap_tissues(const LabelMap<tissues_size_t>& map);
 	void map_tissue_indices(const std::vector<tissues_size_t>& indexMap);
 	void remove_tissue(tissues_size_t tissuenr);
 	void remove_tissues(const std::set<tissues_size_t>& tissuenrs);
@@ -526,6 +556,26 @@ public:
 	void mergetissues(tissues_size_t tissuetype);
 
 private:
+	/// locked flag for every tissue value
+	std::vector<char> tissue_lock_table() const;
+	/// work of the active slices = set_to inside mask, 0 outside
+	void write_mask_to_work(const std::vector<BitMask>& mask, float set_to);
+	/// morphology of the foreground (> 0) of the target in the active slices
+	void target_morphology(morphology::eOperation operation, boost::variant<int, float> radius);
+	/// outline of the tissues in tissuevec in one slice, as written by the outline export
+	OutlineSlice trace_outline(bmphandler& slice, const std::vector<tissues_size_t>& tissuevec,
+			int minsize, bool xmirrored, bool dp, float epsilon, float thickness) const;
+	/// interpolates between key slices and writes the outlines of the interpolated slices, gap by gap
+	void extractinterpolatesave_outlines(int minsize, std::vector<tissues_size_t>& tissuevec,
+			unsigned short between, bool dp, float epsilon, const char* filename, bool xmirrored);
+	/// contours of all tissues in tissuevec, traced by trace(slice, tissues, outer, inner) for all slices in parallel and added to _os in slice order.
+	/// Tissues listed more than once are traced once.
+	void extract_tissuecontours(const std::vector<tissues_size_t>& tissuevec,
+			const std::function<void(bmphandler&, const std::vector<tissues_size_t>&, std::vector<std::vector<std::vector<Point>>>&,
+					std::vector<std::vector<std::vector<Point>>>&)>& trace);
+	/// recomputes the tissue index of the modified slices of the active tissue layer
+	const SliceTissueIndex<tissues_size_t>& update_tissue_index();
+
 	unsigned short _activeslice;
 	std::vector<bmphandler> _image_slices;
 	short unsigned _width;
@@ -542,8 +592,11 @@ private:
 	std::shared_ptr<ColorLookupTable> _color_lookup_table;
 	TissueHiearchy* _tissue_hierachy;
 	float* _overlay;
-	std::vector<Pair> _slice_ranges;
-	std::vector<Pair> _slice_bmpranges;
+	SliceRangeCache _slice_ranges;
+	SliceRangeCache _slice_bmpranges;
+	SliceHistogramCache _slice_histograms;
+	SliceHistogramCache _slice_bmphistograms;
+	SliceTissueIndex<tissues_size_t> _slice_tissues;
 	OutlineSlices _os;
 
 	bool _loaded;
@@ -51,6 +51,10 @@ SmoothingWidget::SmoothingWidget(SlicesHandler* hand3D, QWidget* parent,
 	hbox5 = new Q3HBox(vbox2);
 	hbox4 = new Q3HBox(vbox1);
 	allslices = new QCheckBox(QString("Apply to all slices"), vbox1);
+	in3d = new QCheckBox(QString("3D"), vbox1);
+	in3d->setToolTip("Filter the slices as a volume instead of slice by slice. "
+									 "Requires 'Apply to all slices'.");
+	in3d->setEnabled(false);
 	pushexec = new QPushButton("Execute", vbox1);
 	contdiff = new QPushButton("Cont. Diffusion", vbox1);
 
@@ -105,6 +109,10 @@ SmoothingWidget::SmoothingWidget(SlicesHandler* hand3D, QWidget* parent,
 			"Sigma filtering is a mixture between Gaussian and Average filtering. "
 			"It "
 			"preserves edges better than Average filtering.");
+	rb_bilateral = new QRadioButton(QString("Bilateral Filter"), vboxmethods);
+	rb_bilateral->setToolTip(
+			"Bilateral filtering is a Gaussian smoothing which only averages "
+			"similar intensities, i.e. it preserves edges.");
 	rb_anisodiff =
 			new QRadioButton(QString("Anisotropic Diffusion"), vboxmethods);
 	rb_anisodiff->setToolTip("Anisotropic diffusion can remove noise, while "
@@ -115,6 +123,7 @@ SmoothingWidget::SmoothingWidget(SlicesHandler* hand3D, QWidget* parent,
 	modegroup->insert(rb_average);
 	modegroup->insert(rb_median);
 	modegroup->insert(rb_sigmafilter);
+	modegroup->insert(rb_bilateral);
 	modegroup->insert(rb_anisodiff);
 	rb_gaussian->setChecked(TRUE);
 
@@ -143,6 +152,8 @@ SmoothingWidget::SmoothingWidget(SlicesHandler* hand3D, QWidget* parent,
 
 	QObject::connect(modegroup, SIGNAL(buttonClicked(int)), this,
 			SLOT(method_changed(int)));
+	QObject::connect(allslices, SIGNAL(toggled(bool)), in3d,
+			SLOT(setEnabled(bool)));
 	QObject::connect(pushexec, SIGNAL(clicked()), this, SLOT(execute()));
 	QObject::connect(contdiff, SIGNAL(clicked()), this, SLOT(continue_diff()));
 	QObject::connect(sl_sigma, SIGNAL(valueChanged(int)), this,
@@ -197,11 +208,18 @@ void SmoothingWidget::execute()
 		{
 			handler3D->sigmafilter(
 					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
-					(short unsigned)sb_n->value(), (short unsigned)sb_n->value());
+					(short unsigned)sb_n->value(), (short unsigned)sb_n->value(),
+					(short unsigned)(in3d->isChecked() ? sb_n->value() : 1));
+		}
+		else if (rb_bilateral->isOn())
+		{
+			handler3D->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
+					in3d->isChecked());
 		}
 		else
 		{
-			handler3D->aniso_diff(1.0f, sb_iter->value(), f2,
+			handler3D->aniso_diff(1.0f, sb_iter->value(), diffusion::kRational,
 					sl_k->value() * 0.01f * sb_kmax->value(),
 					sl_restrain->value() * 0.01f);
 		}
@@ -226,9 +244,14 @@ void SmoothingWidget::execute()
 					(short unsigned)sb_n->value(),
 					(short unsigned)sb_n->value());
 		}
+		else if (rb_bilateral->isOn())
+		{
+			bmphand->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value());
+		}
 		else
 		{
-			bmphand->aniso_diff(1.0f, sb_iter->value(), f2,
+			bmphand->aniso_diff(1.0f, sb_iter->value(), diffusion::kRational,
 					sl_k->value() * 0.01f * sb_kmax->value(),
 					sl_restrain->value() * 0.01f);
 		}
@@ -248,6 +271,7 @@ void SmoothingWidget::method_changed(int)
 		hbox4->hide();
 		vbox2->hide();
 		contdiff->hide();
+		in3d->hide();
 	}
 	else if (rb_average->isOn())
 	{
@@ -259,6 +283,7 @@ void SmoothingWidget::method_changed(int)
 		hbox4->hide();
 		vbox2->hide();
 		contdiff->hide();
+		in3d->hide();
 	}
 	else if (rb_median->isOn())
 	{
@@ -267,6 +292,7 @@ void SmoothingWidget::method_changed(int)
 		hbox4->hide();
 		vbox2->hide();
 		contdiff->hide();
+		in3d->hide();
 	}
 	else if (rb_sigmafilter->isOn())
 	{
@@ -282,13 +308,31 @@ void SmoothingWidget::method_changed(int)
 		else
 			hbox4->show();
 		contdiff->hide();
+		in3d->show();
 		txt_k->setText("Sigma: 0 ");
 	}
+	else if (rb_bilateral->isOn())
+	{
+		hbox1->hide();
+		if (hideparams)
+			hbox2->hide();
+		else
+			hbox2->show();
+		vbox2->hide();
+		if (hideparams)
+			hbox4->hide();
+		else
+			hbox4->show();
+		contdiff->hide();
+		in3d->show();
+		txt_k->setText("Range: 0 ");
+	}
 	else
 	{
 		hbox1->hide();
 		hbox2->hide();
 		txt_k->setText("k: 0 ");
+		in3d->hide();
 		if (hideparams)
 			hbox4->hide();
 		else
@@ -319,13 +363,13 @@ void SmoothingWidget::continue_diff()
 
 	if (allslices->isChecked())
 	{
-		handler3D->cont_anisodiff(1.0f, sb_iter->value(), f2,
+		handler3D->cont_anisodiff(1.0f, sb_iter->value(), diffusion::kRational,
 				sl_k->value() * 0.01f * sb_kmax->value(),
 				sl_restrain->value() * 0.01f);
 	}
 	else
 	{
-		bmphand->cont_anisodiff(1.0f, sb_iter->value(), f2,
+		bmphand->cont_anisodiff(1.0f, sb_iter->value(), diffusion::kRational,
 				sl_k->value() * 0.01f * sb_kmax->value(),
 				sl_restrain->value() * 0.01f);
 	}
@@ -344,6 +388,17 @@ void SmoothingWidget::sigmaslider_changed(int newval)
 			bmphand->gaussian(sl_sigma->value() * 0.05f);
 		emit end_datachange(this, iseg::NoUndo);
 	}
+	else if (rb_bilateral->isOn())
+	{
+		if (allslices->isChecked())
+			handler3D->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
+					in3d->isChecked());
+		else
+			bmphand->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value());
+		emit end_datachange(this, iseg::NoUndo);
+	}
 
 	return;
 }
@@ -356,13 +411,25 @@ void SmoothingWidget::kslider_changed(int newval)
 		if (allslices->isChecked())
 			handler3D->sigmafilter(
 					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
-					(short unsigned)sb_n->value(), (short unsigned)sb_n->value());
+					(short unsigned)sb_n->value(), (short unsigned)sb_n->value(),
+					(short unsigned)(in3d->isChecked() ? sb_n->value() : 1));
 		else
 			bmphand->sigmafilter((sl_k->value() + 1) * 0.01f * sb_kmax->value(),
 					(short unsigned)sb_n->value(),
 					(short unsigned)sb_n->value());
 		emit end_datachange(this, iseg::NoUndo);
 	}
+	else if (rb_bilateral->isOn())
+	{
+		if (allslices->isChecked())
+			handler3D->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
+					in3d->isChecked());
+		else
+			bmphand->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value());
+		emit end_datachange(this, iseg::NoUndo);
+	}
 
 	return;
 }
@@ -383,7 +450,8 @@ void SmoothingWidget::n_changed(int newval)
 		{
 			handler3D->sigmafilter(
 					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
-					(short unsigned)sb_n->value(), (short unsigned)sb_n->value());
+					(short unsigned)sb_n->value(), (short unsigned)sb_n->value(),
+					(short unsigned)(in3d->isChecked() ? sb_n->value() : 1));
 		}
 		else
 		{
@@ -422,7 +490,8 @@ void SmoothingWidget::kmax_changed(int newval)
 		{
 			handler3D->sigmafilter(
 					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
-					(short unsigned)sb_n->value(), (short unsigned)sb_n->value());
+					(short unsigned)sb_n->value(), (short unsigned)sb_n->value(),
+					(short unsigned)(in3d->isChecked() ? sb_n->value() : 1));
 		}
 		else
 		{
@@ -431,6 +500,20 @@ void SmoothingWidget::kmax_changed(int newval)
 					(short unsigned)sb_n->value());
 		}
 	}
+	else if (rb_bilateral->isOn())
+	{
+		if (allslices->isChecked())
+		{
+			handler3D->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value(),
+					in3d->isChecked());
+		}
+		else
+		{
+			bmphand->bilateral(sl_sigma->value() * 0.05f,
+					(sl_k->value() + 1) * 0.01f * sb_kmax->value());
+		}
+	}
 	emit end_datachange(this);
 }
 
@@ -461,7 +544,7 @@ void SmoothingWidget::newloaded()
 
 void SmoothingWidget::slider_pressed()
 {
-	if ((rb_gaussian->isOn() || rb_sigmafilter->isOn()))
+	if (rb_gaussian->isOn() || rb_sigmafilter->isOn() || rb_bilateral->isOn())
 	{
 		iseg::DataSelection dataSelection;
 		dataSelection.allSlices = allslices->isChecked();
@@ -473,7 +556,7 @@ void SmoothingWidget::slider_pressed()
 
 void SmoothingWidget::slider_released()
 {
-	if (rb_gaussian->isOn() || rb_sigmafilter->isOn())
+	if (rb_gaussian->isOn() || rb_sigmafilter->isOn() || rb_bilateral->isOn())
 	{
 		emit end_datachange(this);
 	}
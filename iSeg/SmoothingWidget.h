@@ -86,9 +86,11 @@ private:
 	QRadioButton* rb_average;
 	QRadioButton* rb_median;
 	QRadioButton* rb_sigmafilter;
+	QRadioButton* rb_bilateral;
 	QRadioButton* rb_anisodiff;
 	QButtonGroup* modegroup;
 	QCheckBox* allslices;
+	QCheckBox* in3d;
 	bool dontundo;
 
 private slots:
@@ -13,17 +13,21 @@
 #include "SurfaceViewerWidget.h"
 #include "TissueInfos.h"
 
+#include "Core/BrickSurfaceCache.h"
+#include "Core/MajorityPooling.h"
+
 #include "QVTKWidget.h"
 
 #include <QAction>
 #include <QMenu>
 #include <QResizeEvent>
+#include <QTimer>
 
-#include <vtkBitArray.h>
 #include <vtkCellData.h>
 #include <vtkDiscreteFlyingEdges3D.h>
 #include <vtkFlyingEdges3D.h>
 #include <vtkPointData.h>
+#include <vtkPolyData.h>
 #include <vtkUnsignedShortArray.h>
 
 #include <vtkEventQtSlotConnect.h>
@@ -36,6 +40,8 @@
 #include <vtkRenderWindow.h>
 #include <vtkRenderer.h>
 
+#include <cmath>
+
 #include <vtkAutoInit.h>
 #ifdef ISEG_VTK_OPENGL2
 VTK_MODULE_INIT(vtkRenderingOpenGL2);
@@ -49,31 +55,19 @@ VTK_MODULE_INIT(vtkInteractionStyle);
 using namespace iseg;
 
 namespace {
-template<typename TIn, typename TOut, typename TMap>
-void transform_slices(const std::vector<TIn*>& slices, size_t slice_size, TOut* out, const TMap& map)
+template<typename TIter, typename TOut, typename TMap>
+void transform_slices(TIter first, TIter last, size_t slice_size, TOut* out, const TMap& map)
 {
-	for (auto slice : slices)
+	for (; first != last; ++first)
 	{
-		std::transform(slice, slice + slice_size, out, map);
+		std::transform(*first, *first + slice_size, out, map);
 		std::advance(out, slice_size);
 	}
 }
-template<typename TIn, typename TArray, typename TMap>
-void transform_slices_vtk(const std::vector<TIn*>& slices, size_t slice_size, TArray* out, const TMap& map)
-{
-	size_t idx = 0, i;
-	for (auto& slice : slices)
-	{
-		for (i = 0; i < slice_size; ++i)
-		{
-			out->SetValue(idx++, map(slice[i]));
-		}
-	}
-}
 } // namespace
 
 SurfaceViewerWidget::SurfaceViewerWidget(SlicesHandler* hand3D1, eInputType inputtype, QWidget* parent, const char* name, Qt::WindowFlags wFlags)
-		: QWidget(parent, name, wFlags)
+		: QWidget(parent, name, wFlags), tissue_count(0), preview_factor(1), refine_cancel(false), refine_done(false)
 {
 	input_type = inputtype;
 	hand3D = hand3D1;
@@ -111,6 +105,9 @@ SurfaceViewerWidget::SurfaceViewerWidget(SlicesHandler* hand3D1, eInputType inpu
 
 	QObject::connect(bt_update, SIGNAL(clicked()), this, SLOT(reload()));
 
+	refine_timer = new QTimer(this);
+	QObject::connect(refine_timer, SIGNAL(timeout()), this, SLOT(refinement_poll()));
+
 	ren3D = vtkSmartPointer<vtkRenderer>::New();
 	ren3D->SetBackground(0, 0, 0);
 	ren3D->SetViewport(0.0, 0.0, 1.0, 1.0);
@@ -144,7 +141,11 @@ SurfaceViewerWidget::SurfaceViewerWidget(SlicesHandler* hand3D1, eInputType inpu
 	vtkWidget->GetRenderWindow()->Render();
 }
 
-SurfaceViewerWidget::~SurfaceViewerWidget() { delete vbox1; }
+SurfaceViewerWidget::~SurfaceViewerWidget()
+{
+	cancel_refinement();
+	delete vbox1;
+}
 
 void SurfaceViewerWidget::load()
 {
@@ -152,86 +153,67 @@ void SurfaceViewerWidget::load()
 	auto spacing = hand3D->spacing();
 	size_t slice_size = static_cast<size_t>(hand3D->width()) * hand3D->height();
 
+	// surfaces are extracted in voxel coordinates, the spacing is applied by the actor
 	input->SetExtent(0, (int)hand3D->width() - 1, 0,
 			(int)hand3D->height() - 1, 0,
 			(int)hand3D->num_slices() - 1);
-	input->SetSpacing(spacing[0], spacing[1], spacing[2]);
+	input->SetSpacing(1, 1, 1);
 
 	index_tissue_map.clear();
+	label_map.clear();
+	tissue_count = TissueInfos::GetTissueCount();
+	brick_cache.reset();
 
 	if (input_type == kSource) // iso-surface
 	{
 		auto slices = hand3D->source_slices();
 		input->AllocateScalars(VTK_FLOAT, 1);
 		auto field = (float*)input->GetScalarPointer();
-		transform_slices(slices, slice_size, field, [](float v) { return v; });
-	}
-	else if (input_type == kTarget) // foreground
-	{
-		auto slices = hand3D->target_slices();
-		input->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-		auto field = vtkUnsignedCharArray::SafeDownCast(input->GetPointData()->GetScalars());
-		transform_slices_vtk(slices, slice_size, field, [](float v) { return v > 0.f ? 1 : 0; });
+		transform_slices(slices.begin(), slices.end(), slice_size, field, [](float v) { return v; });
+
+		input->GetScalarRange(range);
 	}
-	else if (input_type == kTissues || tissue_selection.size() > 254) // all tissues
+	else
 	{
-		auto slices = hand3D->tissue_slices(0);
-		input->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
-		auto field = static_cast<tissues_size_t*>(input->GetScalarPointer());
-
-		if (input_type == kTissues)
+		if (input_type == kTarget) // foreground
 		{
-			transform_slices(slices, slice_size, field, [](tissues_size_t v) { return v; });
+			input->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+			endLabel = 1;
 		}
-		else // selection only
+		else if (input_type == kTissues || tissue_selection.size() > 254) // all tissues
 		{
-			std::vector<tissues_size_t> tissue_index_map(TissueInfos::GetTissueCount() + 1, 0);
-			for (auto tissue_type : tissue_selection)
+			input->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+			if (input_type == kSelectedTissues) // selection only
 			{
-				tissue_index_map[tissue_type] = tissue_type;
+				label_map.assign(tissue_count + 1, 0);
+				for (auto tissue_type : tissue_selection)
+				{
+					label_map[tissue_type] = tissue_type;
+				}
 			}
-			transform_slices(slices, slice_size, field, [tissue_index_map](tissues_size_t v) { return tissue_index_map.at(v); });
+			endLabel = static_cast<unsigned int>(tissue_count);
 		}
-	}
-	else if (tissue_selection.size() >= 1) // [1, 254]
-	{
-
-		unsigned char count = 1;
-		std::vector<unsigned char> tissue_index_map(TissueInfos::GetTissueCount() + 1, 0);
-		for (auto tissue_type : tissue_selection)
+		else // [0, 254]
 		{
-			index_tissue_map[count] = tissue_type;
-			tissue_index_map[tissue_type] = count++;
-		}
+			unsigned short count = 1;
+			label_map.assign(tissue_count + 1, 0);
+			for (auto tissue_type : tissue_selection)
+			{
+				index_tissue_map[count] = tissue_type;
+				label_map[tissue_type] = count++;
+			}
 
-		auto slices = hand3D->tissue_slices(0);
-		input->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
-		auto field = static_cast<unsigned char*>(input->GetScalarPointer());
-		try
-		{
-			transform_slices(slices, slice_size, field, [tissue_index_map](tissues_size_t v) { return tissue_index_map.at(v); });
-		}
-		catch (std::exception& e)
-		{
-			ISEG_ERROR("bad tissue index map " << e.what());
-			std::fill_n(field, slices.size() * slice_size, 0);
+			input->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+			endLabel = static_cast<unsigned int>(tissue_selection.size());
 		}
-	}
-	else
-	{
-		input->AllocateScalars(VTK_BIT, 1);
-		auto field = vtkBitArray::SafeDownCast(input->GetPointData()->GetScalars());
-		field->FillComponent(0, 0);
-	}
+		startLabel = 1;
 
-	// Define all of the variables
-	input->GetScalarRange(range);
-	startLabel = range[0];
-	endLabel = range[1];
-	startLabel = 1;
+		copy_labels(0, (int)hand3D->num_slices() - 1);
+	}
 
 	mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
 	actor = vtkSmartPointer<vtkQuadricLODActor>::New();
+	actor->SetScale(spacing[0], spacing[1], spacing[2]);
 
 	if (input_type == kSource)
 	{
@@ -243,10 +225,22 @@ void SurfaceViewerWidget::load()
 	}
 	else
 	{
-		discreteCubes->SetInputData(input);
-		discreteCubes->GenerateValues(endLabel - startLabel + 1, startLabel, endLabel);
+		brick_cache.reset(new BrickSurfaceCache);
+		brick_cache->set_input(input);
+
+		build_preview();
+		if (preview_input)
+		{
+			discreteCubes->SetInputData(preview_input);
+			discreteCubes->GenerateValues(endLabel - startLabel + 1, startLabel, endLabel);
+			mapper->SetInputConnection(discreteCubes->GetOutputPort());
+		}
+		else
+		{
+			brick_cache->update();
+			mapper->SetInputData(brick_cache->get_output());
+		}
 
-		mapper->SetInputConnection(discreteCubes->GetOutputPort());
 		if (input_type == kTarget)
 		{
 			mapper->ScalarVisibilityOff();
@@ -264,6 +258,183 @@ void SurfaceViewerWidget::load()
 
 	actor->SetMapper(mapper);
 	ren3D->AddActor(actor);
+
+	if (preview_input)
+	{
+		start_refinement();
+	}
+}
+
+void SurfaceViewerWidget::copy_labels(int z0, int z1)
+{
+	size_t slice_size = static_cast<size_t>(hand3D->width()) * hand3D->height();
+	size_t offset = slice_size * z0;
+
+	if (input_type == kTarget)
+	{
+		auto slices = hand3D->target_slices();
+		auto field = static_cast<unsigned char*>(input->GetScalarPointer()) + offset;
+		transform_slices(slices.begin() + z0, slices.begin() + z1 + 1, slice_size, field,
+				[](float v) { return static_cast<unsigned char>(v > 0.f ? 1 : 0); });
+		return;
+	}
+
+	auto slices = hand3D->tissue_slices(0);
+	const auto& map = label_map;
+	auto lookup = [&map](tissues_size_t v) { return v < map.size() ? map[v] : 0; };
+	if (input->GetScalarType() == VTK_UNSIGNED_SHORT)
+	{
+		auto field = static_cast<tissues_size_t*>(input->GetScalarPointer()) + offset;
+		if (label_map.empty())
+		{
+			transform_slices(slices.begin() + z0, slices.begin() + z1 + 1, slice_size, field, [](tissues_size_t v) { return v; });
+		}
+		else
+		{
+			transform_slices(slices.begin() + z0, slices.begin() + z1 + 1, slice_size, field,
+					[&lookup](tissues_size_t v) { return static_cast<tissues_size_t>(lookup(v)); });
+		}
+	}
+	else
+	{
+		auto field = static_cast<unsigned char*>(input->GetScalarPointer()) + offset;
+		transform_slices(slices.begin() + z0, slices.begin() + z1 + 1, slice_size, field,
+				[&lookup](tissues_size_t v) { return static_cast<unsigned char>(lookup(v)); });
+	}
+}
+
+void SurfaceViewerWidget::slices_modified(const iseg::DataSelection& dataSelection)
+{
+	if (!brick_cache || !(input_type == kTarget ? dataSelection.work : dataSelection.tissues))
+	{
+		return;
+	}
+
+	int dims[3];
+	input->GetDimensions(dims);
+	if (dims[0] != (int)hand3D->width() || dims[1] != (int)hand3D->height() ||
+			dims[2] != (int)hand3D->num_slices() || tissue_count != TissueInfos::GetTissueCount())
+	{
+		reload();
+		return;
+	}
+
+	const int z0 = dataSelection.allSlices ? 0 : static_cast<int>(dataSelection.sliceNr);
+	const int z1 = dataSelection.allSlices ? dims[2] - 1 : static_cast<int>(dataSelection.sliceNr);
+
+	// the worker reads the label field
+	cancel_refinement();
+
+	copy_labels(z0, z1);
+	input->Modified();
+	brick_cache->invalidate_slices(z0, z1);
+
+	if (preview_input)
+	{
+		start_refinement();
+	}
+	else
+	{
+		brick_cache->update();
+		mapper->SetInputData(brick_cache->get_output());
+
+		vtkWidget->GetRenderWindow()->Render();
+	}
+}
+
+void SurfaceViewerWidget::build_preview()
+{
+	// label fields above this size are first shown at reduced resolution
+	static const long long max_preview_voxels = 1 << 22;
+
+	preview_input = nullptr;
+	preview_factor = 1;
+
+	int dims[3];
+	input->GetDimensions(dims);
+	const long long num_voxels = static_cast<long long>(dims[0]) * dims[1] * dims[2];
+	const int scalar_type = input->GetScalarType();
+	if (num_voxels <= max_preview_voxels || (scalar_type != VTK_UNSIGNED_CHAR && scalar_type != VTK_UNSIGNED_SHORT))
+	{
+		return;
+	}
+
+	preview_factor = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(num_voxels) / max_preview_voxels)));
+
+	int preview_dims[3];
+	MajorityPoolingSize(dims, preview_factor, preview_dims);
+
+	preview_input = vtkSmartPointer<vtkImageData>::New();
+	preview_input->SetExtent(0, preview_dims[0] - 1, 0, preview_dims[1] - 1, 0, preview_dims[2] - 1);
+	preview_input->AllocateScalars(scalar_type, 1);
+	update_preview_geometry();
+
+	if (scalar_type == VTK_UNSIGNED_CHAR)
+	{
+		MajorityPooling(static_cast<unsigned char*>(input->GetScalarPointer()), dims, preview_factor,
+				static_cast<unsigned char*>(preview_input->GetScalarPointer()));
+	}
+	else
+	{
+		MajorityPooling(static_cast<unsigned short*>(input->GetScalarPointer()), dims, preview_factor,
+				static_cast<unsigned short*>(preview_input->GetScalarPointer()));
+	}
+}
+
+void SurfaceViewerWidget::update_preview_geometry()
+{
+	double spacing[3], origin[3];
+	input->GetSpacing(spacing);
+	input->GetOrigin(origin);
+
+	// pooled voxels are centered on their input blocks
+	const double f = preview_factor;
+	preview_input->SetSpacing(f * spacing[0], f * spacing[1], f * spacing[2]);
+	preview_input->SetOrigin(origin[0] + 0.5 * (f - 1) * spacing[0],
+			origin[1] + 0.5 * (f - 1) * spacing[1],
+			origin[2] + 0.5 * (f - 1) * spacing[2]);
+	preview_input->Modified();
+}
+
+void SurfaceViewerWidget::start_refinement()
+{
+	cancel_refinement();
+
+	refine_cancel = false;
+	refine_done = false;
+	refine_thread = std::thread([this]() {
+		// cancellation is checked before every brick is meshed, re-meshed bricks are kept
+		if (brick_cache->update([this]() { return refine_cancel.load(); }))
+		{
+			refine_done = true;
+		}
+	});
+
+	refine_timer->start(200);
+}
+
+void SurfaceViewerWidget::cancel_refinement()
+{
+	refine_cancel = true;
+	if (refine_thread.joinable())
+	{
+		refine_thread.join();
+	}
+	refine_timer->stop();
+	refine_done = false;
+}
+
+void SurfaceViewerWidget::refinement_poll()
+{
+	if (refine_done)
+	{
+		cancel_refinement();
+
+		// replace preview or outdated surface by full resolution surface
+		mapper->SetInputData(brick_cache->get_output());
+
+		vtkWidget->GetRenderWindow()->Render();
+	}
 }
 
 void SurfaceViewerWidget::popup(vtkObject* obj, unsigned long, void* client_data, void*, vtkCommand* command)
@@ -344,21 +515,19 @@ void SurfaceViewerWidget::select_action(QAction* action)
 			if (input)
 			{
 				double* worldPosition = picker->GetPickPosition();
+				double* scale = actor->GetScale();
 				int dims[3];
-				double spacing[3], origin[3];
 				input->GetDimensions(dims);
-				input->GetSpacing(spacing);
-				input->GetOrigin(origin);
 				// compute closest slice
-				int slice = static_cast<int>(std::round((worldPosition[2] - origin[2]) / spacing[2]));
+				int slice = static_cast<int>(std::round(worldPosition[2] / scale[2]));
 				slice = std::max(0, std::min(slice, dims[2] - 1));
 
 				if (action->text() == "Mark Point in target")
 				{
 					std::vector<float> work(hand3D->return_area(), 0);
 
-					auto i = static_cast<int>(std::round((worldPosition[0] - origin[0]) / spacing[0]));
-					auto j = static_cast<int>(std::round((worldPosition[1] - origin[1]) / spacing[1]));
+					auto i = static_cast<int>(std::round(worldPosition[0] / scale[0]));
+					auto j = static_cast<int>(std::round(worldPosition[1] / scale[1]));
 					auto idx = static_cast<unsigned>(i + j * hand3D->width());
 					if (idx < hand3D->return_area())
 					{
@@ -428,23 +597,27 @@ void SurfaceViewerWidget::build_lookuptable()
 
 void SurfaceViewerWidget::pixelsize_changed(Pair p)
 {
-	input->SetSpacing(p.high, p.low, hand3D->get_slicethickness());
-	input->Modified();
-
-	vtkWidget->GetRenderWindow()->Render();
+	spacing_changed(p.high, p.low, hand3D->get_slicethickness());
 }
 
 void SurfaceViewerWidget::thickness_changed(float thick)
 {
 	Pair p = hand3D->get_pixelsize();
-	input->SetSpacing(p.high, p.low, thick);
-	input->Modified();
+	spacing_changed(p.high, p.low, thick);
+}
+
+void SurfaceViewerWidget::spacing_changed(double dx, double dy, double dz)
+{
+	// surfaces are in voxel coordinates, no need to extract them again
+	actor->SetScale(dx, dy, dz);
 
 	vtkWidget->GetRenderWindow()->Render();
 }
 
 void SurfaceViewerWidget::reload()
 {
+	cancel_refinement();
+
 	ren3D->RemoveActor(actor);
 
 	load();
@@ -492,10 +665,11 @@ void SurfaceViewerWidget::thresh_changed()
 int SurfaceViewerWidget::get_picked_tissue() const
 {
 	double* worldPosition = picker->GetPickPosition();
-	if (discreteCubes)
+	double* scale = actor->GetScale();
+	double position[3] = {worldPosition[0] / scale[0], worldPosition[1] / scale[1], worldPosition[2] / scale[2]};
+	if (auto surface = mapper->GetInput())
 	{
-		auto surface = discreteCubes->GetOutput();
-		vtkIdType pointId = surface->FindPoint(worldPosition);
+		vtkIdType pointId = surface->FindPoint(position);
 
 		if (pointId != -1)
 		{
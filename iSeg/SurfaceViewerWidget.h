@@ -18,7 +18,11 @@
 
 #include <vtkSmartPointer.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <thread>
+#include <vector>
 
 class QVTKWidget;
 class QVTKInteractor;
@@ -27,12 +31,14 @@ class Q3HBox;
 class QSlider;
 class QLabel;
 class QPushButton;
+class QTimer;
 
 class vtkActor;
 class vtkInteractorStyleTrackballCamera;
 class vtkImageData;
 class vtkFlyingEdges3D;
 class vtkDiscreteFlyingEdges3D;
+class vtkPolyData;
 class vtkPolyDataMapper;
 class vtkRenderer;
 class vtkEventQtSlotConnect;
@@ -43,6 +49,7 @@ class vtkLookupTable;
 
 namespace iseg {
 
+class BrickSurfaceCache;
 class SlicesHandler;
 
 class SurfaceViewerWidget : public QWidget
@@ -58,9 +65,18 @@ public:
 			Qt::WindowFlags wFlags = 0);
 	~SurfaceViewerWidget();
 
+	/// Update surface of modified slices (label inputs only)
+	void slices_modified(const iseg::DataSelection& dataSelection);
+
 protected:
 	void load();
+	void copy_labels(int z0, int z1);
 	void build_lookuptable();
+	void build_preview();
+	void update_preview_geometry();
+	void spacing_changed(double dx, double dy, double dz);
+	void start_refinement();
+	void cancel_refinement();
 	int get_picked_tissue() const;
 	void closeEvent(QCloseEvent*) override;
 	void resizeEvent(QResizeEvent*) override;
@@ -76,6 +92,7 @@ protected slots:
 	void thresh_changed();
 	void popup(vtkObject* obj, unsigned long, void* client_data, void*, vtkCommand* command);
 	void select_action(QAction*);
+	void refinement_poll();
 
 signals:
 	void hasbeenclosed();
@@ -112,6 +129,20 @@ private:
 	std::map<int, tissues_size_t> index_tissue_map;
 	unsigned int startLabel;
 	unsigned int endLabel;
+
+	std::vector<unsigned short> label_map;
+	size_t tissue_count;
+
+	// progressive level of detail: a majority pooled preview is shown first,
+	// the full resolution surface is extracted brick by brick in the background.
+	// After edits only the bricks touching modified slices are re-meshed.
+	int preview_factor;
+	vtkSmartPointer<vtkImageData> preview_input;
+	std::unique_ptr<BrickSurfaceCache> brick_cache;
+	std::thread refine_thread;
+	std::atomic<bool> refine_cancel;
+	std::atomic<bool> refine_done;
+	QTimer* refine_timer;
 };
 
 } // namespace iseg
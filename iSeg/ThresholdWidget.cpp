@@ -268,20 +268,19 @@ void ThresholdWidget::execute()
 	}
 	else if (rb_histo->isOn())
 	{
-		bmphand->swap_bmpwork();
-
 		if (subsect->isOn())
 		{
 			Point p;
 			p.px = (unsigned short)sb_px->value();
 			p.py = (unsigned short)sb_py->value();
+			bmphand->swap_bmpwork();
 			bmphand->make_histogram(p, sb_lx->value(), sb_ly->value(), true);
+			bmphand->swap_bmpwork();
 		}
 		else
-			bmphand->make_histogram(true);
+			handler3D->make_histogram(handler3D->active_slice(), true, true);
 
 		bmphand->gaussian_hist(1.0f);
-		bmphand->swap_bmpwork();
 
 		float* thresh1 = bmphand->find_modal((unsigned)sb_minpix->value(),
 				0.005f * ratio->value());
@@ -354,7 +353,6 @@ void ThresholdWidget::execute()
 						return;
 					if (allslices->isChecked())
 						handler3D->kmeans_png(
-								handler3D->active_slice(),
 								(short)sb_nrtissues->value(),
 								(short)sb_dim->value(), kmeansfiles,
 								extractChannels, weights,
@@ -374,7 +372,6 @@ void ThresholdWidget::execute()
 				{
 					if (allslices->isChecked())
 						handler3D->kmeans_mhd(
-								handler3D->active_slice(),
 								(short)sb_nrtissues->value(),
 								(short)sb_dim->value(), kmeansfiles, weights,
 								(unsigned int)sb_iternr->value(),
@@ -392,7 +389,6 @@ void ThresholdWidget::execute()
 			{
 				if (allslices->isChecked())
 					handler3D->kmeans_mhd(
-							handler3D->active_slice(),
 							(short)sb_nrtissues->value(), (short)sb_dim->value(),
 							kmeansfiles, weights, (unsigned int)sb_iternr->value(),
 							(unsigned int)sb_converge->value());
@@ -417,8 +413,7 @@ void ThresholdWidget::execute()
 		}
 
 		if (allslices->isChecked())
-			handler3D->em(handler3D->active_slice(),
-					(short)sb_nrtissues->value(),
+			handler3D->em((short)sb_nrtissues->value(),
 					(unsigned int)sb_iternr->value(),
 					(unsigned int)sb_converge->value());
 		else
@@ -13,6 +13,8 @@
 #include "WatershedWidget.h"
 #include "bmp_read_1.h"
 
+#include "Interface/ProgressDialog.h"
+
 #include <q3vbox.h>
 #include <qbuttongroup.h>
 #include <qdialog.h>
@@ -52,6 +54,9 @@ WatershedWidget::WatershedWidget(SlicesHandler* hand3D, QWidget* parent,
 	vbox1 = new Q3VBox(this);
 	hbox1 = new Q3HBox(vbox1);
 	btn_exec = new QPushButton("Execute", vbox1);
+	btn_exec3D = new QPushButton("Execute 3D (marks)", vbox1);
+	btn_exec3D->setToolTip(Format("Marker-controlled watershed of the active slices. "
+			"The marks of the active slices are used as seeds."));
 	hbox2 = new Q3HBox(vbox1);
 	hbox3 = new Q3HBox(vbox1);
 	txt_h = new QLabel("Flooding height (h): ", hbox1);
@@ -76,6 +81,7 @@ WatershedWidget::WatershedWidget(SlicesHandler* hand3D, QWidget* parent,
 	QObject::connect(sb_h, SIGNAL(valueChanged(int)), this,
 			SLOT(hsb_changed(int)));
 	QObject::connect(btn_exec, SIGNAL(clicked()), this, SLOT(execute()));
+	QObject::connect(btn_exec3D, SIGNAL(clicked()), this, SLOT(execute3D()));
 }
 
 void WatershedWidget::hsl_changed()
@@ -114,6 +120,20 @@ void WatershedWidget::execute()
 	recalc();
 }
 
+void WatershedWidget::execute3D()
+{
+	ProgressDialog progress("Marker-based watershed", this);
+
+	iseg::DataSelection dataSelection;
+	dataSelection.allSlices = true;
+	dataSelection.work = true;
+	emit begin_datachange(dataSelection, this);
+
+	bool ok = handler3D->compute_marker_watershed(&progress);
+
+	emit end_datachange(this, ok ? iseg::EndUndo : iseg::AbortUndo);
+}
+
 void WatershedWidget::recalc()
 {
 	if (usp != nullptr)
@@ -65,6 +65,7 @@ private:
 	QSpinBox* sb_h;
 	QSlider* sl_h;
 	QPushButton* btn_exec;
+	QPushButton* btn_exec3D;
 
 public slots:
 	void marks_changed();
@@ -76,6 +77,7 @@ private slots:
 	void slider_released();
 	void hsb_changed(int value);
 	void execute();
+	void execute3D();
 	void recalc();
 };
 
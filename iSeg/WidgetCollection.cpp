@@ -366,7 +366,7 @@ ShowHisto::ShowHisto(SlicesHandler* hand3D, QWidget* parent, const char* name,
 	bmphand = handler3D->get_activebmphandler();
 
 	vbox1 = new Q3VBox(this);
-	bmphand->make_histogram(true);
+	handler3D->make_histogram(activeslice, false, true);
 	histwindow = new HistoWin(bmphand->return_histogram(), vbox1, name, wFlags);
 	histwindow->setFixedSize(258, 258);
 
@@ -468,12 +468,12 @@ void ShowHisto::draw_histo()
 	//Point p;
 	if (bmppict->isOn())
 	{
-		bmphand->swap_bmpwork();
 		if (subsect->isOn())
 		{
 			Point p;
 			p.px = xoffset->value();
 			p.py = yoffset->value();
+			bmphand->swap_bmpwork();
 			bmphand->make_histogram(
 					p,
 					min((int)bmphand->return_width() - xoffset->value(),
@@ -481,12 +481,12 @@ void ShowHisto::draw_histo()
 					min((int)bmphand->return_height() - yoffset->value(),
 							ylength->value()),
 					true);
+			bmphand->swap_bmpwork();
 		}
 		else
 		{
-			bmphand->make_histogram(true);
+			handler3D->make_histogram(activeslice, true, true);
 		}
-		bmphand->swap_bmpwork();
 	}
 	else
 	{
@@ -505,7 +505,7 @@ void ShowHisto::draw_histo()
 		}
 		else
 		{
-			bmphand->make_histogram(true);
+			handler3D->make_histogram(activeslice, false, true);
 		}
 	}
 
@@ -3139,16 +3139,18 @@ void ImageOverlay::slider_changed(int newval)
 	emit end_datachange(this, iseg::NoUndo);
 }
 
-CleanerParams::CleanerParams(int* rate1, int* minsize1, QWidget* parent,
+CleanerParams::CleanerParams(int* rate1, int* minsize1, bool* changed_only1, QWidget* parent,
 		const char* name, Qt::WindowFlags wFlags)
 {
 	rate = rate1;
 	minsize = minsize1;
+	changed_only = changed_only1;
 	hbox1 = new Q3HBox(this);
 	vbox1 = new Q3VBox(hbox1);
 	vbox2 = new Q3VBox(hbox1);
 	lb_rate = new QLabel(QString("Rate: "), vbox1);
 	lb_minsize = new QLabel(QString("Pixel Size: "), vbox1);
+	lb_changed_only = new QLabel(QString("Changed tissues only: "), vbox1);
 	pb_doit = new QPushButton("OK", vbox1);
 	sb_rate = new QSpinBox(3, 10000, 1, vbox2);
 	sb_rate->setValue(4);
@@ -3156,6 +3158,8 @@ CleanerParams::CleanerParams(int* rate1, int* minsize1, QWidget* parent,
 	sb_minsize = new QSpinBox(2, 10000, 1, vbox2);
 	sb_minsize->setValue(10);
 	sb_minsize->setToolTip(Format("Minimum number of pixels required by an island."));
+	cb_changed_only = new QCheckBox(vbox2);
+	cb_changed_only->setToolTip(Format("Only clean tissues which changed since the last cleanup with the same parameters."));
 	pb_dontdoit = new QPushButton("Cancel", vbox2);
 	QObject::connect(pb_doit, SIGNAL(clicked()), this, SLOT(doit_pressed()));
 	QObject::connect(pb_dontdoit, SIGNAL(clicked()), this,
@@ -3171,6 +3175,7 @@ void CleanerParams::doit_pressed()
 {
 	*rate = sb_rate->value();
 	*minsize = sb_minsize->value();
+	*changed_only = cb_changed_only->isChecked();
 	close();
 }
 
@@ -3178,6 +3183,7 @@ void CleanerParams::dontdoit_pressed()
 {
 	*rate = 0;
 	*minsize = 0;
+	*changed_only = false;
 	close();
 }
 
@@ -682,13 +682,14 @@ class CleanerParams : public QDialog
 {
 	Q_OBJECT
 public:
-	CleanerParams(int* rate1, int* minsize1, QWidget* parent = 0,
+	CleanerParams(int* rate1, int* minsize1, bool* changed_only1, QWidget* parent = 0,
 			const char* name = 0, Qt::WindowFlags wFlags = 0);
 	~CleanerParams();
 
 private:
 	int* rate;
 	int* minsize;
+	bool* changed_only;
 	Q3HBox* hbox1;
 	Q3VBox* vbox1;
 	Q3VBox* vbox2;
@@ -696,8 +697,10 @@ private:
 	QPushButton* pb_dontdoit;
 	QLabel* lb_rate;
 	QLabel* lb_minsize;
+	QLabel* lb_changed_only;
 	QSpinBox* sb_rate;
 	QSpinBox* sb_minsize;
+	QCheckBox* cb_changed_only;
 
 private slots:
 	void doit_pressed();
@@ -14,12 +14,16 @@
 
 #include "Data/addLine.h"
 
+#include "Core/BufferPool.h"
+#include "Core/ConnectedComponents.h"
+#include "Core/DistanceTransform.h"
 #include "Core/ExpectationMaximization.h"
 #include "Core/ImageForestingTransform.h"
 #include "Core/ImageReader.h"
 #include "Core/KMeans.h"
 #include "Core/MultidimensionalGamma.h"
 #include "Core/SliceProvider.h"
+#include "Core/Watershed.h"
 
 #define cimg_display 0
 #include "AvwReader.h"
@@ -118,10 +122,6 @@ inline void swap_maps(T const*& Tp1, T const*& Tp2)
 	return;
 }
 
-float iseg::f1(float dI, float k) { return exp(-pow(dI / k, 2)); }
-
-float iseg::f2(float dI, float k) { return 1 / (1 + pow(dI / k, 2)); }
-
 std::list<unsigned> bmphandler::stackindex;
 unsigned bmphandler::stackcounter;
 std::list<float*> bmphandler::bits_stack;
@@ -4828,89 +4828,43 @@ unsigned int bmphandler::return_height() { return height; }
 
 unsigned int bmphandler::make_histogram(bool includeoutofrange)
 {
-	unsigned int j = 0;
-	float k;
-	for (int i = 0; i < 256; i++)
-		histogram[i] = 0;
-	for (unsigned int i = 0; i < area; i++)
-	{
-		k = work_bits[i];
-		if (k < 0 || k >= 256)
-		{
-			if (includeoutofrange && k < 0)
-				histogram[0]++;
-			if (includeoutofrange && k >= 256)
-				histogram[255]++;
-			j++;
-		}
-		else
-			histogram[(int)k]++;
-	}
-	return j;
+	Histogram h(256);
+	AccumulateHistogram(work_bits, area, 0, 0, area, 1, HistogramBinning(), h);
+	return set_histogram(h, includeoutofrange);
 }
 
 unsigned int bmphandler::make_histogram(float* mask, float f,
 		bool includeoutofrange)
 {
-	unsigned int j = 0;
-	float k;
-	for (int i = 0; i < 256; i++)
-		histogram[i] = 0;
-	for (unsigned int i = 0; i < area; i++)
-	{
-		if (mask[i] == f)
-		{
-			k = work_bits[i];
-			if (k < 0 || k >= 256)
-			{
-				if (includeoutofrange && k < 0)
-					histogram[0]++;
-				if (includeoutofrange && k >= 256)
-					histogram[255]++;
-				j++;
-			}
-			else
-				histogram[(int)k]++;
-		}
-	}
-	return j;
+	Histogram h(256);
+	AccumulateHistogram(work_bits, area, [mask, f](size_t i) { return mask[i] == f; },
+			HistogramBinning(), h);
+	return set_histogram(h, includeoutofrange);
 }
 
 unsigned int bmphandler::make_histogram(Point p, unsigned short dx,
 		unsigned short dy,
 		bool includeoutofrange)
 {
-	unsigned int i, l;
-	l = 0;
-	float m;
-	for (i = 0; i < 256; i++)
-		histogram[i] = 0;
-
 	dx = std::min(int(dx), width - p.px);
 	dy = std::min(int(dy), height - p.py);
 
-	i = pt2coord(p);
-	for (int j = 0; j < dy; j++)
+	Histogram h(256);
+	AccumulateHistogram(work_bits, width, p.px, p.py, p.px + dx, p.py + dy,
+			HistogramBinning(), h);
+	return set_histogram(h, includeoutofrange);
+}
+
+unsigned int bmphandler::set_histogram(const Histogram& h, bool includeoutofrange)
+{
+	for (int i = 0; i < 256; i++)
+		histogram[i] = (unsigned int)h.counts[i];
+	if (includeoutofrange)
 	{
-		for (int k = 0; k < dx; k++)
-		{
-			m = work_bits[i];
-			if (m < 0 || m >= 256)
-			{
-				if (includeoutofrange && k < 0)
-					histogram[0]++;
-				if (includeoutofrange && k >= 256)
-					histogram[255]++;
-				l++;
-			}
-			else
-				histogram[(int)m]++;
-			i++;
-		}
-		i = i + width - dx;
+		histogram[0] += (unsigned int)h.below;
+		histogram[255] += (unsigned int)h.above;
 	}
-
-	return l;
+	return (unsigned int)(h.below + h.above);
 }
 
 unsigned int* bmphandler::return_histogram() { return histogram; }
@@ -4928,17 +4882,7 @@ void bmphandler::threshold(float* thresholds)
 
 	if (n > 0)
 	{
-		const float leveldiff = 255.0f / n;
-
-		short unsigned j;
-
-		for (unsigned int i = 0; i < area; i++)
-		{
-			j = 0;
-			while (j < n && bmp_bits[i] > thresholds[j + 1])
-				j++;
-			work_bits[i] = j * leveldiff;
-		}
+		ThresholdToLevels(bmp_bits, work_bits, area, thresholds + 1, n, 255.0f / n);
 	}
 
 	mode2 = 2;
@@ -4948,27 +4892,18 @@ void bmphandler::threshold(float* thresholds, Point p, unsigned short dx,
 		unsigned short dy)
 {
 	dx = std::min(int(dx), width - p.px);
-	dy = std::min(int(dy), width - p.py);
+	dy = std::min(int(dy), height - p.py);
 
 	short unsigned n = (short unsigned)thresholds[0];
 	if (n > 0)
 	{
 		const float leveldiff = 255.0f / n;
-		short unsigned l;
-		unsigned int i;
-		i = pt2coord(p);
+		unsigned int i = pt2coord(p);
 
 		for (int j = 0; j < dy; j++)
 		{
-			for (int k = 0; k < dx; k++)
-			{
-				l = 0;
-				while (bmp_bits[i] > thresholds[l + 1] && l < n)
-					l++;
-				work_bits[i] = l * leveldiff;
-				i++;
-			}
-			i = i + width - dx;
+			ThresholdToLevels(bmp_bits + i, work_bits + i, dx, thresholds + 1, n, leveldiff);
+			i += width;
 		}
 	}
 
@@ -5067,6 +5002,20 @@ float* bmphandler::make_laplacianfilter()
 	return filter;
 }
 
+void bmphandler::separable_convolute(float* mask)
+{
+	// the rows are filtered into a scratch buffer of this thread, the columns from there into work
+	ScratchLease<float> rows(area);
+	float* bmp = bmp_bits;
+	float* work = work_bits;
+	work_bits = rows.get();
+	convolute(mask, 0);
+	bmp_bits = rows.get();
+	work_bits = work;
+	convolute(mask, 1);
+	bmp_bits = bmp;
+}
+
 void bmphandler::convolute(float* mask, unsigned short direction)
 {
 	unsigned i, n;
@@ -5274,17 +5223,8 @@ void bmphandler::gaussian(float sigma)
 		int n = int(3 * sigma);
 		if (n % 2 == 0)
 			n++;
-		float* dummy;
-		float* dummy1;
-		convolute(dummy = make_gaussfilter(sigma, n), 0);
-
-		dummy1 = bmp_bits;
-		bmp_bits = sliceprovide->give_me();
-		swap_bmpwork();
-		convolute(dummy, 1);
-		sliceprovide->take_back(bmp_bits);
-		bmp_bits = dummy1;
-
+		float* dummy = make_gaussfilter(sigma, n);
+		separable_convolute(dummy);
 		free(dummy);
 	}
 	else
@@ -5299,7 +5239,6 @@ void bmphandler::gaussian(float sigma)
 void bmphandler::average(unsigned short n)
 {
 	unsigned char dummymode1 = mode1;
-	float* dummy1;
 
 	if (n % 2 == 0)
 		n++;
@@ -5309,13 +5248,7 @@ void bmphandler::average(unsigned short n)
 	for (short unsigned int i = 1; i <= n; i++)
 		filter[i] = 1.0f / n;
 
-	convolute(filter, 0);
-	dummy1 = bmp_bits;
-	bmp_bits = sliceprovide->give_me();
-	swap_bmpwork();
-	convolute(filter, 1);
-	sliceprovide->take_back(bmp_bits);
-	bmp_bits = dummy1;
+	separable_convolute(filter);
 
 	free(filter);
 
@@ -6447,36 +6380,19 @@ void bmphandler::sigmafilter(float sigma, unsigned short nx, unsigned short ny)
 	if (ny % 2 == 0)
 		ny++;
 
-	unsigned short counter;
-	float summa;
-	float dummy;
+	SigmaFilter(&bmp_bits, &work_bits, width, height, 1, sigma, nx, ny, 1);
 
-	unsigned i = 0;
+	mode1 = dummymode;
+	mode2 = 1;
+}
 
-	for (int j = 0; j <= height - ny; j++)
-	{
-		for (int k = 0; k <= width - nx; k++)
-		{
-			summa = 0;
-			counter = 0;
-			dummy = bmp_bits[i + nx / 2 + (ny / 2) * width];
-			for (int l = 0; l < nx; l++)
-			{
-				for (int o = 0; o < ny; o++)
-				{
-					if (bmp_bits[i + l + o * width] < dummy + sigma &&
-							bmp_bits[i + l + o * width] > dummy - sigma)
-					{
-						summa += bmp_bits[i + l + o * width];
-						counter++;
-					}
-				}
-			}
-			work_bits[i + nx / 2 + (ny / 2) * width] = summa / counter;
-			i++;
-		}
-		i = i + nx - 1;
-	}
+void bmphandler::bilateral(float sigma_space, float sigma_range)
+{
+	unsigned char dummymode = mode1;
+
+	// the pixel size is ignored in 2D, as for the other filters
+	const float sigma[3] = {sigma_space, sigma_space, 0.0f};
+	BilateralFilter(&bmp_bits, &work_bits, width, height, 1, sigma, sigma_range);
 
 	mode1 = dummymode;
 	mode2 = 1;
@@ -7265,7 +7181,7 @@ void bmphandler::n_moment_sigma(short unsigned n, short unsigned p, float sigma)
 	return;
 }
 
-void bmphandler::aniso_diff(float dt, int n, float (*f)(float, float), float k,
+void bmphandler::aniso_diff(float dt, int n, diffusion::eConductance f, float k,
 		float restraint)
 {
 	unsigned char dummymode = mode1;
@@ -7275,60 +7191,12 @@ void bmphandler::aniso_diff(float dt, int n, float (*f)(float, float), float k,
 	mode2 = 1;
 }
 
-void bmphandler::cont_anisodiff(float dt, int n, float (*f)(float, float),
+void bmphandler::cont_anisodiff(float dt, int n, diffusion::eConductance f,
 		float k, float restraint)
 {
-	float* flowx = sliceprovide->give_me(); // only area-height of it is used
-	float* flowy = sliceprovide->give_me(); // only area-width of it is used
-
-	float dummy;
-
-	for (int l = 0; l < n; l++)
-	{
-		for (unsigned short i = 0; i < height; i++)
-		{
-			for (unsigned short j = 0; j < width - 1; j++)
-			{
-				dummy =
-						(work_bits[i * width + j + 1] - work_bits[i * width + j]);
-				flowx[i * (width - 1) + j] = f(dummy, k) * dummy;
-			}
-		}
-
-		for (unsigned short i = 0; i < height - 1; i++)
-		{
-			for (unsigned short j = 0; j < width; j++)
-			{
-				dummy =
-						(work_bits[(i + 1) * width + j] - work_bits[i * width + j]);
-				flowy[i * width + j] = f(dummy, k) * dummy;
-			}
-		}
-
-		for (unsigned int i = 0; i < area; i++)
-			work_bits[i] += dt * restraint * (bmp_bits[i] - work_bits[i]);
-
-		for (unsigned short i = 0; i < height; i++)
-		{
-			for (unsigned short j = 0; j < width - 1; j++)
-			{
-				work_bits[i * width + j] += dt * flowx[i * (width - 1) + j];
-				work_bits[i * width + j + 1] -= dt * flowx[i * (width - 1) + j];
-			}
-		}
-
-		for (unsigned short i = 0; i < height - 1; i++)
-		{
-			for (unsigned short j = 0; j < width; j++)
-			{
-				work_bits[i * width + j] += dt * flowy[i * width + j];
-				work_bits[(i + 1) * width + j] -= dt * flowy[i * width + j];
-			}
-		}
-	}
-
-	sliceprovide->take_back(flowx);
-	sliceprovide->take_back(flowy);
+	// the pixel size is ignored in 2D, as before
+	const float spacing[3] = {1.0f, 1.0f, 1.0f};
+	AnisotropicDiffusion(&work_bits, &bmp_bits, width, height, 1, spacing, dt, n, restraint, f, k);
 
 	mode2 = 1;
 	return;
@@ -7352,100 +7220,18 @@ void bmphandler::bucketsort(std::vector<unsigned int>* sorted, float* p_bits)
 
 unsigned* bmphandler::watershed(bool connectivity)
 {
-	wshedobj.B.clear();
-	wshedobj.M.clear();
 	wshedobj.marks.clear();
+	wshedobj.cut_valid = false;
 
-	unsigned p, minbase, minbase_nr;
-	unsigned basin_nr = 0;
 	unsigned* Y = (unsigned*)malloc(sizeof(unsigned) * area);
-	for (unsigned i = 0; i < area; i++)
-		Y[i] = unvisited;
-
-	std::vector<unsigned> sorted[256];
-	std::vector<unsigned>::iterator it, it1;
-	std::vector<unsigned> Bp;
-
-	basin b;
-	b.l = 0;
-	merge_event m;
-
-	bmp_is_grey = false; //xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
-
-	if (!bmp_is_grey)
-	{
-		swap_bmpwork();
-		Pair p1;
-		get_range(&p1);
-		scale_colors(p1);
-		swap_bmpwork();
-	}
-
-	bucketsort(sorted, bmp_bits);
-
-	for (unsigned i = 0; i < 256; i++)
-	{
-		for (it = sorted[i].begin(); it != sorted[i].end(); it++)
-		{
-			p = *it;
-			Bp.clear();
-
-			if (p % width != 0 && Y[p - 1] != unvisited)
-				Bp.push_back(Y[p - 1]);
-			if ((p + 1) % width != 0 && Y[p + 1] != unvisited)
-				Bp.push_back(Y[p + 1]);
-			if (p >= width && Y[p - width] != unvisited)
-				Bp.push_back(Y[p - width]);
-			if ((p + width) < area && Y[p + width] != unvisited)
-				Bp.push_back(Y[p + width]);
-			if (connectivity)
-			{
-				if (p % width != 0 && p >= width &&
-						Y[p - 1 - width] != unvisited)
-					Bp.push_back(Y[p - 1 - width]);
-				if (p % width != 0 && (p + width) < area &&
-						Y[p - 1 + width] != unvisited)
-					Bp.push_back(Y[p + width - 1]);
-				if ((p + 1) % width != 0 && p >= width &&
-						Y[p - width + 1] != unvisited)
-					Bp.push_back(Y[p - width + 1]);
-				if ((p + 1) % width != 0 && (p + width) < area &&
-						Y[p + width + 1] != unvisited)
-					Bp.push_back(Y[p + width + 1]);
-			}
 
-			if (Bp.empty())
-			{
-				b.g = i;
-				b.r = basin_nr;
-				wshedobj.B.push_back(b);
-				Y[p] = basin_nr;
-				basin_nr++;
-			}
-			else
-			{
-				minbase_nr = Bp[0];
-				minbase = deepest_con_bas(Bp[0]);
-				for (unsigned j = 1; j < Bp.size(); j++)
-					if (deepest_con_bas(Bp[j]) < minbase)
-						minbase_nr = Bp[j];
-				Y[p] = minbase_nr;
+	// flooding of the bmp scaled to 256 levels
+	Pair p1;
+	get_bmprange(&p1);
 
-				for (it1 = Bp.begin(); it1 != Bp.end(); it1++)
-				{
-					if (deepest_con_bas(*it1) != deepest_con_bas(minbase_nr))
-					{
-						wshedobj.B[deepest_con_bas(*it1)].r =
-								deepest_con_bas(minbase_nr);
-						m.k = *it1;
-						m.a = minbase_nr;
-						m.g = i;
-						wshedobj.M.push_back(m);
-					}
-				}
-			}
-		}
-	}
+	const float* bits = bmp_bits;
+	WatershedFlooding(&bits, width, height, 1, p1.low, p1.high, 256,
+			connectivity ? kConnectivity8 : kConnectivity4, &Y, wshedobj.hierarchy);
 
 	return Y;
 }
@@ -7473,26 +7259,26 @@ unsigned* bmphandler::watershed_sobel(bool connectivity)
 void bmphandler::construct_regions(unsigned h, unsigned* wshed)
 {
 	unsigned char dummymode1 = mode1;
-	//unsigned char dummymode2=mode2;
 
-	for (unsigned i = 0; i < wshedobj.B.size(); i++)
+	// the merge tree is only cut again if the height or the marks have changed
+	std::vector<std::pair<unsigned, unsigned>> cut_marks;
+	for (std::vector<Mark>::iterator it = marks.begin(); it != marks.end(); it++)
 	{
-		wshedobj.B[i].l = 0;
-		wshedobj.B[i].r = i;
+		cut_marks.push_back(std::make_pair(wshed[pt2coord((*it).p)], (*it).mark));
 	}
 
-	//	unsigned i1=1;
-	//	for(std::vector<mark>::iterator it=marks.begin();it!=marks.end();it++) {
-	//		set_marker(*it,i1,wshed);
-	set_marker(wshed);
-	//		i1++;
-	//	}
-
-	//	cout << wshed[126167]<<" "<<wshedobj.B[wshed[126167]].l<<endl;
-
-	for (unsigned i = 0; i < wshedobj.M.size(); i++)
+	if (!wshedobj.cut_valid || wshedobj.cut_h != h || wshedobj.cut_marks != cut_marks)
 	{
-		cond_merge(i, h);
+		std::vector<unsigned> markers(wshedobj.hierarchy.NumberOfBasins(), 0);
+		for (auto m : cut_marks)
+		{
+			markers[m.first] = m.second;
+		}
+
+		wshedobj.cut_labels = wshedobj.hierarchy.Cut(h, markers);
+		wshedobj.cut_h = h;
+		wshedobj.cut_marks.swap(cut_marks);
+		wshedobj.cut_valid = true;
 	}
 
 	labels2work(wshed, (unsigned)marks.size());
@@ -7503,14 +7289,6 @@ void bmphandler::construct_regions(unsigned h, unsigned* wshed)
 	return;
 }
 
-void bmphandler::set_marker(unsigned* wshed)
-{
-	for (std::vector<Mark>::iterator it = marks.begin(); it != marks.end(); it++)
-	{
-		wshedobj.B[wshed[pt2coord((*it).p)]].l = (*it).mark;
-	}
-}
-
 void bmphandler::add_mark(Point p, unsigned label, std::string str)
 {
 	Mark m;
@@ -7546,36 +7324,9 @@ void bmphandler::clear_marks()
 	marks.clear();
 }
 
-unsigned bmphandler::deepest_con_bas(unsigned k)
-{
-	if (wshedobj.B[k].r != k)
-		return deepest_con_bas(wshedobj.B[k].r);
-	else
-		return k;
-}
-
-void bmphandler::cond_merge(unsigned m, unsigned h)
-{
-	unsigned k, a;
-	k = deepest_con_bas(wshedobj.M[m].k);
-	a = deepest_con_bas(wshedobj.M[m].a);
-	if (h >= (wshedobj.M[m].g - wshedobj.B[k].g))
-	{
-		if (wshedobj.B[a].l == 0 || wshedobj.B[k].l == 0 ||
-				wshedobj.B[a].l == wshedobj.B[k].l)
-		{
-			wshedobj.B[k].r = a;
-		}
-		if (wshedobj.B[a].l == 0)
-		{
-			wshedobj.B[a].l = wshedobj.B[k].l;
-		}
-	}
-}
-
 void bmphandler::wshed2work(unsigned* Y)
 {
-	float d = 255.0f / wshedobj.B.size();
+	float d = 255.0f / wshedobj.hierarchy.NumberOfBasins();
 	for (unsigned i = 0; i < area; i++)
 		work_bits[i] = Y[i] * d;
 
@@ -7592,21 +7343,17 @@ void bmphandler::labels2work(unsigned* Y, unsigned lnr)
 		maxim = std::max(maxim, it->mark);
 	}
 
-	float d = 255.0f / maxim;
-	for (unsigned i = 0; i < area; i++)
-		work_bits[i] = d * label_lookup(i, Y);
+	// linear relabel pass with the labels of the last cut
+	const float d = 255.0f / maxim;
+	const unsigned* labels = wshedobj.cut_labels.data();
+	const int n = static_cast<int>(area);
+#pragma omp parallel for
+	for (int i = 0; i < n; i++)
+		work_bits[i] = d * labels[Y[i]];
 
 	mode2 = 2;
 }
 
-unsigned bmphandler::label_lookup(unsigned i, unsigned* wshed)
-{
-	unsigned k = wshed[i];
-	if (wshedobj.B[k].l == 0 && wshedobj.B[k].r != k)
-		wshedobj.B[k].l = wshedobj.B[deepest_con_bas(k)].l;
-	return wshedobj.B[k].l;
-}
-
 void bmphandler::load_line(std::vector<Point>* vec_pt)
 {
 	contour.clear();
@@ -7717,167 +7464,25 @@ void bmphandler::connected_components(bool connectivity)
 {
 	unsigned char dummymode = mode1;
 
-	float* temp = (float*)malloc(sizeof(float) * (area + width + height + 1));
-	std::vector<float> maps;
-	float newest = 0.1f;
-
-	for (unsigned i = 0; i < area; i++)
-		temp[i + i / width + width + 2] = bmp_bits[i];
-	for (unsigned i = width + 1; i <= area + height; i += width + 1)
-		temp[i] = -1e10f;
-	for (unsigned i = 0; i <= width; i++)
-		temp[i] = -2e10f;
-
-	unsigned i1 = width + 2;
-	unsigned i2 = 0;
-
-	for (short j = 0; j < height; j++)
-	{
-		for (short k = 0; k < width; k++)
-		{
-			if (temp[i1] == temp[i1 - 1])
-			{
-				work_bits[i2] = base_connection(work_bits[i2 - 1], &maps);
-				if (temp[i1] == temp[i1 - width - 1])
-				{
-					maps[(int)base_connection(work_bits[i2 - width], &maps)] =
-							work_bits[i2];
-				}
-			}
-			else
-			{
-				if (temp[i1] == temp[i1 - width - 1])
-					work_bits[i2] =
-							base_connection(work_bits[i2 - width], &maps);
-				else if (connectivity && temp[i1] == temp[i1 - width - 2])
-					work_bits[i2] =
-							base_connection(work_bits[i2 - width - 1], &maps);
-				else
-				{
-					maps.push_back(newest);
-					work_bits[i2] = newest;
-					newest++;
-				}
-			}
-
-			if (connectivity && temp[i1 - 1] == temp[i1 - width - 1])
-				maps[(int)base_connection(work_bits[i2 - 1], &maps)] =
-						base_connection(work_bits[i2 - width], &maps);
-
-			i1++;
-			i2++;
-		}
-		i1++;
-	}
-
-	for (unsigned i = 0; i < area; i++)
-		work_bits[i] = base_connection(work_bits[i], &maps);
-
-	newest = 0.0f;
-	for (i1 = 0; i1 < (unsigned)maps.size(); i1++)
-		if ((unsigned)maps[i1] == i1)
-		{
-			maps[i1] = newest;
-			newest++;
-		}
+	std::vector<unsigned> labels(area);
+	const float* slice = bmp_bits;
+	unsigned* label_slice = labels.data();
+	ConnectedComponents(&slice, width, height, 1, connectivity ? kConnectivity8 : kConnectivity4, &label_slice);
 
+	// components are numbered from 0
 	for (unsigned i = 0; i < area; i++)
-		work_bits[i] = maps[(int)work_bits[i]];
-
-	free(temp);
+		work_bits[i] = static_cast<float>(labels[i] - 1);
 
 	mode1 = dummymode;
 	mode2 = 2;
-
-	return;
 }
 
 void bmphandler::connected_components(bool connectivity, std::set<float>& components)
 {
-	unsigned char dummymode = mode1;
-
-	float* temp = (float*)malloc(sizeof(float) * (area + width + height + 1));
-	std::vector<float> maps;
-	float newest = 0.1f;
-
-	for (unsigned i = 0; i < area; i++)
-		temp[i + i / width + width + 2] = bmp_bits[i];
-	for (unsigned i = width + 1; i <= area + height; i += width + 1)
-		temp[i] = -1e10f;
-	for (unsigned i = 0; i <= width; i++)
-		temp[i] = -2e10f;
-
-	unsigned i1 = width + 2;
-	unsigned i2 = 0;
-
-	for (short j = 0; j < height; j++)
-	{
-		for (short k = 0; k < width; k++)
-		{
-			if (temp[i1] == temp[i1 - 1])
-			{
-				work_bits[i2] = base_connection(work_bits[i2 - 1], &maps);
-				if (temp[i1] == temp[i1 - width - 1])
-				{
-					maps[(int)base_connection(work_bits[i2 - width], &maps)] =
-							work_bits[i2];
-				}
-			}
-			else
-			{
-				if (temp[i1] == temp[i1 - width - 1])
-					work_bits[i2] =
-							base_connection(work_bits[i2 - width], &maps);
-				else if (connectivity && temp[i1] == temp[i1 - width - 2])
-					work_bits[i2] =
-							base_connection(work_bits[i2 - width - 1], &maps);
-				else
-				{
-					maps.push_back(newest);
-					work_bits[i2] = newest;
-					newest++;
-				}
-			}
-
-			if (connectivity && temp[i1 - 1] == temp[i1 - width - 1])
-				maps[(int)base_connection(work_bits[i2 - 1], &maps)] =
-						base_connection(work_bits[i2 - width], &maps);
-
-			i1++;
-			i2++;
-		}
-		i1++;
-	}
-
-	for (unsigned i = 0; i < area; i++)
-		work_bits[i] = base_connection(work_bits[i], &maps);
-
-	newest = 0.0f;
-	for (i1 = 0; i1 < (unsigned)maps.size(); i1++)
-		if ((unsigned)maps[i1] == i1)
-		{
-			maps[i1] = newest;
-			newest++;
-		}
+	connected_components(connectivity);
 
 	for (unsigned i = 0; i < area; i++)
-	{
-		work_bits[i] = maps[(int)work_bits[i]];
 		components.insert(work_bits[i]);
-	}
-
-	free(temp);
-
-	mode1 = dummymode;
-	mode2 = 2;
-}
-
-float bmphandler::base_connection(float c, std::vector<float>* maps)
-{
-	if (c == (*maps)[(int)c])
-		return c;
-	else
-		return (*maps)[(int)c] = base_connection((*maps)[(int)c], maps);
 }
 
 void bmphandler::fill_gaps(short unsigned n, bool connectivity)
@@ -8205,10 +7810,10 @@ void bmphandler::fill_gapstissue(tissuelayers_size_t idx, short unsigned n,
 	mode2 = dummymode2;
 }
 
-void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
-		std::vector<std::vector<Point>>* outer_line,
-		std::vector<std::vector<Point>>* inner_line,
-		int minsize)
+void bmphandler::get_tissuecontours(tissuelayers_size_t idx,
+		const std::vector<tissues_size_t>& tissuetypes,
+		std::vector<std::vector<std::vector<Point>>>& outer_lines,
+		std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize)
 {
 	minsize = 2 * minsize;
 	float bubble_size;
@@ -8217,9 +7822,8 @@ void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
 
 	tissues_size_t* tmp_bits = (tissues_size_t*)malloc(
 			sizeof(tissues_size_t) * (width + 2) * (height + 2));
-	bool* visited = (bool*)malloc(sizeof(bool) * (width + 2) * (height + 2));
-	for (unsigned i = 0; i < unsigned(width + 2) * (height + 2); i++)
-		visited[i] = false;
+	// number of the last tissue (starting at 1), whose contour passed a pixel
+	std::vector<unsigned> visited(unsigned(width + 2) * (height + 2), 0);
 
 	unsigned pos = width + 3;
 	unsigned pos1 = 0;
@@ -8262,15 +7866,36 @@ void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
 			 i += (width + 2))
 		tmp_bits[i] = TISSUES_SIZE_MAX;
 
-	pos = width + 2;
-	while (pos < unsigned(width + 2) * (height + 1))
+	// contours start at the left end of a run of a tissue, collect the starts of all requested tissues
+	// in one pass over the slice, in scan order
+	std::vector<int> tissueindex(TISSUES_SIZE_MAX + 1, -1);
+	for (size_t k = 0; k < tissuetypes.size(); k++)
+		tissueindex[tissuetypes[k]] = (int)k;
+	std::vector<std::vector<unsigned>> starts(tissuetypes.size());
+	for (unsigned i = 1; i <= height; i++)
 	{
-		while ((tmp_bits[pos] != f || tmp_bits[pos - 1] == f || visited[pos]) &&
-					 pos < unsigned(width + 2) * (height + 1))
-			pos++;
+		pos = i * (width + 2) + 1;
+		for (unsigned j = 0; j < width; j++, pos++)
+		{
+			if (tmp_bits[pos] != tmp_bits[pos - 1] && tissueindex[tmp_bits[pos]] >= 0)
+				starts[tissueindex[tmp_bits[pos]]].push_back(pos);
+		}
+	}
 
-		if (pos < unsigned(width + 2) * (height + 1))
+	outer_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	inner_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	for (size_t k = 0; k < tissuetypes.size(); k++)
+	{
+		const tissues_size_t f = tissuetypes[k];
+		const unsigned stamp = (unsigned)k + 1;
+		std::vector<std::vector<Point>>* outer_line = &outer_lines[k];
+		std::vector<std::vector<Point>>* inner_line = &inner_lines[k];
+		for (size_t n = 0; n < starts[k].size(); n++)
 		{
+			pos = starts[k][n];
+			if (visited[pos] == stamp)
+				continue;
+
 			pos1 = pos;
 			vec_pt.clear();
 			p.px = short(pos % (width + 2) - 1);
@@ -8287,7 +7912,7 @@ void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
 				vec_pt.push_back(p);
 				if (1 >= minsize)
 					(*outer_line).push_back(vec_pt);
-				visited[pos] = true;
+				visited[pos] = stamp;
 			}
 			else
 			{
@@ -8342,7 +7967,7 @@ void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
 																 (direction == 3 && directionold == 5)))
 							//					 (inner==1&&!(||(direction==3&&directionold==5)))
 					)
-						visited[pos1] = true;
+						visited[pos1] = stamp;
 					pos1 = pos2;
 					p.px = short(pos1 % (width + 2) - 1);
 					p.py = short(pos1 / (width + 2) - 1);
@@ -8403,19 +8028,72 @@ void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
 					}
 				}
 			}
-			pos++;
 		}
 	}
 
 	free(tmp_bits);
-	free(visited);
-	return;
 }
 
-void bmphandler::get_tissuecontours2_xmirrored(
-		tissuelayers_size_t idx, tissues_size_t f,
-		std::vector<std::vector<Point>>* outer_line, std::vector<std::vector<Point>>* inner_line,
+void bmphandler::get_tissuecontours(tissuelayers_size_t idx, tissues_size_t f,
+		std::vector<std::vector<Point>>* outer_line,
+		std::vector<std::vector<Point>>* inner_line,
 		int minsize)
+{
+	std::vector<std::vector<std::vector<Point>>> outer_lines, inner_lines;
+	get_tissuecontours(idx, std::vector<tissues_size_t>(1, f), outer_lines, inner_lines, minsize);
+	outer_line->insert(outer_line->end(), outer_lines[0].begin(), outer_lines[0].end());
+	inner_line->insert(inner_line->end(), inner_lines[0].begin(), inner_lines[0].end());
+}
+
+namespace {
+// Blocks of 2x2 pixels of the padded label image with boundary edges of the requested tissues,
+// with the number of edges per tissue. Collected for all tissues in one pass, in scan order.
+void collect_contour_starts(const unsigned* tmp_bits, unsigned width, unsigned height,
+		const std::vector<tissues_size_t>& tissuetypes,
+		std::vector<std::vector<std::pair<int, unsigned char>>>& starts)
+{
+	std::vector<int> tissueindex(TISSUES_SIZE_MAX + 1, -1);
+	for (size_t k = 0; k < tissuetypes.size(); k++)
+		tissueindex[tissuetypes[k]] = (int)k;
+	starts.assign(tissuetypes.size(), std::vector<std::pair<int, unsigned char>>());
+
+	int pos = 0;
+	for (unsigned i = 0; i < height + 1; i++)
+	{
+		for (unsigned j = 0; j < width + 1; j++)
+		{
+			const unsigned block[4] = {tmp_bits[pos], tmp_bits[pos + 1],
+					tmp_bits[pos + width + 2], tmp_bits[pos + width + 3]};
+			for (int b = 0; b < 4; b++)
+			{
+				const unsigned f1 = block[b];
+				if (f1 > TISSUES_SIZE_MAX || tissueindex[f1] < 0 ||
+						(b > 0 && block[0] == f1) || (b > 1 && block[1] == f1) ||
+						(b > 2 && block[2] == f1))
+					continue;
+				unsigned char count = 0;
+				if ((block[0] != block[1]) && (block[0] == f1 || block[1] == f1))
+					count++;
+				if ((block[0] != block[2]) && (block[0] == f1 || block[2] == f1))
+					count++;
+				if ((block[2] != block[3]) && (block[2] == f1 || block[3] == f1))
+					count++;
+				if ((block[1] != block[3]) && (block[1] == f1 || block[3] == f1))
+					count++;
+				if (count != 0)
+					starts[tissueindex[f1]].push_back(std::make_pair(pos, count));
+			}
+			pos++;
+		}
+		pos++;
+	}
+}
+} // namespace
+
+void bmphandler::get_tissuecontours2_xmirrored(tissuelayers_size_t idx,
+		const std::vector<tissues_size_t>& tissuetypes,
+		std::vector<std::vector<std::vector<Point>>>& outer_lines,
+		std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize)
 {
 	//int w=(int)width;
 	//int h=(int)height;
@@ -8436,8 +8114,6 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	unsigned char* nrlines = (unsigned char*)malloc(sizeof(unsigned char) *
 																									(width + 2) * (height + 2));
 
-	unsigned f1 = (unsigned)f;
-
 	std::vector<Point> vec_pt;
 	float vol;
 
@@ -8474,28 +8150,8 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	for (unsigned i = 0; i < unsigned(width + 2) * (height + 2); i++)
 		nrlines[i] = 0;
 
-	pos = 0;
-	for (unsigned short i = 0; i < height + 1; i++)
-	{
-		for (unsigned short j = 0; j < width + 1; j++)
-		{
-			if ((tmp_bits[pos] != tmp_bits[pos + 1]) &&
-					(tmp_bits[pos] == f1 || tmp_bits[pos + 1] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos] != tmp_bits[pos + width + 2]) &&
-					(tmp_bits[pos] == f1 || tmp_bits[pos + width + 2] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos + width + 2] != tmp_bits[pos + width + 3]) &&
-					(tmp_bits[pos + width + 2] == f1 ||
-							tmp_bits[pos + width + 3] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos + 1] != tmp_bits[pos + width + 3]) &&
-					(tmp_bits[pos + 1] == f1 || tmp_bits[pos + width + 3] == f1))
-				nrlines[pos]++;
-			pos++;
-		}
-		pos++;
-	}
+	std::vector<std::vector<std::pair<int, unsigned char>>> starts;
+	collect_contour_starts(tmp_bits, width, height, tissuetypes, starts);
 
 	unsigned short direction;
 
@@ -8506,150 +8162,231 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	bool inner;
 	unsigned char casenr;
 
-	while (pos < int(width + 2) * (height + 2))
+	outer_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	inner_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	for (size_t k = 0; k < tissuetypes.size(); k++)
 	{
-		while (pos < int(width + 2) * (height + 2) && nrlines[pos] == 0)
-			pos++;
+		const unsigned f1 = (unsigned)tissuetypes[k];
+		std::vector<std::vector<Point>>* outer_line = &outer_lines[k];
+		std::vector<std::vector<Point>>* inner_line = &inner_lines[k];
+		for (size_t n = 0; n < starts[k].size(); n++)
+			nrlines[starts[k][n].first] = starts[k][n].second;
 
-		if (pos != int(width + 2) * (height + 2))
+		// a block is left when all its edges have been traced, i.e. the same order as a full scan
+		for (size_t n = 0; n < starts[k].size(); n++)
 		{
-			vec_pt.clear();
-			inner = (tmp_bits[pos + width + 3] != f1);
-			pos2 = pos;
-			direction = 3;
-			p.px = p2.px = 2 * (width + 1 - (pos % (width + 2)));
-			p.py = p2.py = 2 * (pos / (width + 2)) + 1;
-
-			vol = 0;
-			unsigned count = 0;
-
-			do
-			{
-				count++;
-				casenr = 0;
-				if (tmp_bits[pos] == f1)
-					casenr += 1;
-				if (tmp_bits[pos + 1] == f1)
-					casenr += 2;
-				if (tmp_bits[pos + width + 3] == f1)
-					casenr += 4;
-				if (tmp_bits[pos + width + 2] == f1)
-					casenr += 8;
-				nrlines[pos] -= 2;
-				switch (casenr)
-				{
-				case 1:
-					if (direction == 0)
+			pos = starts[k][n].first;
+			while (nrlines[pos] != 0)
+			{
+				vec_pt.clear();
+				inner = (tmp_bits[pos + width + 3] != f1);
+				pos2 = pos;
+				direction = 3;
+				p.px = p2.px = 2 * (width + 1 - (pos % (width + 2)));
+				p.py = p2.py = 2 * (pos / (width + 2)) + 1;
+
+				vol = 0;
+				unsigned count = 0;
+
+				do
+				{
+					count++;
+					casenr = 0;
+					if (tmp_bits[pos] == f1)
+						casenr += 1;
+					if (tmp_bits[pos + 1] == f1)
+						casenr += 2;
+					if (tmp_bits[pos + width + 3] == f1)
+						casenr += 4;
+					if (tmp_bits[pos + width + 2] == f1)
+						casenr += 8;
+					nrlines[pos] -= 2;
+					switch (casenr)
 					{
-						p.px--;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+					case 1:
+						if (direction == 0)
 						{
-							vec_pt.push_back(p);
-							vol += p.py;
+							p.px--;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py - .5f);
+							}
+							direction = 3;
+							p.py--;
 						}
 						else
 						{
-							vol += (p.py - .5f);
+							direction = 2;
+							p.py++;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py - .5f);
+							}
+							p.px++;
 						}
-						direction = 3;
-						p.py--;
-					}
-					else
-					{
-						direction = 2;
-						p.py++;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+						break;
+					case 2:
+						if (direction == 1)
 						{
-							vec_pt.push_back(p);
-							vol -= p.py;
+							direction = 0;
+							p.py++;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py - .5f);
+							}
+							p.px--;
 						}
 						else
 						{
-							vol -= (p.py - .5f);
+							direction = 3;
+							p.px++;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py - .5f);
+							}
+							p.py--;
 						}
-						p.px++;
-					}
-					break;
-				case 2:
-					if (direction == 1)
-					{
-						direction = 0;
-						p.py++;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 3:
+						if (direction == 0)
 						{
-							vec_pt.push_back(p);
-							vol += p.py;
+							p.px -= 2;
+							vol += (p.py * 2.0f);
 						}
 						else
 						{
-							vol += (p.py - .5f);
+							p.px += 2;
+							vol -= (p.py * 2.0f);
 						}
-						p.px--;
-					}
-					else
-					{
-						direction = 3;
-						p.px++;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 4:
+						if (direction == 3)
 						{
-							vec_pt.push_back(p);
-							vol -= p.py;
+							direction = 0;
+							p.py--;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py + 0.5f);
+							}
+							p.px--;
 						}
 						else
 						{
-							vol -= (p.py - .5f);
+							direction = 1;
+							p.px++;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py + 0.5f);
+							}
+							p.py++;
 						}
-						p.py--;
-					}
-					break;
-				case 3:
-					if (direction == 0)
-					{
-						p.px -= 2;
-						vol += (p.py * 2.0f);
-					}
-					else
-					{
-						p.px += 2;
-						vol -= (p.py * 2.0f);
-					}
-					break;
-				case 4:
-					if (direction == 3)
-					{
-						direction = 0;
-						p.py--;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+						break;
+					case 5:
+						if (tmp_bits[pos + width + 2] != tmp_bits[pos + 1] ||
+								tmp_bits[pos + 1] > f1)
 						{
-							vec_pt.push_back(p);
-							vol += p.py;
+							if (direction == 0)
+							{
+								direction = 1;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 0;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 3;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 2;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
 						}
 						else
 						{
-							vol += (p.py + 0.5f);
+							if (direction == 0)
+							{
+								direction = 3;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 2;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 1;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 0;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
 						}
-						p.px--;
-					}
-					else
-					{
-						direction = 1;
-						p.px++;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+						break;
+					case 6:
+						if (direction == 3)
 						{
-							vec_pt.push_back(p);
-							vol -= p.py;
+							p.py -= 2;
 						}
 						else
 						{
-							vol -= (p.py + 0.5f);
+							p.py += 2;
 						}
-						p.py++;
-					}
-					break;
-				case 5:
-					if (tmp_bits[pos + width + 2] != tmp_bits[pos + 1] ||
-							tmp_bits[pos + 1] > f1)
-					{
+						break;
+					case 7:
 						if (direction == 0)
 						{
 							direction = 1;
@@ -8657,265 +8394,194 @@ void bmphandler::get_tissuecontours2_xmirrored(
 							p.py++;
 							vol += (p.py - 0.5f);
 						}
-						else if (direction == 1)
-						{
-							direction = 0;
-							p.px--;
-							p.py++;
-							vol += (p.py - 0.5f);
-						}
-						else if (direction == 2)
-						{
-							direction = 3;
-							p.px++;
-							p.py--;
-							vol -= (p.py + 0.5f);
-						}
-						else if (direction == 3)
+						else
 						{
 							direction = 2;
 							p.px++;
 							p.py--;
 							vol -= (p.py + 0.5f);
 						}
-					}
-					else
-					{
+						break;
+					case 8:
 						if (direction == 0)
-						{
-							direction = 3;
-							p.px--;
-							p.py--;
-							vol += (p.py + 0.5f);
-						}
-						else if (direction == 1)
-						{
-							direction = 2;
-							p.px++;
-							p.py++;
-							vol -= (p.py - 0.5f);
-						}
-						else if (direction == 2)
 						{
 							direction = 1;
-							p.px++;
+							p.px--;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py + 0.5f);
+							}
 							p.py++;
-							vol -= (p.py - 0.5f);
 						}
-						else if (direction == 3)
+						else
 						{
-							direction = 0;
-							p.px--;
+							direction = 2;
 							p.py--;
-							vol += (p.py + 0.5f);
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py + 0.5f);
+							}
+							p.px++;
 						}
-					}
-					break;
-				case 6:
-					if (direction == 3)
-					{
-						p.py -= 2;
-					}
-					else
-					{
-						p.py += 2;
-					}
-					break;
-				case 7:
-					if (direction == 0)
-					{
-						direction = 1;
-						p.px--;
-						p.py++;
-						vol += (p.py - 0.5f);
-					}
-					else
-					{
-						direction = 2;
-						p.px++;
-						p.py--;
-						vol -= (p.py + 0.5f);
-					}
-					break;
-				case 8:
-					if (direction == 0)
-					{
-						direction = 1;
-						p.px--;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 9:
+						if (direction == 3)
 						{
-							vec_pt.push_back(p);
-							vol += p.py;
+							p.py -= 2;
 						}
 						else
 						{
-							vol += (p.py + 0.5f);
+							p.py += 2;
 						}
-						p.py++;
-					}
-					else
-					{
-						direction = 2;
-						p.py--;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 10:
+						if (tmp_bits[pos] != tmp_bits[pos + width + 3] ||
+								tmp_bits[pos] > f1)
 						{
-							vec_pt.push_back(p);
-							vol -= p.py;
+							if (direction == 0)
+							{
+								direction = 3;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 2;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 1;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 0;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
 						}
 						else
 						{
-							vol -= (p.py + 0.5f);
+							if (direction == 0)
+							{
+								direction = 1;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 0;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 3;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 2;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
 						}
-						p.px++;
-					}
-					break;
-				case 9:
-					if (direction == 3)
-					{
-						p.py -= 2;
-					}
-					else
-					{
-						p.py += 2;
-					}
-					break;
-				case 10:
-					if (tmp_bits[pos] != tmp_bits[pos + width + 3] ||
-							tmp_bits[pos] > f1)
-					{
-						if (direction == 0)
+						break;
+					case 11:
+						if (direction == 3)
 						{
-							direction = 3;
+							direction = 0;
 							p.px--;
 							p.py--;
 							vol += (p.py + 0.5f);
 						}
-						else if (direction == 1)
-						{
-							direction = 2;
-							p.px++;
-							p.py++;
-							vol -= (p.py - 0.5f);
-						}
-						else if (direction == 2)
+						else
 						{
 							direction = 1;
 							p.px++;
 							p.py++;
 							vol -= (p.py - 0.5f);
 						}
-						else if (direction == 3)
+						break;
+					case 12:
+						if (direction == 0)
 						{
-							direction = 0;
-							p.px--;
-							p.py--;
-							vol += (p.py + 0.5f);
+							p.px -= 2;
+							vol += (p.py * 2.0f);
 						}
-					}
-					else
-					{
-						if (direction == 0)
+						else
 						{
-							direction = 1;
-							p.px--;
-							p.py++;
-							vol += (p.py - 0.5f);
+							p.px += 2;
+							vol -= (p.py * 2.0f);
 						}
-						else if (direction == 1)
+						break;
+					case 13:
+						if (direction == 1)
 						{
 							direction = 0;
 							p.px--;
 							p.py++;
-							vol += (p.py - 0.5f);
+							vol += (p.py - .5f);
 						}
-						else if (direction == 2)
+						else
 						{
 							direction = 3;
 							p.px++;
 							p.py--;
-							vol -= (p.py + 0.5f);
+							vol -= (p.py + .5f);
+						}
+						break;
+					case 14:
+						if (direction == 0)
+						{
+							direction = 3;
+							p.px--;
+							p.py--;
+							vol += (p.py + .5f);
 						}
-						else if (direction == 3)
+						else
 						{
 							direction = 2;
 							p.px++;
-							p.py--;
-							vol -= (p.py + 0.5f);
+							p.py++;
+							vol -= (p.py - .5f);
 						}
+						break;
 					}
-					break;
-				case 11:
-					if (direction == 3)
-					{
-						direction = 0;
-						p.px--;
-						p.py--;
-						vol += (p.py + 0.5f);
-					}
-					else
-					{
-						direction = 1;
-						p.px++;
-						p.py++;
-						vol -= (p.py - 0.5f);
-					}
-					break;
-				case 12:
-					if (direction == 0)
-					{
-						p.px -= 2;
-						vol += (p.py * 2.0f);
-					}
-					else
-					{
-						p.px += 2;
-						vol -= (p.py * 2.0f);
-					}
-					break;
-				case 13:
-					if (direction == 1)
-					{
-						direction = 0;
-						p.px--;
-						p.py++;
-						vol += (p.py - .5f);
-					}
-					else
-					{
-						direction = 3;
-						p.px++;
-						p.py--;
-						vol -= (p.py + .5f);
-					}
-					break;
-				case 14:
-					if (direction == 0)
-					{
-						direction = 3;
-						p.px--;
-						p.py--;
-						vol += (p.py + .5f);
-					}
-					else
-					{
-						direction = 2;
-						p.px++;
-						p.py++;
-						vol -= (p.py - .5f);
-					}
-					break;
-				}
 
-				pos += movpos[direction];
-				vec_pt.push_back(p);
-			} while (pos != pos2 || p.px != p2.px || p.py != p2.py);
+					pos += movpos[direction];
+					vec_pt.push_back(p);
+				} while (pos != pos2 || p.px != p2.px || p.py != p2.py);
 
-			if (std::abs(vol / 4) >= (float)minsize - 0.6f)
-			{
-				if (inner)
-					(*inner_line).push_back(vec_pt);
-				else
-					(*outer_line).push_back(vec_pt);
+				if (std::abs(vol / 4) >= (float)minsize - 0.6f)
+				{
+					if (inner)
+						(*inner_line).push_back(vec_pt);
+					else
+						(*outer_line).push_back(vec_pt);
+				}
 			}
 		}
 	}
@@ -8926,9 +8592,20 @@ void bmphandler::get_tissuecontours2_xmirrored(
 
 void bmphandler::get_tissuecontours2_xmirrored(
 		tissuelayers_size_t idx, tissues_size_t f,
-		std::vector<std::vector<Point>>* outer_line,
-		std::vector<std::vector<Point>>* inner_line,
-		int minsize, float disttol)
+		std::vector<std::vector<Point>>* outer_line, std::vector<std::vector<Point>>* inner_line,
+		int minsize)
+{
+	std::vector<std::vector<std::vector<Point>>> outer_lines, inner_lines;
+	get_tissuecontours2_xmirrored(idx, std::vector<tissues_size_t>(1, f), outer_lines, inner_lines, minsize);
+	outer_line->insert(outer_line->end(), outer_lines[0].begin(), outer_lines[0].end());
+	inner_line->insert(inner_line->end(), inner_lines[0].begin(), inner_lines[0].end());
+}
+
+void bmphandler::get_tissuecontours2_xmirrored(tissuelayers_size_t idx,
+		const std::vector<tissues_size_t>& tissuetypes,
+		std::vector<std::vector<std::vector<Point>>>& outer_lines,
+		std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize,
+		float disttol)
 {
 	//int w=(int)width;
 	//int h=(int)height;
@@ -8946,7 +8623,6 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	unsigned setto = TISSUES_SIZE_MAX + 1;
 	unsigned* tmp_bits =
 			(unsigned*)malloc(sizeof(unsigned) * (width + 2) * (height + 2));
-	unsigned f1 = (unsigned)f;
 	unsigned char* nrlines = (unsigned char*)malloc(sizeof(unsigned char) *
 																									(width + 2) * (height + 2));
 
@@ -8988,28 +8664,8 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	for (unsigned i = 0; i < unsigned(width + 2) * (height + 2); i++)
 		nrlines[i] = 0;
 
-	pos = 0;
-	for (unsigned short i = 0; i < height + 1; i++)
-	{
-		for (unsigned short j = 0; j < width + 1; j++)
-		{
-			if ((tmp_bits[pos] != tmp_bits[pos + 1]) &&
-					(tmp_bits[pos] == f1 || tmp_bits[pos + 1] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos] != tmp_bits[pos + width + 2]) &&
-					(tmp_bits[pos] == f1 || tmp_bits[pos + width + 2] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos + width + 2] != tmp_bits[pos + width + 3]) &&
-					(tmp_bits[pos + width + 2] == f1 ||
-							tmp_bits[pos + width + 3] == f1))
-				nrlines[pos]++;
-			if ((tmp_bits[pos + 1] != tmp_bits[pos + width + 3]) &&
-					(tmp_bits[pos + 1] == f1 || tmp_bits[pos + width + 3] == f1))
-				nrlines[pos]++;
-			pos++;
-		}
-		pos++;
-	}
+	std::vector<std::vector<std::pair<int, unsigned char>>> starts;
+	collect_contour_starts(tmp_bits, width, height, tissuetypes, starts);
 
 	unsigned short direction;
 
@@ -9022,179 +8678,280 @@ void bmphandler::get_tissuecontours2_xmirrored(
 
 	//bool firsttime=true;
 
-	while (pos < int(width + 2) * (height + 2))
+	outer_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	inner_lines.assign(tissuetypes.size(), std::vector<std::vector<Point>>());
+	for (size_t k = 0; k < tissuetypes.size(); k++)
 	{
-		while (pos < int(width + 2) * (height + 2) && nrlines[pos] == 0)
-			pos++;
+		const unsigned f1 = (unsigned)tissuetypes[k];
+		std::vector<std::vector<Point>>* outer_line = &outer_lines[k];
+		std::vector<std::vector<Point>>* inner_line = &inner_lines[k];
+		for (size_t n = 0; n < starts[k].size(); n++)
+			nrlines[starts[k][n].first] = starts[k][n].second;
 
-		if (pos != int(width + 2) * (height + 2))
+		// a block is left when all its edges have been traced, i.e. the same order as a full scan
+		for (size_t n = 0; n < starts[k].size(); n++)
 		{
-			vec_pt.clear();
-			vec_meetings.clear();
-			inner = (tmp_bits[pos + width + 3] != f1);
-			pos2 = pos;
-			direction = 3;
-			p.px = p2.px = 2 * (width + 1 - (pos % (width + 2)));
-			p.py = p2.py = 2 * (pos / (width + 2)) + 1;
-
-			vol = 0;
-			unsigned count = 0;
-
-			do
-			{
-				count++;
-				casenr = 0;
-				if (tmp_bits[pos] == f1)
-					casenr += 1;
-				if (tmp_bits[pos + 1] == f1)
-					casenr += 2;
-				if (tmp_bits[pos + width + 3] == f1)
-					casenr += 4;
-				if (tmp_bits[pos + width + 2] == f1)
-					casenr += 8;
-				nrlines[pos] -= 2;
-				switch (casenr)
-				{
-				case 1:
-					if (direction == 0)
+			pos = starts[k][n].first;
+			while (nrlines[pos] != 0)
+			{
+				vec_pt.clear();
+				vec_meetings.clear();
+				inner = (tmp_bits[pos + width + 3] != f1);
+				pos2 = pos;
+				direction = 3;
+				p.px = p2.px = 2 * (width + 1 - (pos % (width + 2)));
+				p.py = p2.py = 2 * (pos / (width + 2)) + 1;
+
+				vol = 0;
+				unsigned count = 0;
+
+				do
+				{
+					count++;
+					casenr = 0;
+					if (tmp_bits[pos] == f1)
+						casenr += 1;
+					if (tmp_bits[pos + 1] == f1)
+						casenr += 2;
+					if (tmp_bits[pos + width + 3] == f1)
+						casenr += 4;
+					if (tmp_bits[pos + width + 2] == f1)
+						casenr += 8;
+					nrlines[pos] -= 2;
+					switch (casenr)
 					{
-						p.px--;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+					case 1:
+						if (direction == 0)
 						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol += p.py;
-						}
-						else
-						{
-							vol += (p.py - .5f);
-						}
-						direction = 3;
-						p.py--;
-					}
-					else
-					{
-						direction = 2;
-						p.py++;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
-						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol -= p.py;
+							p.px--;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py - .5f);
+							}
+							direction = 3;
+							p.py--;
 						}
 						else
 						{
-							vol -= (p.py - .5f);
+							direction = 2;
+							p.py++;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py - .5f);
+							}
+							p.px++;
 						}
-						p.px++;
-					}
-					break;
-				case 2:
-					if (direction == 1)
-					{
-						direction = 0;
-						p.py++;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 2:
+						if (direction == 1)
 						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol += p.py;
+							direction = 0;
+							p.py++;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py - .5f);
+							}
+							p.px--;
 						}
 						else
 						{
-							vol += (p.py - .5f);
+							direction = 3;
+							p.px++;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py - .5f);
+							}
+							p.py--;
 						}
-						p.px--;
-					}
-					else
-					{
-						direction = 3;
-						p.px++;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+						break;
+					case 3:
+						if (direction == 0)
 						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol -= p.py;
+							if (tmp_bits[pos + width + 2] !=
+									tmp_bits[pos + width + 3])
+							{
+								p.px--;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.px--;
+							}
+							else
+							{
+								p.px -= 2;
+							}
+							vol += (p.py * 2.0f);
 						}
 						else
 						{
-							vol -= (p.py - .5f);
+							if (tmp_bits[pos + width + 2] !=
+									tmp_bits[pos + width + 3])
+							{
+								p.px++;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.px++;
+							}
+							else
+							{
+								p.px += 2;
+							}
+							vol -= (p.py * 2.0f);
 						}
-						p.py--;
-					}
-					break;
-				case 3:
-					if (direction == 0)
-					{
-						if (tmp_bits[pos + width + 2] !=
-								tmp_bits[pos + width + 3])
+						break;
+					case 4:
+						if (direction == 3)
 						{
-							p.px--;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
+							direction = 0;
+							p.py--;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py + 0.5f);
+							}
 							p.px--;
 						}
 						else
 						{
-							p.px -= 2;
-						}
-						vol += (p.py * 2.0f);
-					}
-					else
-					{
-						if (tmp_bits[pos + width + 2] !=
-								tmp_bits[pos + width + 3])
-						{
-							p.px++;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
+							direction = 1;
 							p.px++;
+							if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py + 0.5f);
+							}
+							p.py++;
 						}
-						else
+						break;
+					case 5:
+						if (tmp_bits[pos + width + 2] != tmp_bits[pos + 1] ||
+								tmp_bits[pos + 1] > f1)
 						{
-							p.px += 2;
-						}
-						vol -= (p.py * 2.0f);
-					}
-					break;
-				case 4:
-					if (direction == 3)
-					{
-						direction = 0;
-						p.py--;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
-						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol += p.py;
+							if (direction == 0)
+							{
+								direction = 1;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 0;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 3;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 2;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
 						}
 						else
 						{
-							vol += (p.py + 0.5f);
+							if (direction == 0)
+							{
+								direction = 3;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 2;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 1;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 0;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
 						}
-						p.px--;
-					}
-					else
-					{
-						direction = 1;
-						p.px++;
-						if (tmp_bits[pos + 1] != tmp_bits[pos + width + 2])
+						break;
+					case 6:
+						if (direction == 3)
 						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol -= p.py;
+							if (tmp_bits[pos + width + 2] != tmp_bits[pos])
+							{
+								p.py--;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.py--;
+							}
+							else
+							{
+								p.py -= 2;
+							}
 						}
 						else
 						{
-							vol -= (p.py + 0.5f);
+							if (tmp_bits[pos + width + 2] != tmp_bits[pos])
+							{
+								p.py++;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.py++;
+							}
+							else
+							{
+								p.py += 2;
+							}
 						}
-						p.py++;
-					}
-					break;
-				case 5:
-					if (tmp_bits[pos + width + 2] != tmp_bits[pos + 1] ||
-							tmp_bits[pos + 1] > f1)
-					{
+						break;
+					case 7:
 						if (direction == 0)
 						{
 							direction = 1;
@@ -9202,335 +8959,244 @@ void bmphandler::get_tissuecontours2_xmirrored(
 							p.py++;
 							vol += (p.py - 0.5f);
 						}
-						else if (direction == 1)
-						{
-							direction = 0;
-							p.px--;
-							p.py++;
-							vol += (p.py - 0.5f);
-						}
-						else if (direction == 2)
-						{
-							direction = 3;
-							p.px++;
-							p.py--;
-							vol -= (p.py + 0.5f);
-						}
-						else if (direction == 3)
+						else
 						{
 							direction = 2;
 							p.px++;
 							p.py--;
 							vol -= (p.py + 0.5f);
 						}
-					}
-					else
-					{
+						break;
+					case 8:
 						if (direction == 0)
-						{
-							direction = 3;
-							p.px--;
-							p.py--;
-							vol += (p.py + 0.5f);
-						}
-						else if (direction == 1)
-						{
-							direction = 2;
-							p.px++;
-							p.py++;
-							vol -= (p.py - 0.5f);
-						}
-						else if (direction == 2)
 						{
 							direction = 1;
-							p.px++;
-							p.py++;
-							vol -= (p.py - 0.5f);
-						}
-						else if (direction == 3)
-						{
-							direction = 0;
 							p.px--;
-							p.py--;
-							vol += (p.py + 0.5f);
-						}
-					}
-					break;
-				case 6:
-					if (direction == 3)
-					{
-						if (tmp_bits[pos + width + 2] != tmp_bits[pos])
-						{
-							p.py--;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							p.py--;
-						}
-						else
-						{
-							p.py -= 2;
-						}
-					}
-					else
-					{
-						if (tmp_bits[pos + width + 2] != tmp_bits[pos])
-						{
-							p.py++;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol += p.py;
+							}
+							else
+							{
+								vol += (p.py + 0.5f);
+							}
 							p.py++;
 						}
 						else
 						{
-							p.py += 2;
-						}
-					}
-					break;
-				case 7:
-					if (direction == 0)
-					{
-						direction = 1;
-						p.px--;
-						p.py++;
-						vol += (p.py - 0.5f);
-					}
-					else
-					{
-						direction = 2;
-						p.px++;
-						p.py--;
-						vol -= (p.py + 0.5f);
-					}
-					break;
-				case 8:
-					if (direction == 0)
-					{
-						direction = 1;
-						p.px--;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
-						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol += p.py;
+							direction = 2;
+							p.py--;
+							if (tmp_bits[pos] != tmp_bits[pos + width + 3])
+							{
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								vol -= p.py;
+							}
+							else
+							{
+								vol -= (p.py + 0.5f);
+							}
+							p.px++;
 						}
-						else
+						break;
+					case 9:
+						if (direction == 3)
 						{
-							vol += (p.py + 0.5f);
-						}
-						p.py++;
-					}
-					else
-					{
-						direction = 2;
-						p.py--;
-						if (tmp_bits[pos] != tmp_bits[pos + width + 3])
-						{
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							vol -= p.py;
+							if (tmp_bits[pos + width + 3] != tmp_bits[pos + 1])
+							{
+								p.py--;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.py--;
+							}
+							else
+							{
+								p.py -= 2;
+							}
 						}
 						else
 						{
-							vol -= (p.py + 0.5f);
+							if (tmp_bits[pos + width + 3] != tmp_bits[pos + 1])
+							{
+								p.py++;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.py++;
+							}
+							else
+							{
+								p.py += 2;
+							}
 						}
-						p.px++;
-					}
-					break;
-				case 9:
-					if (direction == 3)
-					{
-						if (tmp_bits[pos + width + 3] != tmp_bits[pos + 1])
+						break;
+					case 10:
+						if (tmp_bits[pos] != tmp_bits[pos + width + 3] ||
+								tmp_bits[pos] > f1)
 						{
-							p.py--;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							p.py--;
+							if (direction == 0)
+							{
+								direction = 3;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 2;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 1;
+								p.px++;
+								p.py++;
+								vol -= (p.py - 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 0;
+								p.px--;
+								p.py--;
+								vol += (p.py + 0.5f);
+							}
 						}
 						else
 						{
-							p.py -= 2;
+							if (direction == 0)
+							{
+								direction = 1;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 1)
+							{
+								direction = 0;
+								p.px--;
+								p.py++;
+								vol += (p.py - 0.5f);
+							}
+							else if (direction == 2)
+							{
+								direction = 3;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
+							else if (direction == 3)
+							{
+								direction = 2;
+								p.px++;
+								p.py--;
+								vol -= (p.py + 0.5f);
+							}
 						}
-					}
-					else
-					{
-						if (tmp_bits[pos + width + 3] != tmp_bits[pos + 1])
+						break;
+					case 11:
+						if (direction == 3)
 						{
-							p.py++;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							p.py++;
-						}
-						else
-						{
-							p.py += 2;
-						}
-					}
-					break;
-				case 10:
-					if (tmp_bits[pos] != tmp_bits[pos + width + 3] ||
-							tmp_bits[pos] > f1)
-					{
-						if (direction == 0)
-						{
-							direction = 3;
+							direction = 0;
 							p.px--;
 							p.py--;
 							vol += (p.py + 0.5f);
 						}
-						else if (direction == 1)
-						{
-							direction = 2;
-							p.px++;
-							p.py++;
-							vol -= (p.py - 0.5f);
-						}
-						else if (direction == 2)
+						else
 						{
 							direction = 1;
 							p.px++;
 							p.py++;
 							vol -= (p.py - 0.5f);
 						}
-						else if (direction == 3)
+						break;
+					case 12:
+						if (direction == 0)
 						{
-							direction = 0;
-							p.px--;
-							p.py--;
-							vol += (p.py + 0.5f);
+							if (tmp_bits[pos] != tmp_bits[pos + 1])
+							{
+								p.px--;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.px--;
+							}
+							else
+							{
+								p.px -= 2;
+							}
+							vol += (p.py * 2.0f);
 						}
-					}
-					else
-					{
-						if (direction == 0)
+						else
 						{
-							direction = 1;
-							p.px--;
-							p.py++;
-							vol += (p.py - 0.5f);
+							if (tmp_bits[pos] != tmp_bits[pos + 1])
+							{
+								p.px++;
+								vec_meetings.push_back(vec_pt.size());
+								vec_pt.push_back(p);
+								p.px++;
+							}
+							else
+							{
+								p.px += 2;
+							}
+							vol -= (p.py * 2.0f);
 						}
-						else if (direction == 1)
+						break;
+					case 13:
+						if (direction == 1)
 						{
 							direction = 0;
 							p.px--;
 							p.py++;
-							vol += (p.py - 0.5f);
+							vol += (p.py - .5f);
 						}
-						else if (direction == 2)
+						else
 						{
 							direction = 3;
 							p.px++;
 							p.py--;
-							vol -= (p.py + 0.5f);
-						}
-						else if (direction == 3)
-						{
-							direction = 2;
-							p.px++;
-							p.py--;
-							vol -= (p.py + 0.5f);
+							vol -= (p.py + .5f);
 						}
-					}
-					break;
-				case 11:
-					if (direction == 3)
-					{
-						direction = 0;
-						p.px--;
-						p.py--;
-						vol += (p.py + 0.5f);
-					}
-					else
-					{
-						direction = 1;
-						p.px++;
-						p.py++;
-						vol -= (p.py - 0.5f);
-					}
-					break;
-				case 12:
-					if (direction == 0)
-					{
-						if (tmp_bits[pos] != tmp_bits[pos + 1])
+						break;
+					case 14:
+						if (direction == 0)
 						{
+							direction = 3;
 							p.px--;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
-							p.px--;
+							p.py--;
+							vol += (p.py + .5f);
 						}
 						else
 						{
-							p.px -= 2;
-						}
-						vol += (p.py * 2.0f);
-					}
-					else
-					{
-						if (tmp_bits[pos] != tmp_bits[pos + 1])
-						{
-							p.px++;
-							vec_meetings.push_back(vec_pt.size());
-							vec_pt.push_back(p);
+							direction = 2;
 							p.px++;
+							p.py++;
+							vol -= (p.py - .5f);
 						}
-						else
-						{
-							p.px += 2;
-						}
-						vol -= (p.py * 2.0f);
+						break;
 					}
-					break;
-				case 13:
-					if (direction == 1)
-					{
-						direction = 0;
-						p.px--;
-						p.py++;
-						vol += (p.py - .5f);
-					}
-					else
-					{
-						direction = 3;
-						p.px++;
-						p.py--;
-						vol -= (p.py + .5f);
-					}
-					break;
-				case 14:
-					if (direction == 0)
+					pos += movpos[direction];
+					vec_pt.push_back(p);
+				} while (pos != pos2 || p.px != p2.px || p.py != p2.py);
+
+				if (std::abs(vol / 4) >= (float)minsize - 0.6f)
+				{
+					if (vec_meetings.empty())
 					{
-						direction = 3;
-						p.px--;
-						p.py--;
-						vol += (p.py + .5f);
+						vec_meetings.push_back(0);
 					}
-					else
+					Contour2 cc2;
+					std::vector<Point> vec_simp;
+					cc2.doug_peuck(disttol * 2, &vec_pt, &vec_meetings, &vec_simp);
+					if (vec_simp.size() > 2)
 					{
-						direction = 2;
-						p.px++;
-						p.py++;
-						vol -= (p.py - .5f);
+						if (inner)
+							(*inner_line).push_back(vec_simp);
+						else
+							(*outer_line).push_back(vec_simp);
 					}
-					break;
-				}
-				pos += movpos[direction];
-				vec_pt.push_back(p);
-			} while (pos != pos2 || p.px != p2.px || p.py != p2.py);
-
-			if (std::abs(vol / 4) >= (float)minsize - 0.6f)
-			{
-				if (vec_meetings.empty())
-				{
-					vec_meetings.push_back(0);
-				}
-				Contour2 cc2;
-				std::vector<Point> vec_simp;
-				cc2.doug_peuck(disttol * 2, &vec_pt, &vec_meetings, &vec_simp);
-				if (vec_simp.size() > 2)
-				{
-					if (inner)
-						(*inner_line).push_back(vec_simp);
-					else
-						(*outer_line).push_back(vec_simp);
 				}
 			}
 		}
@@ -9540,6 +9206,18 @@ void bmphandler::get_tissuecontours2_xmirrored(
 	free(nrlines);
 }
 
+void bmphandler::get_tissuecontours2_xmirrored(
+		tissuelayers_size_t idx, tissues_size_t f,
+		std::vector<std::vector<Point>>* outer_line,
+		std::vector<std::vector<Point>>* inner_line,
+		int minsize, float disttol)
+{
+	std::vector<std::vector<std::vector<Point>>> outer_lines, inner_lines;
+	get_tissuecontours2_xmirrored(idx, std::vector<tissues_size_t>(1, f), outer_lines, inner_lines, minsize, disttol);
+	outer_line->insert(outer_line->end(), outer_lines[0].begin(), outer_lines[0].end());
+	inner_line->insert(inner_line->end(), inner_lines[0].begin(), inner_lines[0].end());
+}
+
 void bmphandler::get_contours(float f, std::vector<std::vector<Point>>* outer_line,
 		std::vector<std::vector<Point>>* inner_line, int minsize)
 {
@@ -9846,400 +9524,94 @@ void bmphandler::distance_map(bool connectivity)
 	return;
 }
 
-void bmphandler::distance_map(bool connectivity, float f,
-		short unsigned levlset)
+void bmphandler::distance_map(float f, short unsigned levlset)
 {
 	unsigned char dummymode = mode1;
-	std::vector<unsigned> v1, v2;
-	std::vector<unsigned>*vp1, *vp2, *vpdummy;
 	const float background = f - width - height;
 
 	std::vector<std::vector<Point>> vo, vi;
-	std::vector<unsigned>::iterator vuit;
 	std::vector<Point>::iterator vpit;
 
 	swap_bmpwork();
 	get_contours(f, &vo, &vi, 0);
 	swap_bmpwork();
 
-	for (unsigned i = 0; i < (unsigned)vo.size(); i++)
-		for (vpit = vo[i].begin(); vpit != vo[i].end(); vpit++)
-			v1.push_back(pt2coord(*vpit));
-	for (unsigned i = 0; i < (unsigned)vi.size(); i++)
-		for (vpit = vi[i].begin(); vpit != vi[i].end(); vpit++)
-			v1.push_back(pt2coord(*vpit));
-
-	for (unsigned i = 0; i < area; i++)
-		work_bits[i] = background;
-	for (vuit = v1.begin(); vuit != v1.end(); vuit++)
-		work_bits[*vuit] = f;
-
-	if (levlset == 0)
-		for (unsigned i = 0; i < area; i++)
-			if (bmp_bits[i] == f)
-				work_bits[i] = f;
-
-	if (levlset == 1)
-		for (unsigned i = 0; i < area; i++)
-			if (bmp_bits[i] != f)
-				work_bits[i] = f;
-
-	vp1 = &v1;
-	vp2 = &v2;
-
-	float wbp;
-	unsigned p;
-
-	while (!(*vp1).empty())
-	{
-		for (vuit = (*vp1).begin(); vuit != (*vp1).end(); vuit++)
-		{
-			p = *vuit;
-			wbp = work_bits[p];
-
-			if (p % width != 0 && work_bits[p - 1] == background)
-			{
-				if (bmp_bits[p - 1] == f)
-				{
-					work_bits[p - 1] = wbp + 1;
-					(*vp2).push_back(p - 1);
-				}
-				else
-				{
-					work_bits[p - 1] = wbp - 1;
-					(*vp2).push_back(p - 1);
-				}
-			}
-
-			if ((p + 1) % width != 0 && work_bits[p + 1] == background)
-			{
-				if (bmp_bits[p + 1] == f)
-				{
-					work_bits[p + 1] = wbp + 1;
-					(*vp2).push_back(p + 1);
-				}
-				else
-				{
-					work_bits[p + 1] = wbp - 1;
-					(*vp2).push_back(p + 1);
-				}
-			}
-
-			if (p >= width && work_bits[p - width] == background)
-			{
-				if (bmp_bits[p - width] == f)
-				{
-					work_bits[p - width] = wbp + 1;
-					(*vp2).push_back(p - width);
-				}
-				else
-				{
-					work_bits[p - width] = wbp - 1;
-					(*vp2).push_back(p - width);
-				}
-			}
-
-			if ((p + width) < area != 0 && work_bits[p + width] == background)
-			{
-				if (bmp_bits[p + width] == f)
-				{
-					work_bits[p + width] = wbp + 1;
-					(*vp2).push_back(p + width);
-				}
-				else
-				{
-					work_bits[p + width] = wbp - 1;
-					(*vp2).push_back(p + width);
-				}
-			}
-
-			if (connectivity)
-			{
-				if (p % width != 0 && p >= width &&
-						work_bits[p - 1 - width] == background)
-				{
-					if (bmp_bits[p - 1 - width] == f)
-					{
-						work_bits[p - 1 - width] = wbp + 1;
-						(*vp2).push_back(p - 1 - width);
-					}
-					else
-					{
-						work_bits[p - 1 - width] = wbp - 1;
-						(*vp2).push_back(p - 1 - width);
-					}
-				}
-
-				if (p % width != 0 && (p + width) < area &&
-						work_bits[p - 1 + width] == background)
-				{
-					if (bmp_bits[p - 1 + width] == f)
-					{
-						work_bits[p - 1 + width] = wbp + 1;
-						(*vp2).push_back(p - 1 + width);
-					}
-					else
-					{
-						work_bits[p - 1 + width] = wbp - 1;
-						(*vp2).push_back(p - 1 + width);
-					}
-				}
-
-				if ((p + 1) % width != 0 && p >= width &&
-						work_bits[p - width + 1] == background)
-				{
-					if (bmp_bits[p - width + 1] == f)
-					{
-						work_bits[p - width + 1] = wbp + 1;
-						(*vp2).push_back(p - width + 1);
-					}
-					else
-					{
-						work_bits[p - width + 1] = wbp - 1;
-						(*vp2).push_back(p - width + 1);
-					}
-				}
-
-				if ((p + 1) % width != 0 && (p + width) < area &&
-						work_bits[p + width + 1] == background)
-				{
-					if (bmp_bits[p + width + 1] == f)
-					{
-						work_bits[p + width + 1] = wbp + 1;
-						(*vp2).push_back(p + width + 1);
-					}
-					else
-					{
-						work_bits[p + width + 1] = wbp - 1;
-						(*vp2).push_back(p + width + 1);
-					}
-				}
-			}
-		}
-
-		(*vp1).clear();
-		vpdummy = vp1;
-		vp1 = vp2;
-		vp2 = vpdummy;
-	}
-
-	mode1 = dummymode;
-	mode2 = 1;
-
-	return;
-}
-
-unsigned* bmphandler::dead_reckoning(float f)
-{
-	unsigned char dummymode = mode1;
-	unsigned* P = (unsigned*)malloc(area * sizeof(unsigned));
-
+	// Euclidean distance to the contour
 	for (unsigned i = 0; i < area; i++)
-	{
-		work_bits[i] = float((width + height) * (width + height));
-		P[i] = area;
-	}
-
-	std::vector<std::vector<Point>> vo, vi;
-	std::vector<unsigned>::iterator vuit;
-	std::vector<Point>::iterator vpit;
-
-	swap_bmpwork();
-	get_contours(f, &vo, &vi, 0);
-	swap_bmpwork();
-
+		work_bits[i] = edt::Infinity();
 	for (unsigned i = 0; i < (unsigned)vo.size(); i++)
-	{
 		for (vpit = vo[i].begin(); vpit != vo[i].end(); vpit++)
-		{
 			work_bits[pt2coord(*vpit)] = 0;
-			P[pt2coord(*vpit)] = pt2coord(*vpit);
-		}
-		//		cout << ";"<<vo[i].size();
-	}
 	for (unsigned i = 0; i < (unsigned)vi.size(); i++)
-	{
-		for (vpit = vi[i].begin(); vpit != vi[i].end(); vpit++)
-		{
-			work_bits[pt2coord(*vpit)] = 0;
-			P[pt2coord(*vpit)] = pt2coord(*vpit);
-		}
-		//		cout << "."<<vi[i].size();
-	}
-
-	unsigned j = 0;
-
-	float d1 = 1;
-	float d2 = sqrt(2.0f);
-
-	for (unsigned short k = 0; k < height; k++)
-	{
-		for (unsigned short l = 0; l < width; l++)
-		{
-			if (k > 0)
-			{
-				if (l > 0 && work_bits[j - 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j - width] + d1 < work_bits[j])
-				{
-					P[j] = P[j - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
-
-			if (l > 0 && work_bits[j - 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j - 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
-
-			j++;
-		}
-	}
-
-	j = area - 1;
-
-	for (int k = height - 1; k >= 0; k--)
-	{
-		for (int l = width - 1; l >= 0; l--)
-		{
-			if ((l + 1) != width && work_bits[j + 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j + 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
-
-			if ((k + 1) != height)
-			{
-				if (l > 0 && work_bits[j - 1 + width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j + width] + d1 < work_bits[j])
-				{
-					P[j] = P[j + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 + width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
-
-			j--;
-		}
-	}
-
-	j = 0;
-
-	for (unsigned short k = 0; k < height; k++)
-	{
-		for (unsigned short l = 0; l < width; l++)
-		{
-			if (k > 0)
-			{
-				if (l > 0 && work_bits[j - 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j - width] + d1 < work_bits[j])
-				{
-					P[j] = P[j - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
+		for (vpit = vi[i].begin(); vpit != vi[i].end(); vpit++)
+			work_bits[pt2coord(*vpit)] = 0;
 
-			if (l > 0 && work_bits[j - 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j - 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	float* dist = work_bits;
+	SquaredDistanceTransform(&dist, width, height, 1, spacing);
 
-			j++;
-		}
+	for (unsigned i = 0; i < area; i++)
+	{
+		if ((levlset == 0 && bmp_bits[i] == f) || (levlset == 1 && bmp_bits[i] != f))
+			work_bits[i] = f;
+		else if (work_bits[i] == edt::Infinity())
+			work_bits[i] = background;
+		else if (bmp_bits[i] == f)
+			work_bits[i] = f + std::sqrt(work_bits[i]);
+		else
+			work_bits[i] = f - std::sqrt(work_bits[i]);
 	}
 
+	mode1 = dummymode;
+	mode2 = 1;
+
+	return;
+}
+
+void bmphandler::dead_reckoning(float f)
+{
+	unsigned char dummymode = mode1;
+
+	std::vector<std::vector<Point>> vo, vi;
+	std::vector<Point>::iterator vpit;
+
+	swap_bmpwork();
+	get_contours(f, &vo, &vi, 0);
+	swap_bmpwork();
+
 	for (unsigned i = 0; i < area; i++)
-		if (bmp_bits[i] != f)
-			work_bits[i] = -work_bits[i];
+		work_bits[i] = edt::Infinity();
+	for (unsigned i = 0; i < (unsigned)vo.size(); i++)
+		for (vpit = vo[i].begin(); vpit != vo[i].end(); vpit++)
+			work_bits[pt2coord(*vpit)] = 0;
+	for (unsigned i = 0; i < (unsigned)vi.size(); i++)
+		for (vpit = vi[i].begin(); vpit != vi[i].end(); vpit++)
+			work_bits[pt2coord(*vpit)] = 0;
 
-	/*	for(unsigned i=0;i<(unsigned)vo.size();i++)
-		for(vpit=vo[i].begin();vpit!=vo[i].end();vpit++) {
-			work_bits[pt2coord(*vpit)]=255;
-			P[pt2coord(*vpit)]=pt2coord(*vpit);
-		}
-	for(unsigned i=0;i<(unsigned)vi.size();i++)
-		for(vpit=vi[i].begin();vpit!=vi[i].end();vpit++) {
-			work_bits[pt2coord(*vpit)]=255;
-			P[pt2coord(*vpit)]=pt2coord(*vpit);
-		}*/
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	float* dist = work_bits;
+	SquaredDistanceTransform(&dist, width, height, 1, spacing);
+
+	// signed distance, negative outside of f
+	const float far_away = float((width + height) * (width + height));
+	for (unsigned i = 0; i < area; i++)
+	{
+		float d = (work_bits[i] == edt::Infinity()) ? far_away : std::sqrt(work_bits[i]);
+		work_bits[i] = (bmp_bits[i] != f) ? -d : d;
+	}
 
 	mode1 = dummymode;
 	mode2 = 1;
-
-	return P;
 }
 
 void bmphandler::dead_reckoning()
 {
 	unsigned char dummymode = mode1;
-	unsigned* P = (unsigned*)malloc(area * sizeof(unsigned));
 
 	for (unsigned i = 0; i < area; i++)
-	{
-		work_bits[i] = float((width + height) * (width + height));
-		P[i] = area;
-	}
+		work_bits[i] = edt::Infinity();
 
+	// pixels on both sides of a change of value are the features
 	unsigned i1 = 0;
 	for (unsigned short h = 0; h < height - 1; h++)
 	{
@@ -10248,8 +9620,6 @@ void bmphandler::dead_reckoning()
 			if (bmp_bits[i1] != bmp_bits[i1 + width])
 			{
 				work_bits[i1] = work_bits[i1 + width] = 0;
-				P[i1] = i1;
-				P[i1 + width] = i1 + width;
 			}
 			i1++;
 		}
@@ -10263,163 +9633,24 @@ void bmphandler::dead_reckoning()
 			if (bmp_bits[i1] != bmp_bits[i1 + 1])
 			{
 				work_bits[i1] = work_bits[i1 + 1] = 0;
-				P[i1] = i1;
-				P[i1 + 1] = i1 + 1;
 			}
 			i1++;
 		}
 		i1++;
 	}
 
-	unsigned j = 0;
-
-	float d1 = 1;
-	float d2 = sqrt(2.0f);
-
-	for (unsigned short k = 0; k < height; k++)
-	{
-		for (unsigned short l = 0; l < width; l++)
-		{
-			if (k > 0)
-			{
-				if (l > 0 && work_bits[j - 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j - width] + d1 < work_bits[j])
-				{
-					P[j] = P[j - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
-
-			if (l > 0 && work_bits[j - 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j - 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
-
-			j++;
-		}
-	}
-
-	j = area - 1;
-
-	for (int k = height - 1; k >= 0; k--)
-	{
-		for (int l = width - 1; l >= 0; l--)
-		{
-			if ((l + 1) != width && work_bits[j + 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j + 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
-
-			if ((k + 1) != height)
-			{
-				if (l > 0 && work_bits[j - 1 + width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j + width] + d1 < work_bits[j])
-				{
-					P[j] = P[j + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 + width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 + width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
-
-			j--;
-		}
-	}
-
-	j = 0;
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	float* dist = work_bits;
+	SquaredDistanceTransform(&dist, width, height, 1, spacing);
 
-	for (unsigned short k = 0; k < height; k++)
+	const float far_away = float((width + height) * (width + height));
+	for (unsigned i = 0; i < area; i++)
 	{
-		for (unsigned short l = 0; l < width; l++)
-		{
-			if (k > 0)
-			{
-				if (l > 0 && work_bits[j - 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j - 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if (work_bits[j - width] + d1 < work_bits[j])
-				{
-					P[j] = P[j - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-
-				if ((l + 1) != width &&
-						work_bits[j + 1 - width] + d2 < work_bits[j])
-				{
-					P[j] = P[j + 1 - width];
-					work_bits[j] =
-							sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-												 (k - P[j] / width) * (k - P[j] / width)));
-				}
-			}
-
-			if (l > 0 && work_bits[j - 1] + d1 < work_bits[j])
-			{
-				P[j] = P[j - 1];
-				work_bits[j] =
-						sqrt(float((l - P[j] % width) * (l - P[j] % width) +
-											 (k - P[j] / width) * (k - P[j] / width)));
-			}
-
-			j++;
-		}
+		work_bits[i] = (work_bits[i] == edt::Infinity()) ? far_away : std::sqrt(work_bits[i]);
 	}
 
-	//	for(unsigned i=0;i<area;i++)
-	//		if(bmp_bits[i]==0) work_bits[i]=-work_bits[i];
-
 	mode1 = dummymode;
 	mode2 = 1;
-
-	free(P);
-	return;
 }
 
 unsigned* bmphandler::dead_reckoning_squared(float f)
@@ -10860,104 +10091,18 @@ void bmphandler::fill_contour(std::vector<Point>* vp, bool continuous)
 
 void bmphandler::add_skin(unsigned i4, float setto)
 {
-	unsigned i = 0, pos, y, x, j;
-
-	//Create a binary std::vector noTissue/Tissue
-	std::vector<int> s;
-	for (int j = 0; j < height; j++)
-	{
-		for (int k = 0; k < width; k++)
-		{
-			if (work_bits[i] == 0)
-				s.push_back(-1);
-			else
-				s.push_back(0);
-			i++;
-		}
-	}
-
-	// i4 itetations through  y, -y, x, -x converting, each time a tissue beginning is find, one tissue pixel into skin
-	//!! It is assumed that ix and iy are the same
-	bool convertSkin = true;
-	for (i = 1; i < i4 + 1; i++)
-	{
-		for (y = 0; y < height; y++)
-		{
-			pos = y * width;
-			while (pos < (y + 1) * width)
-			{
-				if (s[pos] == 0)
-				{
-					if (convertSkin)
-						s[pos] = 256;
-					convertSkin = false;
-				}
-				else
-					convertSkin = true;
-
-				pos++;
-			}
-
-			pos = (y + 1) * width - 1;
-			while (pos > y * width)
-			{
-				if (s[pos] == 0)
-				{
-					if (convertSkin)
-						s[pos] = 256;
-					convertSkin = false;
-				}
-				else
-					convertSkin = true;
-
-				pos--;
-			}
-		}
-
-		for (x = 0; x < width; x++)
-		{
-			pos = x;
-			while (pos < height * width)
-			{
-				if (s[pos] == 0)
-				{
-					if (convertSkin)
-						s[pos] = 256;
-					convertSkin = false;
-				}
-				else
-					convertSkin = true;
-
-				pos += width;
-			}
-
-			pos = width * (height - 1) + x;
-			while (pos > width)
-			{
-				if (s[pos] == 0)
-				{
-					if (convertSkin)
-						s[pos] = 256;
-					convertSkin = false;
-				}
-				else
-					convertSkin = true;
-
-				pos -= width;
-			}
-		}
-	}
+	// tissue pixels within distance i4 of the background become skin
+	std::vector<float> dist(area);
+	const float* source = work_bits;
+	float* target = dist.data();
+	const double spacing[3] = {1.0, 1.0, 1.0};
+	DistanceTransform(&source, width, height, 1, spacing, [](float v) { return v == 0; }, &target, true);
 
-	//go over the std::vector and set the skin pixel at the source pointer
-	i = 0;
-	for (j = 0; j < height; j++)
+	const float radius2 = float(i4) * float(i4);
+	for (unsigned i = 0; i < area; i++)
 	{
-		for (int k = 0; k < width; k++)
-		{
-			if (s[i] == 256)
-				work_bits[i] = setto;
-			i++;
-		}
+		if (work_bits[i] != 0 && dist[i] <= radius2)
+			work_bits[i] = setto;
 	}
 }
 
@@ -13219,19 +12364,19 @@ void bmphandler::cleartissue(tissuelayers_size_t idx, tissues_size_t tissuetype)
 	}
 }
 
-void bmphandler::cap_tissue(tissues_size_t maxval)
+void bmphandler::remap_tissues(const LabelMap<tissues_size_t>& map)
 {
 	for (tissuelayers_size_t idx = 0; idx < tissuelayers.size(); ++idx)
 	{
-		tissues_size_t* tissues = tissuelayers[idx];
-		for (unsigned int i = 0; i < area; i++)
-		{
-			if (tissues[i] > maxval)
-				tissues[i] = 0;
-		}
+		remap_tissues(idx, map);
 	}
 }
 
+void bmphandler::remap_tissues(tissuelayers_size_t idx, const LabelMap<tissues_size_t>& map)
+{
+	RemapLabels(tissuelayers[idx], area, map);
+}
+
 void bmphandler::cleartissues(tissuelayers_size_t idx)
 {
 	tissues_size_t* tissues = tissuelayers[idx];
@@ -15560,56 +14705,6 @@ void bmphandler::copy2limits(std::vector<std::vector<Point>>* limits1)
 	limits = *limits1;
 }
 
-void bmphandler::map_tissue_indices(const std::vector<tissues_size_t>& indexMap)
-{
-	for (tissuelayers_size_t idx = 0; idx < tissuelayers.size(); ++idx)
-	{
-		tissues_size_t* tissues = tissuelayers[idx];
-		for (unsigned int i = 0; i < area; ++i)
-		{
-			tissues[i] = indexMap[tissues[i]];
-		}
-	}
-}
-
-void bmphandler::remove_tissue(tissues_size_t tissuenr)
-{
-	for (tissuelayers_size_t idx = 0; idx < tissuelayers.size(); ++idx)
-	{
-		tissues_size_t* tissues = tissuelayers[idx];
-		for (unsigned int i = 0; i < area; ++i)
-		{
-			if (tissues[i] > tissuenr)
-			{
-				tissues[i]--;
-			}
-			else if (tissues[i] == tissuenr)
-			{
-				tissues[i] = 0;
-			}
-		}
-	}
-}
-
-void bmphandler::group_tissues(tissuelayers_size_t idx,
-		std::vector<tissues_size_t>& olds,
-		std::vector<tissues_size_t>& news)
-{
-	tissues_size_t crossref[TISSUES_SIZE_MAX + 1];
-	for (int i = 0; i < TISSUES_SIZE_MAX + 1; i++)
-		crossref[i] = (tissues_size_t)i;
-	unsigned count = std::min(olds.size(), news.size());
-
-	for (unsigned int i = 0; i < count; i++)
-		crossref[olds[i]] = news[i];
-
-	tissues_size_t* tissues = tissuelayers[idx];
-	for (unsigned int j = 0; j < area; j++)
-	{
-		tissues[j] = crossref[tissues[j]];
-	}
-}
-
 unsigned char bmphandler::return_mode(bool bmporwork)
 {
 	if (bmporwork)
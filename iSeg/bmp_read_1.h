@@ -12,9 +12,14 @@
 #include "Data/Mark.h"
 #include "Data/Types.h"
 
+#include "Core/AnisotropicDiffusion.h"
 #include "Core/Contour.h"
+#include "Core/EdgePreservingFilter.h"
 #include "Core/FeatureExtractor.h"
+#include "Core/LabelKernels.h"
 #include "Core/Pair.h"
+#include "Core/SliceHistogramCache.h"
+#include "Core/Watershed.h"
 
 #include <list>
 #include <set>
@@ -33,22 +38,13 @@ const float f_tol = 0.00001f;
 
 typedef struct
 {
-	unsigned g;
-	unsigned r;
-	unsigned l;
-} basin;
-
-typedef struct
-{
-	unsigned k;
-	unsigned a;
-	unsigned g;
-} merge_event;
-
-typedef struct
-{
-	std::vector<basin> B;
-	std::vector<merge_event> M;
+	/// merge tree of the last watershed
+	WatershedHierarchy hierarchy;
+	/// last cut: height, (basin, label) of the marks and the resulting label of each basin
+	bool cut_valid = false;
+	unsigned cut_h = 0;
+	std::vector<std::pair<unsigned, unsigned>> cut_marks;
+	std::vector<unsigned> cut_labels;
 	std::vector<Point> marks;
 } wshed_obj;
 
@@ -98,7 +94,8 @@ public:
 	void cleartissue(tissuelayers_size_t idx, tissues_size_t tissuetype);
 	void cleartissues(tissuelayers_size_t idx);
 	void cleartissuesall();
-	void cap_tissue(tissues_size_t maxval);
+	void remap_tissues(const LabelMap<tissues_size_t>& map);
+	void remap_tissues(tissuelayers_size_t idx, const LabelMap<tissues_size_t>& map);
 	void set_bmp(float* bits, unsigned char mode);
 	void set_work(float* bits, unsigned char mode);
 	void set_tissue(tissuelayers_size_t idx, tissues_size_t* bits);
@@ -190,6 +187,8 @@ public:
 	unsigned int make_histogram(float* mask, float f, bool includeoutofrange);
 	unsigned int make_histogram(Point p, unsigned short dx, unsigned short dy, bool includeoutofrange);
 	unsigned int* return_histogram();
+	/// sets the histogram from 256 bins over [0, 256), e.g. from the cached histograms of SlicesHandler
+	unsigned int set_histogram(const Histogram& h, bool includeoutofrange);
 	float* find_modal(unsigned int thresh1, float thresh2);
 	void print_info();
 	void print_histogram();
@@ -199,6 +198,7 @@ public:
 	void threshold(float* thresholds);
 	void threshold(float* thresholds, Point p, unsigned short dx, unsigned short dy);
 	void convolute(float* mask, unsigned short direction); // x: 0, y: 1, xy: 2
+	void separable_convolute(float* mask); // x, then y
 	void scale_colors(Pair p);
 	void crop_colors();
 	void get_range(Pair* pp);
@@ -214,6 +214,7 @@ public:
 	void median_interquartile(bool median);
 	void median_interquartile(float* median, float* iq);
 	void sigmafilter(float sigma, unsigned short nx, unsigned short ny);
+	void bilateral(float sigma_space, float sigma_range);
 	void compacthist();
 	void moment_line();
 	void gauss_line(float sigma);
@@ -234,9 +235,9 @@ public:
 	void thresholded_growing(Point p, float threshfactor_low, float threshfactor_high, bool connectivity, float set_to, Pair* tp);
 	void thresholded_growing(float thresh_low, float thresh_high, bool connectivity, float* mask, float f, float set_to);
 	void distance_map(bool connectivity);
-	void distance_map(bool connectivity, float f, short unsigned levlset); //0:outside,1:inside,2:both
+	void distance_map(float f, short unsigned levlset); //0:outside,1:inside,2:both
 	void dead_reckoning();
-	unsigned* dead_reckoning(float f);
+	void dead_reckoning(float f);
 	unsigned* dead_reckoning_squared(float f);
 	void IFT_distance1(float f);
 	void erosion(int n, bool connectivity);
@@ -249,8 +250,8 @@ public:
 	void floodwork(bool* mask);
 	void floodtissue(tissuelayers_size_t idx, bool* mask);
 	void mark_border(bool connectivity);
-	void aniso_diff(float dt, int n, float (*f)(float, float), float k, float restraint);
-	void cont_anisodiff(float dt, int n, float (*f)(float, float), float k, float restraint);
+	void aniso_diff(float dt, int n, diffusion::eConductance f, float k, float restraint);
+	void cont_anisodiff(float dt, int n, diffusion::eConductance f, float k, float restraint);
 	unsigned* watershed(bool connectivity);
 	unsigned* watershed_sobel(bool connectivity);
 	void construct_regions(unsigned h, unsigned* wshed);
@@ -284,6 +285,21 @@ public:
 			std::vector<std::vector<Point>>* outer_line,
 			std::vector<std::vector<Point>>* inner_line, int minsize,
 			float disttol);
+	/// Contours of several tissues, traced from one scan of the slice, outer_lines[k] and
+	/// inner_lines[k] hold the contours of tissuetypes[k]
+	void get_tissuecontours(tissuelayers_size_t idx,
+			const std::vector<tissues_size_t>& tissuetypes,
+			std::vector<std::vector<std::vector<Point>>>& outer_lines,
+			std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize);
+	void get_tissuecontours2_xmirrored(tissuelayers_size_t idx,
+			const std::vector<tissues_size_t>& tissuetypes,
+			std::vector<std::vector<std::vector<Point>>>& outer_lines,
+			std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize);
+	void get_tissuecontours2_xmirrored(tissuelayers_size_t idx,
+			const std::vector<tissues_size_t>& tissuetypes,
+			std::vector<std::vector<std::vector<Point>>>& outer_lines,
+			std::vector<std::vector<std::vector<Point>>>& inner_lines, int minsize,
+			float disttol);
 	void get_contours(float f, std::vector<std::vector<Point>>* outer_line,
 			std::vector<std::vector<Point>>* inner_line, int minsize);
 	void get_contours(Point p, std::vector<std::vector<Point>>* outer_line,
@@ -381,11 +397,6 @@ public:
 	bool del_limit(Point p, short radius);
 	std::vector<std::vector<Point>>* return_limits();
 	void copy2limits(std::vector<std::vector<Point>>* limits1);
-	void map_tissue_indices(const std::vector<tissues_size_t>& indexMap);
-	void remove_tissue(tissues_size_t tissuenr);
-	void group_tissues(tissuelayers_size_t idx,
-			std::vector<tissues_size_t>& olds,
-			std::vector<tissues_size_t>& news);
 	unsigned char return_mode(bool bmporwork);
 	void set_mode(unsigned char mode, bool bmporwork);
 	bool print_amascii_slice(tissuelayers_size_t idx, std::ofstream& streamname);
@@ -418,14 +429,9 @@ protected:
 	inline unsigned int pt2coord(Point p);
 	float* make_gaussfilter(float sigma, int n);
 	float* make_laplacianfilter();
-	unsigned deepest_con_bas(unsigned k);
-	void cond_merge(unsigned m, unsigned h);
-	unsigned label_lookup(unsigned i, unsigned* wshed);
 	int SaveDIBitmap(const char* filename, float* p_bits);
 	int SaveRaw(const char* filename, float* p_bits);
 	void bucketsort(std::vector<unsigned int>* sorted, float* p_bits);
-	void set_marker(unsigned* wshed);
-	float base_connection(float c, std::vector<float>* maps);
 	void hysteretic_growth(float* pict, std::vector<int>* s, unsigned short w,
 			unsigned short h, bool connectivity, float set_to);
 	void hysteretic_growth(float* pict, std::vector<int>* s, unsigned short w,
@@ -463,7 +469,4 @@ private:
 	double blueFactor;
 };
 
-float f1(float dI, float k);
-float f2(float dI, float k);
-
 } // namespace iseg
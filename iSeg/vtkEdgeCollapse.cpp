@@ -39,9 +39,13 @@
 #define vtkNew(type, name) vtkSmartPointer<type> name = vtkSmartPointer<type>::New()
 
 #include <algorithm>
+#include <cstdint>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "predicates.h"
 
@@ -120,8 +124,114 @@ public:
 bool NoSelfIntersection(vtkPoints* mesh, std::vector<Triangle>& tris);
 bool NoSelfIntersection(vtkPoints* mesh, std::vector<Triangle>& changedtris,
 						std::vector<Triangle>& closetris);
+
+// Bounding volume hierarchy over the triangles of a mesh. Query is thread-safe,
+// after local changes to the mesh only the affected leaves and their ancestors are refitted.
+class TriangleBVH
+{
+public:
+	void Build(vtkPolyData* mesh);
+	void Refit(vtkPolyData* mesh, const std::vector<vtkIdType>& cells);
+	void Query(const double bounds[6], std::vector<vtkIdType>& cells) const;
+
+private:
+	struct Node
+	{
+		double box[6];
+		int left, right; // children, -1 for leaf
+		int first, count; // range in Cells (leaf)
+		int parent;
+	};
+	int BuildNode(int first, int count, int parent, std::vector<double>& centers);
+	void ComputeLeafBox(vtkPolyData* mesh, Node& node) const;
+
+	vtkPolyData* Mesh = nullptr;
+	std::vector<Node> Nodes;
+	std::vector<vtkIdType> Cells;
+	std::vector<int> Leaf; // leaf node of each cell, -1 if not in tree
+};
+
+// Garland-Heckbert quadric error metric, symmetric 4x4 matrix
+struct Quadric
+{
+	double q[10];
+
+	Quadric() { std::fill(q, q + 10, 0.0); }
+	void AddPlane(const double n[3], double d, double w)
+	{
+		q[0] += w * n[0] * n[0];
+		q[1] += w * n[0] * n[1];
+		q[2] += w * n[0] * n[2];
+		q[3] += w * n[0] * d;
+		q[4] += w * n[1] * n[1];
+		q[5] += w * n[1] * n[2];
+		q[6] += w * n[1] * d;
+		q[7] += w * n[2] * n[2];
+		q[8] += w * n[2] * d;
+		q[9] += w * d * d;
+	}
+	Quadric& operator+=(const Quadric& rhs)
+	{
+		for (int i = 0; i < 10; i++)
+			q[i] += rhs.q[i];
+		return *this;
+	}
+	double Error(const double x[3]) const
+	{
+		return x[0] * (q[0] * x[0] + 2.0 * (q[1] * x[1] + q[2] * x[2] + q[3])) +
+			   x[1] * (q[4] * x[1] + 2.0 * (q[5] * x[2] + q[6])) +
+			   x[2] * (q[7] * x[2] + 2.0 * q[8]) + q[9];
+	}
+};
 } // namespace MESH
 
+namespace {
+inline void ExpandBounds(double bounds[6], const double x[3])
+{
+	for (int d = 0; d < 3; d++)
+	{
+		bounds[2 * d] = std::min(bounds[2 * d], x[d]);
+		bounds[2 * d + 1] = std::max(bounds[2 * d + 1], x[d]);
+	}
+}
+
+inline void EmptyBounds(double bounds[6])
+{
+	for (int d = 0; d < 3; d++)
+	{
+		bounds[2 * d] = std::numeric_limits<double>::max();
+		bounds[2 * d + 1] = -std::numeric_limits<double>::max();
+	}
+}
+
+inline bool Overlap(const double a[6], const double b[6])
+{
+	return a[0] <= b[1] && b[0] <= a[1] && a[2] <= b[3] && b[2] <= a[3] &&
+		   a[4] <= b[5] && b[4] <= a[5];
+}
+
+// Candidate edge for the parallel collapse: keep is kept, remove is merged into keep
+struct CollapseCandidate
+{
+	double cost;
+	vtkIdType keep, remove;
+
+	bool operator<(const CollapseCandidate& rhs) const
+	{
+		if (cost != rhs.cost)
+			return cost < rhs.cost;
+		if (std::min(keep, remove) != std::min(rhs.keep, rhs.remove))
+			return std::min(keep, remove) < std::min(rhs.keep, rhs.remove);
+		return std::max(keep, remove) < std::max(rhs.keep, rhs.remove);
+	}
+	bool SameEdge(const CollapseCandidate& rhs) const
+	{
+		return (keep == rhs.keep && remove == rhs.remove) ||
+			   (keep == rhs.remove && remove == rhs.keep);
+	}
+};
+} // namespace
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkEdgeCollapse);
 
@@ -155,6 +265,7 @@ vtkEdgeCollapse::vtkEdgeCollapse()
 	this->UseMaximumEdgeLength = 0;
 	this->MaximumEdgeLength = VTK_DOUBLE_MAX;
 	this->MeshIsManifold = 0;
+	this->UseParallelCollapse = 0;
 	this->DomainLabelName = 0;
 	this->IntersectionCheckLevel = 2;
 	this->NumberOfClosestPoints = 30; // currently not used
@@ -275,7 +386,7 @@ int vtkEdgeCollapse::RequestData(vtkInformation* vtkNotUsed(request),
 	// Compute edges and priority for each edge
 	this->Edges->InitEdgeInsertion(numPts, 1); // storing edge id as attribute
 	this->EdgeCosts->Allocate(this->Mesh->GetPolys()->GetNumberOfCells() * 3);
-	for (i = 0; i < this->Mesh->GetNumberOfCells(); i++)
+	for (i = 0; i < this->Mesh->GetNumberOfCells() && !this->UseParallelCollapse; i++)
 	{
 		if (this->Mesh->GetCellType(i) != VTK_TRIANGLE)
 			continue;
@@ -325,6 +436,12 @@ int vtkEdgeCollapse::RequestData(vtkInformation* vtkNotUsed(request),
 		cout << "Starting edge collapse" << endl;
 	int numEdgesToCollapse = this->EdgeCosts->GetNumberOfItems() * 0.5;
 	int abort = 0, processed = 0;
+	if (this->UseParallelCollapse)
+	{
+		numDeletedTris = this->ParallelCollapseEdges();
+		this->ActualReduction = (double)numDeletedTris / numTris;
+		abort = this->GetAbortExecute();
+	}
 	edgeId = this->EdgeCosts->Pop(0, cost);
 	while (!abort && edgeId >= 0)
 	{
@@ -706,6 +823,559 @@ int vtkEdgeCollapse::CollapseEdge(vtkIdType pt0Id, vtkIdType pt1Id)
 	return numDeleted;
 }
 
+//----------------------------------------------------------------------------
+int vtkEdgeCollapse::ParallelCollapseEdges()
+{
+	const vtkIdType numPts = this->Mesh->GetNumberOfPoints();
+	const int numCells = static_cast<int>(this->Mesh->GetNumberOfCells());
+	vtkPoints* points = this->Mesh->GetPoints();
+
+	// Per-vertex quadrics from the (area weighted) planes of the incident triangles
+	std::vector<MESH::Quadric> quadrics(numPts);
+	const int num_pts = static_cast<int>(numPts);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (int i = 0; i < num_pts; i++)
+	{
+		unsigned short ncells;
+		vtkIdType *cells, npts, *pts;
+		double x0[3], x1[3], x2[3], n[3];
+		this->Mesh->GetPointCells(i, ncells, cells);
+		for (unsigned short k = 0; k < ncells; k++)
+		{
+			if (this->Mesh->GetCellType(cells[k]) != VTK_TRIANGLE)
+				continue;
+			this->Mesh->GetCellPoints(cells[k], npts, pts);
+			points->GetPoint(pts[0], x0);
+			points->GetPoint(pts[1], x1);
+			points->GetPoint(pts[2], x2);
+			vtkTriangle::ComputeNormal(x0, x1, x2, n);
+			double area = vtkTriangle::TriangleArea(x0, x1, x2);
+			quadrics[i].AddPlane(n, -vtkMath::Dot(n, x0), area);
+		}
+	}
+
+	MESH::TriangleBVH bvh;
+	if (IntersectionCheckLevel > 0)
+	{
+		bvh.Build(this->Mesh);
+	}
+
+	// Rejected edges are only tested again if the 1-ring of an end point changed
+	std::vector<int> stamp(numPts, 0);
+	std::unordered_map<std::uint64_t, std::pair<int, int>> rejected;
+	auto edge_key = [numPts](vtkIdType a, vtkIdType b) {
+		return static_cast<std::uint64_t>(std::min(a, b)) * numPts + std::max(a, b);
+	};
+
+	std::vector<CollapseCandidate> candidates;
+	std::vector<CollapseCandidate> selected;
+	std::vector<double> selected_bounds;
+	std::vector<char> result;
+	std::vector<char> locked(numPts, 0);
+	std::vector<vtkIdType> locked_ids, ring, modified;
+	std::unordered_set<std::uint64_t> occupied;
+
+	int numDeleted = 0, numInitial = -1, abort = 0;
+	while (!abort)
+	{
+		// Collect short edges, cost is the error of the combined quadric at the kept point
+		candidates.clear();
+#pragma omp parallel
+		{
+			std::vector<CollapseCandidate> local;
+			vtkIdType npts, *pts;
+			double x[3], y[3];
+
+#pragma omp for schedule(dynamic, 1024) nowait
+			for (int c = 0; c < numCells; c++)
+			{
+				if (this->Mesh->GetCellType(c) != VTK_TRIANGLE)
+					continue;
+				this->Mesh->GetCellPoints(c, npts, pts);
+				for (int j = 0; j < 3; j++)
+				{
+					vtkIdType a = pts[j], b = pts[(j + 1) % 3];
+					points->GetPoint(a, x);
+					points->GetPoint(b, y);
+					if (vtkMath::Distance2BetweenPoints(x, y) >= MinLength2)
+						continue;
+
+					auto found = rejected.find(edge_key(a, b));
+					if (found != rejected.end() &&
+						found->second == std::make_pair(stamp[std::min(a, b)], stamp[std::max(a, b)]))
+						continue;
+
+					MESH::Quadric q = quadrics[a];
+					q += quadrics[b];
+					CollapseCandidate e = {q.Error(x), a, b};
+					double cost_b = q.Error(y);
+					// keep boundary nodes, else keep the node with lower error
+					if (isboundary[b] || (!isboundary[a] && cost_b < e.cost))
+					{
+						e.cost = cost_b;
+						std::swap(e.keep, e.remove);
+					}
+					local.push_back(e);
+				}
+			}
+#pragma omp critical
+			candidates.insert(candidates.end(), local.begin(), local.end());
+		}
+		if (candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end(),
+									 [](const CollapseCandidate& l, const CollapseCandidate& r) { return l.SameEdge(r); }),
+						 candidates.end());
+		if (numInitial < 0)
+			numInitial = static_cast<int>(candidates.size());
+
+		// Greedily select edges, whose 1-rings don't overlap
+		selected.clear();
+		for (const auto& e : candidates)
+		{
+			ring.clear();
+			bool free = true;
+			for (vtkIdType p : {e.keep, e.remove})
+			{
+				unsigned short ncells;
+				vtkIdType *cells, npts, *pts;
+				this->Mesh->GetPointCells(p, ncells, cells);
+				for (unsigned short k = 0; k < ncells && free; k++)
+				{
+					this->Mesh->GetCellPoints(cells[k], npts, pts);
+					for (vtkIdType j = 0; j < npts; j++)
+					{
+						free = free && !locked[pts[j]];
+						ring.push_back(pts[j]);
+					}
+				}
+			}
+			if (!free)
+				continue;
+			for (vtkIdType p : ring)
+			{
+				locked[p] = 1;
+				locked_ids.push_back(p);
+			}
+			selected.push_back(e);
+		}
+		for (vtkIdType p : locked_ids)
+		{
+			locked[p] = 0;
+		}
+		locked_ids.clear();
+
+		// Test legality in parallel, the mesh is not modified in this phase
+		const int numSelected = static_cast<int>(selected.size());
+		result.assign(numSelected, 0);
+		selected_bounds.resize(6 * numSelected);
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int k = 0; k < numSelected; k++)
+		{
+			const auto& e = selected[k];
+			if (this->IsCollapseLegalConcurrent(e.keep, e.remove, IntersectionCheckLevel > 0 ? &bvh : nullptr))
+			{
+				result[k] = 1;
+			}
+			else if (this->IsCollapseLegalConcurrent(e.remove, e.keep, IntersectionCheckLevel > 0 ? &bvh : nullptr))
+			{
+				result[k] = 2;
+			}
+
+			// bounds of the triangles before and after the collapse
+			double* bounds = &selected_bounds[6 * k];
+			EmptyBounds(bounds);
+			unsigned short ncells;
+			vtkIdType *cells, npts, *pts;
+			double x[3];
+			for (vtkIdType p : {e.keep, e.remove})
+			{
+				this->Mesh->GetPointCells(p, ncells, cells);
+				for (unsigned short c = 0; c < ncells; c++)
+				{
+					this->Mesh->GetCellPoints(cells[c], npts, pts);
+					for (vtkIdType j = 0; j < npts; j++)
+					{
+						points->GetPoint(pts[j], x);
+						ExpandBounds(bounds, x);
+					}
+				}
+			}
+		}
+
+		// The self-intersection tests only see the mesh from before this batch, therefore
+		// collapses with overlapping bounds are deferred to the next batch.
+		const double h = std::max(2.0 * this->MinimumEdgeLength, 1e-12);
+		const int max_grid_cells = 64;
+		occupied.clear();
+		modified.clear();
+		int numApplied = 0;
+		for (int k = 0; k < numSelected; k++)
+		{
+			auto e = selected[k];
+			if (result[k] == 0)
+			{
+				rejected[edge_key(e.keep, e.remove)] =
+					std::make_pair(stamp[std::min(e.keep, e.remove)], stamp[std::max(e.keep, e.remove)]);
+				continue;
+			}
+			if (result[k] == 2)
+				std::swap(e.keep, e.remove);
+
+			const double* bounds = &selected_bounds[6 * k];
+			long long lo[3], hi[3], num_grid_cells = 1;
+			for (int d = 0; d < 3; d++)
+			{
+				lo[d] = static_cast<long long>(std::floor(bounds[2 * d] / h));
+				hi[d] = static_cast<long long>(std::floor(bounds[2 * d + 1] / h));
+				num_grid_cells *= (hi[d] - lo[d] + 1);
+			}
+			if (num_grid_cells > max_grid_cells && !occupied.empty())
+				continue;
+
+			bool conflict = false;
+			std::vector<std::uint64_t> keys;
+			for (long long gz = lo[2]; gz <= hi[2] && !conflict; gz++)
+			{
+				for (long long gy = lo[1]; gy <= hi[1] && !conflict; gy++)
+				{
+					for (long long gx = lo[0]; gx <= hi[0] && !conflict; gx++)
+					{
+						std::uint64_t key = (static_cast<std::uint64_t>(gx) & 0x1FFFFF) |
+											((static_cast<std::uint64_t>(gy) & 0x1FFFFF) << 21) |
+											((static_cast<std::uint64_t>(gz) & 0x1FFFFF) << 42);
+						conflict = occupied.count(key) != 0;
+						keys.push_back(key);
+					}
+				}
+			}
+			if (conflict)
+				continue;
+			occupied.insert(keys.begin(), keys.end());
+
+			// Apply collapse
+			unsigned short ncells;
+			vtkIdType *cells, npts, *pts;
+			this->Mesh->GetPointCells(e.remove, ncells, cells);
+			modified.insert(modified.end(), cells, cells + ncells);
+			this->Mesh->GetPointCells(e.keep, ncells, cells);
+			modified.insert(modified.end(), cells, cells + ncells);
+			for (unsigned short c = 0; c < ncells; c++)
+			{
+				this->Mesh->GetCellPoints(cells[c], npts, pts);
+				for (vtkIdType j = 0; j < npts; j++)
+					stamp[pts[j]]++;
+			}
+			this->Mesh->GetPointCells(e.remove, ncells, cells);
+			for (unsigned short c = 0; c < ncells; c++)
+			{
+				this->Mesh->GetCellPoints(cells[c], npts, pts);
+				for (vtkIdType j = 0; j < npts; j++)
+					stamp[pts[j]]++;
+			}
+
+			numDeleted += this->CollapseEdge(e.keep, e.remove);
+			quadrics[e.keep] += quadrics[e.remove];
+			this->NumberOfEdgeCollapses++;
+			numApplied++;
+		}
+
+		if (numSelected == 0)
+			break;
+
+		if (IntersectionCheckLevel > 0 && numApplied > 0)
+		{
+			bvh.Refit(this->Mesh, modified);
+		}
+
+		double myprogress = std::min(1.0, 0.25 + 0.75 * this->NumberOfEdgeCollapses / std::max(0.5 * numInitial, 1.0));
+		this->UpdateProgress(myprogress);
+		abort = this->GetAbortExecute();
+	}
+
+	return numDeleted;
+}
+
+//----------------------------------------------------------------------------
+bool vtkEdgeCollapse::IsCollapseLegalConcurrent(vtkIdType i1, vtkIdType i2,
+												const MESH::TriangleBVH* bvh)
+{ // Assumption is that i2 will be removed (moved to i1)
+	unsigned short ncells1, ncells2;
+	vtkIdType *cells1, *cells2, npts, *pts;
+	if (i1 == i2)
+		return false;
+	this->Mesh->GetPointCells(i1, ncells1, cells1);
+	this->Mesh->GetPointCells(i2, ncells2, cells2);
+	if (ncells1 == 0 || ncells2 == 0)
+		return false;
+
+	std::vector<vtkIdType> nodes_i1, nodes_i2;
+	int edge_tris = 0;
+	for (unsigned short k = 0; k < ncells1; k++)
+	{
+		this->Mesh->GetCellPoints(cells1[k], npts, pts);
+		nodes_i1.insert(nodes_i1.end(), pts, pts + npts);
+		if (std::find(pts, pts + npts, i2) != pts + npts)
+			edge_tris++;
+	}
+	if (edge_tris == 0)
+		return false;
+
+	// If both end points are on boundary then the connecting edge should be nonmanifold
+	bool nonmanifold = (edge_tris != 2);
+	if (!nonmanifold && (isboundary[i1] && isboundary[i2]))
+		return false;
+
+	// The normals of the new triangles should point more or less in the same direction as the old triangles
+	int countDegenerate = 0;
+	double normal_new[3];
+	double normal[3];
+	std::vector<MESH::Triangle> changed;
+	for (unsigned short k = 0; k < ncells2; k++)
+	{
+		this->Mesh->GetCellPoints(cells2[k], npts, pts);
+		nodes_i2.insert(nodes_i2.end(), pts, pts + npts);
+
+		vtkIdType ids[3] = {pts[0], pts[1], pts[2]};
+		for (int i = 0; i < 3; i++)
+			if (ids[i] == i2)
+				ids[i] = i1;
+		if (this->IsDegenerateTriangle(ids[0], ids[1], ids[2]))
+		{
+			countDegenerate++;
+			continue;
+		}
+
+		vtkPolygon::ComputeNormal(this->Mesh->GetPoints(), 3, ids, normal_new);
+		this->Normals->GetTuple(cells2[k], normal);
+		if (vtkMath::Dot(normal, normal_new) < NormalDotProductThreshold)
+			return false;
+		changed.push_back(MESH::Triangle(ids[0], ids[1], ids[2]));
+	}
+
+	// Only those triangles at edge i1,i2 should be degenerate
+	if (countDegenerate > edge_tris)
+		return false;
+
+	// Test if not exactly 2 nodes are connected to the edge i1,i2
+	std::sort(nodes_i1.begin(), nodes_i1.end());
+	nodes_i1.erase(std::unique(nodes_i1.begin(), nodes_i1.end()), nodes_i1.end());
+	std::sort(nodes_i2.begin(), nodes_i2.end());
+	nodes_i2.erase(std::unique(nodes_i2.begin(), nodes_i2.end()), nodes_i2.end());
+	std::vector<vtkIdType> inter;
+	std::set_intersection(nodes_i1.begin(), nodes_i1.end(), nodes_i2.begin(),
+						  nodes_i2.end(), std::back_inserter(inter));
+	if (inter.size() != 2 + edge_tris)
+		return false;
+
+	// Self-intersection test of the new triangles against each other and all nearby triangles
+	if (bvh && !changed.empty())
+	{
+		double bounds[6], x[3];
+		EmptyBounds(bounds);
+		for (const auto& tri : changed)
+		{
+			for (int id : {tri.n1, tri.n2, tri.n3})
+			{
+				this->Mesh->GetPoint(id, x);
+				ExpandBounds(bounds, x);
+			}
+		}
+
+		std::vector<vtkIdType> close_ids;
+		bvh->Query(bounds, close_ids);
+		std::vector<MESH::Triangle> close;
+		for (vtkIdType cellId : close_ids)
+		{
+			if (this->Mesh->GetCellType(cellId) != VTK_TRIANGLE)
+				continue;
+			this->Mesh->GetCellPoints(cellId, npts, pts);
+			// triangles at i2 are replaced or deleted
+			if (std::find(pts, pts + npts, i2) != pts + npts)
+				continue;
+			close.push_back(MESH::Triangle(pts[0], pts[1], pts[2]));
+		}
+		if (!MESH::NoSelfIntersection(this->Mesh->GetPoints(), changed) ||
+			!MESH::NoSelfIntersection(this->Mesh->GetPoints(), changed, close))
+			return false;
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+void MESH::TriangleBVH::Build(vtkPolyData* mesh)
+{
+	this->Mesh = mesh;
+	this->Nodes.clear();
+	this->Cells.clear();
+	this->Leaf.assign(mesh->GetNumberOfCells(), -1);
+
+	std::vector<double> centers;
+	vtkIdType npts, *pts;
+	double x[3];
+	for (vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++)
+	{
+		if (mesh->GetCellType(c) != VTK_TRIANGLE)
+			continue;
+		mesh->GetCellPoints(c, npts, pts);
+		double center[3] = {0, 0, 0};
+		for (vtkIdType j = 0; j < npts; j++)
+		{
+			mesh->GetPoint(pts[j], x);
+			for (int d = 0; d < 3; d++)
+				center[d] += x[d] / npts;
+		}
+		this->Cells.push_back(c);
+		centers.insert(centers.end(), center, center + 3);
+	}
+
+	if (!this->Cells.empty())
+	{
+		this->Nodes.reserve(this->Cells.size());
+		this->BuildNode(0, static_cast<int>(this->Cells.size()), -1, centers);
+	}
+}
+
+int MESH::TriangleBVH::BuildNode(int first, int count, int parent,
+								 std::vector<double>& centers)
+{
+	const int max_leaf_size = 4;
+	int id = static_cast<int>(this->Nodes.size());
+	Node node = {{0, 0, 0, 0, 0, 0}, -1, -1, first, count, parent};
+	this->Nodes.push_back(node);
+
+	if (count <= max_leaf_size)
+	{
+		for (int i = first; i < first + count; i++)
+			this->Leaf[this->Cells[i]] = id;
+		this->ComputeLeafBox(this->Mesh, this->Nodes[id]);
+		return id;
+	}
+
+	// median split along largest extent of the triangle centers
+	double cbox[6];
+	EmptyBounds(cbox);
+	for (int i = first; i < first + count; i++)
+		ExpandBounds(cbox, &centers[3 * i]);
+	int axis = 0;
+	for (int d = 1; d < 3; d++)
+	{
+		if (cbox[2 * d + 1] - cbox[2 * d] > cbox[2 * axis + 1] - cbox[2 * axis])
+			axis = d;
+	}
+
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++)
+		order[i] = first + i;
+	int half = count / 2;
+	std::nth_element(order.begin(), order.begin() + half, order.end(),
+					 [&centers, axis](int l, int r) { return centers[3 * l + axis] < centers[3 * r + axis]; });
+	std::vector<vtkIdType> cells(count);
+	std::vector<double> ctrs(3 * count);
+	for (int i = 0; i < count; i++)
+	{
+		cells[i] = this->Cells[order[i]];
+		std::copy(&centers[3 * order[i]], &centers[3 * order[i]] + 3, &ctrs[3 * i]);
+	}
+	std::copy(cells.begin(), cells.end(), this->Cells.begin() + first);
+	std::copy(ctrs.begin(), ctrs.end(), centers.begin() + 3 * first);
+
+	int left = this->BuildNode(first, half, id, centers);
+	int right = this->BuildNode(first + half, count - half, id, centers);
+	Node& n = this->Nodes[id];
+	n.left = left;
+	n.right = right;
+	for (int d = 0; d < 3; d++)
+	{
+		n.box[2 * d] = std::min(this->Nodes[left].box[2 * d], this->Nodes[right].box[2 * d]);
+		n.box[2 * d + 1] = std::max(this->Nodes[left].box[2 * d + 1], this->Nodes[right].box[2 * d + 1]);
+	}
+	return id;
+}
+
+void MESH::TriangleBVH::ComputeLeafBox(vtkPolyData* mesh, Node& node) const
+{
+	vtkIdType npts, *pts;
+	double x[3];
+	EmptyBounds(node.box);
+	for (int i = node.first; i < node.first + node.count; i++)
+	{
+		vtkIdType c = this->Cells[i];
+		if (mesh->GetCellType(c) != VTK_TRIANGLE)
+			continue;
+		mesh->GetCellPoints(c, npts, pts);
+		for (vtkIdType j = 0; j < npts; j++)
+		{
+			mesh->GetPoint(pts[j], x);
+			ExpandBounds(node.box, x);
+		}
+	}
+}
+
+void MESH::TriangleBVH::Refit(vtkPolyData* mesh, const std::vector<vtkIdType>& cells)
+{
+	// cells are only modified or deleted, never added
+	std::vector<int> dirty;
+	for (vtkIdType c : cells)
+	{
+		if (c < static_cast<vtkIdType>(this->Leaf.size()) && this->Leaf[c] >= 0)
+			dirty.push_back(this->Leaf[c]);
+	}
+	std::sort(dirty.begin(), dirty.end());
+	dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+	std::vector<int> ancestors;
+	for (int id : dirty)
+	{
+		this->ComputeLeafBox(mesh, this->Nodes[id]);
+		for (int p = this->Nodes[id].parent; p >= 0; p = this->Nodes[p].parent)
+			ancestors.push_back(p);
+	}
+	std::sort(ancestors.begin(), ancestors.end());
+	ancestors.erase(std::unique(ancestors.begin(), ancestors.end()), ancestors.end());
+
+	// nodes are created depth-first, i.e. children have larger ids than their parent
+	for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it)
+	{
+		Node& n = this->Nodes[*it];
+		const Node& l = this->Nodes[n.left];
+		const Node& r = this->Nodes[n.right];
+		for (int d = 0; d < 3; d++)
+		{
+			n.box[2 * d] = std::min(l.box[2 * d], r.box[2 * d]);
+			n.box[2 * d + 1] = std::max(l.box[2 * d + 1], r.box[2 * d + 1]);
+		}
+	}
+}
+
+void MESH::TriangleBVH::Query(const double bounds[6], std::vector<vtkIdType>& cells) const
+{
+	if (this->Nodes.empty())
+		return;
+
+	std::vector<int> stack(1, 0);
+	while (!stack.empty())
+	{
+		const Node& n = this->Nodes[stack.back()];
+		stack.pop_back();
+		if (!Overlap(n.box, bounds))
+			continue;
+		if (n.left < 0)
+		{
+			cells.insert(cells.end(), this->Cells.begin() + n.first,
+						 this->Cells.begin() + n.first + n.count);
+		}
+		else
+		{
+			stack.push_back(n.left);
+			stack.push_back(n.right);
+		}
+	}
+}
+
 //----------------------------------------------------------------------------
 // FIXME: memory allocation clean up
 void vtkEdgeCollapse::UpdateEdgeData(vtkIdType pt0Id, vtkIdType pt1Id)
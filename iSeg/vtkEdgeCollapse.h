@@ -23,6 +23,12 @@ class vtkGenericCell;
 class vtkAbstractCellLocator;
 class vtkFloatArray;
 
+//BTX
+namespace MESH {
+class TriangleBVH;
+}
+//ETX
+
 /**
 This filter implements a strategy to collapse edges in a surface mesh. Optionally it can flip the edges 
 after collapsing in order to improve the angles. Maybe more important is the feature that self-intersection
@@ -43,6 +49,12 @@ Options:
 
 - IntersectionCheckLevel: self-intersections can occur due to collapsing/flipping edges. This can be avoided by increasing this parameter.
 
+- UseParallelCollapse: default=0, instead of collapsing one edge at a time from a global priority queue, 
+  independent sets of edges (no shared 1-ring) are collapsed in batches. Edges are ordered by a quadric error metric,
+  the per-vertex quadrics are cached and accumulated on collapse. The legality tests of a batch run in parallel, 
+  and self-intersection tests (any IntersectionCheckLevel > 0) query a bounding volume hierarchy of the triangles, 
+  which is refitted locally after each batch.
+
  */
 class vtkEdgeCollapse : public vtkPolyDataAlgorithm
 {
@@ -87,6 +99,11 @@ public:
 	vtkSetMacro(MaximumEdgeLength, double);
 	vtkGetMacro(MaximumEdgeLength, double);
 
+	// Collapse independent sets of edges in parallel batches: Default Off
+	vtkSetMacro(UseParallelCollapse, int);
+	vtkGetMacro(UseParallelCollapse, int);
+	vtkBooleanMacro(UseParallelCollapse, int);
+
 	// Assume the mesh is closed and manifold or not. More checks are done if you set MeshIsManifold ot off
 	vtkSetMacro(MeshIsManifold, int);
 	vtkGetMacro(MeshIsManifold, int);
@@ -128,6 +145,14 @@ protected:
 	// Do edge collapse (p2Id is removed)
 	int CollapseEdge(vtkIdType p1Id, vtkIdType p2Id);
 
+	// Collapse edges in batches of independent edges, returns number of deleted triangles
+	int ParallelCollapseEdges();
+
+	// Variant of IsCollapseLegal, which only reads the mesh and can be called concurrently.
+	// The self-intersection test uses all triangles in the bvh, which are close to the new triangles.
+	bool IsCollapseLegalConcurrent(vtkIdType p1Id, vtkIdType p2Id,
+																 const MESH::TriangleBVH *bvh);
+
 	// Helper function
 	bool IsDegenerateTriangle(vtkIdType i0, vtkIdType i1, vtkIdType i2);
 
@@ -168,6 +193,7 @@ protected:
 	int UseMaximumEdgeLength;
 	double MaximumEdgeLength;
 	int MeshIsManifold;
+	int UseParallelCollapse;
 	int Loud;
 	int IntersectionCheckLevel;
 	int NumberOfClosestPoints;
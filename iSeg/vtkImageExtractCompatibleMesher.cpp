@@ -13,14 +13,20 @@
 #include "vtkTemplateTriangulator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <ctime>
 #include <map>
 #include <set>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
+#ifndef NO_OPENMP_SUPPORT
+#	include <omp.h>
+#endif
+
 #include <vtkExecutive.h>
 #include <vtkInformation.h>
 #include <vtkInformationVector.h>
@@ -28,6 +34,7 @@
 
 #include <vtkCellArray.h>
 #include <vtkCellData.h>
+#include <vtkFloatArray.h>
 #include <vtkIdList.h>
 #include <vtkImageData.h>
 #include <vtkIntArray.h>
@@ -389,6 +396,72 @@ private:
 	std::vector<TetNeighbors> neighbors;
 };
 
+/**	Points are identified by their position on a lattice with 1/36 voxel
+	resolution. The templates create edge centers (1/2), face centers (1/3) and
+	tetrahedron centers (1/4) of voxel corners, and prism Steiner points, which
+	average 6 of these points and therefore lie on a 1/12 or, for prisms with
+	face centers, a 1/36 grid. With 21 bits per axis this limits the image to
+	58254 voxels per dimension. Since the templates choose
+	diagonals based on point ids, using the lattice position as id makes the
+	tetrahedra of a voxel independent of the order in which voxels are processed.
+*/
+class vtkMesherLattice
+{
+public:
+	enum { Resolution = 36, Bits = 21 };
+
+	vtkMesherLattice(vtkImageData* image)
+	{
+		int extent[6];
+		image->GetDimensions(Dims);
+		image->GetSpacing(Spacing);
+		image->GetOrigin(Origin);
+		image->GetExtent(extent);
+		for (int i = 0; i < 3; i++)
+		{
+			Origin[i] += extent[2 * i] * Spacing[i];
+		}
+		ExtOffset = extent[0] + extent[2] + extent[4];
+	}
+
+	bool IsValid() const
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (static_cast<vtkIdType>(Dims[i]) * Resolution >= (vtkIdType(1) << Bits))
+				return false;
+		}
+		return true;
+	}
+
+	vtkIdType Key(const double x[3]) const
+	{
+		vtkIdType key = 0;
+		for (int i = 2; i >= 0; i--)
+		{
+			key = (key << Bits) | static_cast<vtkIdType>(std::llround((x[i] - Origin[i]) / Spacing[i] * Resolution));
+		}
+		return key;
+	}
+
+	void Point(vtkIdType key, double x[3]) const
+	{
+		const vtkIdType mask = (vtkIdType(1) << Bits) - 1;
+		for (int i = 0; i < 3; i++)
+		{
+			x[i] = Origin[i] + Spacing[i] * static_cast<double>((key >> (i * Bits)) & mask) / Resolution;
+		}
+	}
+
+	/// z coordinate in lattice units
+	vtkIdType Layer(vtkIdType key) const { return key >> (2 * Bits); }
+
+	int Dims[3];
+	int ExtOffset;
+	double Spacing[3];
+	double Origin[3];
+};
+
 class vtkTriangulatorImpl : public vtkTemplateTriangulator
 {
 public:
@@ -402,37 +475,33 @@ public:
 	/// Override
 	void GetPoint(vtkIdType v, double p[3]) override
 	{
-		assert(Points != nullptr);
-		assert(v >= 0 && v < Points->GetNumberOfPoints());
-		Points->GetPoint(v, p);
+		assert(Lattice != nullptr);
+		Lattice->Point(v, p);
 	}
 
 	/// Override
 	virtual vtkIdType AddPoint(double x, double y, double z) override
 	{
-		assert(Locator != nullptr);
+		assert(Lattice != nullptr);
 		double p[3] = {x, y, z};
-		vtkIdType ptId;
-		Locator->InsertUniquePoint(p, ptId);
-		return ptId;
+		return Lattice->Key(p);
 	}
 
 	/// Override
 	virtual void AddTetrahedron(vtkIdType v1, vtkIdType v2, vtkIdType v3,
 								vtkIdType v4, int domain) override
 	{
-		assert(Tetrahedra);
-		assert(CellDomainArray);
-		assert(Tetrahedra->GetNumberOfTetrahedra() ==
-			   CellDomainArray->GetNumberOfTuples());
-		Tetrahedra->push_back(v1, v2, v3, v4);
-		CellDomainArray->InsertNextValue(domain);
+		assert(TetKeys && Domains);
+		TetKeys->push_back(v1);
+		TetKeys->push_back(v2);
+		TetKeys->push_back(v3);
+		TetKeys->push_back(v4);
+		Domains->push_back(static_cast<short>(domain));
 	}
 
-	vtkIncrementalPointLocator* Locator;
-	vtkPoints* Points;
-	TetContainer* Tetrahedra;
-	vtkShortArray* CellDomainArray;
+	const vtkMesherLattice* Lattice = nullptr;
+	std::vector<vtkIdType>* TetKeys = nullptr;
+	std::vector<short>* Domains = nullptr;
 
 protected:
 	vtkTriangulatorImpl() {}
@@ -441,6 +510,29 @@ protected:
 
 vtkStandardNewMacro(vtkTriangulatorImpl);
 
+/// Thread local data of a z-slab of voxels
+class vtkMesherSlab
+{
+public:
+	int K0, K1; // voxel layers [K0, K1)
+	const vtkMesherLattice* Lattice;
+	vtkSmartPointer<vtkOrderedTriangulator> Triangulator;
+	vtkSmartPointer<vtkTriangulatorImpl> MyTriangulator;
+	vtkSmartPointer<vtkCellArray> Connectivity;
+
+	// tetrahedra in traversal order, with lattice keys as point ids
+	std::vector<vtkIdType> TetKeys;
+	std::vector<short> Domains;
+
+	// tetrahedra with slab local point ids, numbered by first appearance
+	std::vector<IDType> Tets;
+	std::vector<vtkIdType> UniqueKeys;
+
+	// global point ids, and whether the point was first used by this slab
+	std::vector<IDType> GlobalIds;
+	std::vector<char> Owned;
+};
+
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkImageExtractCompatibleMesher);
 
@@ -456,7 +548,6 @@ vtkImageExtractCompatibleMesher::vtkImageExtractCompatibleMesher()
 	this->MaxNumberOfIterations = 10;
 	this->BackgroundLabel = 0;
 	this->UseTemplates = true;
-	this->UseOctreeLocator = true;
 	this->OutputScalarName = 0;
 	this->SetOutputScalarName("Material");
 	this->GenerateTetMeshOutput = false;
@@ -539,73 +630,7 @@ int vtkImageExtractCompatibleMesher::ContourSurface(
 		vtkErrorMacro(<< "Cannot run with zero cells");
 		return 1;
 	}
-	vtkIdType estimatedSize = this->Input->GetNumberOfCells();
-	estimatedSize = estimatedSize / 1024 * 1024; //multiple of 1024
-	if (estimatedSize < 1024)
-	{
-		estimatedSize = 1024;
-	}
-	this->Points = vtkPoints::New();
-	Points->SetDataTypeToFloat();
-	Points->Allocate(estimatedSize / 2, estimatedSize / 2);
-	if (this->UseOctreeLocator)
-	{
-		vtkIncrementalOctreePointLocator* loc =
-			vtkIncrementalOctreePointLocator::New();
-		loc->SetTolerance(0.0);
-		loc->SetMaxLevel(12); // does this have any effect?
-		// loc->SetMaxPointsPerLeaf(128);
-		this->Locator = loc;
-	}
-	else
-	{
-		vtkMergePoints* loc = vtkMergePoints::New();
-		int div[3];
-		this->Input->GetDimensions(div);
-		div[0] = std::max(div[0] / 7, 50);
-		div[1] = std::max(div[1] / 7, 50);
-		div[2] = std::max(div[2] / 7, 50);
-		loc->SetDivisions(div);
-		loc->SetMaxLevel(12); // does this have any effect?
-		this->Locator = loc;
-	}
-	this->Locator->InitPointInsertion(Points, this->Input->GetBounds());
-	this->Connectivity = vtkCellArray::New();
-	this->Tetrahedra = new TetContainer(estimatedSize, estimatedSize / 2);
-
-	this->CellDomainArray = vtkShortArray::New();
-	this->CellDomainArray->SetName(this->OutputScalarName);
-	this->CellDomainArray->SetNumberOfComponents(1);
-	this->PointDomainArray = vtkShortArray::New();
-	this->PointDomainArray->SetName(this->OutputScalarName);
-	this->Triangulator = vtkOrderedTriangulator::New();
-	this->Triangulator->PreSortedOn();
-	this->Triangulator->UseTwoSortIdsOn();
-	this->Triangulator->SetUseTemplates(this->UseTemplates);
-
-	MyTriangulator = vtkTriangulatorImpl::New();
-	MyTriangulator->CellDomainArray = CellDomainArray;
-	MyTriangulator->Locator = Locator;
-	MyTriangulator->Points = Points;
-	MyTriangulator->Tetrahedra = Tetrahedra;
-
-	int dims[3];
-	double spacing[3], origin[3];
-	this->Input->GetDimensions(dims);
-	this->Input->GetOrigin(origin);
-	this->Input->GetSpacing(spacing);
-
-	vtkIdType numICells = dims[0] - 1;
-	vtkIdType numJCells = dims[1] - 1;
-	vtkIdType numKCells = dims[2] - 1;
-	vtkIdType sliceSize = numICells * numJCells;
-	vtkIdType extOffset = this->Input->GetExtent()[0] +
-						  this->Input->GetExtent()[2] +
-						  this->Input->GetExtent()[4];
 
-	vtkPoints* cellPts;
-	vtkIdList* cellIds;
-	vtkGenericCell* cell = vtkGenericCell::New();
 	this->ClipScalars = this->GetInputArrayToProcess(0, inputVector);
 	if (!this->ClipScalars)
 	{
@@ -617,76 +642,146 @@ int vtkImageExtractCompatibleMesher::ContourSurface(
 			return 1;
 		}
 	}
-	vtkShortArray* cellScalars = vtkShortArray::New();
-	cellScalars->SetNumberOfComponents(1);
-	cellScalars->SetNumberOfTuples(8);
 
-	// Traverse through all all voxels, compute tetrahedra on the go
-	int abort = 0;
-	for (vtkIdType k = 0; k < numKCells && !abort; k++)
+	vtkMesherLattice lattice(this->Input);
+	if (!lattice.IsValid())
 	{
-		// Check for progress and abort on every z-slice
-		this->UpdateProgress(static_cast<double>(k) / numKCells);
-		abort = this->GetAbortExecute();
-		for (vtkIdType j = 0; j < numJCells; j++)
+		vtkErrorMacro(<< "Image is too large");
+		return 1;
+	}
+
+	// The volume is partitioned into z-slabs, which are meshed concurrently.
+	// Several slabs per thread are used for load balancing.
+#ifdef NO_OPENMP_SUPPORT
+	const int numberThreads = 1;
+#else
+	const int numberThreads = omp_get_max_threads();
+#endif
+	const int numKCells = lattice.Dims[2] - 1;
+	const int numSlabs = std::max(1, std::min(numKCells, 4 * numberThreads));
+	std::vector<vtkMesherSlab> slabs(numSlabs);
+	for (int s = 0; s < numSlabs; s++)
+	{
+		slabs[s].K0 = static_cast<int>(static_cast<vtkIdType>(s) * numKCells / numSlabs);
+		slabs[s].K1 = static_cast<int>(static_cast<vtkIdType>(s + 1) * numKCells / numSlabs);
+		slabs[s].Lattice = &lattice;
+	}
+
+	std::atomic<int> slabsDone(0);
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < numSlabs; s++)
+	{
+		// Check for abort on every slab
+		if (this->GetAbortExecute())
 		{
-			for (vtkIdType i = 0; i < numICells; i++)
-			{
-				int flip = (extOffset + i + j + k) & 0x1;
-				vtkIdType cellId = i + j * numICells + k * sliceSize;
+			continue;
+		}
 
-				this->Input->GetCell(cellId, cell);
-				if (cell->GetCellType() == VTK_EMPTY_CELL)
-				{
-					continue;
-				}
-				cellPts = cell->GetPoints();
-				cellIds = cell->GetPointIds();
+		this->MeshSlab(slabs[s]);
 
-				// Check if this cell is at surface/interface
-				bool isClipped = false;
-				int s0 = this->ClipScalars->GetComponent(cellIds->GetId(0), 0);
-				for (int ii = 0; ii < 8; ii++)
-				{
-					int s =
-						this->ClipScalars->GetComponent(cellIds->GetId(ii), 0);
-					cellScalars->SetValue(ii, s);
-					if (s != s0)
-					{
-						isClipped = true;
-					}
-				}
+		int done = ++slabsDone;
+#ifndef NO_OPENMP_SUPPORT
+		if (omp_get_thread_num() == 0)
+#endif
+		{
+			this->UpdateProgress(0.5 * done / numSlabs);
+		}
+	}
 
-				//
-				if (isClipped == true)
-				{
-					this->ClipVoxel(cellScalars, flip, spacing, cellIds,
-									cellPts);
-				}
-				else if (s0 != this->BackgroundLabel)
-				{
-					this->TriangulateVoxel(s0, flip, spacing, cellIds, cellPts);
-				}
+	if (this->GetAbortExecute())
+	{
+		this->Input = nullptr;
+		this->ClipScalars = nullptr;
+		return 1;
+	}
+
+	// Merge slabs: points are numbered in order of first appearance, as in a
+	// serial traversal. Slabs only share points on the plane between them.
+	size_t numPoints = 0, numTets = 0;
+	std::unordered_map<vtkIdType, IDType> boundary, nextBoundary;
+	for (auto& slab : slabs)
+	{
+		const vtkIdType bottom = static_cast<vtkIdType>(slab.K0) * vtkMesherLattice::Resolution;
+		const vtkIdType top = static_cast<vtkIdType>(slab.K1) * vtkMesherLattice::Resolution;
+
+		slab.GlobalIds.resize(slab.UniqueKeys.size());
+		slab.Owned.assign(slab.UniqueKeys.size(), 1);
+		for (size_t l = 0; l < slab.UniqueKeys.size(); l++)
+		{
+			const vtkIdType key = slab.UniqueKeys[l];
+			const vtkIdType layer = lattice.Layer(key);
+
+			std::unordered_map<vtkIdType, IDType>::const_iterator found;
+			if (layer == bottom && (found = boundary.find(key)) != boundary.end())
+			{
+				slab.GlobalIds[l] = found->second;
+				slab.Owned[l] = 0;
+			}
+			else
+			{
+				slab.GlobalIds[l] = static_cast<IDType>(numPoints++);
+			}
+
+			if (layer == top)
+			{
+				nextBoundary[key] = slab.GlobalIds[l];
 			}
 		}
-		if (k % 10 == 0)
+		boundary.swap(nextBoundary);
+		nextBoundary.clear();
+
+		numTets += slab.Domains.size();
+	}
+
+	if (numPoints >= VTK_UNSIGNED_INT_MAX || numTets >= VTK_UNSIGNED_INT_MAX)
+	{
+		vtkErrorMacro(<< "Too many points or tetrahedra");
+		this->Input = nullptr;
+		this->ClipScalars = nullptr;
+		return 1;
+	}
+
+	this->Points = vtkPoints::New();
+	this->Points->SetDataTypeToFloat();
+	this->Points->SetNumberOfPoints(static_cast<vtkIdType>(numPoints));
+	float* pointsData = vtkFloatArray::SafeDownCast(this->Points->GetData())->GetPointer(0);
+#pragma omp parallel for
+	for (int s = 0; s < numSlabs; s++)
+	{
+		const auto& slab = slabs[s];
+		double x[3];
+		for (size_t l = 0; l < slab.UniqueKeys.size(); l++)
 		{
-			std::cerr << "Time for full voxels: " << Timer<1>::EllapsedTime()
-					  << std::endl;
-			std::cerr << "Time for clipped voxels: " << Timer<2>::EllapsedTime()
-					  << std::endl;
+			if (slab.Owned[l])
+			{
+				lattice.Point(slab.UniqueKeys[l], x);
+				float* p = pointsData + 3 * static_cast<size_t>(slab.GlobalIds[l]);
+				p[0] = static_cast<float>(x[0]);
+				p[1] = static_cast<float>(x[1]);
+				p[2] = static_cast<float>(x[2]);
+			}
 		}
 	}
-	std::cerr << "Final Time for full voxels: " << Timer<1>::EllapsedTime()
-			  << std::endl;
-	std::cerr << "Final Time for clipped voxels: " << Timer<2>::EllapsedTime()
-			  << std::endl;
 
-	// Start cleaning up
-	this->Triangulator->Delete();
-	this->Locator->Delete();
-	cell->Delete();
-	cellScalars->Delete();
+	this->Tetrahedra = new TetContainer(numTets + 1, 1024);
+	this->CellDomainArray = vtkShortArray::New();
+	this->CellDomainArray->SetName(this->OutputScalarName);
+	this->CellDomainArray->SetNumberOfComponents(1);
+	this->CellDomainArray->SetNumberOfTuples(static_cast<vtkIdType>(numTets));
+	vtkIdType cellId = 0;
+	for (auto& slab : slabs)
+	{
+		const auto& ids = slab.GlobalIds;
+		for (size_t t = 0; t < slab.Domains.size(); t++, cellId++)
+		{
+			const IDType* tet = &slab.Tets[4 * t];
+			this->Tetrahedra->push_back(ids[tet[0]], ids[tet[1]], ids[tet[2]], ids[tet[3]]);
+			this->CellDomainArray->SetValue(cellId, slab.Domains[t]);
+		}
+		std::vector<IDType>().swap(slab.Tets);
+		std::vector<short>().swap(slab.Domains);
+	}
+	slabs.clear();
 
 	std::cerr << "Number of tetra: "
 			  << this->Tetrahedra->GetNumberOfTetrahedra() << std::endl;
@@ -712,14 +807,114 @@ int vtkImageExtractCompatibleMesher::ContourSurface(
 	// Cleanup
 	this->Input = nullptr;
 	this->Points->Delete();
-	this->Connectivity->Delete();
+	this->Points = nullptr;
 	this->CellDomainArray->Delete();
+	this->CellDomainArray = nullptr;
 	this->ClipScalars = nullptr;
 	delete this->Tetrahedra;
+	this->Tetrahedra = nullptr;
 
 	return 1;
 }
 
+void vtkImageExtractCompatibleMesher::MeshSlab(vtkMesherSlab& slab)
+{
+	const vtkMesherLattice& lattice = *slab.Lattice;
+
+	slab.Triangulator = vtkSmartPointer<vtkOrderedTriangulator>::New();
+	slab.Triangulator->PreSortedOn();
+	slab.Triangulator->UseTwoSortIdsOn();
+	slab.Triangulator->SetUseTemplates(this->UseTemplates);
+	slab.Connectivity = vtkSmartPointer<vtkCellArray>::New();
+	slab.MyTriangulator = vtkSmartPointer<vtkTriangulatorImpl>::New();
+	slab.MyTriangulator->Lattice = &lattice;
+	slab.MyTriangulator->TetKeys = &slab.TetKeys;
+	slab.MyTriangulator->Domains = &slab.Domains;
+
+	const vtkIdType dimX = lattice.Dims[0];
+	const vtkIdType dimXY = dimX * lattice.Dims[1];
+	const vtkIdType numICells = lattice.Dims[0] - 1;
+	const vtkIdType numJCells = lattice.Dims[1] - 1;
+	const vtkIdType sliceSize = numICells * numJCells;
+
+	// corners in vtkVoxel order
+	vtkIdType cornerOffsets[8];
+	for (int n = 0; n < 8; n++)
+	{
+		cornerOffsets[n] = (n & 0x1) + ((n >> 1) & 0x1) * dimX + ((n >> 2) & 0x1) * dimXY;
+	}
+
+	short cellScalars[8];
+	double cellPts[8][3];
+	for (vtkIdType k = slab.K0; k < slab.K1; k++)
+	{
+		for (vtkIdType j = 0; j < numJCells; j++)
+		{
+			for (vtkIdType i = 0; i < numICells; i++)
+			{
+				vtkIdType cellId = i + j * numICells + k * sliceSize;
+				if (!this->Input->IsCellVisible(cellId))
+				{
+					continue;
+				}
+				int flip = (lattice.ExtOffset + i + j + k) & 0x1;
+
+				// Check if this cell is at surface/interface
+				const vtkIdType ptId0 = i + j * dimX + k * dimXY;
+				bool isClipped = false;
+				int s0 = static_cast<int>(this->ClipScalars->GetComponent(ptId0, 0));
+				for (int ii = 0; ii < 8; ii++)
+				{
+					int s = static_cast<int>(this->ClipScalars->GetComponent(ptId0 + cornerOffsets[ii], 0));
+					cellScalars[ii] = static_cast<short>(s);
+					if (s != s0)
+					{
+						isClipped = true;
+					}
+				}
+				if (!isClipped && s0 == this->BackgroundLabel)
+				{
+					continue;
+				}
+
+				for (int ii = 0; ii < 8; ii++)
+				{
+					cellPts[ii][0] = lattice.Origin[0] + (i + (ii & 0x1)) * lattice.Spacing[0];
+					cellPts[ii][1] = lattice.Origin[1] + (j + ((ii >> 1) & 0x1)) * lattice.Spacing[1];
+					cellPts[ii][2] = lattice.Origin[2] + (k + ((ii >> 2) & 0x1)) * lattice.Spacing[2];
+				}
+
+				if (isClipped)
+				{
+					this->ClipVoxel(slab, cellScalars, flip, cellPts);
+				}
+				else
+				{
+					this->TriangulateVoxel(slab, s0, flip, cellPts);
+				}
+			}
+		}
+	}
+
+	slab.Triangulator = nullptr;
+	slab.MyTriangulator = nullptr;
+	slab.Connectivity = nullptr;
+
+	// number points of this slab in order of first appearance
+	std::unordered_map<vtkIdType, IDType> localIds;
+	slab.Tets.resize(slab.TetKeys.size());
+	for (size_t n = 0; n < slab.TetKeys.size(); n++)
+	{
+		auto inserted = localIds.insert(std::make_pair(slab.TetKeys[n], static_cast<IDType>(slab.UniqueKeys.size())));
+		if (inserted.second)
+		{
+			slab.UniqueKeys.push_back(slab.TetKeys[n]);
+		}
+		slab.Tets[n] = inserted.first->second;
+	}
+	std::vector<vtkIdType>().swap(slab.TetKeys);
+}
+
 // Method to triangulate and clip voxel using ordered Delaunay
 // triangulation to produce tetrahedra. Voxel is initially triangulated
 // using 8 voxel corner points inserted in order (to control direction
@@ -861,16 +1056,13 @@ void vtkImageExtractCompatibleMesher::ClipVoxel_not_used(
 	}
 }
 
-void vtkImageExtractCompatibleMesher::ClipVoxel(vtkShortArray* cellScalars,
-												int flip, double spacing[3],
-												vtkIdList* cellIds,
-												vtkPoints* cellPts)
+void vtkImageExtractCompatibleMesher::ClipVoxel(vtkMesherSlab& slab,
+												const short cellScalars[8],
+												int flip, double cellPts[8][3])
 {
-	Timer<2> timer;
-
-	double x[3], voxelOrigin[3];
 	double bounds[6];
-	vtkIdType id, ptId;
+	vtkIdType ptId;
+	vtkIdType ids[8];
 	static int order_flip[2][8] = {
 		{0, 3, 5, 6, 1, 2, 4, 7},
 		{1, 2, 4, 7, 0, 3, 5, 6}}; //injection order based on flip
@@ -878,16 +1070,15 @@ void vtkImageExtractCompatibleMesher::ClipVoxel(vtkShortArray* cellScalars,
 								  4, 5, 6, 7}; //injection order without flip
 
 	// compute bounds for voxel and initialize
-	cellPts->GetPoint(0, voxelOrigin);
 	for (int i = 0; i < 3; i++)
 	{
-		bounds[2 * i] = voxelOrigin[i];
-		bounds[2 * i + 1] = voxelOrigin[i] + spacing[i];
+		bounds[2 * i] = cellPts[0][i];
+		bounds[2 * i + 1] = cellPts[7][i];
 	}
 
 	// Initialize Delaunay insertion process with voxel triangulation.
 	// No more than 8 points (8 corners) may be inserted.
-	this->Triangulator->InitTriangulation(bounds, 8);
+	slab.Triangulator->InitTriangulation(bounds, 8);
 
 	// Inject ordered voxel corner points into triangulation. Recall
 	// that the PreSortedOn() flag was set in the triangulator.
@@ -898,50 +1089,43 @@ void vtkImageExtractCompatibleMesher::ClipVoxel(vtkShortArray* cellScalars,
 		else
 			ptId = order_noflip[numPts];
 
-		cellPts->GetPoint(ptId, x);
-		if (this->Locator->InsertUniquePoint(x, id))
-		{
-			this->PointDomainArray->InsertValue(id,
-												cellScalars->GetValue(ptId));
-		}
-		this->Triangulator->InsertPoint(id, id, 0 /*cellScalar*/, x, x, 0);
+		ids[ptId] = slab.Lattice->Key(cellPts[ptId]);
+		slab.Triangulator->InsertPoint(ids[ptId], ids[ptId], 0 /*cellScalar*/,
+									   cellPts[ptId], cellPts[ptId], 0);
 	}
 
 	// triangulate the points
 	if (UseTemplates)
-		this->Triangulator->TemplateTriangulate(VTK_NUMBER_OF_CELL_TYPES + flip,
-												8, 12);
+		slab.Triangulator->TemplateTriangulate(VTK_NUMBER_OF_CELL_TYPES + flip,
+											   8, 12);
 	else
-		this->Triangulator->Triangulate();
+		slab.Triangulator->Triangulate();
 
 	// Add the triangulation to the mesh
-	this->Connectivity->Initialize();
-	this->Triangulator->AddTetras(0, this->Connectivity);
-	vtkIdType numNew = this->Connectivity->GetNumberOfCells();
+	slab.Connectivity->Initialize();
+	slab.Triangulator->AddTetras(0, slab.Connectivity);
+	vtkIdType numNew = slab.Connectivity->GetNumberOfCells();
 
 	vtkIdType npts, *pts;
-	this->Connectivity->InitTraversal();
+	slab.Connectivity->InitTraversal();
 	for (vtkIdType i = 0; i < numNew; i++)
 	{
-		this->Connectivity->GetNextCell(npts, pts);
+		slab.Connectivity->GetNextCell(npts, pts);
 
 		// now check colors at nodes and subdivide the tetrahedra accordingly
-		int doms[4] = {PointDomainArray->GetValue(pts[0]),
-					   PointDomainArray->GetValue(pts[1]),
-					   PointDomainArray->GetValue(pts[2]),
-					   PointDomainArray->GetValue(pts[3])};
-		MyTriangulator->AddMultipleDomainTetrahedron(pts, doms);
+		int doms[4];
+		for (int n = 0; n < 4; n++)
+		{
+			doms[n] = cellScalars[std::find(ids, ids + 8, pts[n]) - ids];
+		}
+		slab.MyTriangulator->AddMultipleDomainTetrahedron(pts, doms);
 	}
 }
 
-void vtkImageExtractCompatibleMesher::TriangulateVoxel(int cellScalar, int flip,
-													   double spacing[3],
-													   vtkIdList* cellIds,
-													   vtkPoints* cellPts)
+void vtkImageExtractCompatibleMesher::TriangulateVoxel(vtkMesherSlab& slab,
+													   int cellScalar, int flip,
+													   double cellPts[8][3])
 {
-	Timer<1> timer;
-
-	double x[3], voxelOrigin[3];
 	double bounds[6];
 	vtkIdType id, ptId;
 	static int order_flip[2][8] = {
@@ -951,16 +1135,15 @@ void vtkImageExtractCompatibleMesher::TriangulateVoxel(int cellScalar, int flip,
 								  4, 5, 6, 7}; //injection order without flip
 
 	// compute bounds for voxel and initialize
-	cellPts->GetPoint(0, voxelOrigin);
 	for (int i = 0; i < 3; i++)
 	{
-		bounds[2 * i] = voxelOrigin[i];
-		bounds[2 * i + 1] = voxelOrigin[i] + spacing[i];
+		bounds[2 * i] = cellPts[0][i];
+		bounds[2 * i + 1] = cellPts[7][i];
 	}
 
 	// Initialize Delaunay insertion process with voxel triangulation.
 	// No more than 8 points (8 corners) may be inserted.
-	this->Triangulator->InitTriangulation(bounds, 8);
+	slab.Triangulator->InitTriangulation(bounds, 8);
 
 	// Inject ordered voxel corner points into triangulation. Recall
 	// that the PreSortedOn() flag was set in the triangulator.
@@ -971,34 +1154,30 @@ void vtkImageExtractCompatibleMesher::TriangulateVoxel(int cellScalar, int flip,
 		else
 			ptId = order_noflip[numPts];
 
-		cellPts->GetPoint(ptId, x);
-		if (this->Locator->InsertUniquePoint(x, id))
-		{
-			this->PointDomainArray->InsertValue(id, cellScalar);
-		}
-		this->Triangulator->InsertPoint(id, id, cellScalar, x, x, 0);
+		id = slab.Lattice->Key(cellPts[ptId]);
+		slab.Triangulator->InsertPoint(id, id, cellScalar, cellPts[ptId],
+									   cellPts[ptId], 0);
 	} //for eight voxel corner points
 
 	// triangulate the points
 	if (UseTemplates)
-		this->Triangulator->TemplateTriangulate(VTK_NUMBER_OF_CELL_TYPES + flip,
-												8, 12);
+		slab.Triangulator->TemplateTriangulate(VTK_NUMBER_OF_CELL_TYPES + flip,
+											   8, 12);
 	else
-		this->Triangulator->Triangulate();
+		slab.Triangulator->Triangulate();
 
 	// Add the triangulation to the mesh
-	this->Connectivity->Initialize();
-	this->Triangulator->AddTetras(0, this->Connectivity);
-	vtkIdType numNew = this->Connectivity->GetNumberOfCells();
+	slab.Connectivity->Initialize();
+	slab.Triangulator->AddTetras(0, slab.Connectivity);
+	vtkIdType numNew = slab.Connectivity->GetNumberOfCells();
 
 	vtkIdType npts, *pts;
 	int doms[4] = {cellScalar, cellScalar, cellScalar, cellScalar};
-	this->Connectivity->InitTraversal();
+	slab.Connectivity->InitTraversal();
 	for (vtkIdType i = 0; i < numNew; i++)
 	{
-		this->Connectivity->GetNextCell(npts, pts);
-		// this->Tetrahedra->push_back(pts[0],pts[1],pts[2],pts[3]);
-		MyTriangulator->AddMultipleDomainTetrahedron(pts, doms);
+		slab.Connectivity->GetNextCell(npts, pts);
+		slab.MyTriangulator->AddMultipleDomainTetrahedron(pts, doms);
 	}
 }
 
@@ -24,6 +24,7 @@ class vtkPoints;
 //BTX
 class TetContainer;
 class vtkTriangulatorImpl;
+class vtkMesherSlab;
 //ETX
 
 /**	\brief Extract compatible multi-domain surface mesh from label field
@@ -36,6 +37,10 @@ class vtkTriangulatorImpl;
 	templates. It uses a leaner data-structure (unsigned int for indices, different technique 
 	for tet neighbor computation).
 
+	The voxels are processed in z-slabs, which are meshed concurrently (OpenMP).
+	Points are identified by their position, so the result does not depend on
+	the number of threads and is identical to a serial run.
+
 	\note You should set the output name of the scalars. It will be used to differentiate
 	between different materials (e.g. in vtkEdgeCollapse)
 
@@ -71,10 +76,6 @@ public:
 	vtkSetMacro(UseTemplates, bool) vtkGetMacro(UseTemplates, bool);
 	vtkBooleanMacro(UseTemplates, bool);
 
-	// Use octree point locator: Default On
-	vtkSetMacro(UseOctreeLocator, bool) vtkGetMacro(UseOctreeLocator, bool);
-	vtkBooleanMacro(UseOctreeLocator, bool);
-
 	// Generate tetrahedral in second output: Default Off
 	// Attention: this will consume lots of memory
 	vtkSetMacro(GenerateTetMeshOutput, bool);
@@ -101,12 +102,16 @@ protected:
 	// to extract the surfaces between different material regions
 	int ContourSurface(vtkInformationVector**, vtkInformationVector*);
 
-	void ClipVoxel(vtkShortArray* cellScalars, int flip, double spacing[3],
-			vtkIdList* cellIds, vtkPoints* cellPts);
+	// Helper function for ContourSurface: mesh all voxels of a z-slab
+	void MeshSlab(vtkMesherSlab& slab);
 
-	// Helper function for ContourSurface
-	void TriangulateVoxel(int cellScalar, int flip, double spacing[3],
-			vtkIdList* cellIds, vtkPoints* cellPts);
+	// Helper function for MeshSlab
+	void ClipVoxel(vtkMesherSlab& slab, const short cellScalars[8], int flip,
+			double cellPts[8][3]);
+
+	// Helper function for MeshSlab
+	void TriangulateVoxel(vtkMesherSlab& slab, int cellScalar, int flip,
+			double cellPts[8][3]);
 
 	// Helper function for ContourSurface
 	int EvaluateLabel(double x[3]);
@@ -129,7 +134,6 @@ protected:
 	bool CreateVoxelCenterPoint;
 	int BackgroundLabel;
 	bool UseTemplates;
-	bool UseOctreeLocator;
 	char* OutputScalarName;
 	bool GenerateTetMeshOutput;
 	int MaxNumberOfIterations;